@@ -1562,6 +1562,20 @@ typedef int (* confval_cb_t)(RIG *,
 //! @endcond
 
 
+/**
+ * \brief State of the current VFO, see rig_get_state_snapshot()
+ */
+typedef struct rig_snapshot {
+    vfo_t vfo;          /*!< Current (RX) VFO */
+    freq_t freq;        /*!< Frequency of the current VFO */
+    rmode_t mode;       /*!< Mode of the current VFO */
+    pbwidth_t width;    /*!< Passband of the current VFO */
+    ptt_t ptt;          /*!< PTT status */
+    split_t split;      /*!< Split status */
+    vfo_t tx_vfo;       /*!< Transmit VFO */
+} rig_snapshot_t;
+
+
 /**
  * \brief Rig data structure.
  *
@@ -1852,6 +1866,9 @@ struct rig_caps {
     const char *clone_combo_set;    /*!< String describing key combination to enter load cloning mode */
     const char *clone_combo_get;    /*!< String describing key combination to enter save cloning mode */
     const char *macro_name;     /*!< Rig model macro name */
+
+    /* whole rig_snapshot_t in one transaction, mode may be left RIG_MODE_NONE */
+    int (*get_snapshot)(RIG *rig, rig_snapshot_t *snap);
 };
 //! @endcond
 
@@ -1990,6 +2007,33 @@ extern long long rig_get_caps_int(rig_model_t rig_model, enum rig_caps_int_e rig
 //! @cond Doxygen_Suppress
 extern const char* rig_get_caps_cptr(rig_model_t rig_model, enum rig_caps_cptr_e rig_caps);
 
+/**
+ * \brief Number of buckets in the rig_port_stats_t latency histograms
+ *
+ * Bucket i counts latencies from rig_port_stats_bucket_us(i) up to
+ * rig_port_stats_bucket_us(i + 1) microseconds, four buckets per power of
+ * two.  The last bucket also holds everything longer, from about 29 s.
+ */
+#define RIG_PORT_STATS_BUCKETS 96
+
+/**
+ * \brief Traffic statistics of a port, see rig_get_port_stats()
+ *
+ * Latencies are measured from the end of a write_block() to the first byte
+ * of each following read, and to the end of that read.
+ */
+typedef struct rig_port_stats {
+    unsigned long writes;       /*!< Frames sent */
+    unsigned long reads;        /*!< Frames received */
+    unsigned long timeouts;     /*!< Reads that timed out */
+    unsigned long retries;      /*!< Commands repeated by the backend after a failure */
+    unsigned long first_byte_max_us;    /*!< Longest write to first byte latency */
+    unsigned long complete_max_us;      /*!< Longest write to end of frame latency */
+    unsigned int first_byte_us[RIG_PORT_STATS_BUCKETS]; /*!< Histogram of write to first byte latencies */
+    unsigned int complete_us[RIG_PORT_STATS_BUCKETS];   /*!< Histogram of write to end of frame latencies */
+    unsigned long complete_sum_us;      /*!< Sum of the write to end of frame latencies */
+} rig_port_stats_t;
+
 /**
  * \brief Port definition
  *
@@ -2070,9 +2114,32 @@ typedef enum {
     HAMLIB_CACHE_FREQ,
     HAMLIB_CACHE_MODE,
     HAMLIB_CACHE_PTT,
-    HAMLIB_CACHE_SPLIT
+    HAMLIB_CACHE_SPLIT,
+    HAMLIB_CACHE_METER, // read-only levels and parms, see RIG_LEVEL_READONLY_LIST
+    HAMLIB_CACHE_TRN // entries the rig keeps current through transceive frames
 } hamlib_cache_t;
 
+/**
+ * \brief Time stamp of a cache entry
+ *
+ * Taken from CLOCK_MONOTONIC_COARSE where available, so clock steps
+ * neither age nor refresh entries.  See hl_cache_set(), hl_cache_age_ms().
+ */
+struct rig_cache_time {
+    struct timespec ts;
+    int valid;  // cleared to invalidate the entry
+};
+
+/**
+ * \brief Cache hit and miss counts, see rig_get_cache_stats()
+ */
+typedef struct rig_cache_stats {
+    unsigned long hits[HAMLIB_CACHE_SPLIT + 1];     /*!< Reads answered from the cache, by hamlib_cache_t item */
+    unsigned long misses[HAMLIB_CACHE_SPLIT + 1];   /*!< Reads that went to the rig, by hamlib_cache_t item */
+    unsigned long setting_hits;     /*!< Level, func and parm reads answered from the cache */
+    unsigned long setting_misses;   /*!< Level, func and parm reads that went to the rig */
+} rig_cache_stats_t;
+
 /**
  * \brief Rig cache data
  * 
@@ -2224,6 +2291,8 @@ struct rig_state {
     int power_max;              /*!< Maximum RF power level in rig units */
     unsigned char disable_yaesu_bandselect; /*!< Disables Yaeus band select logic */
     int twiddle_rit;            /*!< Suppresses VFOB reading (cached value used) so RIT control can be used */
+    /* keep last, only hamlib allocates rig_state */
+    rig_ptr_t internal;         /*!< Async engine, cache statistics and other state of the frontend (internal use) */
 };
 
 //! @cond Doxygen_Suppress
@@ -2345,6 +2414,16 @@ rig_get_vfo_info HAMLIB_PARAMS((RIG *rig,
 extern HAMLIB_EXPORT(int)
 rig_get_vfo_list HAMLIB_PARAMS((RIG *rig, char *buf, int buflen));
 
+extern HAMLIB_EXPORT(int)
+rig_get_state_snapshot HAMLIB_PARAMS((RIG *rig,
+                                      rig_snapshot_t *snap));
+
+extern HAMLIB_EXPORT(void)
+rig_publish_cache HAMLIB_PARAMS((RIG *rig));
+extern HAMLIB_EXPORT(int)
+rig_get_published_cache HAMLIB_PARAMS((RIG *rig,
+                                       rig_snapshot_t *snap));
+
 extern HAMLIB_EXPORT(int)
 netrigctl_get_vfo_mode HAMLIB_PARAMS((RIG *rig));
 
@@ -2835,6 +2914,106 @@ rig_set_pltune_callback HAMLIB_PARAMS((RIG *,
                                        pltune_cb_t,
                                        rig_ptr_t));
 
+/**
+ * \brief Asynchronous request operations
+ * \sa rig_async_submit()
+ */
+enum rig_async_op_e {
+    RIG_ASYNC_GET_FREQ,         /*!< rig_get_freq(), result in freq */
+    RIG_ASYNC_SET_FREQ,         /*!< rig_set_freq() with freq */
+    RIG_ASYNC_GET_MODE,         /*!< rig_get_mode(), result in mode/width */
+    RIG_ASYNC_SET_MODE,         /*!< rig_set_mode() with mode/width */
+    RIG_ASYNC_GET_VFO,          /*!< rig_get_vfo(), result in vfo */
+    RIG_ASYNC_SET_VFO,          /*!< rig_set_vfo() with vfo */
+    RIG_ASYNC_GET_PTT,          /*!< rig_get_ptt(), result in ptt */
+    RIG_ASYNC_SET_PTT,          /*!< rig_set_ptt() with ptt */
+    RIG_ASYNC_GET_SPLIT_VFO,    /*!< rig_get_split_vfo(), result in split/tx_vfo */
+    RIG_ASYNC_SET_SPLIT_VFO,    /*!< rig_set_split_vfo() with split/tx_vfo */
+    RIG_ASYNC_GET_LEVEL,        /*!< rig_get_level() of setting, result in val */
+    RIG_ASYNC_SET_LEVEL,        /*!< rig_set_level() of setting with val */
+    RIG_ASYNC_GET_FUNC,         /*!< rig_get_func() of setting, result in status */
+    RIG_ASYNC_SET_FUNC          /*!< rig_set_func() of setting with status */
+};
+
+//! @cond Doxygen_Suppress
+typedef struct rig_async_req rig_async_req_t;
+
+typedef void (*rig_async_cb_t)(RIG *, rig_async_req_t *, rig_ptr_t);
+//! @endcond
+
+/**
+ * \brief Asynchronous request
+ *
+ * Filled in by the caller and handed to rig_async_submit().  The memory
+ * belongs to the caller but must stay valid until the request completes.
+ * Only the fields used by \a op are read or written.
+ */
+struct rig_async_req {
+    enum rig_async_op_e op;     /*!< Operation to perform */
+    vfo_t vfo;                  /*!< Target VFO, or VFO read back */
+    freq_t freq;                /*!< Frequency */
+    rmode_t mode;               /*!< Mode */
+    pbwidth_t width;            /*!< Passband width */
+    ptt_t ptt;                  /*!< PTT status */
+    split_t split;              /*!< Split status */
+    vfo_t tx_vfo;               /*!< Split TX VFO */
+    setting_t setting;          /*!< Level or function */
+    value_t val;                /*!< Level value */
+    int status;                 /*!< Function status */
+    int retcode;                /*!< Result, RIG_OK or a negative error code */
+    rig_async_cb_t cb;          /*!< Completion callback, NULL to queue the
+                                     request for rig_async_next_done() */
+    rig_ptr_t cb_arg;           /*!< Argument passed to \a cb */
+    rig_async_req_t *next;      /*!< Queue link, internal use */
+};
+
+extern HAMLIB_EXPORT(int)
+rig_async_open HAMLIB_PARAMS((RIG *rig));
+
+extern HAMLIB_EXPORT(int)
+rig_async_close HAMLIB_PARAMS((RIG *rig));
+
+extern HAMLIB_EXPORT(int)
+rig_async_submit HAMLIB_PARAMS((RIG *rig,
+                                rig_async_req_t *req));
+
+extern HAMLIB_EXPORT(int)
+rig_async_get_fd HAMLIB_PARAMS((RIG *rig));
+
+extern HAMLIB_EXPORT(rig_async_req_t *)
+rig_async_next_done HAMLIB_PARAMS((RIG *rig));
+
+/**
+ * \brief Direction byte in front of each frame written by rig_wirecap_dump()
+ */
+enum rig_wirecap_dir_e {
+    RIG_WIRECAP_TX = 0,         /*!< Frame sent to the rig */
+    RIG_WIRECAP_RX = 1,         /*!< Frame received from the rig */
+    RIG_WIRECAP_RX_TIMEOUT = 2  /*!< Bytes received before a read timed out */
+};
+
+/** \brief pcap link type of rig_wirecap_dump() files, LINKTYPE_USER0 */
+#define RIG_WIRECAP_LINKTYPE 147
+
+extern HAMLIB_EXPORT(int)
+rig_wirecap_dump HAMLIB_PARAMS((RIG *rig,
+                                const char *path));
+
+extern HAMLIB_EXPORT(int)
+rig_get_port_stats HAMLIB_PARAMS((RIG *rig,
+                                  rig_port_stats_t *stats));
+
+extern HAMLIB_EXPORT(int)
+rig_get_cache_stats HAMLIB_PARAMS((RIG *rig,
+                                   rig_cache_stats_t *stats));
+
+extern HAMLIB_EXPORT(unsigned long)
+rig_port_stats_bucket_us HAMLIB_PARAMS((int bucket));
+
+extern HAMLIB_EXPORT(unsigned long)
+rig_port_stats_percentile HAMLIB_PARAMS((const unsigned int *histogram,
+                                         double percent));
+
 extern HAMLIB_EXPORT(int)
 rig_set_twiddle HAMLIB_PARAMS((RIG *rig,
                                  int seconds));
@@ -2892,15 +3071,21 @@ extern HAMLIB_EXPORT(int)
 rig_need_debug HAMLIB_PARAMS((enum rig_debug_level_e debug_level));
 
 
-// this need to be fairly big to avoid compiler warnings
+// Deprecated and no longer written, they stay empty; rigerror() appends
+// the recent debug messages instead.  Will be removed in 5.0
 #define DEBUGMSGSAVE_SIZE 24000
 extern HAMLIB_EXPORT_VAR(char) debugmsgsave[DEBUGMSGSAVE_SIZE];  // last debug msg
 extern HAMLIB_EXPORT_VAR(char) debugmsgsave2[DEBUGMSGSAVE_SIZE];  // last-1 debug msg
 extern HAMLIB_EXPORT_VAR(char) debugmsgsave3[DEBUGMSGSAVE_SIZE];  // last-2 debug msg
+
+// Messages at RIG_DEBUG_WARN and above are always kept in a small ring
+// of recent messages that rigerror() appends, lower levels only when enabled
+#define RIG_DEBUG_SAVE_LEVEL RIG_DEBUG_WARN
 #ifndef __cplusplus
 #ifdef __GNUC__
-// doing the debug macro with a dummy sprintf allows gcc to check the format string
-#define rig_debug(debug_level,fmt,...) do { strncpy(debugmsgsave3, debugmsgsave2,sizeof(debugmsgsave3));strncpy(debugmsgsave2, debugmsgsave, sizeof(debugmsgsave2));snprintf(debugmsgsave,sizeof(debugmsgsave),fmt,__VA_ARGS__);rig_debug(debug_level,fmt,##__VA_ARGS__); } while(0);
+// the level check comes first so a disabled message does not even evaluate
+// its arguments; the dead snprintf allows gcc to check the format string
+#define rig_debug(debug_level,fmt,...) do { if (0) { snprintf(NULL,0,fmt,##__VA_ARGS__); } if ((debug_level) <= RIG_DEBUG_SAVE_LEVEL || rig_need_debug(debug_level)) { rig_debug(debug_level,fmt,##__VA_ARGS__); } } while(0);
 #endif
 #endif
 extern HAMLIB_EXPORT(void)
@@ -2979,6 +3164,7 @@ extern HAMLIB_EXPORT(void) rig_no_restore_ai();
 
 extern HAMLIB_EXPORT(int) rig_get_cache_timeout_ms(RIG *rig, hamlib_cache_t selection);
 extern HAMLIB_EXPORT(int) rig_set_cache_timeout_ms(RIG *rig, hamlib_cache_t selection, int ms);
+extern HAMLIB_EXPORT(void) rig_set_cache_request_time(RIG *rig, const struct rig_cache_time *t);
 
 extern HAMLIB_EXPORT(int) rig_set_vfo_opt(RIG *rig, int status);
 extern HAMLIB_EXPORT(int) rig_get_vfo_info(RIG *rig, vfo_t vfo, freq_t *freq, rmode_t *mode, pbwidth_t *width, split_t *split);
@@ -52,7 +52,7 @@
 #define NB_CHAN 22      /* see caps->chan_list */
 
 
-#define CMDSLEEP 20*1000  /* ms for each command */
+#define CMDSLEEP 20*1000  /* default us for each command, see cmd_delay */
 
 struct dummy_priv_data
 {
@@ -79,6 +79,7 @@ struct dummy_priv_data
 
     char *magic_conf;
     int static_data;
+    int cmd_sleep;      /* us */
 
     //freq_t freq_vfoa;
     //freq_t freq_vfob;
@@ -136,6 +137,10 @@ static const struct confparams dummy_cfg_params[] =
         TOK_CFG_STATIC_DATA, "static_data", "Static data", "Output only static data, no randomization of meter values",
         "0", RIG_CONF_CHECKBUTTON, { }
     },
+    {
+        TOK_CFG_CMD_DELAY, "cmd_delay", "Command delay", "Time each command takes, in ms, to simulate a slow rig",
+        "20", RIG_CONF_NUMERIC, { .n = { 0, 10000, 1 } }
+    },
     { RIG_CONF_END, NULL, }
 };
 
@@ -271,6 +276,7 @@ static int dummy_init(RIG *rig)
     }
 
     priv->magic_conf = strdup("DX");
+    priv->cmd_sleep = CMDSLEEP;
 
     RETURNFUNC(RIG_OK);
 }
@@ -303,6 +309,16 @@ static int dummy_cleanup(RIG *rig)
     RETURNFUNC(RIG_OK);
 }
 
+static void dummy_cmd_sleep(const RIG *rig)
+{
+    const struct dummy_priv_data *priv = (struct dummy_priv_data *)rig->state.priv;
+
+    if (priv->cmd_sleep > 0)
+    {
+        usleep(priv->cmd_sleep);
+    }
+}
+
 static int dummy_open(RIG *rig)
 {
     ENTERFUNC;
@@ -316,7 +332,7 @@ static int dummy_open(RIG *rig)
         rig->caps->get_vfo = NULL;
     }
 
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
 
     RETURNFUNC(RIG_OK);
 }
@@ -325,7 +341,7 @@ static int dummy_close(RIG *rig)
 {
     ENTERFUNC;
 
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
 
     RETURNFUNC(RIG_OK);
 }
@@ -352,6 +368,10 @@ static int dummy_set_conf(RIG *rig, token_t token, const char *val)
         priv->static_data = atoi(val) ? 1 : 0;
         break;
 
+    case TOK_CFG_CMD_DELAY:
+        priv->cmd_sleep = atoi(val) * 1000;
+        break;
+
     default:
         RETURNFUNC(-RIG_EINVAL);
     }
@@ -372,6 +392,10 @@ static int dummy_get_conf(RIG *rig, token_t token, char *val)
         strcpy(val, priv->magic_conf);
         break;
 
+    case TOK_CFG_CMD_DELAY:
+        sprintf(val, "%d", priv->cmd_sleep / 1000);
+        break;
+
     default:
         RETURNFUNC(-RIG_EINVAL);
     }
@@ -388,7 +412,7 @@ static int dummy_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
 
     if (vfo == RIG_VFO_CURR) { vfo = priv->curr_vfo; }
 
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     sprintf_freq(fstr, sizeof(fstr), freq);
     rig_debug(RIG_DEBUG_VERBOSE, "%s called: %s %s\n", __func__,
               rig_strvfo(vfo), fstr);
@@ -424,7 +448,7 @@ static int dummy_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
         RETURNFUNC(RIG_OK);
     }
 
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     rig_debug(RIG_DEBUG_VERBOSE, "%s called: %s\n", __func__, rig_strvfo(vfo));
 
     switch (vfo)
@@ -450,7 +474,7 @@ static int dummy_set_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
     char buf[16];
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     sprintf_freq(buf, sizeof(buf), width);
     rig_debug(RIG_DEBUG_VERBOSE, "%s called: %s %s %s\n", __func__,
               rig_strvfo(vfo), rig_strrmode(mode), buf);
@@ -478,7 +502,7 @@ static int dummy_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     rig_debug(RIG_DEBUG_VERBOSE, "%s called: %s\n", __func__, rig_strvfo(vfo));
 
     *mode = curr->mode;
@@ -494,7 +518,7 @@ static int dummy_set_vfo(RIG *rig, vfo_t vfo)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     rig_debug(RIG_DEBUG_VERBOSE, "%s called: %s\n", __func__, rig_strvfo(vfo));
 
     priv->last_vfo = priv->curr_vfo;
@@ -543,7 +567,7 @@ static int dummy_get_vfo(RIG *rig, vfo_t *vfo)
     struct dummy_priv_data *priv = (struct dummy_priv_data *)rig->state.priv;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     *vfo = priv->curr_vfo;
 
     RETURNFUNC(RIG_OK);
@@ -568,7 +592,7 @@ static int dummy_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     int status = 0;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
 
     // sneak a look at the hardware PTT and OR that in with our result
     // as if it had keyed us
@@ -641,7 +665,7 @@ static int dummy_get_dcd(RIG *rig, vfo_t vfo, dcd_t *dcd)
     static int twiddle = 0;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     *dcd = (twiddle++ & 1) ? RIG_DCD_ON : RIG_DCD_OFF;
 
     RETURNFUNC(RIG_OK);
@@ -654,7 +678,7 @@ static int dummy_set_rptr_shift(RIG *rig, vfo_t vfo, rptr_shift_t rptr_shift)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     curr->rptr_shift = rptr_shift;
 
     RETURNFUNC(RIG_OK);
@@ -667,7 +691,7 @@ static int dummy_get_rptr_shift(RIG *rig, vfo_t vfo, rptr_shift_t *rptr_shift)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     *rptr_shift = curr->rptr_shift;
 
     RETURNFUNC(RIG_OK);
@@ -680,7 +704,7 @@ static int dummy_set_rptr_offs(RIG *rig, vfo_t vfo, shortfreq_t rptr_offs)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     curr->rptr_offs = rptr_offs;
 
     RETURNFUNC(RIG_OK);
@@ -705,7 +729,7 @@ static int dummy_set_ctcss_tone(RIG *rig, vfo_t vfo, tone_t tone)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     curr->ctcss_tone = tone;
 
     RETURNFUNC(RIG_OK);
@@ -718,7 +742,7 @@ static int dummy_get_ctcss_tone(RIG *rig, vfo_t vfo, tone_t *tone)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     *tone = curr->ctcss_tone;
 
     RETURNFUNC(RIG_OK);
@@ -731,7 +755,7 @@ static int dummy_set_dcs_code(RIG *rig, vfo_t vfo, tone_t code)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     curr->dcs_code = code;
 
     RETURNFUNC(RIG_OK);
@@ -744,7 +768,7 @@ static int dummy_get_dcs_code(RIG *rig, vfo_t vfo, tone_t *code)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     *code = curr->dcs_code;
 
     RETURNFUNC(RIG_OK);
@@ -757,7 +781,7 @@ static int dummy_set_ctcss_sql(RIG *rig, vfo_t vfo, tone_t tone)
     channel_t *curr = priv->curr;
 
     ENTERFUNC;
-    usleep(CMDSLEEP);
+    dummy_cmd_sleep(rig);
     curr->ctcss_sql = tone;
 
     RETURNFUNC(RIG_OK);
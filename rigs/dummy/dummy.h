@@ -28,6 +28,7 @@
 /* backend conf */
 #define TOK_CFG_MAGICCONF    TOKEN_BACKEND(1)
 #define TOK_CFG_STATIC_DATA  TOKEN_BACKEND(2)
+#define TOK_CFG_CMD_DELAY    TOKEN_BACKEND(3)
 
 
 /* ext_level's and ext_parm's tokens */
@@ -30,6 +30,13 @@
 #include <math.h>
 #include <time.h>
 #include <errno.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define MKDIR(path) _mkdir(path)
+#else
+#define MKDIR(path) mkdir(path, 0755)
+#endif
 
 #include "hamlib/rig.h"
 #include "network.h"
@@ -37,6 +44,7 @@
 #include "iofunc.h"
 #include "misc.h"
 #include "num_stdio.h"
+#include "event.h"
 
 #include "dummy.h"
 
@@ -49,6 +57,36 @@ struct netrigctl_priv_data
 {
     vfo_t vfo_curr;
     int rigctld_vfo_mode;
+    int has_snapshot;   /* server knows dump_state2, and get_snapshot with it */
+    int subscribed;     /* the server pushes the values below when they change */
+    int push_valid;     /* PUSH_* of the values held */
+    struct rig_cache_time push_heard;   /* last line read from the server */
+    freq_t push_freq;   /* of the current VFO, like the rest */
+    rmode_t push_mode;
+    pbwidth_t push_width;
+    vfo_t push_vfo;
+    ptt_t push_ptt;
+    split_t push_split;
+    vfo_t push_tx_vfo;
+};
+
+#define PUSH_FREQ   0x01
+#define PUSH_MODE   0x02
+#define PUSH_VFO    0x04
+#define PUSH_PTT    0x08
+#define PUSH_SPLIT  0x10
+#define PUSH_ALL    0x1f
+
+/* max reply lines of a pipelined command, get_snapshot has the most */
+#define PIPE_LINES 7
+
+/* one command of netrigctl_pipeline() and its reply */
+struct netrigctl_req
+{
+    char cmd[CMD_MAX];
+    int lines;                          /* reply lines on success */
+    char reply[PIPE_LINES][BUF_MAX];    /* chomped */
+    int ret;                            /* RIG_OK or the RPRT code */
 };
 
 int netrigctl_get_vfo_mode(RIG *rig)
@@ -58,6 +96,248 @@ int netrigctl_get_vfo_mode(RIG *rig)
     return priv->rigctld_vfo_mode;
 }
 
+/*
+ * Reading from the server failed, the connection is most likely gone:
+ * no more notifications will come, so drop what they brought and let
+ * the getters ask the server, which reports the error
+ */
+static void netrigctl_push_lost(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    if (priv->subscribed)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: read failed, subscription dropped\n",
+                  __func__);
+    }
+
+    priv->subscribed = 0;
+    priv->push_valid = 0;
+}
+
+/*
+ * Notifications of the subscription made in netrigctl_open() arrive
+ * between replies in the extended response format, e.g. "get_freq:",
+ * "Frequency: 14074000", "RPRT 0".  Given the line read, this takes in
+ * the rest of such a block and returns 1, or 0 when the line is not
+ * the start of one.  The values go to rig_cache through the
+ * rig_fire_*_event() helpers, as transceive frames do, and stay here
+ * for the getters.
+ */
+static int netrigctl_push(RIG *rig, const char *line)
+{
+    static const char *const header[] =
+    {
+        "get_freq:", "get_mode:", "get_vfo:", "get_ptt:", "get_split_vfo:"
+    };
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char value[2][BUF_MAX];
+    char buf[BUF_MAX];
+    int item = -1;
+    int n = 0;
+    int err = RIG_OK;
+    int ret;
+    int i;
+
+    if (!priv->subscribed || strncmp(line, "get_", 4) != 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < 5; i++)
+    {
+        if (!strncmp(line, header[i], strlen(header[i]))
+                && strchr("\r\n", line[strlen(header[i])]))
+        {
+            item = i;
+        }
+    }
+
+    if (item < 0)
+    {
+        return 0;
+    }
+
+    do
+    {
+        ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+
+        if (ret <= 0)
+        {
+            netrigctl_push_lost(rig);
+            return 1;
+        }
+
+        strtok(buf, "\r\n");
+
+        if (strncmp(buf, NETRIGCTL_RET, strlen(NETRIGCTL_RET)) == 0)
+        {
+            err = atoi(buf + strlen(NETRIGCTL_RET));
+            break;
+        }
+
+        if (n < 2 && strstr(buf, ": "))
+        {
+            snprintf(value[n++], BUF_MAX, "%s", strstr(buf, ": ") + 2);
+        }
+    }
+    while (1);
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: %s %s %s\n", __func__, header[item],
+              n > 0 ? value[0] : "", n > 1 ? value[1] : "");
+
+    hl_cache_set(&priv->push_heard);
+    priv->push_valid &= ~(1 << item);
+
+    if (err != RIG_OK || n < ((item == 1 || item == 4) ? 2 : 1))
+    {
+        return 1;
+    }
+
+    switch (item)
+    {
+    case 0:
+        if (num_sscanf(value[0], "%"SCNfreq, &priv->push_freq) != 1) { return 1; }
+
+        priv->push_valid |= PUSH_FREQ;
+        rig_fire_freq_event(rig, RIG_VFO_CURR, priv->push_freq);
+        break;
+
+    case 1:
+        priv->push_mode = rig_parse_mode(value[0]);
+        priv->push_width = atol(value[1]);
+        priv->push_valid |= PUSH_MODE;
+        rig_fire_mode_event(rig, RIG_VFO_CURR, priv->push_mode, priv->push_width);
+        break;
+
+    case 2:
+        priv->push_vfo = rig_parse_vfo(value[0]);
+        priv->vfo_curr = priv->push_vfo;
+        priv->push_valid |= PUSH_VFO;
+        rig_fire_vfo_event(rig, priv->push_vfo);
+        break;
+
+    case 3:
+        priv->push_ptt = atoi(value[0]);
+        priv->push_valid |= PUSH_PTT;
+        rig_fire_ptt_event(rig, RIG_VFO_CURR, priv->push_ptt);
+        break;
+
+    case 4:
+        priv->push_split = atoi(value[0]);
+        priv->push_tx_vfo = rig_parse_vfo(value[1]);
+        priv->push_valid |= PUSH_SPLIT;
+        break;
+    }
+
+    return 1;
+}
+
+/*
+ * Takes in the notifications already received, without waiting.  In
+ * place of rig_flush() once subscribed, anything else is dropped.
+ */
+static void netrigctl_drain(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char buf[BUF_MAX];
+
+    if (!priv->subscribed)
+    {
+        rig_flush(&rig->state.rigport);
+        return;
+    }
+
+    while (port_pending(&rig->state.rigport))
+    {
+        if (read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1) <= 0)
+        {
+            netrigctl_push_lost(rig);
+            break;
+        }
+
+        if (!netrigctl_push(rig, buf))
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: dropped '%s'\n", __func__,
+                      strtok(buf, "\r\n"));
+        }
+    }
+}
+
+/* first line of a reply, past any notifications in front of it */
+static int netrigctl_read_reply(RIG *rig, char *buf)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    int ret;
+
+    do
+    {
+        ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    }
+    while (ret > 0 && netrigctl_push(rig, buf));
+
+    if (ret <= 0)
+    {
+        netrigctl_push_lost(rig);
+    }
+    else
+    {
+        hl_cache_set(&priv->push_heard);
+    }
+
+    return ret;
+}
+
+/*
+ * Whether a pushed value answers for vfo: without VFO mode the server
+ * only ever reports the current VFO
+ */
+static int netrigctl_push_vfo(RIG *rig, vfo_t vfo)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    return !priv->rigctld_vfo_mode || vfo == RIG_VFO_CURR
+           || ((priv->push_valid & PUSH_VFO) && vfo == priv->push_vfo);
+}
+
+/*
+ * For our own commands that may change pushed values: these are not
+ * known any more until the server sends them again, which it does
+ * after every set command of a subscriber
+ */
+static void netrigctl_push_forget(RIG *rig, int items)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    priv->push_valid &= ~items;
+}
+
+/*
+ * A pushed value is current and answers for vfo.  A link that died
+ * without closing says nothing, so once the server has been quiet for
+ * the HAMLIB_CACHE_TRN timeout the getters ask it again, and its reply
+ * vouches for what was pushed.
+ */
+static int netrigctl_pushed(RIG *rig, int items, vfo_t vfo)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+
+    if (!priv->subscribed)
+    {
+        return 0;
+    }
+
+    netrigctl_drain(rig);
+
+    if (hl_cache_age_ms(&priv->push_heard)
+            > rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_TRN))
+    {
+        return 0;
+    }
+
+    return (priv->push_valid & items) == items && netrigctl_push_vfo(rig, vfo);
+}
+
 /*
  * Helper function with protocol return code parsing
  */
@@ -68,7 +348,7 @@ static int netrigctl_transaction(RIG *rig, char *cmd, int len, char *buf)
     rig_debug(RIG_DEBUG_VERBOSE, "%s: called len=%d\n", __func__, len);
 
     /* flush anything in the read buffer before command is sent */
-    rig_flush(&rig->state.rigport);
+    netrigctl_drain(rig);
 
     ret = write_block(&rig->state.rigport, cmd, len);
 
@@ -77,7 +357,7 @@ static int netrigctl_transaction(RIG *rig, char *cmd, int len, char *buf)
         return ret;
     }
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = netrigctl_read_reply(rig, buf);
 
     if (ret < 0)
     {
@@ -92,6 +372,77 @@ static int netrigctl_transaction(RIG *rig, char *cmd, int len, char *buf)
     return ret;
 }
 
+/*
+ * Sends all the commands in one write and then matches the replies in
+ * order: a get command answers its value lines, or a single RPRT line
+ * when it fails.  One round trip instead of n.  An error is returned
+ * only when the connection itself failed, the outcome of each command
+ * is in its ret.
+ */
+static int netrigctl_pipeline(RIG *rig, struct netrigctl_req *req, int n)
+{
+    char cmd[CMD_MAX * 8];
+    int len = 0;
+    int ret;
+    int i, j;
+
+    if (n > 8)
+    {
+        return -RIG_EINVAL;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        len += sprintf(cmd + len, "%s", req[i].cmd);
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: called n=%d len=%d\n", __func__, n, len);
+
+    netrigctl_drain(rig);
+
+    ret = write_block(&rig->state.rigport, cmd, len);
+
+    if (ret != RIG_OK)
+    {
+        return ret;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        req[i].ret = RIG_OK;
+
+        for (j = 0; j < req[i].lines; j++)
+        {
+            char *buf = req[i].reply[j];
+
+            if (j == 0)
+            {
+                ret = netrigctl_read_reply(rig, buf);
+            }
+            else
+            {
+                ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+            }
+
+            if (ret <= 0)
+            {
+                netrigctl_push_lost(rig);
+                return (ret < 0) ? ret : -RIG_EPROTO;
+            }
+
+            if (buf[ret - 1] == '\n') { buf[ret - 1] = '\0'; } /* chomp */
+
+            if (j == 0 && strncmp(buf, NETRIGCTL_RET, strlen(NETRIGCTL_RET)) == 0)
+            {
+                req[i].ret = atoi(buf + strlen(NETRIGCTL_RET));
+                break;
+            }
+        }
+    }
+
+    return RIG_OK;
+}
+
 /* this will fill vfostr with the vfo value if the vfo mode is enabled
  * otherwise string will be null terminated
  * this allows us to use the string in snprintf in either mode
@@ -198,22 +549,347 @@ static int netrigctl_cleanup(RIG *rig)
     return RIG_OK;
 }
 
+/*
+ * dump_state lines come either straight from the socket (the original
+ * dump_state) or from a buffer holding a dump_state2 body
+ */
+struct dump_state_src
+{
+    hamlib_port_t *port;
+    const char *mem;
+    size_t len;
+    size_t pos;
+};
+
+/* same contract as read_string(..., "\n", 1) */
+static int dump_state_line(struct dump_state_src *src, char *buf, int buf_len)
+{
+    int n = 0;
+
+    if (!src->mem)
+    {
+        return read_string(src->port, buf, buf_len, "\n", 1);
+    }
+
+    while (src->pos < src->len && n < buf_len - 1)
+    {
+        buf[n++] = src->mem[src->pos++];
+
+        if (buf[n - 1] == '\n')
+        {
+            break;
+        }
+    }
+
+    buf[n] = '\0';
+
+    return n > 0 ? n : -RIG_EPROTO;
+}
+
+static unsigned long long dump_state_hash(const char *body, size_t len)
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL;   /* FNV-1a */
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)body[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/*
+ * Where the dump_state2 body of a server is kept between runs:
+ * $XDG_CACHE_HOME/hamlib, or ~/.cache/hamlib, one file per host:port.
+ * With mkdirs set the directories are created.
+ */
+static int dump_state_cache_path(RIG *rig, char *path, int path_len, int mkdirs)
+{
+    const char *dir = getenv("XDG_CACHE_HOME");
+    const char *sub = "";
+    char host[128];
+    int i;
+
+    if (!dir || !dir[0])
+    {
+        dir = getenv("HOME");
+        sub = "/.cache";
+    }
+
+    if (!dir || !dir[0])
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    snprintf(host, sizeof(host), "%.127s", rig->state.rigport.pathname);
+
+    for (i = 0; host[i]; i++)
+    {
+        if (host[i] == '/' || host[i] == '\\' || host[i] == ':')
+        {
+            host[i] = '_';
+        }
+    }
+
+    if (mkdirs)
+    {
+        snprintf(path, path_len, "%s%s", dir, sub);
+        MKDIR(path);
+        snprintf(path, path_len, "%s%s/hamlib", dir, sub);
+        MKDIR(path);
+    }
+
+    snprintf(path, path_len, "%s%s/hamlib/netrigctl-%s", dir, sub, host);
+
+    return RIG_OK;
+}
+
+/*
+ * Loads the cached body, which must hash to what its first line says.
+ * Returns the body (to be freed) and its hash in hash_str, or NULL.
+ */
+static char *dump_state_cache_load(RIG *rig, char *hash_str, size_t *len)
+{
+    char path[HAMLIB_FILPATHLEN];
+    char line[32];
+    char *body;
+    long size;
+    FILE *fp;
+
+    if (dump_state_cache_path(rig, path, sizeof(path), 0) != RIG_OK)
+    {
+        return NULL;
+    }
+
+    fp = fopen(path, "rb");
+
+    if (!fp)
+    {
+        return NULL;
+    }
+
+    if (!fgets(line, sizeof(line), fp)
+            || fseek(fp, 0, SEEK_END) != 0
+            || (size = ftell(fp) - (long)strlen(line)) <= 0
+            || fseek(fp, (long)strlen(line), SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    body = malloc(size);
+
+    if (!body || fread(body, 1, size, fp) != (size_t)size)
+    {
+        free(body);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+
+    snprintf(hash_str, 17, "%016llx", dump_state_hash(body, size));
+
+    if (strncmp(line, hash_str, 16) != 0)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: stale %s ignored\n", __func__, path);
+        free(body);
+        return NULL;
+    }
+
+    *len = size;
+
+    return body;
+}
+
+static void dump_state_cache_save(RIG *rig, const char *hash_str,
+                                  const char *body, size_t len)
+{
+    char path[HAMLIB_FILPATHLEN];
+    FILE *fp;
+
+    if (dump_state_cache_path(rig, path, sizeof(path), 1) != RIG_OK)
+    {
+        return;
+    }
+
+    fp = fopen(path, "wb");
+
+    if (!fp)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: cannot write %s: %s\n", __func__, path,
+                  strerror(errno));
+        return;
+    }
+
+    fprintf(fp, "%s\n", hash_str);
+    fwrite(body, 1, len, fp);
+    fclose(fp);
+}
+
+/*
+ * Asks for dump_state2 and chk_vfo in one write.  A server without
+ * dump_state2 ignores the first line and only answers chk_vfo, whose
+ * reply is then left in buf and *state set to NULL.  Otherwise *state is
+ * the body (to be freed), from the server or from the disk cache when
+ * the server says ours is current, and buf holds the chk_vfo reply.
+ * Fails when a body was announced but cannot be read whole, since the
+ * connection is then out of step.
+ */
+static int netrigctl_dump_state2(RIG *rig, char *buf, char **state,
+                                 size_t *len)
+{
+    hamlib_port_t *port = &rig->state.rigport;
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char cmd[CMD_MAX];
+    char hash_str[17] = "0";
+    char server_hash[17];
+    char *cached;
+    char *body = NULL;
+    size_t cached_len = 0;
+    unsigned long body_len;
+    int ret;
+
+    buf[0] = '\0';
+    *state = NULL;
+
+    cached = dump_state_cache_load(rig, hash_str, &cached_len);
+
+    ret = sprintf(cmd, "\\dump_state2 #%s\n\\chk_vfo\n", hash_str);
+
+    rig_flush(port);
+
+    if (write_block(port, cmd, ret) != RIG_OK
+            || read_string(port, buf, BUF_MAX, "\n", 1) <= 0)
+    {
+        free(cached);
+        return RIG_OK;
+    }
+
+    if (sscanf(buf, "DUMP_STATE2 %16s %lu", server_hash, &body_len) != 2)
+    {
+        /* an error from dump_state2 rather than the chk_vfo reply */
+        if (strncmp(buf, NETRIGCTL_RET, strlen(NETRIGCTL_RET)) == 0)
+        {
+            read_string(port, buf, BUF_MAX, "\n", 1);
+        }
+
+        free(cached);
+        return RIG_OK;
+    }
+
+    priv->has_snapshot = 1;
+
+    if (body_len == 0 && cached && !strcmp(server_hash, hash_str))
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: using cached state %s\n", __func__,
+                  hash_str);
+        body = cached;
+        *len = cached_len;
+        cached = NULL;
+    }
+    else if (body_len > 0)
+    {
+        free(cached);
+        cached = NULL;
+
+        if (body_len >= 1024 * 1024)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: dump_state2 body of %lu bytes refused\n",
+                      __func__, body_len);
+            return -RIG_EPROTO;
+        }
+
+        body = malloc(body_len);
+
+        if (!body)
+        {
+            return -RIG_ENOMEM;
+        }
+
+        ret = read_block(port, body, body_len);
+
+        if (ret != (int)body_len)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: dump_state2 body cut short, %d of %lu bytes\n",
+                      __func__, ret, body_len);
+            free(body);
+            return ret < 0 ? ret : -RIG_EPROTO;
+        }
+
+        *len = body_len;
+        dump_state_cache_save(rig, server_hash, body, body_len);
+    }
+
+    free(cached);
+
+    if (read_string(port, buf, BUF_MAX, "\n", 1) <= 0)
+    {
+        free(body);
+        return RIG_OK;
+    }
+
+    *state = body;
+
+    return RIG_OK;
+}
+
+static int netrigctl_parse_state(RIG *rig, struct dump_state_src *src,
+                                 char *buf);
+
+/*
+ * Has the server push the values most often asked for, see
+ * netrigctl_push().  A server that knows dump_state2 can do this.
+ */
+static void netrigctl_subscribe(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = rig->state.priv;
+    char cmd[] = "\\subscribe freq mode vfo ptt split\n";
+    char buf[BUF_MAX];
+    int ret;
+
+    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+
+    if (ret != RIG_OK)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: subscribe failed: %s\n", __func__,
+                  rigerror(ret));
+        return;
+    }
+
+    priv->subscribed = 1;
+}
+
 static int netrigctl_open(RIG *rig)
 {
-    int ret, len, i;
-    struct rig_state *rs = &rig->state;
-    int prot_ver;
+    int ret, len;
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     struct netrigctl_priv_data *priv;
+    struct dump_state_src src = { &rig->state.rigport, NULL, 0, 0 };
+    char *state_body;
 
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
     priv = (struct netrigctl_priv_data *)rig->state.priv;
 
-    len = sprintf(cmd, "\\chk_vfo\n");
-    ret = netrigctl_transaction(rig, cmd, len, buf);
+    ret = netrigctl_dump_state2(rig, buf, &state_body, &src.len);
+
+    if (ret != RIG_OK)
+    {
+        return ret;
+    }
+
+    ret = strlen(buf);
+
+    if (!state_body && !buf[0])
+    {
+        len = sprintf(cmd, "\\chk_vfo\n");
+        ret = netrigctl_transaction(rig, cmd, len, buf);
+    }
 
     if (sscanf(buf, "CHKVFO %d", &priv->rigctld_vfo_mode) == 1)
     {
@@ -237,6 +913,26 @@ static int netrigctl_open(RIG *rig)
     rig_debug(RIG_DEBUG_VERBOSE, "%s: vfo_mode=%d\n", __func__,
               priv->rigctld_vfo_mode);
 
+    if (state_body)
+    {
+        src.mem = state_body;
+        ret = dump_state_line(&src, buf, BUF_MAX);
+
+        if (ret > 0)
+        {
+            ret = netrigctl_parse_state(rig, &src, buf);
+        }
+
+        free(state_body);
+
+        if (ret == RIG_OK)
+        {
+            netrigctl_subscribe(rig);
+        }
+
+        return ret;
+    }
+
     len = sprintf(cmd, "\\dump_state\n");
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
@@ -246,6 +942,16 @@ static int netrigctl_open(RIG *rig)
         return (ret < 0) ? ret : -RIG_EPROTO;
     }
 
+    return netrigctl_parse_state(rig, &src, buf);
+}
+
+/* buf holds the first line, the protocol version */
+static int netrigctl_parse_state(RIG *rig, struct dump_state_src *src, char *buf)
+{
+    int ret, i;
+    struct rig_state *rs = &rig->state;
+    int prot_ver;
+
     prot_ver = atoi(buf);
 #define RIGCTLD_PROT_VER 0
 
@@ -254,14 +960,14 @@ static int netrigctl_open(RIG *rig)
         return -RIG_EPROTO;
     }
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
         return (ret < 0) ? ret : -RIG_EPROTO;
     }
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -272,7 +978,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_FRQRANGESIZ; i++)
     {
-        ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+        ret = dump_state_line(src, buf, BUF_MAX);
 
         if (ret <= 0)
         {
@@ -302,7 +1008,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_FRQRANGESIZ; i++)
     {
-        ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+        ret = dump_state_line(src, buf, BUF_MAX);
 
         if (ret <= 0)
         {
@@ -332,7 +1038,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_TSLSTSIZ; i++)
     {
-        ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+        ret = dump_state_line(src, buf, BUF_MAX);
 
         if (ret <= 0)
         {
@@ -356,7 +1062,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_FLTLSTSIZ; i++)
     {
-        ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+        ret = dump_state_line(src, buf, BUF_MAX);
 
         if (ret <= 0)
         {
@@ -383,7 +1089,7 @@ static int netrigctl_open(RIG *rig)
     chan_t chan_list[HAMLIB_CHANLSTSIZ]; /*!< Channel list, zero ended */
 #endif
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -392,7 +1098,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->max_rit = atol(buf);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -401,7 +1107,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->max_xit = atol(buf);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -410,7 +1116,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->max_ifshift = atol(buf);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -419,7 +1125,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->announces = atoi(buf);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -439,7 +1145,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->preamp[ret] = RIG_DBLST_END;
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -459,7 +1165,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->attenuator[ret] = RIG_DBLST_END;
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -468,7 +1174,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->has_get_func = strtoll(buf, NULL, 0);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -477,7 +1183,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->has_set_func = strtoll(buf, NULL, 0);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -494,7 +1200,7 @@ static int netrigctl_open(RIG *rig)
         rs->has_get_level |= RIG_LEVEL_STRENGTH;
     }
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -503,7 +1209,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->has_set_level = strtoll(buf, NULL, 0);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -512,7 +1218,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->has_get_parm = strtoll(buf, NULL, 0);
 
-    ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+    ret = dump_state_line(src, buf, BUF_MAX);
 
     if (ret <= 0)
     {
@@ -546,7 +1252,7 @@ static int netrigctl_open(RIG *rig)
     do
     {
         char setting[32], value[256];
-        ret = read_string(&rig->state.rigport, buf, BUF_MAX, "\n", 1);
+        ret = dump_state_line(src, buf, BUF_MAX);
         strtok(buf, "\r\n"); // chop the EOL
 
         if (ret <= 0)
@@ -656,6 +1362,7 @@ static int netrigctl_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     int ret, len;
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
+    struct netrigctl_priv_data *priv = rig->state.priv;
     char vfostr[16] = "";
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -673,6 +1380,12 @@ static int netrigctl_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     ret = netrigctl_transaction(rig, cmd, len, buf);
     rig_debug(RIG_DEBUG_TRACE, "%s: cmd=%s\n", __func__, strtok(cmd, "\r\n"));
 
+    if (ret == RIG_OK && netrigctl_push_vfo(rig, vfo))
+    {
+        priv->push_freq = freq;
+        priv->push_valid |= priv->subscribed ? PUSH_FREQ : 0;
+    }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -689,6 +1402,7 @@ static int netrigctl_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     char vfostr[16] = "";
+    struct netrigctl_priv_data *priv = rig->state.priv;
 #if 0 // disable until we figure out if we can do this without breaking backwards compatibility
     char vfotmp[16];
 #endif
@@ -700,6 +1414,12 @@ static int netrigctl_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 
     if (ret != RIG_OK) { return ret; }
 
+    if (netrigctl_pushed(rig, PUSH_FREQ, vfo))
+    {
+        *freq = priv->push_freq;
+        return RIG_OK;
+    }
+
     len = sprintf(cmd, "f%s\n", vfostr);
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
@@ -748,6 +1468,11 @@ static int netrigctl_set_mode(RIG *rig, vfo_t vfo, rmode_t mode,
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK && netrigctl_push_vfo(rig, vfo))
+    {
+        netrigctl_push_forget(rig, PUSH_MODE);
+    }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -766,6 +1491,7 @@ static int netrigctl_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     char vfostr[16] = "";
+    struct netrigctl_priv_data *priv = rig->state.priv;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called, vfo=%s\n", __func__, rig_strvfo(vfo));
 
@@ -773,6 +1499,13 @@ static int netrigctl_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
 
     if (ret != RIG_OK) { return ret; }
 
+    if (netrigctl_pushed(rig, PUSH_MODE, vfo))
+    {
+        *mode = priv->push_mode;
+        *width = priv->push_width;
+        return RIG_OK;
+    }
+
     len = sprintf(cmd, "m%s\n", vfostr);
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
@@ -815,6 +1548,13 @@ static int netrigctl_set_vfo(RIG *rig, vfo_t vfo)
     rig_debug(RIG_DEBUG_VERBOSE, "%s: cmd='%s'\n", __func__, cmd);
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK && priv->subscribed)
+    {
+        priv->push_vfo = vfo;
+        priv->push_valid |= PUSH_VFO;
+        netrigctl_push_forget(rig, PUSH_FREQ | PUSH_MODE);
+    }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -836,6 +1576,12 @@ static int netrigctl_get_vfo(RIG *rig, vfo_t *vfo)
 
     priv = (struct netrigctl_priv_data *)rig->state.priv;
 
+    if (netrigctl_pushed(rig, PUSH_VFO, RIG_VFO_CURR))
+    {
+        *vfo = priv->push_vfo;
+        return RIG_OK;
+    }
+
     len = sprintf(cmd, "v\n");
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
@@ -867,6 +1613,7 @@ static int netrigctl_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
     int ret, len;
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
+    struct netrigctl_priv_data *priv = rig->state.priv;
     char vfostr[16] = "";
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -879,6 +1626,12 @@ static int netrigctl_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK)
+    {
+        priv->push_ptt = ptt;
+        priv->push_valid |= priv->subscribed ? PUSH_PTT : 0;
+    }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -896,9 +1649,16 @@ static int netrigctl_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     char vfostr[16] = "";
+    struct netrigctl_priv_data *priv = rig->state.priv;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    if (netrigctl_pushed(rig, PUSH_PTT, RIG_VFO_CURR))
+    {
+        *ptt = priv->push_ptt;
+        return RIG_OK;
+    }
+
     ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), RIG_VFO_A);
 
     if (ret != RIG_OK) { return ret; }
@@ -1301,6 +2061,8 @@ static int netrigctl_set_split_freq(RIG *rig, vfo_t vfo, freq_t tx_freq)
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK) { netrigctl_push_forget(rig, PUSH_ALL); }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -1358,6 +2120,8 @@ static int netrigctl_set_split_mode(RIG *rig, vfo_t vfo, rmode_t tx_mode,
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK) { netrigctl_push_forget(rig, PUSH_ALL); }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -1413,6 +2177,7 @@ static int netrigctl_set_split_vfo(RIG *rig, vfo_t vfo, split_t split,
     int ret, len;
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
+    struct netrigctl_priv_data *priv = rig->state.priv;
     char vfostr[16] = "";
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -1425,6 +2190,13 @@ static int netrigctl_set_split_vfo(RIG *rig, vfo_t vfo, split_t split,
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK)
+    {
+        priv->push_split = split;
+        priv->push_tx_vfo = tx_vfo;
+        priv->push_valid |= priv->subscribed ? PUSH_SPLIT : 0;
+    }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -1443,9 +2215,17 @@ static int netrigctl_get_split_vfo(RIG *rig, vfo_t vfo, split_t *split,
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
     char vfostr[16] = "";
+    struct netrigctl_priv_data *priv = rig->state.priv;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    if (netrigctl_pushed(rig, PUSH_SPLIT, RIG_VFO_CURR))
+    {
+        *split = priv->push_split;
+        *tx_vfo = priv->push_tx_vfo;
+        return RIG_OK;
+    }
+
     ret = netrigctl_vfostr(rig, vfostr, sizeof(vfostr), RIG_VFO_A);
 
     if (ret != RIG_OK) { return ret; }
@@ -1476,6 +2256,112 @@ static int netrigctl_get_split_vfo(RIG *rig, vfo_t vfo, split_t *split,
     return RIG_OK;
 }
 
+/*
+ * The whole rig_snapshot_t in one round trip: get_snapshot when the
+ * server has it, otherwise v, f, m, t and s pipelined
+ */
+static int netrigctl_get_snapshot(RIG *rig, rig_snapshot_t *snap)
+{
+    struct netrigctl_priv_data *priv;
+    struct netrigctl_req req[5];
+    int ret;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
+
+    priv = (struct netrigctl_priv_data *)rig->state.priv;
+
+    if (netrigctl_pushed(rig, PUSH_ALL, RIG_VFO_CURR))
+    {
+        snap->vfo = priv->push_vfo;
+        snap->freq = priv->push_freq;
+        snap->mode = priv->push_mode;
+        snap->width = priv->push_width;
+        snap->ptt = priv->push_ptt;
+        snap->split = priv->push_split;
+        snap->tx_vfo = priv->push_tx_vfo;
+        return RIG_OK;
+    }
+
+    memset(req, 0, sizeof(req));
+
+    if (priv->has_snapshot)
+    {
+        strcpy(req[0].cmd, "\\get_snapshot\n");
+        req[0].lines = 7;
+
+        ret = netrigctl_pipeline(rig, req, 1);
+
+        if (ret != RIG_OK || req[0].ret != RIG_OK)
+        {
+            return ret != RIG_OK ? ret : req[0].ret;
+        }
+
+        snap->vfo = rig_parse_vfo(req[0].reply[0]);
+        CHKSCN1ARG(num_sscanf(req[0].reply[1], "%"SCNfreq, &snap->freq));
+        snap->mode = rig_parse_mode(req[0].reply[2]);
+        snap->width = atol(req[0].reply[3]);
+        snap->ptt = atoi(req[0].reply[4]);
+        snap->split = atoi(req[0].reply[5]);
+        snap->tx_vfo = rig_parse_vfo(req[0].reply[6]);
+
+        priv->vfo_curr = snap->vfo;
+
+        return RIG_OK;
+    }
+
+    /* the getters would need a VFO argument each, let rig.c do them */
+    if (priv->rigctld_vfo_mode)
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    strcpy(req[0].cmd, "v\n");
+    req[0].lines = 1;
+    strcpy(req[1].cmd, "f\n");
+    req[1].lines = 1;
+    strcpy(req[2].cmd, "m\n");
+    req[2].lines = 2;
+    strcpy(req[3].cmd, "t\n");
+    req[3].lines = 1;
+    strcpy(req[4].cmd, "s\n");
+    req[4].lines = 2;
+
+    ret = netrigctl_pipeline(rig, req, 5);
+
+    if (ret != RIG_OK)
+    {
+        return ret;
+    }
+
+    if (req[1].ret != RIG_OK || req[2].ret != RIG_OK)
+    {
+        return req[1].ret != RIG_OK ? req[1].ret : req[2].ret;
+    }
+
+    /* same fallbacks as netrigctl_get_vfo() and rig_get_state_snapshot() */
+    snap->vfo = req[0].ret == RIG_OK ? rig_parse_vfo(req[0].reply[0])
+                : priv->vfo_curr;
+    CHKSCN1ARG(num_sscanf(req[1].reply[0], "%"SCNfreq, &snap->freq));
+    snap->mode = rig_parse_mode(req[2].reply[0]);
+    snap->width = atol(req[2].reply[1]);
+    snap->ptt = req[3].ret == RIG_OK ? atoi(req[3].reply[0]) : RIG_PTT_OFF;
+
+    if (req[4].ret == RIG_OK)
+    {
+        snap->split = atoi(req[4].reply[0]);
+        snap->tx_vfo = rig_parse_vfo(req[4].reply[1]);
+    }
+    else
+    {
+        snap->split = RIG_SPLIT_OFF;
+        snap->tx_vfo = snap->vfo;
+    }
+
+    priv->vfo_curr = snap->vfo;
+
+    return RIG_OK;
+}
+
 static int netrigctl_set_rit(RIG *rig, vfo_t vfo, shortfreq_t rit)
 {
     int ret, len;
@@ -1789,6 +2675,8 @@ static int netrigctl_set_powerstat(RIG *rig, powerstat_t status)
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK) { netrigctl_push_forget(rig, PUSH_ALL); }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -2018,6 +2906,8 @@ static int netrigctl_set_bank(RIG *rig, vfo_t vfo, int bank)
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK) { netrigctl_push_forget(rig, PUSH_ALL); }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -2046,6 +2936,8 @@ static int netrigctl_set_mem(RIG *rig, vfo_t vfo, int ch)
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK) { netrigctl_push_forget(rig, PUSH_ALL); }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -2096,6 +2988,8 @@ static int netrigctl_scan(RIG *rig, vfo_t vfo, scan_t scan, int ch)
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK) { netrigctl_push_forget(rig, PUSH_ALL); }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -2118,6 +3012,8 @@ static int netrigctl_vfo_op(RIG *rig, vfo_t vfo, vfo_op_t op)
 
     ret = netrigctl_transaction(rig, cmd, len, buf);
 
+    if (ret == RIG_OK) { netrigctl_push_forget(rig, PUSH_ALL); }
+
     if (ret > 0)
     {
         return -RIG_EPROTO;
@@ -2382,4 +3278,5 @@ struct rig_caps netrigctl_caps =
     .set_channel =    netrigctl_set_channel,
     .get_channel =    netrigctl_get_channel,
     .set_vfo_opt = netrigctl_set_vfo_opt,
+    .get_snapshot = netrigctl_get_snapshot,
 };
@@ -669,6 +669,7 @@ int dttsp_cleanup(RIG *rig)
 
     if (rig->state.priv)
     {
+        port_priv_free(&priv->meter_port);
         free(rig->state.priv);
     }
 
@@ -30,10 +30,15 @@
 #include "hamlib/rig.h"
 #include "serial.h"
 #include "misc.h"
+#include "event.h"
 #include "icom.h"
 #include "icom_defs.h"
 #include "frame.h"
 
+static int read_icom_frame_deadline(hamlib_port_t *p, unsigned char rxbuffer[],
+                                    int rxbuffer_len,
+                                    const struct timespec *deadline);
+
 /*
  * Build a CI-V frame.
  * The whole frame is placed in frame[],
@@ -90,6 +95,36 @@ int make_cmd_frame(char frame[], char re_id, char ctrl_id, char cmd, int subcmd,
     RETURNFUNC(i);
 }
 
+/*
+ * read_icom_reply
+ *
+ * Reads the next frame like read_icom_frame_deadline(), except that
+ * frames the rig broadcasts on its own in transceive mode (to BCASTID)
+ * are decoded into the cache on the way instead of being taken for the
+ * reply.
+ */
+static int read_icom_reply(RIG *rig, unsigned char *buf, int buflen,
+                           const struct timespec *deadline)
+{
+    int frm_len;
+
+    for (;;)
+    {
+        frm_len = read_icom_frame_deadline(&rig->state.rigport, buf, buflen,
+                                           deadline);
+
+        if (frm_len < 6 || buf[frm_len - 1] != FI || buf[2] != BCASTID)
+        {
+            return frm_len;
+        }
+
+        rig_debug(RIG_DEBUG_TRACE, "%s: transceive frame cmd %#2.2x\n", __func__,
+                  buf[4]);
+        icom_process_trn_frame(rig, buf, frm_len);
+    }
+}
+
+
 /*
  * icom_one_transaction
  *
@@ -98,13 +133,15 @@ int make_cmd_frame(char frame[], char re_id, char ctrl_id, char cmd, int subcmd,
  * payload can be NULL if payload_len == 0
  * subcmd can be equal to -1 (no subcmd wanted)
  * if no answer is to be expected, data_len must be set to NULL to tell so
+ * deadline is the budget left for the whole icom_transaction(), this try
+ * waits at most one rigport.timeout within it
  *
  * return RIG_OK if transaction completed,
  * or a negative value otherwise indicating the error.
  */
 int icom_one_transaction(RIG *rig, int cmd, int subcmd,
                          const unsigned char *payload, int payload_len, unsigned char *data,
-                         int *data_len)
+                         int *data_len, const struct timespec *deadline)
 {
     struct icom_priv_data *priv;
     const struct icom_priv_caps *priv_caps;
@@ -115,6 +152,8 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
     unsigned char sendbuf[MAXFRAMELEN];
     int frm_len, retval;
     int ctrl_id;
+    int remaining_ms;
+    struct timespec read_deadline;
 
     ENTERFUNC;
     memset(buf, 0, 200);
@@ -123,6 +162,10 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
     priv = (struct icom_priv_data *)rs->priv;
     priv_caps = (struct icom_priv_caps *)rig->caps->priv;
 
+    remaining_ms = hl_deadline_remaining_ms(deadline);
+    hl_deadline_set(&read_deadline, remaining_ms < rs->rigport.timeout
+                    ? remaining_ms : rs->rigport.timeout);
+
     ctrl_id = priv_caps->serial_full_duplex == 0 ? CTRLID : 0x80;
 
     frm_len = make_cmd_frame((char *) sendbuf, priv->re_civ_addr, ctrl_id, cmd,
@@ -133,7 +176,7 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
      */
     Hold_Decode(rig);
 
-    rig_flush(&rs->rigport);
+    rig_flush_trn(rig);
 
     if (data_len) { *data_len = 0; }
 
@@ -157,7 +200,7 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
          *          up to rs->retry times.
          */
 
-        retval = read_icom_frame(&rs->rigport, buf, sizeof(buf));
+        retval = read_icom_reply(rig, buf, sizeof(buf), &read_deadline);
 
         if (retval == -RIG_ETIMEOUT || retval == 0)
         {
@@ -229,7 +272,7 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
      * ACKFRMLEN is the smallest frame we can expect from the rig
      */
     buf[0] = 0;
-    frm_len = read_icom_frame(&rs->rigport, buf, sizeof(buf));
+    frm_len = read_icom_reply(rig, buf, sizeof(buf), &read_deadline);
 
 #if 0
 
@@ -297,6 +340,8 @@ int icom_one_transaction(RIG *rig, int cmd, int subcmd,
  * icom_transaction
  *
  * This function honors rigport.retry count.
+ * All tries share a budget of rigport.timeout * (rigport.retry + 1)
+ * so a rig trickling bytes cannot hold the port much longer than that.
  *
  * We assume that rig!=NULL, rig->state!= NULL, payload!=NULL, data!=NULL, data_len!=NULL
  * Otherwise, you'll get a nice seg fault. You've been warned!
@@ -311,6 +356,7 @@ int icom_transaction(RIG *rig, int cmd, int subcmd,
                      int *data_len)
 {
     int retval, retry;
+    struct timespec deadline;
 
     ENTERFUNC;
     rig_debug(RIG_DEBUG_VERBOSE,
@@ -318,11 +364,12 @@ int icom_transaction(RIG *rig, int cmd, int subcmd,
               cmd, subcmd, payload_len);
 
     retry = rig->state.rigport.retry;
+    hl_deadline_set(&deadline, rig->state.rigport.timeout * (retry + 1));
 
     do
     {
         retval = icom_one_transaction(rig, cmd, subcmd, payload, payload_len, data,
-                                      data_len);
+                                      data_len, &deadline);
 
         if (retval == RIG_OK || retval == -RIG_ERJCTED)
         {
@@ -332,6 +379,17 @@ int icom_transaction(RIG *rig, int cmd, int subcmd,
         rig_debug(RIG_DEBUG_WARN, "%s: retry=%d: %s\n", __func__, retry,
                   rigerror(retval));
 
+        if (hl_deadline_remaining_ms(&deadline) <= 0)
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: transaction budget exhausted\n", __func__);
+            break;
+        }
+
+        if (retry > 0)
+        {
+            port_stats_retry(&rig->state.rigport);
+        }
+
         // On some serial errors we may need a bit of time
         hl_usleep(100 * 1000); // pause just a bit
     }
@@ -357,6 +415,18 @@ static const char icom_block_end[2] = {FI, COL};
  */
 int read_icom_frame(hamlib_port_t *p, unsigned char rxbuffer[],
                     int rxbuffer_len)
+{
+    return read_icom_frame_deadline(p, rxbuffer, rxbuffer_len, NULL);
+}
+
+/*
+ * read_icom_frame_deadline
+ * same as read_icom_frame, giving up at deadline (NULL for one
+ * rigport.timeout per read)
+ */
+static int read_icom_frame_deadline(hamlib_port_t *p, unsigned char rxbuffer[],
+                                    int rxbuffer_len,
+                                    const struct timespec *deadline)
 {
     int read = 0;
     int retries = 10;
@@ -373,8 +443,9 @@ int read_icom_frame(hamlib_port_t *p, unsigned char rxbuffer[],
      */
     do
     {
-        int i = read_string(p, rx_ptr, MAXFRAMELEN - read,
-                            icom_block_end, icom_block_end_length);
+        int i = read_string_deadline(p, rx_ptr, MAXFRAMELEN - read,
+                                     icom_block_end, icom_block_end_length,
+                                     deadline);
 
         if (i < 0) /* die on errors */
         {
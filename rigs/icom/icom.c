@@ -39,6 +39,7 @@
 #include <cal.h>
 #include <token.h>
 #include <register.h>
+#include <event.h>
 
 #include "icom.h"
 #include "icom_defs.h"
@@ -1024,7 +1025,6 @@ int icom_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     subcmd = -1;
     retval = icom_transaction(rig, cmd, subcmd, freqbuf, freq_len, ackbuf,
                               &ack_len);
-    hl_usleep(50*1000);  // pause for transceive message and we'll flush it
 
     if (retval != RIG_OK)
     {
@@ -1663,8 +1663,6 @@ int icom_set_mode_with_data(RIG *rig, vfo_t vfo, rmode_t mode,
     rig_debug(RIG_DEBUG_VERBOSE, "%s mode=%d, width=%d\n", __func__, (int)icom_mode,
               (int)width);
     retval = icom_set_mode(rig, vfo, icom_mode, width);
-    
-    hl_usleep(50*1000); // pause for possible transceive message which we'll flush
 
     if (RIG_OK == retval)
     {
@@ -7217,8 +7215,6 @@ int icom_decode_event(RIG *rig)
     struct rig_state *rs;
     unsigned char buf[MAXFRAMELEN];
     int frm_len;
-    rmode_t mode;
-    pbwidth_t width;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -7261,10 +7257,28 @@ int icom_decode_event(RIG *rig)
                   priv->re_civ_addr, buf[3]);
     }
 
+    RETURNFUNC(icom_process_trn_frame(rig, buf, frm_len));
+}
+
+
+/*
+ * icom_process_trn_frame decodes a frame the rig broadcast on its own,
+ * in transceive mode, into the cache and the event callbacks.
+ * Called by icom_decode_event and by the transaction code when such a
+ * frame turns up instead of a reply.
+ */
+int icom_process_trn_frame(RIG *rig, const unsigned char *buf, int frm_len)
+{
+    const struct icom_priv_data *priv = (struct icom_priv_data *)rig->state.priv;
+    rmode_t mode;
+    pbwidth_t width;
+    freq_t freq;
+    int freq_len;
+
     /*
      * the first 2 bytes must be 0xfe
-     * the 3rd one the emitter
-     * the 4rd one 0x00 since this is transceive mode
+     * the 3rd one 0x00 since this is transceive mode
+     * the 4th one the emitter
      * then the command number
      * the rest is data
      * and don't forget one byte at the end for the EOM
@@ -7272,47 +7286,35 @@ int icom_decode_event(RIG *rig)
     switch (buf[4])
     {
     case C_SND_FREQ:
-
         /*
          * TODO: the freq length might be less than 4 or 5 bytes
          *          on older rigs!
          */
-        if (rig->callbacks.freq_event)
-        {
-            freq_t freq;
-            freq = from_bcd(buf + 5, (priv->civ_731_mode ? 4 : 5) * 2);
-            RETURNFUNC(rig->callbacks.freq_event(rig, RIG_VFO_CURR, freq,
-                                                 rig->callbacks.freq_arg));
-        }
-        else
+        freq_len = priv->civ_731_mode ? 4 : 5;
+
+        if (frm_len < 6 + freq_len)
         {
-            RETURNFUNC(-RIG_ENAVAIL);
+            RETURNFUNC(-RIG_EPROTO);
         }
 
-        break;
+        freq = from_bcd(buf + 5, freq_len * 2);
+        RETURNFUNC(rig_fire_freq_event(rig, RIG_VFO_CURR, freq));
 
     case C_SND_MODE:
-        if (rig->callbacks.mode_event)
-        {
-            icom2rig_mode(rig, buf[5], buf[6], &mode, &width);
-            RETURNFUNC(rig->callbacks.mode_event(rig, RIG_VFO_CURR,
-                                                 mode, width,
-                                                 rig->callbacks.mode_arg));
-        }
-        else
+        if (frm_len < 7)
         {
-            RETURNFUNC(-RIG_ENAVAIL);
+            RETURNFUNC(-RIG_EPROTO);
         }
 
-        break;
+        /* the filter byte is optional */
+        icom2rig_mode(rig, buf[5], frm_len > 7 ? buf[6] : -1, &mode, &width);
+        RETURNFUNC(rig_fire_mode_event(rig, RIG_VFO_CURR, mode, width));
 
     default:
         rig_debug(RIG_DEBUG_VERBOSE, "%s: transceive cmd unsupported %#2.2x\n",
                   __func__, buf[4]);
         RETURNFUNC(-RIG_ENIMPL);
     }
-
-    RETURNFUNC(RIG_OK);
 }
 
 int icom_set_raw(RIG *rig, int cmd, int subcmd, int subcmdbuflen,
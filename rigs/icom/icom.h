@@ -303,6 +303,7 @@ int icom_set_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t option);
 int icom_get_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t *option,
                  ant_t *ant_curr, ant_t *ant_tx, ant_t *ant_rx);
 int icom_decode_event(RIG *rig);
+int icom_process_trn_frame(RIG *rig, const unsigned char *buf, int frm_len);
 int icom_power2mW(RIG *rig, unsigned int *mwpower, float power, freq_t freq,
                   rmode_t mode);
 int icom_mW2power(RIG *rig, float *power, unsigned int mwpower, freq_t freq,
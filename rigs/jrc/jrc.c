@@ -34,6 +34,7 @@
 #include "misc.h"
 #include "cal.h"
 #include "register.h"
+#include "event.h"
 
 #include "jrc.h"
 
@@ -1652,24 +1653,15 @@ int jrc_decode_event(RIG *rig)
      * TODO: Attenuator and AGC change notification.
      */
 
-    if (rig->callbacks.freq_event)
-    {
+    jrc2rig_mode(rig, buf[3], buf[2], &mode, &width);
 
-        //buf[14] = '\0'; /* side-effect: destroy AGC first digit! */
-        buf[4 + priv->max_freq_len] = '\0'; /* side-effect: destroy AGC first digit! */
-        sscanf(buf + 4, "%"SCNfreq, &freq);
-        return rig->callbacks.freq_event(rig, RIG_VFO_CURR, freq,
-                                         rig->callbacks.freq_arg);
-    }
+    //buf[14] = '\0'; /* side-effect: destroy AGC first digit! */
+    buf[4 + priv->max_freq_len] = '\0'; /* side-effect: destroy AGC first digit! */
+    sscanf(buf + 4, "%"SCNfreq, &freq);
 
-    if (rig->callbacks.mode_event)
-    {
-        jrc2rig_mode(rig, buf[3], buf[2], &mode, &width);
-        return rig->callbacks.mode_event(rig, RIG_VFO_CURR, mode, width,
-                                         rig->callbacks.freq_arg);
-    }
+    rig_fire_freq_event(rig, RIG_VFO_CURR, freq);
 
-    return RIG_OK;
+    return rig_fire_mode_event(rig, RIG_VFO_CURR, mode, width);
 }
 
 
@@ -1186,6 +1186,7 @@ const struct rig_caps f6k_caps =
     .set_split_vfo =    kenwood_set_split_vfo,
     .get_split_vfo =    kenwood_get_split_vfo_if,
     .get_ptt =      kenwood_get_ptt,
+    .get_snapshot =      kenwood_get_snapshot,
     .set_ptt =      kenwood_set_ptt,
     // TODO copy over kenwood_[set|get]_level and modify to handle DSP filter values
     // correctly - use actual values instead of indices
@@ -36,6 +36,7 @@
 #include "serial.h"
 #include "misc.h"
 #include "register.h"
+#include "event.h"
 
 #include "kenwood.h"
 #include "ic10.h"
@@ -1243,26 +1244,13 @@ int ic10_decode_event(RIG *rig)
     sscanf(asyncbuf + 2, "%011"SCNfreq, &freq);
 
     /* Callback execution */
-    if (rig->callbacks.vfo_event)
-    {
-        rig->callbacks.vfo_event(rig, vfo, rig->callbacks.vfo_arg);
-    }
+    rig_fire_vfo_event(rig, vfo);
 
-    if (rig->callbacks.freq_event)
-    {
-        rig->callbacks.freq_event(rig, vfo, freq, rig->callbacks.freq_arg);
-    }
+    rig_fire_freq_event(rig, vfo, freq);
 
-    if (rig->callbacks.mode_event)
-    {
-        rig->callbacks.mode_event(rig, vfo, mode, RIG_PASSBAND_NORMAL,
-                                  rig->callbacks.mode_arg);
-    }
+    rig_fire_mode_event(rig, vfo, mode, RIG_PASSBAND_NORMAL);
 
-    if (rig->callbacks.ptt_event)
-    {
-        rig->callbacks.ptt_event(rig, vfo, ptt, rig->callbacks.ptt_arg);
-    }
+    rig_fire_ptt_event(rig, vfo, ptt);
 
     return RIG_OK;
 }
@@ -228,6 +228,7 @@ const struct rig_caps k2_caps =
     .set_xit =      kenwood_set_xit,
     .get_xit =      kenwood_get_xit,
     .get_ptt =      kenwood_get_ptt,
+    .get_snapshot =      kenwood_get_snapshot,
     .set_ptt =      kenwood_set_ptt,
     .get_dcd =      kenwood_get_dcd,
     .set_func =     kenwood_set_func,
@@ -36,6 +36,7 @@
 #include "serial.h"
 #include "register.h"
 #include "cal.h"
+#include "event.h"
 
 #include "kenwood.h"
 #include "ts990s.h"
@@ -208,6 +209,34 @@ const struct confparams kenwood_cfg_params[] =
 };
 
 
+/*
+ * Decode a frame the rig sent on its own in AI mode.  VFO frequencies
+ * go into the cache; a mode frame carries no passband, so it only
+ * invalidates the cached mode.
+ * Returns RIG_OK if buffer was such a frame.
+ */
+static int kenwood_process_trn_frame(RIG *rig, const char *buffer)
+{
+    freq_t freq;
+
+    if (buffer[0] == 'F' && (buffer[1] == 'A' || buffer[1] == 'B')
+            && isdigit((unsigned char)buffer[2])
+            && sscanf(buffer + 2, "%"SCNfreq, &freq) == 1)
+    {
+        rig_fire_freq_event(rig, buffer[1] == 'A' ? RIG_VFO_A : RIG_VFO_B, freq);
+        return RIG_OK;
+    }
+
+    if (buffer[0] == 'M' && buffer[1] == 'D')
+    {
+        HL_CACHE_INVALIDATE(rig, time_mode);
+        return RIG_OK;
+    }
+
+    return -RIG_EPROTO;
+}
+
+
 /**
  * kenwood_transaction
  * Assumes rig!=NULL rig->state!=NULL rig->caps!=NULL
@@ -238,9 +267,12 @@ int kenwood_transaction(RIG *rig, const char *cmdstr, char *data,
     char *cmd;
     int len;
     int retry_read = 0;
+    int trn_frames = 0;             /* AI frames read in place of the reply */
     struct kenwood_priv_data *priv = rig->state.priv;
     struct kenwood_priv_caps *caps = kenwood_caps(rig);
     struct rig_state *rs;
+    struct timespec deadline;       /* budget for all tries together */
+    struct timespec read_deadline;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
@@ -251,6 +283,8 @@ int kenwood_transaction(RIG *rig, const char *cmdstr, char *data,
 
     rs = &rig->state;
 
+    hl_deadline_set(&deadline, rs->rigport.timeout * (rs->rigport.retry + 1));
+
     rs->hold_decode = 1;
 
     /* Emulators don't need any post_write_delay */
@@ -288,6 +322,14 @@ int kenwood_transaction(RIG *rig, const char *cmdstr, char *data,
 
 transaction_write:
 
+    if (retry_read && hl_deadline_remaining_ms(&deadline) <= 0)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: transaction budget exhausted after %d tries\n",
+                  __func__, retry_read);
+        retval = -RIG_ETIMEOUT;
+        goto transaction_quit;
+    }
+
     if (cmdstr)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cmdstr = %s\n", __func__, cmdstr);
@@ -312,7 +354,7 @@ transaction_write:
         }
 
         /* flush anything in the read buffer before command is sent */
-        rig_flush(&rs->rigport);
+        rig_flush_trn(rig);
 
         retval = write_block(&rs->rigport, cmd, len);
 
@@ -346,10 +388,25 @@ transaction_write:
     }
 
 transaction_read:
+
+    if ((retry_read || trn_frames) && hl_deadline_remaining_ms(&deadline) <= 0)
+    {
+        rig_debug(RIG_DEBUG_WARN,
+                  "%s: transaction budget exhausted after %d tries, %d AI frames\n",
+                  __func__, retry_read, trn_frames);
+        retval = -RIG_ETIMEOUT;
+        goto transaction_quit;
+    }
+
+    /* each try gets at most one timeout, but never beyond the budget */
+    hl_deadline_set(&read_deadline, min(rs->rigport.timeout,
+                                        hl_deadline_remaining_ms(&deadline)));
+
     /* allow room for most any response */
     len = min(datasize ? datasize + 1 : strlen(priv->verify_cmd) + 32,
               KENWOOD_MAX_BUF_LEN);
-    retval = read_string(&rs->rigport, buffer, len, cmdtrm_str, strlen(cmdtrm_str));
+    retval = read_string_deadline(&rs->rigport, buffer, len, cmdtrm_str,
+                                  strlen(cmdtrm_str), &read_deadline);
     rig_debug(RIG_DEBUG_TRACE, "%s: read_string(len=%d)='%s'\n", __func__,
               (int)strlen(buffer), buffer);
 
@@ -363,6 +420,7 @@ transaction_read:
         // only retry if we expect a response from the command
         if (retry_read++ < rs->rigport.retry)
         {
+            port_stats_retry(&rs->rigport);
             if (datasize)
             {
                 goto transaction_write;
@@ -384,6 +442,7 @@ transaction_read:
 
         if (retry_read++ < rs->rigport.retry)
         {
+            port_stats_retry(&rs->rigport);
             goto transaction_write;
         }
 
@@ -416,6 +475,7 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                port_stats_retry(&rs->rigport);
                 goto transaction_write;
             }
 
@@ -433,6 +493,7 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                port_stats_retry(&rs->rigport);
                 goto transaction_write;
             }
 
@@ -450,6 +511,7 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                port_stats_retry(&rs->rigport);
                 rig_debug(RIG_DEBUG_ERR, "%s: Retrying shortly\n", __func__);
                 hl_usleep(rig->caps->timeout * 1000);
                 goto transaction_read;
@@ -470,11 +532,13 @@ transaction_read:
     {
         if (cmdstr && (buffer[0] != cmdstr[0] || (cmdstr[1] && buffer[1] != cmdstr[1])))
         {
-            /*
-             * TODO: When RIG_TRN is enabled, we can pass the string to
-             * the decoder for callback. That way we don't ignore any
-             * commands.
-             */
+            /* sent by the rig on its own in AI mode, use it and read on */
+            if (kenwood_process_trn_frame(rig, buffer) == RIG_OK)
+            {
+                trn_frames++;
+                goto transaction_read;
+            }
+
             rig_debug(RIG_DEBUG_ERR, "%s: wrong reply %c%c for command %c%c\n",
                       __func__, buffer[0], buffer[1], cmdstr[0], cmdstr[1]);
 
@@ -483,6 +547,7 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                port_stats_retry(&rs->rigport);
                 goto transaction_write;
             }
 
@@ -532,6 +597,7 @@ transaction_read:
 
             if (retry_read++ < rs->rigport.retry)
             {
+                port_stats_retry(&rs->rigport);
                 goto transaction_write;
             }
 
@@ -1307,56 +1373,14 @@ int kenwood_set_split(RIG *rig, vfo_t vfo, split_t split, vfo_t txvfo)
 }
 
 
-/* IF TB
- *  Gets split VFO status from kenwood_get_if()
- *
+/*
+ * Split and TX VFO from the last IF answer
  */
-int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
-                             vfo_t *txvfo)
+static int kenwood_if_split_vfo(RIG *rig, split_t *split, vfo_t *txvfo)
 {
     int transmitting;
-    int retval;
     struct kenwood_priv_data *priv = rig->state.priv;
 
-
-    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
-
-    if (!split || !txvfo)
-    {
-        RETURNFUNC(-RIG_EINVAL);
-    }
-
-    if (RIG_IS_TS990S)
-    {
-        char buf[4];
-
-        if (RIG_OK == (retval = kenwood_safe_transaction(rig, "TB", buf, sizeof(buf),
-                                3)))
-        {
-            if ('1' == buf[2])
-            {
-                *split = RIG_SPLIT_ON;
-                *txvfo = RIG_VFO_SUB;
-                priv->tx_vfo = *txvfo;
-            }
-            else
-            {
-                *split = RIG_SPLIT_OFF;
-                *txvfo = RIG_VFO_MAIN;
-                priv->tx_vfo = *txvfo;
-            }
-        }
-
-        RETURNFUNC(retval);
-    }
-
-    retval = kenwood_get_if(rig);
-
-    if (retval != RIG_OK)
-    {
-        RETURNFUNC(retval);
-    }
-
     switch (priv->info[32])
     {
     case '0':
@@ -1370,7 +1394,7 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
     default:
         rig_debug(RIG_DEBUG_ERR, "%s: unsupported split %c\n",
                   __func__, priv->info[32]);
-        RETURNFUNC(-RIG_EPROTO);
+        return -RIG_EPROTO;
     }
 
     /* Remember whether split is on, for kenwood_set_vfo */
@@ -1398,36 +1422,58 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
     default:
         rig_debug(RIG_DEBUG_ERR, "%s: unsupported VFO %c\n",
                   __func__, priv->info[30]);
-        RETURNFUNC(-RIG_EPROTO);
+        return -RIG_EPROTO;
     }
 
     priv->tx_vfo = *txvfo;
     rig_debug(RIG_DEBUG_VERBOSE, "%s: priv->tx_vfo=%s\n", __func__,
               rig_strvfo(priv->tx_vfo));
-    RETURNFUNC(RIG_OK);
+    return RIG_OK;
 }
 
 
-/*
- * kenwood_get_vfo_if using byte 31 of the IF information field
+/* IF TB
+ *  Gets split VFO status from kenwood_get_if()
  *
- * Specifically this needs to return the RX VFO, the IF command tells
- * us the TX VFO in split TX mode when transmitting so we need to swap
- * results sometimes.
  */
-int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
+int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
+                             vfo_t *txvfo)
 {
     int retval;
-    int split_and_transmitting;
     struct kenwood_priv_data *priv = rig->state.priv;
 
+
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
-    if (!vfo)
+    if (!split || !txvfo)
     {
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    if (RIG_IS_TS990S)
+    {
+        char buf[4];
+
+        if (RIG_OK == (retval = kenwood_safe_transaction(rig, "TB", buf, sizeof(buf),
+                                3)))
+        {
+            if ('1' == buf[2])
+            {
+                *split = RIG_SPLIT_ON;
+                *txvfo = RIG_VFO_SUB;
+                priv->tx_vfo = *txvfo;
+            }
+            else
+            {
+                *split = RIG_SPLIT_OFF;
+                *txvfo = RIG_VFO_MAIN;
+                priv->tx_vfo = *txvfo;
+            }
+        }
+
+        RETURNFUNC(retval);
+    }
+
     retval = kenwood_get_if(rig);
 
     if (retval != RIG_OK)
@@ -1435,6 +1481,18 @@ int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
         RETURNFUNC(retval);
     }
 
+    RETURNFUNC(kenwood_if_split_vfo(rig, split, txvfo));
+}
+
+
+/*
+ * RX VFO from the last IF answer
+ */
+static int kenwood_if_vfo(RIG *rig, vfo_t *vfo)
+{
+    int split_and_transmitting;
+    struct kenwood_priv_data *priv = rig->state.priv;
+
     /* Elecraft info[30] does not track split VFO when transmitting */
     split_and_transmitting =
         '1' == priv->info[28] /* transmitting */
@@ -1463,12 +1521,41 @@ int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
     default:
         rig_debug(RIG_DEBUG_ERR, "%s: unsupported VFO %c\n",
                   __func__, priv->info[30]);
-        RETURNFUNC(-RIG_EPROTO);
+        return -RIG_EPROTO;
     }
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s: priv->tx_vfo=%s\n", __func__,
               rig_strvfo(priv->tx_vfo));
-    RETURNFUNC(RIG_OK);
+    return RIG_OK;
+}
+
+
+/*
+ * kenwood_get_vfo_if using byte 31 of the IF information field
+ *
+ * Specifically this needs to return the RX VFO, the IF command tells
+ * us the TX VFO in split TX mode when transmitting so we need to swap
+ * results sometimes.
+ */
+int kenwood_get_vfo_if(RIG *rig, vfo_t *vfo)
+{
+    int retval;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
+
+    if (!vfo)
+    {
+        RETURNFUNC(-RIG_EINVAL);
+    }
+
+    retval = kenwood_get_if(rig);
+
+    if (retval != RIG_OK)
+    {
+        RETURNFUNC(retval);
+    }
+
+    RETURNFUNC(kenwood_if_vfo(rig, vfo));
 }
 
 
@@ -3734,6 +3821,70 @@ int kenwood_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     RETURNFUNC(RIG_OK);
 }
 
+
+/*
+ * kenwood_get_snapshot
+ *  VFO, frequency, PTT and split from a single IF, mode too on the rigs
+ *  that read it from there anyway
+ */
+int kenwood_get_snapshot(RIG *rig, rig_snapshot_t *snap)
+{
+    struct kenwood_priv_caps *caps = kenwood_caps(rig);
+    struct kenwood_priv_data *priv = rig->state.priv;
+    char freqbuf[50];
+    int retval;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
+
+    retval = kenwood_get_if(rig);
+
+    if (retval != RIG_OK)
+    {
+        RETURNFUNC(retval);
+    }
+
+    /* the frequency shown is the TX one then, let the caller ask around */
+    if ('1' == priv->info[28] && '1' == priv->info[32])
+    {
+        RETURNFUNC(-RIG_ENAVAIL);
+    }
+
+    memcpy(freqbuf, priv->info, 15);
+    freqbuf[14] = '\0';
+    sscanf(freqbuf + 2, "%"SCNfreq, &snap->freq);
+
+    snap->ptt = priv->info[28] == '0' ? RIG_PTT_OFF : RIG_PTT_ON;
+
+    retval = kenwood_if_vfo(rig, &snap->vfo);
+
+    if (retval != RIG_OK)
+    {
+        RETURNFUNC(retval);
+    }
+
+    retval = kenwood_if_split_vfo(rig, &snap->split, &snap->tx_vfo);
+
+    if (retval != RIG_OK)
+    {
+        RETURNFUNC(retval);
+    }
+
+    if (rig->caps->get_mode == kenwood_get_mode_if)
+    {
+        snap->mode = kenwood2rmode(priv->info[29] - '0', caps->mode_table);
+        snap->width = rig_passband_normal(rig, snap->mode);
+
+        if (RIG_IS_TS450S || RIG_IS_TS690S || RIG_IS_TS850 || RIG_IS_TS950S
+                || RIG_IS_TS950SDX)
+        {
+            kenwood_get_filter(rig, &snap->width);
+            /* non fatal */
+        }
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
 int kenwood_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
 {
     const char *ptt_cmd;
@@ -275,6 +275,7 @@ const struct rig_caps pihpsdr_caps =
     .set_ctcss_sql =  kenwood_set_ctcss_sql,
     .get_ctcss_sql =  kenwood_get_ctcss_sql,
     .get_ptt =  kenwood_get_ptt,
+    .get_snapshot =  kenwood_get_snapshot,
     .set_ptt =  kenwood_set_ptt,
     .get_dcd =  kenwood_get_dcd,
     .set_func =  kenwood_set_func,
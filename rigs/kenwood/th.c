@@ -35,6 +35,7 @@
 #include "th.h"
 #include "serial.h"
 #include "misc.h"
+#include "event.h"
 #include "num_stdio.h"
 
 /* Note: Currently the code assumes the command termination is a
@@ -96,21 +97,11 @@ th_decode_event(RIG *rig)
                   __func__, vfo, freq, mode);
 
         /* Callback execution */
-        if (rig->callbacks.vfo_event)
-        {
-            rig->callbacks.vfo_event(rig, vfo, rig->callbacks.vfo_arg);
-        }
+        rig_fire_vfo_event(rig, vfo);
 
-        if (rig->callbacks.freq_event)
-        {
-            rig->callbacks.freq_event(rig, vfo, freq, rig->callbacks.freq_arg);
-        }
+        rig_fire_freq_event(rig, vfo, freq);
 
-        if (rig->callbacks.mode_event)
-        {
-            rig->callbacks.mode_event(rig, vfo, mode, RIG_PASSBAND_NORMAL,
-                                      rig->callbacks.mode_arg);
-        }
+        rig_fire_mode_event(rig, vfo, mode, RIG_PASSBAND_NORMAL);
 
     }
     else if (async_len > 2 && asyncbuf[0] == 'S' && asyncbuf[1] == 'M')
@@ -182,10 +173,7 @@ th_decode_event(RIG *rig)
 
         rig_debug(RIG_DEBUG_TRACE, "%s: VFO event - vfo = %d\n", __func__, vfo);
 
-        if (rig->callbacks.vfo_event)
-        {
-            rig->callbacks.vfo_event(rig, vfo, rig->callbacks.vfo_arg);
-        }
+        rig_fire_vfo_event(rig, vfo);
 
     }
     else
@@ -31,6 +31,7 @@
 #include <hamlib/rig.h>
 #include "kenwood.h"
 #include "th.h"
+#include "event.h"
 
 #if 1
 #define RIG_ASSERT(x)   if (!(x)) { rig_debug(RIG_DEBUG_ERR, "Assertion failed on line %i\n",__LINE__); abort(); }
@@ -245,21 +246,12 @@ int thg71_decode_event(RIG *rig)
         rig_debug(RIG_DEBUG_TRACE, "%s: Buffer (freq %"PRIfreq" Hz)\n", __func__, freq);
 
         /* Callback execution */
-        if (rig->callbacks.vfo_event)
-        {
-            rig->callbacks.vfo_event(rig, RIG_VFO_A, rig->callbacks.vfo_arg);
-        }
+        rig_fire_vfo_event(rig, RIG_VFO_A);
 
-        if (rig->callbacks.freq_event)
-        {
-            rig->callbacks.freq_event(rig, RIG_VFO_A, freq, rig->callbacks.freq_arg);
-        }
+        rig_fire_freq_event(rig, RIG_VFO_A, freq);
 
         /*
-            if (rig->callbacks.mode_event) {
-                rig->callbacks.mode_event(rig, RIG_VFO_A, mode, RIG_PASSBAND_NORMAL,
-                                rig->callbacks.mode_arg);
-            }
+            rig_fire_mode_event(rig, RIG_VFO_A, mode, RIG_PASSBAND_NORMAL);
         */
 
         /* --------------------------------------------------------------------- */
@@ -32,6 +32,7 @@
 #include "kenwood.h"
 #include "th.h"
 #include "misc.h"
+#include "event.h"
 #include "num_stdio.h"
 
 #if 1
@@ -259,21 +260,12 @@ int tmv7_decode_event(RIG *rig)
         rig_debug(RIG_DEBUG_TRACE, "%s: Buffer (freq %"PRIfreq" Hz)\n", __func__, freq);
 
         /* Callback execution */
-        if (rig->callbacks.vfo_event)
-        {
-            rig->callbacks.vfo_event(rig, RIG_VFO_A, rig->callbacks.vfo_arg);
-        }
+        rig_fire_vfo_event(rig, RIG_VFO_A);
 
-        if (rig->callbacks.freq_event)
-        {
-            rig->callbacks.freq_event(rig, RIG_VFO_A, freq, rig->callbacks.freq_arg);
-        }
+        rig_fire_freq_event(rig, RIG_VFO_A, freq);
 
         /*
-            if (rig->callbacks.mode_event) {
-                rig->callbacks.mode_event(rig, RIG_VFO_A, mode, RIG_PASSBAND_NORMAL,
-                                rig->callbacks.mode_arg);
-            }
+            rig_fire_mode_event(rig, RIG_VFO_A, mode, RIG_PASSBAND_NORMAL);
         */
 
         /* --------------------------------------------------------------------- */
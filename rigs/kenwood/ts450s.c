@@ -247,6 +247,7 @@ const struct rig_caps ts450s_caps =
     .set_split_vfo = kenwood_set_split_vfo,
     .get_split_vfo = kenwood_get_split_vfo_if,
     .get_ptt = kenwood_get_ptt,
+    .get_snapshot = kenwood_get_snapshot,
     .set_ptt = kenwood_set_ptt,
     .get_dcd = kenwood_get_dcd,
     .set_func = kenwood_set_func,
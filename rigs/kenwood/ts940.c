@@ -183,6 +183,7 @@ const struct rig_caps ts940_caps =
     .get_split_vfo =  kenwood_get_split_vfo_if,
     .set_ptt =  kenwood_set_ptt,
     .get_ptt =  kenwood_get_ptt,
+    .get_snapshot =  kenwood_get_snapshot,
     .set_func =  kenwood_set_func,
     .vfo_op =  kenwood_vfo_op,
     .set_mem =  kenwood_set_mem,
@@ -34,12 +34,14 @@
 
 #include <stdlib.h>
 #include <string.h>  /* String function definitions */
+#include <ctype.h>
 #include <math.h>
 
 #include "hamlib/rig.h"
 #include "iofunc.h"
 #include "misc.h"
 #include "cal.h"
+#include "event.h"
 #include "newcat.h"
 
 /* global variables */
@@ -9430,6 +9432,43 @@ int newcat_vfomem_toggle(RIG *rig)
     RETURNFUNC(newcat_set_cmd(rig));
 }
 
+/*
+ * Decode a frame the rig sent on its own in AI mode that turned up in
+ * ret_data instead of the reply to cmd_str.  VFO frequencies go into the
+ * cache; a mode frame carries no passband, so it only invalidates the
+ * cached mode.
+ * Returns RIG_OK if ret_data was such a frame.
+ */
+static int newcat_process_trn_frame(RIG *rig)
+{
+    const struct newcat_priv_data *priv = (struct newcat_priv_data *)
+                                          rig->state.priv;
+    const char *frame = priv->ret_data;
+    freq_t freq;
+
+    if (frame[0] == priv->cmd_str[0] && frame[1] == priv->cmd_str[1])
+    {
+        return -RIG_EPROTO;
+    }
+
+    if (frame[0] == 'F' && (frame[1] == 'A' || frame[1] == 'B')
+            && isdigit((unsigned char)frame[2])
+            && sscanf(frame + 2, "%"SCNfreq, &freq) == 1)
+    {
+        rig_fire_freq_event(rig, frame[1] == 'A' ? RIG_VFO_A : RIG_VFO_B, freq);
+        return RIG_OK;
+    }
+
+    if (frame[0] == 'M' && frame[1] == 'D')
+    {
+        HL_CACHE_INVALIDATE(rig, time_mode);
+        return RIG_OK;
+    }
+
+    return -RIG_EPROTO;
+}
+
+
 /*
  * Writes a null  terminated command string from  priv->cmd_str to the
  * CAT  port and  returns a  response from  the rig  in priv->ret_data
@@ -9448,6 +9487,7 @@ int newcat_get_cmd(RIG *rig)
     int retry_count = 0;
     int rc = -RIG_EPROTO;
     int is_read_cmd = 0;
+    struct timespec deadline;       /* budget for all tries together */
 
     ENTERFUNC;
 
@@ -9534,9 +9574,30 @@ int newcat_get_cmd(RIG *rig)
     }
 
 
+    hl_deadline_set(&deadline, state->rigport.timeout * (state->rigport.retry + 1));
+
     while (rc != RIG_OK && retry_count++ <= state->rigport.retry)
     {
-        rig_flush(&state->rigport);  /* discard any unsolicited data */
+        struct timespec read_deadline;
+        int remaining_ms = hl_deadline_remaining_ms(&deadline);
+
+        if (retry_count > 1 && remaining_ms <= 0)
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: transaction budget exhausted after %d tries\n",
+                      __func__, retry_count - 1);
+            break;
+        }
+
+        if (retry_count > 1)
+        {
+            port_stats_retry(&state->rigport);
+        }
+
+        /* each try gets at most one timeout, but never beyond the budget */
+        hl_deadline_set(&read_deadline, remaining_ms < state->rigport.timeout
+                        ? remaining_ms : state->rigport.timeout);
+
+        rig_flush_trn(rig);  /* discard any unsolicited data */
 
         if (rc != -RIG_BUSBUSY)
         {
@@ -9550,9 +9611,16 @@ int newcat_get_cmd(RIG *rig)
             }
         }
 
-        /* read the reply */
-        if ((rc = read_string(&state->rigport, priv->ret_data, sizeof(priv->ret_data),
-                              &cat_term, sizeof(cat_term))) <= 0)
+        /* read the reply, using up what the rig sends on its own in AI mode */
+        do
+        {
+            rc = read_string_deadline(&state->rigport, priv->ret_data,
+                                      sizeof(priv->ret_data), &cat_term,
+                                      sizeof(cat_term), &read_deadline);
+        }
+        while (rc > 0 && newcat_process_trn_frame(rig) == RIG_OK);
+
+        if (rc <= 0)
         {
             continue;             /* usually a timeout - retry */
         }
@@ -9731,7 +9799,7 @@ int newcat_set_cmd_validate(RIG *rig)
     {
         int bytes;
         char cmd[256]; // big enough
-        rig_flush(&state->rigport);  /* discard any unsolicited data */
+        rig_flush_trn(rig);  /* discard any unsolicited data */
         snprintf(cmd, sizeof(cmd), "%s%s", priv->cmd_str, valcmd);
         rc = write_block(&state->rigport, cmd, strlen(cmd));
 
@@ -9808,7 +9876,7 @@ int newcat_set_cmd(RIG *rig)
 
     while (rc != RIG_OK && retry_count++ <= state->rigport.retry)
     {
-        rig_flush(&state->rigport);  /* discard any unsolicited data */
+        rig_flush_trn(rig);  /* discard any unsolicited data */
         /* send the command */
         rig_debug(RIG_DEBUG_TRACE, "cmd_str = %s\n", priv->cmd_str);
 
@@ -27,7 +27,9 @@ LOCAL_SRC_FILES := \
 	gpio.c \
 	microham.c \
 	rot_ext.c \
-        cm108.c
+        cm108.c \
+        async.c \
+        wirecap.c
 
 
 LOCAL_MODULE := libhamlib
@@ -541,6 +541,8 @@ int HAMLIB_API amp_cleanup(AMP *amp)
         amp->caps->amp_cleanup(amp);
     }
 
+    port_priv_free(&amp->state.ampport);
+
     free(amp);
 
     return RIG_OK;
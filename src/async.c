@@ -0,0 +1,523 @@
+/*
+ *  Hamlib Interface - asynchronous request engine
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/**
+ * \addtogroup rig
+ * @{
+ */
+
+/**
+ * \file async.c
+ * \brief Asynchronous request engine
+ *
+ * rig_async_open() starts one I/O thread for an opened rig.  Requests
+ * handed to rig_async_submit() are queued and run by that thread, one at
+ * a time, through the regular rig_* API.  Completion is signalled either
+ * by calling the request callback from the I/O thread, or by queueing the
+ * request and making the fd returned by rig_async_get_fd() readable, so
+ * many rigs can be driven from a single poll()/select() loop.
+ *
+ * While the engine is open all access to the rig should go through it,
+ * the rig_* API itself is not thread safe.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#include <hamlib/rig.h>
+#include "misc.h"
+#include "state.h"
+
+#ifdef HAVE_PTHREAD
+
+#if defined(WIN32) && !defined(HAVE_TERMIOS_H)
+#  define ASYNC_NO_FD
+#endif
+
+struct rig_async
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        /* signalled on submit and on stop */
+    rig_async_req_t *head;      /* submission queue */
+    rig_async_req_t *tail;
+    rig_async_req_t *done_head; /* completed requests without callback */
+    rig_async_req_t *done_tail;
+    int done_fd[2];             /* one byte per queued completion */
+    int stop;
+};
+
+
+static void async_execute(RIG *rig, rig_async_req_t *req)
+{
+    switch (req->op)
+    {
+    case RIG_ASYNC_GET_FREQ:
+        req->retcode = rig_get_freq(rig, req->vfo, &req->freq);
+        break;
+
+    case RIG_ASYNC_SET_FREQ:
+        req->retcode = rig_set_freq(rig, req->vfo, req->freq);
+        break;
+
+    case RIG_ASYNC_GET_MODE:
+        req->retcode = rig_get_mode(rig, req->vfo, &req->mode, &req->width);
+        break;
+
+    case RIG_ASYNC_SET_MODE:
+        req->retcode = rig_set_mode(rig, req->vfo, req->mode, req->width);
+        break;
+
+    case RIG_ASYNC_GET_VFO:
+        req->retcode = rig_get_vfo(rig, &req->vfo);
+        break;
+
+    case RIG_ASYNC_SET_VFO:
+        req->retcode = rig_set_vfo(rig, req->vfo);
+        break;
+
+    case RIG_ASYNC_GET_PTT:
+        req->retcode = rig_get_ptt(rig, req->vfo, &req->ptt);
+        break;
+
+    case RIG_ASYNC_SET_PTT:
+        req->retcode = rig_set_ptt(rig, req->vfo, req->ptt);
+        break;
+
+    case RIG_ASYNC_GET_SPLIT_VFO:
+        req->retcode = rig_get_split_vfo(rig, req->vfo, &req->split, &req->tx_vfo);
+        break;
+
+    case RIG_ASYNC_SET_SPLIT_VFO:
+        req->retcode = rig_set_split_vfo(rig, req->vfo, req->split, req->tx_vfo);
+        break;
+
+    case RIG_ASYNC_GET_LEVEL:
+        req->retcode = rig_get_level(rig, req->vfo, req->setting, &req->val);
+        break;
+
+    case RIG_ASYNC_SET_LEVEL:
+        req->retcode = rig_set_level(rig, req->vfo, req->setting, req->val);
+        break;
+
+    case RIG_ASYNC_GET_FUNC:
+        req->retcode = rig_get_func(rig, req->vfo, req->setting, &req->status);
+        break;
+
+    case RIG_ASYNC_SET_FUNC:
+        req->retcode = rig_set_func(rig, req->vfo, req->setting, req->status);
+        break;
+
+    default:
+        rig_debug(RIG_DEBUG_ERR, "%s: unknown op %d\n", __func__, req->op);
+        req->retcode = -RIG_EINVAL;
+    }
+}
+
+
+static void async_complete(RIG *rig, struct rig_async *as, rig_async_req_t *req)
+{
+    if (req->cb)
+    {
+        req->cb(rig, req, req->cb_arg);
+        return;
+    }
+
+    pthread_mutex_lock(&as->lock);
+
+    if (as->done_tail)
+    {
+        as->done_tail->next = req;
+    }
+    else
+    {
+        as->done_head = req;
+    }
+
+    as->done_tail = req;
+
+#ifndef ASYNC_NO_FD
+
+    /* written under the lock so the byte is there before the request
+     * can be collected.  The write end does not block: a full pipe is
+     * readable already, and rig_async_next_done() tops it up again */
+    if (write(as->done_fd[1], "", 1) != 1 && errno != EAGAIN
+            && errno != EWOULDBLOCK)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: completion fd write: %s\n", __func__,
+                  strerror(errno));
+    }
+
+#endif
+
+    pthread_mutex_unlock(&as->lock);
+}
+
+
+static void *async_thread(void *arg)
+{
+    RIG *rig = (RIG *)arg;
+    struct rig_async *as = RIG_INTERNAL(rig)->async;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: started\n", __func__);
+
+    for (;;)
+    {
+        rig_async_req_t *req;
+
+        pthread_mutex_lock(&as->lock);
+
+        /* queued requests are still run after a stop request */
+        while (!as->head && !as->stop)
+        {
+            pthread_cond_wait(&as->cond, &as->lock);
+        }
+
+        req = as->head;
+
+        if (req)
+        {
+            as->head = req->next;
+
+            if (!as->head) { as->tail = NULL; }
+
+            req->next = NULL;
+        }
+
+        pthread_mutex_unlock(&as->lock);
+
+        if (!req)
+        {
+            break;
+        }
+
+        async_execute(rig, req);
+        async_complete(rig, as, req);
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: stopped\n", __func__);
+
+    return NULL;
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * \brief Start the asynchronous I/O thread of a rig
+ * \param rig The rig handle, must be opened
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * \sa rig_async_close(), rig_async_submit()
+ */
+int HAMLIB_API rig_async_open(RIG *rig)
+{
+#ifdef HAVE_PTHREAD
+    struct rig_async *as;
+    int retcode;
+
+    ENTERFUNC;
+
+    if (!rig || !rig->state.comm_state)
+    {
+        RETURNFUNC(-RIG_EINVAL);
+    }
+
+    if (RIG_INTERNAL(rig)->async)
+    {
+        RETURNFUNC(RIG_OK);
+    }
+
+    as = calloc(1, sizeof(struct rig_async));
+
+    if (!as)
+    {
+        RETURNFUNC(-RIG_ENOMEM);
+    }
+
+    as->done_fd[0] = as->done_fd[1] = -1;
+
+#ifndef ASYNC_NO_FD
+
+    if (pipe(as->done_fd) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pipe: %s\n", __func__, strerror(errno));
+        free(as);
+        RETURNFUNC(-RIG_EIO);
+    }
+
+    fcntl(as->done_fd[0], F_SETFL, O_NONBLOCK);
+    fcntl(as->done_fd[1], F_SETFL, O_NONBLOCK);
+#endif
+
+    pthread_mutex_init(&as->lock, NULL);
+    pthread_cond_init(&as->cond, NULL);
+
+    RIG_INTERNAL(rig)->async = as;
+
+    retcode = pthread_create(&as->thread, NULL, async_thread, rig);
+
+    if (retcode != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pthread_create: %s\n", __func__,
+                  strerror(retcode));
+        RIG_INTERNAL(rig)->async = NULL;
+        pthread_cond_destroy(&as->cond);
+        pthread_mutex_destroy(&as->lock);
+#ifndef ASYNC_NO_FD
+        close(as->done_fd[0]);
+        close(as->done_fd[1]);
+#endif
+        free(as);
+        RETURNFUNC(-RIG_EINTERNAL);
+    }
+
+    RETURNFUNC(RIG_OK);
+#else
+    return -RIG_ENIMPL;
+#endif
+}
+
+
+/**
+ * \brief Stop the asynchronous I/O thread of a rig
+ * \param rig The rig handle
+ *
+ * Requests already submitted are run to completion first.  Completed
+ * requests not yet collected with rig_async_next_done() are dropped,
+ * their memory still belongs to the caller.  rig_close() calls this.
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * \sa rig_async_open()
+ */
+int HAMLIB_API rig_async_close(RIG *rig)
+{
+#ifdef HAVE_PTHREAD
+    struct rig_async *as;
+
+    ENTERFUNC;
+
+    if (!rig)
+    {
+        RETURNFUNC(-RIG_EINVAL);
+    }
+
+    as = RIG_INTERNAL(rig)->async;
+
+    if (!as)
+    {
+        RETURNFUNC(RIG_OK);
+    }
+
+    pthread_mutex_lock(&as->lock);
+    as->stop = 1;
+    pthread_cond_signal(&as->cond);
+    pthread_mutex_unlock(&as->lock);
+
+    pthread_join(as->thread, NULL);
+
+    RIG_INTERNAL(rig)->async = NULL;
+
+    pthread_cond_destroy(&as->cond);
+    pthread_mutex_destroy(&as->lock);
+#ifndef ASYNC_NO_FD
+    close(as->done_fd[0]);
+    close(as->done_fd[1]);
+#endif
+    free(as);
+
+    RETURNFUNC(RIG_OK);
+#else
+    return -RIG_ENIMPL;
+#endif
+}
+
+
+/**
+ * \brief Queue a request for the I/O thread
+ * \param rig The rig handle
+ * \param req The request, must stay valid until it completes
+ *
+ * Returns immediately.  When the request has run, req->retcode holds
+ * the result and either req->cb is called from the I/O thread or, when
+ * req->cb is NULL, the request is queued for rig_async_next_done().
+ *
+ * \return RIG_OK if the request was queued, otherwise a negative value
+ * if an error occurred (in which case, cause is set appropriately).
+ *
+ * \sa rig_async_open(), rig_async_get_fd()
+ */
+int HAMLIB_API rig_async_submit(RIG *rig, rig_async_req_t *req)
+{
+#ifdef HAVE_PTHREAD
+    struct rig_async *as;
+
+    if (!rig || !req)
+    {
+        return -RIG_EINVAL;
+    }
+
+    as = RIG_INTERNAL(rig)->async;
+
+    if (!as)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: rig_async_open not called\n", __func__);
+        return -RIG_EINVAL;
+    }
+
+    req->next = NULL;
+    req->retcode = -RIG_EINTERNAL;
+
+    pthread_mutex_lock(&as->lock);
+
+    if (as->stop)
+    {
+        pthread_mutex_unlock(&as->lock);
+        return -RIG_EINVAL;
+    }
+
+    if (as->tail)
+    {
+        as->tail->next = req;
+    }
+    else
+    {
+        as->head = req;
+    }
+
+    as->tail = req;
+    pthread_cond_signal(&as->cond);
+    pthread_mutex_unlock(&as->lock);
+
+    return RIG_OK;
+#else
+    return -RIG_ENIMPL;
+#endif
+}
+
+
+/**
+ * \brief Get the completion fd of a rig
+ * \param rig The rig handle
+ *
+ * The fd becomes readable when a request without callback has completed.
+ * Collect it with rig_async_next_done(), never read the fd directly.
+ *
+ * \return the fd, or a negative value if the engine is not open or
+ * the platform has no pollable completion fd.
+ *
+ * \sa rig_async_next_done()
+ */
+int HAMLIB_API rig_async_get_fd(RIG *rig)
+{
+#if defined(HAVE_PTHREAD) && !defined(ASYNC_NO_FD)
+    struct rig_async *as;
+
+    if (!rig || !(as = RIG_INTERNAL(rig)->async))
+    {
+        return -RIG_EINVAL;
+    }
+
+    return as->done_fd[0];
+#else
+    return -RIG_ENIMPL;
+#endif
+}
+
+
+/**
+ * \brief Collect one completed request
+ * \param rig The rig handle
+ *
+ * Does not block.
+ *
+ * \return the oldest completed request without callback, or NULL if
+ * there is none.
+ *
+ * \sa rig_async_get_fd()
+ */
+rig_async_req_t *HAMLIB_API rig_async_next_done(RIG *rig)
+{
+#ifdef HAVE_PTHREAD
+    struct rig_async *as;
+    rig_async_req_t *req;
+
+    if (!rig || !(as = RIG_INTERNAL(rig)->async))
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&as->lock);
+
+    req = as->done_head;
+
+    if (req)
+    {
+        as->done_head = req->next;
+
+        if (!as->done_head) { as->done_tail = NULL; }
+
+        req->next = NULL;
+    }
+
+#ifndef ASYNC_NO_FD
+
+    if (req)
+    {
+        char c;
+
+        /* one byte was written per completion, keep the fd level in step.
+         * Bytes dropped while the pipe was full leave it short, so keep it
+         * readable as long as requests remain */
+        if (read(as->done_fd[0], &c, 1) != 1 && as->done_head
+                && write(as->done_fd[1], "", 1) != 1)
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: completion fd out of step\n", __func__);
+        }
+    }
+
+#endif
+
+    pthread_mutex_unlock(&as->lock);
+
+    return req;
+#else
+    return NULL;
+#endif
+}
+
+/** @} */
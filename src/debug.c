@@ -63,6 +63,80 @@ static FILE *rig_debug_stream;
 static vprintf_cb_t rig_vprintf_cb;
 static rig_ptr_t rig_vprintf_arg;
 
+//! @cond Doxygen_Suppress
+/*
+ * Ring of the most recent saved messages, see RIG_DEBUG_SAVE_LEVEL.
+ * Writers claim a slot with an atomic increment of debugmsg_head and stamp
+ * it with its sequence number once the text is complete, readers drop a
+ * slot whose stamp changed while they copied it.  No lock is taken.
+ */
+#define DEBUGMSG_RING_SIZE 8    /* must be a power of 2 */
+
+static struct
+{
+    volatile unsigned long seq;
+    char msg[DEBUGMSG_LEN];
+} debugmsg_ring[DEBUGMSG_RING_SIZE];
+
+static volatile unsigned long debugmsg_head;
+
+static void debugmsg_save(const char *fmt, va_list ap)
+{
+    unsigned long seq = HL_ATOMIC_ADD(debugmsg_head, 1);
+    int i = (seq - 1) & (DEBUGMSG_RING_SIZE - 1);
+
+    debugmsg_ring[i].seq = 0;
+    HL_BARRIER();
+    vsnprintf(debugmsg_ring[i].msg, sizeof(debugmsg_ring[i].msg), fmt, ap);
+    HL_BARRIER();
+    debugmsg_ring[i].seq = seq;
+}
+
+
+/*
+ * Copy up to count of the most recent saved messages, oldest first,
+ * into buf.  Returns the number of messages copied.
+ */
+int debugmsg_recent(char *buf, int buflen, int count)
+{
+    unsigned long head = debugmsg_head;
+    unsigned long seq;
+    int n = 0;
+    int len = 0;
+
+    if (buflen <= 0) { return 0; }
+
+    buf[0] = 0;
+
+    if (count > DEBUGMSG_RING_SIZE - 1) { count = DEBUGMSG_RING_SIZE - 1; }
+
+    if (count > head) { count = head; }
+
+    for (seq = head - count + 1; seq <= head && len < buflen - 1; seq++)
+    {
+        int i = (seq - 1) & (DEBUGMSG_RING_SIZE - 1);
+
+        if (debugmsg_ring[i].seq != seq) { continue; }
+
+        HL_BARRIER();
+        snprintf(buf + len, buflen - len, "%s", debugmsg_ring[i].msg);
+        HL_BARRIER();
+
+        if (debugmsg_ring[i].seq != seq)
+        {
+            /* overwritten while copying */
+            buf[len] = 0;
+            continue;
+        }
+
+        len += strlen(buf + len);
+        n++;
+    }
+
+    return n;
+}
+//! @endcond
+
 extern HAMLIB_EXPORT(void) dump_hex(const unsigned char ptr[], size_t size);
 
 /**
@@ -173,12 +247,18 @@ void HAMLIB_API rig_debug(enum rig_debug_level_e debug_level,
 {
     va_list ap;
 
+    if (debug_level <= RIG_DEBUG_SAVE_LEVEL || rig_need_debug(debug_level))
+    {
+        va_start(ap, fmt);
+        debugmsg_save(fmt, ap);
+        va_end(ap);
+    }
+
     if (!rig_need_debug(debug_level))
     {
         return;
     }
 
-
     va_start(ap, fmt);
 
     if (rig_vprintf_cb)
@@ -59,6 +59,8 @@
 
 #include <hamlib/rig.h>
 #include "event.h"
+#include "misc.h"
+#include "iofunc.h"
 
 #if defined(WIN32) && !defined(HAVE_TERMIOS_H)
 #  include "win32termios.h"
@@ -296,10 +298,6 @@ static int remove_trn_poll_rig(RIG *rig)
  */
 static int search_rig_and_decode(RIG *rig, rig_ptr_t data)
 {
-    fd_set rfds;
-    struct timeval tv;
-    int retval;
-
     /*
      * so far, only file oriented ports have event reporting support
      */
@@ -319,24 +317,13 @@ static int search_rig_and_decode(RIG *rig, rig_ptr_t data)
     }
 
 #else
-    FD_ZERO(&rfds);
-    FD_SET(rig->state.rigport.fd, &rfds);
-    /* Read status immediately. */
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
-
-    /* don't use FIONREAD to detect activity
-     * since it is less portable than select
-     * REM: EINTR possible with 0sec timeout? retval==0?
-     */
-    retval = select(rig->state.rigport.fd + 1, &rfds, NULL, NULL, &tv);
 
-    if (retval < 0)
+    /*
+     * Read status immediately.  Bytes a previous read_string() read
+     * ahead never show on the fd, so they count as well.
+     */
+    if (!port_pending(&rig->state.rigport))
     {
-        rig_debug(RIG_DEBUG_ERR,
-                  "%s: select: %s\n",
-                  __func__,
-                  strerror(errno));
         return -1;
     }
 
@@ -721,6 +708,9 @@ int HAMLIB_API rig_set_trn(RIG *rig, int trn)
 
     caps = rig->caps;
 
+    /* what the rig pushed is only trusted while it keeps pushing */
+    RIG_INTERNAL(rig)->cache_trn_items = 0;
+
     /* detect whether tranceive is active already */
     if (trn != RIG_TRN_OFF && rig->state.transceive != RIG_TRN_OFF)
     {
@@ -870,4 +860,183 @@ int HAMLIB_API rig_get_trn(RIG *rig, int *trn)
     return RIG_OK;
 }
 
+/**
+ * \brief report a frequency change sent by the rig on its own
+ * \param rig   The rig handle
+ * \param vfo   The VFO the frame is about, RIG_VFO_CURR if it does not say
+ * \param freq  The new frequency
+ *
+ * For backends decoding transceive frames, in decode_event or when such
+ * a frame turns up instead of a reply.  Stores \a freq in the cache as if
+ * rig_get_freq() had just read it, publishes the cache (see
+ * rig_publish_cache()), then calls the freq_event callback.
+ * While the rig is in RIG_TRN_RIG mode frequencies it has reported stay
+ * cached for the #HAMLIB_CACHE_TRN timeout.
+ *
+ * \return the return code of the callback, RIG_OK without callback
+ *
+ * \sa rig_set_freq_callback()
+ */
+int HAMLIB_API rig_fire_freq_event(RIG *rig, vfo_t vfo, freq_t freq)
+{
+    struct rig_state *rs = &rig->state;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo=%s, freq=%.0f\n", __func__,
+              rig_strvfo(vfo), freq);
+
+    if (vfo == RIG_VFO_CURR || vfo == rs->current_vfo)
+    {
+        rs->current_freq = freq;
+        rs->cache.freq = freq;
+        rs->cache.vfo_freq = vfo;
+        HL_CACHE_SET(rig, time_freq);
+    }
+
+    rig_set_cache_freq(rig, vfo, freq);
+    RIG_INTERNAL(rig)->cache_trn_items |= 1 << HAMLIB_CACHE_FREQ;
+    rig_publish_cache(rig);
+
+    if (rig->callbacks.freq_event)
+    {
+        return rig->callbacks.freq_event(rig, vfo, freq, rig->callbacks.freq_arg);
+    }
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief report a mode change sent by the rig on its own
+ * \param rig   The rig handle
+ * \param vfo   The VFO the frame is about, RIG_VFO_CURR if it does not say
+ * \param mode  The new mode
+ * \param width The new passband width, RIG_PASSBAND_NORMAL if the frame
+ *              does not carry one
+ *
+ * Same as rig_fire_freq_event() for the mode and the mode_event callback.
+ * A frame without passband only tells that the mode changed, so the
+ * cached mode is invalidated instead of stored with a guessed width.
+ *
+ * \return the return code of the callback, RIG_OK without callback
+ *
+ * \sa rig_set_mode_callback()
+ */
+int HAMLIB_API rig_fire_mode_event(RIG *rig, vfo_t vfo, rmode_t mode,
+                                   pbwidth_t width)
+{
+    if (width == RIG_PASSBAND_NORMAL)
+    {
+        HL_CACHE_INVALIDATE(rig, time_mode);
+        RIG_INTERNAL(rig)->cache_trn_items &= ~(1 << HAMLIB_CACHE_MODE);
+    }
+    else
+    {
+        rig_set_cache_mode(rig, vfo, mode, width);
+        RIG_INTERNAL(rig)->cache_trn_items |= 1 << HAMLIB_CACHE_MODE;
+    }
+
+    rig_publish_cache(rig);
+
+    if (rig->callbacks.mode_event)
+    {
+        return rig->callbacks.mode_event(rig, vfo, mode, width,
+                                         rig->callbacks.mode_arg);
+    }
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief report a VFO change sent by the rig on its own
+ * \param rig   The rig handle
+ * \param vfo   The new current VFO
+ *
+ * Same as rig_fire_freq_event() for the current VFO and the vfo_event
+ * callback.
+ *
+ * \return the return code of the callback, RIG_OK without callback
+ *
+ * \sa rig_set_vfo_callback()
+ */
+int HAMLIB_API rig_fire_vfo_event(RIG *rig, vfo_t vfo)
+{
+    struct rig_state *rs = &rig->state;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo=%s\n", __func__, rig_strvfo(vfo));
+
+    rs->current_vfo = vfo;
+    rs->cache.vfo = vfo;
+    HL_CACHE_SET(rig, time_vfo);
+    RIG_INTERNAL(rig)->cache_trn_items |= 1 << HAMLIB_CACHE_VFO;
+    rig_publish_cache(rig);
+
+    if (rig->callbacks.vfo_event)
+    {
+        return rig->callbacks.vfo_event(rig, vfo, rig->callbacks.vfo_arg);
+    }
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief report a PTT change sent by the rig on its own
+ * \param rig   The rig handle
+ * \param vfo   The VFO the frame is about, RIG_VFO_CURR if it does not say
+ * \param ptt   The new PTT status
+ *
+ * Same as rig_fire_freq_event() for the PTT and the ptt_event callback.
+ *
+ * \return the return code of the callback, RIG_OK without callback
+ *
+ * \sa rig_set_ptt_callback()
+ */
+int HAMLIB_API rig_fire_ptt_event(RIG *rig, vfo_t vfo, ptt_t ptt)
+{
+    struct rig_state *rs = &rig->state;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo=%s, ptt=%d\n", __func__,
+              rig_strvfo(vfo), ptt);
+
+    rs->cache.ptt = ptt;
+    HL_CACHE_SET(rig, time_ptt);
+    RIG_INTERNAL(rig)->cache_trn_items |= 1 << HAMLIB_CACHE_PTT;
+    rig_publish_cache(rig);
+
+    if (rig->callbacks.ptt_event)
+    {
+        return rig->callbacks.ptt_event(rig, vfo, ptt, rig->callbacks.ptt_arg);
+    }
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief flush the rig port before sending a command
+ * \param rig   The rig handle
+ *
+ * rig_flush() for backends that decode transceive frames.  Bytes thrown
+ * away here may be frames the event thread never got to decode while it
+ * was held, so the cache can no longer count on having the rig's latest
+ * values and goes back to the normal timeout until new frames arrive.
+ *
+ * \return the return code of rig_flush()
+ */
+int HAMLIB_API rig_flush_trn(RIG *rig)
+{
+    hamlib_port_t *port = &rig->state.rigport;
+
+    if (RIG_INTERNAL(rig)->cache_trn_items && port_pending(port))
+    {
+        rig_debug(RIG_DEBUG_VERBOSE,
+                  "%s: discarding unread data, transceive cache dropped\n",
+                  __func__);
+        RIG_INTERNAL(rig)->cache_trn_items = 0;
+    }
+
+    return rig_flush(port);
+}
+
 /** @} */
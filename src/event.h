@@ -28,5 +28,13 @@
 int add_trn_rig(RIG *rig);
 int remove_trn_rig(RIG *rig);
 
+/* for backends decoding frames the rig sends on its own */
+extern HAMLIB_EXPORT(int) rig_fire_freq_event(RIG *rig, vfo_t vfo, freq_t freq);
+extern HAMLIB_EXPORT(int) rig_fire_mode_event(RIG *rig, vfo_t vfo, rmode_t mode,
+                                              pbwidth_t width);
+extern HAMLIB_EXPORT(int) rig_fire_vfo_event(RIG *rig, vfo_t vfo);
+extern HAMLIB_EXPORT(int) rig_fire_ptt_event(RIG *rig, vfo_t vfo, ptt_t ptt);
+extern HAMLIB_EXPORT(int) rig_flush_trn(RIG *rig);
+
 #endif /* _EVENT_H */
 
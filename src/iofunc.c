@@ -44,6 +44,14 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef HAVE_POLL_H
+#  include <poll.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
 #include <hamlib/rig.h>
 #include "iofunc.h"
 #include "misc.h"
@@ -54,6 +62,7 @@
 #include "network.h"
 #include "cm108.h"
 #include "gpio.h"
+#include "wirecap.h"
 
 /**
  * \brief Open a hamlib_port based on its rig port type
@@ -64,11 +73,24 @@ int HAMLIB_API port_open(hamlib_port_t *p)
 {
     int status;
     int want_state_delay = 0;
+    struct port_priv *pp;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
     p->fd = -1;
 
+    pp = port_priv(p);
+
+    if (!pp)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    port_rxbuf_reset(p);
+    memset(&pp->stats, 0, sizeof(pp->stats));
+    memset(&pp->last_write, 0, sizeof(pp->last_write));
+    pp->first_byte_pending = 0;
+
     switch (p->type.rig)
     {
     case RIG_PORT_SERIAL:
@@ -179,6 +201,8 @@ int HAMLIB_API port_open(hamlib_port_t *p)
         return -RIG_EINVAL;
     }
 
+    wirecap_open(p);
+
     return RIG_OK;
 }
 
@@ -227,6 +251,9 @@ int HAMLIB_API port_close(hamlib_port_t *p, rig_port_t port_type)
         p->fd = -1;
     }
 
+    port_rxbuf_reset(p);
+    wirecap_close(p);
+
     return ret;
 }
 
@@ -395,6 +422,498 @@ static ssize_t port_read(hamlib_port_t *p, void *buf, size_t count)
 
 #endif
 
+
+/*
+ * Wait up to timeout_ms for p->fd to become readable.
+ * Returns >0 when readable, 0 on timeout, -1 if the wait itself
+ * failed (errno is set) and -2 if the fd reports an error condition.
+ *
+ * poll() is used where available since select() cannot handle an fd
+ * above FD_SETSIZE, which a busy multi-client daemon can easily reach.
+ */
+static int port_wait(hamlib_port_t *p, int timeout_ms)
+{
+    if (timeout_ms < 0)
+    {
+        /* deadline passed, still pick up anything already there */
+        timeout_ms = 0;
+    }
+
+#if defined(HAVE_POLL_H) && !(defined(WIN32) && !defined(HAVE_TERMIOS_H))
+    struct pollfd pfd;
+    int retval;
+
+    pfd.fd = p->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    retval = poll(&pfd, 1, timeout_ms);
+
+    if (retval > 0 && (pfd.revents & (POLLERR | POLLNVAL)))
+    {
+        return -2;
+    }
+
+    return retval;
+#else
+    fd_set rfds, efds;
+    struct timeval tv;
+    int retval;
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    FD_ZERO(&rfds);
+    FD_SET(p->fd, &rfds);
+    efds = rfds;
+
+    retval = port_select(p, p->fd + 1, &rfds, NULL, &efds, &tv);
+
+    if (retval > 0 && FD_ISSET(p->fd, &efds))
+    {
+        return -2;
+    }
+
+    return retval;
+#endif
+}
+
+/*
+ * Histogram bucket of a latency, 4 buckets per power of two, see
+ * rig_port_stats_bucket_us() for the inverse.
+ */
+static int port_stats_bucket(unsigned long us)
+{
+    unsigned long v = us;
+    int e = 0;
+
+    if (us < 8)
+    {
+        return us;
+    }
+
+    while (v >= 8)
+    {
+        v >>= 1;
+        e++;
+    }
+
+    /* us is now about v << e with v in 4..7 */
+    if (4 * e + v >= RIG_PORT_STATS_BUCKETS)
+    {
+        return RIG_PORT_STATS_BUCKETS - 1;
+    }
+
+    return 4 * e + v;
+}
+
+
+static unsigned long port_stats_since_write(const struct port_priv *pp)
+{
+    struct timespec now;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    clock_gettime(CLOCK_REALTIME, &now);
+#endif
+
+    return (now.tv_sec - pp->last_write.tv_sec) * 1000000
+           + (now.tv_nsec - pp->last_write.tv_nsec) / 1000;
+}
+
+
+/* raise *max to us, other threads may be doing the same */
+static void port_stats_max(unsigned long *max, unsigned long us)
+{
+    unsigned long old;
+
+    do
+    {
+        old = *max;
+
+        if (us <= old)
+        {
+            return;
+        }
+    }
+    while (!HL_ATOMIC_CAS(*max, old, us));
+}
+
+
+static void port_stats_write(struct port_priv *pp)
+{
+    HL_ATOMIC_ADD(pp->stats.writes, 1);
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &pp->last_write);
+#else
+    clock_gettime(CLOCK_REALTIME, &pp->last_write);
+#endif
+    pp->first_byte_pending = 1;
+}
+
+
+/* bytes arrived on the fd */
+static void port_stats_rx_bytes(struct port_priv *pp)
+{
+    unsigned long us;
+
+    if (!HL_ATOMIC_CAS(pp->first_byte_pending, 1, 0))
+    {
+        return;
+    }
+
+    us = port_stats_since_write(pp);
+    HL_ATOMIC_ADD(pp->stats.first_byte_us[port_stats_bucket(us)], 1);
+    port_stats_max(&pp->stats.first_byte_max_us, us);
+}
+
+
+/* a read completed, reply may have been read ahead already */
+static void port_stats_rx_frame(struct port_priv *pp)
+{
+    unsigned long us;
+
+    if (pp->last_write.tv_sec == 0 && pp->last_write.tv_nsec == 0)
+    {
+        return;
+    }
+
+    port_stats_rx_bytes(pp);
+
+    HL_ATOMIC_ADD(pp->stats.reads, 1);
+    us = port_stats_since_write(pp);
+    HL_ATOMIC_ADD(pp->stats.complete_us[port_stats_bucket(us)], 1);
+    HL_ATOMIC_ADD(pp->stats.complete_sum_us, us);
+    port_stats_max(&pp->stats.complete_max_us, us);
+}
+
+
+/**
+ * \brief Count a command the backend sends again after a failure
+ * \param p rig port descriptor
+ *
+ * Backends call this from their retry loops so rig_get_port_stats()
+ * can tell how often rigport.retry kicks in.
+ */
+void HAMLIB_API port_stats_retry(hamlib_port_t *p)
+{
+    struct port_priv *pp = port_priv_get(p);
+
+    if (pp)
+    {
+        HL_ATOMIC_ADD(pp->stats.retries, 1);
+    }
+}
+
+
+/*
+ * What port_priv() hands out, found by the address of the port so that
+ * hamlib_port_t keeps the layout applications were built against.  A
+ * rig has at most a few ports, a linear scan is all it takes.
+ */
+struct port_slot
+{
+    const hamlib_port_t *port;
+    struct port_priv *pp;
+};
+
+static struct port_slot *port_slots;
+static int port_nslots;
+static int port_slots_size;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t port_slots_lock = PTHREAD_MUTEX_INITIALIZER;
+#  define PORT_SLOTS_LOCK() pthread_mutex_lock(&port_slots_lock)
+#  define PORT_SLOTS_UNLOCK() pthread_mutex_unlock(&port_slots_lock)
+#else
+#  define PORT_SLOTS_LOCK()
+#  define PORT_SLOTS_UNLOCK()
+#endif
+
+
+/* slot of p, port_slots_lock held */
+static struct port_slot *port_slot(const hamlib_port_t *p)
+{
+    int i;
+
+    for (i = 0; i < port_nslots; i++)
+    {
+        if (port_slots[i].port == p)
+        {
+            return &port_slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * \brief Get the receive buffer, capture ring and statistics of a port
+ * \param p rig port descriptor
+ *
+ * They are kept out of hamlib_port_t so the public struct keeps its
+ * size.  Allocated on first use, ports opened without port_open() get
+ * theirs on their first read or write.  Freed by port_priv_free().
+ *
+ * \return the port data, NULL if out of memory
+ */
+struct port_priv *port_priv(hamlib_port_t *p)
+{
+    struct port_slot *slot;
+    struct port_priv *pp = NULL;
+
+    PORT_SLOTS_LOCK();
+
+    slot = port_slot(p);
+
+    if (slot)
+    {
+        pp = slot->pp;
+    }
+    else if (port_nslots < port_slots_size
+             || (slot = realloc(port_slots, (port_slots_size + 4)
+                                * sizeof(*port_slots))))
+    {
+        if (slot)
+        {
+            port_slots = slot;
+            port_slots_size += 4;
+        }
+
+        pp = calloc(1, sizeof(struct port_priv));
+
+        if (pp)
+        {
+            port_slots[port_nslots].port = p;
+            port_slots[port_nslots].pp = pp;
+            port_nslots++;
+        }
+    }
+
+    PORT_SLOTS_UNLOCK();
+
+    if (!pp)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: no memory\n", __func__);
+    }
+
+    return pp;
+}
+
+
+/**
+ * \brief Get what port_priv() allocated, without allocating
+ * \param p rig port descriptor
+ * \return the port data, NULL if the port was never used
+ */
+struct port_priv *port_priv_get(const hamlib_port_t *p)
+{
+    struct port_slot *slot;
+    struct port_priv *pp;
+
+    PORT_SLOTS_LOCK();
+    slot = port_slot(p);
+    pp = slot ? slot->pp : NULL;
+    PORT_SLOTS_UNLOCK();
+
+    return pp;
+}
+
+
+/**
+ * \brief Release what port_priv() allocated
+ * \param p rig port descriptor
+ *
+ * Called when the port goes away with its rig, rotator or amplifier.
+ * The statistics are kept across port_close() until then.
+ */
+void port_priv_free(hamlib_port_t *p)
+{
+    struct port_slot *slot;
+    struct port_priv *pp = NULL;
+
+    wirecap_close(p);
+
+    PORT_SLOTS_LOCK();
+
+    slot = port_slot(p);
+
+    if (slot)
+    {
+        pp = slot->pp;
+        *slot = port_slots[--port_nslots];
+    }
+
+    PORT_SLOTS_UNLOCK();
+
+    free(pp);
+}
+
+
+/**
+ * \brief Copy the traffic statistics of a port
+ * \param p rig port descriptor
+ * \param stats Buffer to receive the copy, zeroed if the port was never used
+ */
+void port_get_stats(hamlib_port_t *p, rig_port_stats_t *stats)
+{
+    const struct port_priv *pp = port_priv_get(p);
+
+    if (pp)
+    {
+        memcpy(stats, &pp->stats, sizeof(*stats));
+    }
+    else
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+
+/**
+ * \brief Discard any bytes held in the port receive buffer
+ * \param p rig port descriptor
+ *
+ * Must be called whenever the fd is (re)opened, closed or flushed,
+ * otherwise stale read-ahead data would be handed to the next reader.
+ */
+void port_rxbuf_reset(hamlib_port_t *p)
+{
+    struct port_priv *pp = port_priv_get(p);
+
+    if (pp)
+    {
+        pp->rxbuf.head = 0;
+        pp->rxbuf.tail = 0;
+    }
+}
+
+
+/*
+ * Number of bytes read ahead and not yet handed out.
+ */
+static int port_rxbuf_avail(const hamlib_port_t *p)
+{
+    const struct port_priv *pp = port_priv_get(p);
+
+    return pp ? pp->rxbuf.tail - pp->rxbuf.head : 0;
+}
+
+
+/**
+ * \brief Tell whether something can be read without waiting
+ * \param p rig port descriptor
+ *
+ * For backends picking up data the other end sends on its own between
+ * replies, e.g. the notifications of a rigctld subscription.
+ *
+ * \return non-zero when bytes are buffered or the fd is readable
+ */
+int HAMLIB_API port_pending(hamlib_port_t *p)
+{
+    return port_rxbuf_avail(p) > 0 || port_wait(p, 0) > 0;
+}
+
+
+/*
+ * Move up to count buffered bytes to rxbuffer.
+ * Returns the number of bytes copied.
+ */
+static int port_rxbuf_take(struct port_priv *pp, char *rxbuffer, int count)
+{
+    int avail = pp->rxbuf.tail - pp->rxbuf.head;
+
+    if (count > avail)
+    {
+        count = avail;
+    }
+
+    memcpy(rxbuffer, &pp->rxbuf.data[pp->rxbuf.head], count);
+    pp->rxbuf.head += count;
+
+    if (pp->rxbuf.head == pp->rxbuf.tail)
+    {
+        pp->rxbuf.head = 0;
+        pp->rxbuf.tail = 0;
+    }
+
+    return count;
+}
+
+
+/*
+ * Read whatever the fd has ready into the receive buffer, in one call.
+ * Unread bytes are moved to the front first so the buffer stays
+ * contiguous and can be scanned with memchr().
+ * Returns the number of bytes added, 0 or <0 on error.
+ */
+static int port_rxbuf_fill(hamlib_port_t *p, struct port_priv *pp)
+{
+    int rd_count;
+
+    if (pp->rxbuf.head > 0)
+    {
+        int avail = pp->rxbuf.tail - pp->rxbuf.head;
+
+        memmove(pp->rxbuf.data, &pp->rxbuf.data[pp->rxbuf.head], avail);
+        pp->rxbuf.head = 0;
+        pp->rxbuf.tail = avail;
+    }
+
+    if (pp->rxbuf.tail >= HAMLIB_PORT_RXBUFSIZ)
+    {
+        /* caller must consume before asking for more */
+        return 0;
+    }
+
+    rd_count = port_read(p, &pp->rxbuf.data[pp->rxbuf.tail],
+                         HAMLIB_PORT_RXBUFSIZ - pp->rxbuf.tail);
+
+    if (rd_count > 0)
+    {
+        pp->rxbuf.tail += rd_count;
+        port_stats_rx_bytes(pp);
+    }
+
+    return rd_count;
+}
+
+
+/*
+ * Length of the buffered data up to and including the first
+ * stopset character, or 0 if none is in the first len bytes.
+ */
+static int port_rxbuf_scan(const struct port_priv *pp,
+                           int len,
+                           const char *stopset,
+                           int stopset_len)
+{
+    const unsigned char *start = &pp->rxbuf.data[pp->rxbuf.head];
+    const unsigned char *stop = NULL;
+    int i;
+
+    if (!stopset)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < stopset_len; i++)
+    {
+        const unsigned char *q = memchr(start, (unsigned char)stopset[i],
+                                        stop ? stop - start : len);
+
+        if (q)
+        {
+            stop = q;
+        }
+    }
+
+    return stop ? stop - start + 1 : 0;
+}
+
+
 /**
  * \brief Write a block of characters to an fd.
  * \param p rig port descriptor
@@ -427,9 +946,17 @@ static ssize_t port_read(hamlib_port_t *p, void *buf, size_t count)
 int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
 {
     int ret;
+    struct port_priv *pp;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    pp = port_priv(p);
+
+    if (!pp)
+    {
+        return -RIG_ENOMEM;
+    }
+
 #ifdef WANT_NON_ACTIVE_POST_WRITE_DELAY
 
     if (p->post_write_date.tv_sec != 0)
@@ -518,6 +1045,8 @@ int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
 
     rig_debug(RIG_DEBUG_TRACE, "%s(): TX %d bytes\n", __func__, (int)count);
     dump_hex((unsigned char *) txbuffer, count);
+    wirecap_record(p, RIG_WIRECAP_TX, txbuffer, count);
+    port_stats_write(pp);
 
     return RIG_OK;
 }
@@ -533,7 +1062,9 @@ int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
  * Read "num" bytes from "fd" and put results into
  * an array of unsigned char pointed to by "rxbuffer"
  *
- * Blocks on read until timeout hits.
+ * Blocks on read until timeout hits.  The timeout applies to the
+ * whole block, not to each byte, so a slowly trickling reply cannot
+ * stretch the call beyond p->timeout.
  *
  * It then reads "num" bytes into rxbuffer.
  *
@@ -543,32 +1074,67 @@ int HAMLIB_API write_block(hamlib_port_t *p, const char *txbuffer, size_t count)
 
 int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
 {
-    fd_set rfds, efds;
-    struct timeval tv, tv_timeout, start_time, end_time, elapsed_time;
+    return read_block_deadline(p, rxbuffer, count, NULL);
+}
+
+
+/**
+ * \brief Read bytes from an fd before a deadline
+ * \param p rig port descriptor
+ * \param rxbuffer buffer to receive text
+ * \param count number of bytes
+ * \param deadline absolute time, see hl_deadline_set(), NULL for
+ * p->timeout from now
+ * \return count of bytes received
+ *
+ * Same as read_block() but gives up at \a deadline. Backends use this
+ * to spend one time budget across all the retries of a transaction.
+ */
+int HAMLIB_API read_block_deadline(hamlib_port_t *p,
+                                   char *rxbuffer,
+                                   size_t count,
+                                   const struct timespec *deadline)
+{
+    struct timeval start_time, end_time, elapsed_time;
+    struct timespec default_deadline;
+    struct port_priv *pp;
     int total_count = 0;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
-    /*
-     * Wait up to timeout ms.
-     */
-    tv_timeout.tv_sec = p->timeout / 1000;
-    tv_timeout.tv_usec = (p->timeout % 1000) * 1000;
+    pp = port_priv(p);
+
+    if (!pp)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    if (!deadline)
+    {
+        hl_deadline_set(&default_deadline, p->timeout);
+        deadline = &default_deadline;
+    }
 
     /* Store the time of the read loop start */
     gettimeofday(&start_time, NULL);
 
+    /*
+     * Hand out anything a previous read_string() read ahead.
+     * The rest is read straight into rxbuffer and never beyond count,
+     * so binary protocols see exactly the bytes they asked for.
+     */
+    total_count = port_rxbuf_take(pp, rxbuffer, count);
+    count -= total_count;
+
     while (count > 0)
     {
         int retval;
         int rd_count;
-        tv = tv_timeout;    /* select may have updated it */
-
-        FD_ZERO(&rfds);
-        FD_SET(p->fd, &rfds);
-        efds = rfds;
 
-        retval = port_select(p, p->fd + 1, &rfds, NULL, &efds, &tv);
+        /*
+         * Wait until the deadline.
+         */
+        retval = port_wait(p, hl_deadline_remaining_ms(deadline));
 
         if (retval == 0)
         {
@@ -577,6 +1143,8 @@ int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
             timersub(&end_time, &start_time, &elapsed_time);
 
             dump_hex((unsigned char *) rxbuffer, total_count);
+            wirecap_record(p, RIG_WIRECAP_RX_TIMEOUT, rxbuffer, total_count);
+            HL_ATOMIC_ADD(pp->stats.timeouts, 1);
             rig_debug(RIG_DEBUG_WARN,
                       "%s(): Timed out %d.%d seconds after %d chars\n",
                       __func__,
@@ -587,24 +1155,24 @@ int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
             return -RIG_ETIMEOUT;
         }
 
-        if (retval < 0)
+        if (retval == -2)
         {
-            dump_hex((unsigned char *) rxbuffer, total_count);
             rig_debug(RIG_DEBUG_ERR,
-                      "%s(): select() error after %d chars: %s\n",
+                      "%s(): fd error after %d chars\n",
                       __func__,
-                      total_count,
-                      strerror(errno));
+                      total_count);
 
             return -RIG_EIO;
         }
 
-        if (FD_ISSET(p->fd, &efds))
+        if (retval < 0)
         {
+            dump_hex((unsigned char *) rxbuffer, total_count);
             rig_debug(RIG_DEBUG_ERR,
-                      "%s(): fd error after %d chars\n",
+                      "%s(): wait error after %d chars: %s\n",
                       __func__,
-                      total_count);
+                      total_count,
+                      strerror(errno));
 
             return -RIG_EIO;
         }
@@ -625,12 +1193,19 @@ int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
             return -RIG_EIO;
         }
 
+        if (rd_count > 0)
+        {
+            port_stats_rx_bytes(pp);
+        }
+
         total_count += rd_count;
         count -= rd_count;
     }
 
     rig_debug(RIG_DEBUG_TRACE, "%s(): RX %d bytes\n", __func__, total_count);
     dump_hex((unsigned char *) rxbuffer, total_count);
+    wirecap_record(p, RIG_WIRECAP_RX, rxbuffer, total_count);
+    port_stats_rx_frame(pp);
 
     return total_count;           /* return bytes count read */
 }
@@ -650,7 +1225,8 @@ int HAMLIB_API read_block(hamlib_port_t *p, char *rxbuffer, size_t count)
  * Read a string from "fd" and put result into
  * an array of unsigned char pointed to by "rxbuffer"
  *
- * Blocks on read until timeout hits.
+ * Blocks on read until timeout hits.  The timeout applies to the
+ * whole string, not to each character.
  *
  * It then reads characters until one of the characters in
  * "stopset" is found, or until "rxmax-1" characters was copied
@@ -667,9 +1243,38 @@ int HAMLIB_API read_string(hamlib_port_t *p,
                            const char *stopset,
                            int stopset_len)
 {
-    fd_set rfds, efds;
-    struct timeval tv, tv_timeout, start_time, end_time, elapsed_time;
+    return read_string_deadline(p, rxbuffer, rxmax, stopset, stopset_len, NULL);
+}
+
+
+/**
+ * \brief Read a string from an fd before a deadline
+ * \param p Hamlib port descriptor
+ * \param rxbuffer buffer to receive string
+ * \param rxmax maximum string size + 1
+ * \param stopset string of recognized end of string characters
+ * \param stopset_len length of stopset
+ * \param deadline absolute time, see hl_deadline_set(), NULL for
+ * p->timeout from now
+ * \return number of characters read if the operation has been successful,
+ * otherwise a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * Same as read_string() but gives up at \a deadline. Backends use this
+ * to spend one time budget across all the retries of a transaction.
+ */
+int HAMLIB_API read_string_deadline(hamlib_port_t *p,
+                                    char *rxbuffer,
+                                    size_t rxmax,
+                                    const char *stopset,
+                                    int stopset_len,
+                                    const struct timespec *deadline)
+{
+    struct timeval start_time, end_time, elapsed_time;
+    struct timespec default_deadline;
+    struct port_priv *pp;
     int total_count = 0;
+    int timed_out = 0;
 
     rig_debug(RIG_DEBUG_TRACE, "%s called, rxmax=%d\n", __func__, (int)rxmax);
 
@@ -686,11 +1291,18 @@ int HAMLIB_API read_string(hamlib_port_t *p,
         return 0;
     }
 
-    /*
-     * Wait up to timeout ms.
-     */
-    tv_timeout.tv_sec = p->timeout / 1000;
-    tv_timeout.tv_usec = (p->timeout % 1000) * 1000;
+    pp = port_priv(p);
+
+    if (!pp)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    if (!deadline)
+    {
+        hl_deadline_set(&default_deadline, p->timeout);
+        deadline = &default_deadline;
+    }
 
     /* Store the time of the read loop start */
     gettimeofday(&start_time, NULL);
@@ -699,84 +1311,103 @@ int HAMLIB_API read_string(hamlib_port_t *p,
 
     while (total_count < rxmax - 1)
     {
-        int rd_count;
+        int avail;
+        int len;
         int retval;
-        tv = tv_timeout;    /* select may have updated it */
 
-        FD_ZERO(&rfds);
-        FD_SET(p->fd, &rfds);
-        efds = rfds;
+        if (port_rxbuf_avail(p) == 0)
+        {
+            int rd_count;
 
-        retval = port_select(p, p->fd + 1, &rfds, NULL, &efds, &tv);
+            /*
+             * Wait until the deadline.
+             */
+            retval = port_wait(p, hl_deadline_remaining_ms(deadline));
 
-        if (retval == 0)
-        {
-            if (0 == total_count)
+            if (retval == 0)
             {
-                /* Record timeout time and calculate elapsed time */
-                gettimeofday(&end_time, NULL);
-                timersub(&end_time, &start_time, &elapsed_time);
+                if (0 == total_count)
+                {
+                    /* Record timeout time and calculate elapsed time */
+                    gettimeofday(&end_time, NULL);
+                    timersub(&end_time, &start_time, &elapsed_time);
+
+                    dump_hex((unsigned char *) rxbuffer, total_count);
+                    wirecap_record(p, RIG_WIRECAP_RX_TIMEOUT, rxbuffer, 0);
+                    HL_ATOMIC_ADD(pp->stats.timeouts, 1);
+                    rig_debug(RIG_DEBUG_WARN,
+                              "%s(): Timed out %d.%03d seconds after %d chars\n",
+                              __func__,
+                              (int)elapsed_time.tv_sec,
+                              (int)elapsed_time.tv_usec / 1000,
+                              total_count);
+
+                    return -RIG_ETIMEOUT;
+                }
+
+                timed_out = 1;
+                HL_ATOMIC_ADD(pp->stats.timeouts, 1);
+                break;                      /* return what we have read */
+            }
 
-                dump_hex((unsigned char *) rxbuffer, total_count);
-                rig_debug(RIG_DEBUG_WARN,
-                          "%s(): Timed out %d.%03d seconds after %d chars\n",
+            if (retval == -2)
+            {
+                rig_debug(RIG_DEBUG_ERR,
+                          "%s(): fd error after %d chars\n",
                           __func__,
-                          (int)elapsed_time.tv_sec,
-                          (int)elapsed_time.tv_usec / 1000,
                           total_count);
 
-                return -RIG_ETIMEOUT;
+                return -RIG_EIO;
             }
 
-            break;                      /* return what we have read */
-        }
+            if (retval < 0)
+            {
+                dump_hex((unsigned char *) rxbuffer, total_count);
+                rig_debug(RIG_DEBUG_ERR,
+                          "%s(): wait error after %d chars: %s\n",
+                          __func__,
+                          total_count,
+                          strerror(errno));
 
-        if (retval < 0)
-        {
-            dump_hex((unsigned char *) rxbuffer, total_count);
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): select() error after %d chars: %s\n",
-                      __func__,
-                      total_count,
-                      strerror(errno));
+                return -RIG_EIO;
+            }
 
-            return -RIG_EIO;
-        }
+            /*
+             * read whatever the rig has sent so far in one go
+             * The file descriptor must have been set up non blocking.
+             */
+            rd_count = port_rxbuf_fill(p, pp);
 
-        if (FD_ISSET(p->fd, &efds))
-        {
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): fd error after %d chars\n",
-                      __func__,
-                      total_count);
+            /* if we get 0 bytes or an error something is wrong */
+            if (rd_count <= 0)
+            {
+                dump_hex((unsigned char *) rxbuffer, total_count);
+                rig_debug(RIG_DEBUG_ERR,
+                          "%s(): read() failed - %s\n",
+                          __func__,
+                          strerror(errno));
 
-            return -RIG_EIO;
+                return -RIG_EIO;
+            }
         }
 
-        /*
-             * read 1 character from the rig, (check if in stop set)
-         * The file descriptor must have been set up non blocking.
-         */
-        rd_count = port_read(p, &rxbuffer[total_count], 1);
+        // check to see if our string startis with \...if so we need more chars
+        if (total_count == 0 && pp->rxbuf.data[pp->rxbuf.head] == '\\') { rxmax = (rxmax - 1) * 5; }
 
-        /* if we get 0 bytes or an error something is wrong */
-        if (rd_count <= 0)
-        {
-            dump_hex((unsigned char *) rxbuffer, total_count);
-            rig_debug(RIG_DEBUG_ERR,
-                      "%s(): read() failed - %s\n",
-                      __func__,
-                      strerror(errno));
+        avail = port_rxbuf_avail(p);
 
-            return -RIG_EIO;
+        if (avail > rxmax - 1 - total_count)
+        {
+            avail = rxmax - 1 - total_count;
         }
 
-        // check to see if our string startis with \...if so we need more chars
-        if (total_count == 0 && rxbuffer[total_count] == '\\') { rxmax = (rxmax - 1) * 5; }
+        /* bytes past the stopset character stay buffered for the next read */
+        len = port_rxbuf_scan(pp, avail, stopset, stopset_len);
 
-        ++total_count;
+        total_count += port_rxbuf_take(pp, &rxbuffer[total_count],
+                                       len ? len : avail);
 
-        if (stopset && memchr(stopset, rxbuffer[total_count - 1], stopset_len))
+        if (len)
         {
             break;
         }
@@ -794,6 +1425,13 @@ int HAMLIB_API read_string(hamlib_port_t *p,
               total_count);
 
     dump_hex((unsigned char *) rxbuffer, total_count);
+    wirecap_record(p, timed_out ? RIG_WIRECAP_RX_TIMEOUT : RIG_WIRECAP_RX,
+                   rxbuffer, total_count);
+
+    if (!timed_out)
+    {
+        port_stats_rx_frame(pp);
+    }
 
     return total_count;           /* return bytes count read */
 }
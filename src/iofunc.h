@@ -23,12 +23,45 @@
 #define _IOFUNC_H 1
  
 #include <sys/types.h>
+#include <time.h>
 #include <hamlib/rig.h>
 
 
+#define HAMLIB_PORT_RXBUFSIZ 1024  /* per-port receive buffer size */
+
+struct wirecap;
+
+/*
+ * What hamlib keeps for an open port, out of the public hamlib_port_t.
+ * Allocated on first use by port_priv().
+ */
+struct port_priv
+{
+    struct
+    {
+        int head;           /* offset of the next unread byte */
+        int tail;           /* offset past the last received byte */
+        unsigned char data[HAMLIB_PORT_RXBUFSIZ]; /* bytes read ahead of the caller */
+    } rxbuf;
+    struct wirecap *wirecap;    /* traffic capture ring, see rig_wirecap_dump() */
+    rig_port_stats_t stats;     /* see rig_get_port_stats() */
+    struct timespec last_write; /* end of the last write, latencies count from there */
+    int first_byte_pending;     /* no byte received since the last write */
+};
+
+
 extern HAMLIB_EXPORT(int) port_open(hamlib_port_t *p);
 extern HAMLIB_EXPORT(int) port_close(hamlib_port_t *p, rig_port_t port_type);
 
+extern HAMLIB_EXPORT(struct port_priv *) port_priv(hamlib_port_t *p);
+extern HAMLIB_EXPORT(struct port_priv *) port_priv_get(const hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) port_priv_free(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) port_rxbuf_reset(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) port_stats_retry(hamlib_port_t *p);
+extern HAMLIB_EXPORT(void) port_get_stats(hamlib_port_t *p,
+                                          rig_port_stats_t *stats);
+extern HAMLIB_EXPORT(int) port_pending(hamlib_port_t *p);
+
 
 extern HAMLIB_EXPORT(int) read_block(hamlib_port_t *p,
                                      char *rxbuffer,
@@ -44,4 +77,16 @@ extern HAMLIB_EXPORT(int) read_string(hamlib_port_t *p,
                                       const char *stopset,
                                       int stopset_len);
 
+extern HAMLIB_EXPORT(int) read_block_deadline(hamlib_port_t *p,
+                                              char *rxbuffer,
+                                              size_t count,
+                                              const struct timespec *deadline);
+
+extern HAMLIB_EXPORT(int) read_string_deadline(hamlib_port_t *p,
+                                               char *rxbuffer,
+                                               size_t rxmax,
+                                               const char *stopset,
+                                               int stopset_len,
+                                               const struct timespec *deadline);
+
 #endif /* _IOFUNC_H */
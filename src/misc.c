@@ -39,6 +39,7 @@
 #include <unistd.h>  /* UNIX standard function definitions */
 #include <fcntl.h>   /* File control definitions */
 #include <errno.h>   /* Error number definitions */
+#include <limits.h>
 
 #ifdef HAVE_SYS_TYPES_H
 #  include <sys/types.h>
@@ -55,6 +56,7 @@
 #include <hamlib/amplifier.h>
 
 #include "misc.h"
+#include "state.h"
 #include "serial.h"
 #include "network.h"
 
@@ -1610,9 +1612,158 @@ double HAMLIB_API elapsed_ms(struct timespec *start, int option)
     return elapsed_msec;
 }
 
+/**
+ * \brief Set an absolute deadline timeout_ms from now
+ * \param deadline deadline to set
+ * \param timeout_ms time budget in milliseconds
+ *
+ * Uses the monotonic clock where available so the deadline does not
+ * move when the wall clock is stepped.
+ */
+void HAMLIB_API hl_deadline_set(struct timespec *deadline, int timeout_ms)
+{
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+#else
+    clock_gettime(CLOCK_REALTIME, deadline);
+#endif
+
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+
+    if (deadline->tv_nsec >= 1000000000)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+
+/**
+ * \brief Milliseconds left until a deadline set by hl_deadline_set()
+ * \param deadline the deadline
+ * \return remaining time, 0 or negative once the deadline has passed
+ */
+int HAMLIB_API hl_deadline_remaining_ms(const struct timespec *deadline)
+{
+    struct timespec now;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    clock_gettime(CLOCK_REALTIME, &now);
+#endif
+
+    return (deadline->tv_sec - now.tv_sec) * 1000
+           + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+}
+
+
+/* the cache only needs ms resolution, the coarse clock skips the timer read */
+static void hl_cache_clock(struct timespec *ts)
+{
+#if defined(CLOCK_MONOTONIC_COARSE)
+    clock_gettime(CLOCK_MONOTONIC_COARSE, ts);
+#elif defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, ts);
+#else
+    clock_gettime(CLOCK_REALTIME, ts);
+#endif
+}
+
+
+/**
+ * \brief Mark a cache entry as refreshed now
+ * \param t the cache entry time stamp
+ */
+void HAMLIB_API hl_cache_set(struct rig_cache_time *t)
+{
+    hl_cache_clock(&t->ts);
+    t->valid = 1;
+}
+
+
+/**
+ * \brief Invalidate a cache entry
+ * \param t the cache entry time stamp
+ */
+void HAMLIB_API hl_cache_invalidate(struct rig_cache_time *t)
+{
+    t->valid = 0;
+}
+
+
+/**
+ * \brief Mark a rig_cache entry as refreshed now
+ * \param t the cache entry time stamp
+ * \param pub the public time stamp of the entry in rig_cache
+ *
+ * Sets \a pub to the wall clock time, as elapsed_ms() used to.
+ */
+void HAMLIB_API hl_cache_entry_set(struct rig_cache_time *t,
+                                   struct timespec *pub)
+{
+    hl_cache_set(t);
+    clock_gettime(CLOCK_REALTIME, pub);
+}
+
+
+/**
+ * \brief Invalidate a rig_cache entry
+ * \param t the cache entry time stamp
+ * \param pub the public time stamp of the entry in rig_cache
+ *
+ * Sets \a pub ten seconds back, as elapsed_ms() used to.
+ */
+void HAMLIB_API hl_cache_entry_invalidate(struct rig_cache_time *t,
+        struct timespec *pub)
+{
+    hl_cache_invalidate(t);
+    clock_gettime(CLOCK_REALTIME, pub);
+    pub->tv_sec -= 10;
+}
+
+
+/**
+ * \brief Age of a cache entry
+ * \param t the cache entry time stamp
+ * \return milliseconds since hl_cache_set(), INT_MAX for an invalid entry
+ */
+int HAMLIB_API hl_cache_age_ms(const struct rig_cache_time *t)
+{
+    struct timespec now;
+    long sec;
+
+    if (!t->valid)
+    {
+        return INT_MAX;
+    }
+
+    hl_cache_clock(&now);
+    sec = now.tv_sec - t->ts.tv_sec;
+
+    if (sec >= INT_MAX / 1000)
+    {
+        return INT_MAX;
+    }
+
+    return sec * 1000 + (now.tv_nsec - t->ts.tv_nsec) / 1000000;
+}
+
 int HAMLIB_API rig_get_cache_timeout_ms(RIG *rig, hamlib_cache_t selection)
 {
     rig_debug(RIG_DEBUG_TRACE, "%s: called selection=%d\n", __func__, selection);
+
+    if (selection == HAMLIB_CACHE_METER)
+    {
+        return RIG_INTERNAL(rig)->cache_timeout_ms_meter;
+    }
+
+    if (selection == HAMLIB_CACHE_TRN)
+    {
+        return RIG_INTERNAL(rig)->cache_timeout_ms_trn;
+    }
+
     return rig->state.cache.timeout_ms;
 }
 
@@ -1621,11 +1772,71 @@ int HAMLIB_API rig_set_cache_timeout_ms(RIG *rig, hamlib_cache_t selection,
 {
     rig_debug(RIG_DEBUG_TRACE, "%s: called selection=%d, ms=%d\n", __func__,
               selection, ms);
+
+    if (selection == HAMLIB_CACHE_METER)
+    {
+        RIG_INTERNAL(rig)->cache_timeout_ms_meter = ms;
+        return RIG_OK;
+    }
+
+    if (selection == HAMLIB_CACHE_TRN)
+    {
+        RIG_INTERNAL(rig)->cache_timeout_ms_trn = ms;
+        return RIG_OK;
+    }
+
     rig->state.cache.timeout_ms = ms;
     return RIG_OK;
 }
 
 
+/**
+ * \brief Tell the cache when the request being served arrived
+ * \param rig The rig handle
+ * \param t   time stamp taken with hl_cache_set() when the request came in,
+ *            NULL when done with it
+ *
+ * A value the rig reported after the request arrived is as good as a
+ * fresh read for it, whatever the cache timeouts say.  A server that
+ * queues requests from several clients sets this before serving each one,
+ * so identical reads waiting behind one that is on the wire are all
+ * answered by that single transaction.
+ */
+void HAMLIB_API rig_set_cache_request_time(RIG *rig,
+        const struct rig_cache_time *t)
+{
+    if (t)
+    {
+        RIG_INTERNAL(rig)->cache_request = *t;
+    }
+    else
+    {
+        hl_cache_invalidate(&RIG_INTERNAL(rig)->cache_request);
+    }
+}
+
+
+/*
+ * Cache timeout stretched to cover every entry refreshed since the
+ * request being served arrived, see rig_set_cache_request_time().
+ * Ages are truncated to ms, so an entry from before the request never
+ * comes out younger than it.
+ */
+int HAMLIB_API hl_cache_timeout_ms(const RIG *rig, int timeout_ms)
+{
+    int request_ms;
+
+    if (!RIG_INTERNAL(rig)->cache_request.valid)
+    {
+        return timeout_ms;
+    }
+
+    request_ms = hl_cache_age_ms(&RIG_INTERNAL(rig)->cache_request);
+
+    return request_ms > timeout_ms ? request_ms : timeout_ms;
+}
+
+
 vfo_t HAMLIB_API vfo_fixup(RIG *rig, vfo_t vfo)
 {
     rig_debug(RIG_DEBUG_TRACE, "%s: vfo=%s\n", __func__, rig_strvfo(vfo));
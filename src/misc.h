@@ -23,6 +23,7 @@
 #define _MISC_H 1
 
 #include <hamlib/rig.h>
+#include "state.h"
 
 
 /*
@@ -106,10 +107,56 @@ extern HAMLIB_EXPORT(int) hl_usleep(rig_useconds_t usec);
 
 extern HAMLIB_EXPORT(double) elapsed_ms(struct timespec *start, int start_flag);
 
+extern HAMLIB_EXPORT(void) hl_deadline_set(struct timespec *deadline,
+                                           int timeout_ms);
+extern HAMLIB_EXPORT(int) hl_deadline_remaining_ms(const struct timespec *deadline);
+
+/*
+ * Counters and sequence numbers that other threads read without locking.
+ * HL_ATOMIC_ADD() yields the new value, HL_ATOMIC_CAS() whether x held
+ * old and now holds new, HL_BARRIER() is a full memory barrier.
+ */
+#ifdef __GNUC__
+#  define HL_ATOMIC_ADD(x, n) __sync_add_and_fetch(&(x), n)
+#  define HL_ATOMIC_CAS(x, old, new) __sync_bool_compare_and_swap(&(x), old, new)
+#  define HL_BARRIER() __sync_synchronize()
+#else
+#  define HL_ATOMIC_ADD(x, n) ((x) += (n))
+#  define HL_ATOMIC_CAS(x, old, new) ((x) = (new), 1)
+#  define HL_BARRIER()
+#endif
+
+extern HAMLIB_EXPORT(void) hl_cache_set(struct rig_cache_time *t);
+extern HAMLIB_EXPORT(void) hl_cache_invalidate(struct rig_cache_time *t);
+extern HAMLIB_EXPORT(int) hl_cache_age_ms(const struct rig_cache_time *t);
+extern HAMLIB_EXPORT(int) hl_cache_timeout_ms(const RIG *rig, int timeout_ms);
+extern HAMLIB_EXPORT(void) hl_cache_entry_set(struct rig_cache_time *t,
+                                              struct timespec *pub);
+extern HAMLIB_EXPORT(void) hl_cache_entry_invalidate(struct rig_cache_time *t,
+                                                     struct timespec *pub);
+
+/*
+ * Time stamp of the rig_cache entry t, e.g. time_freq.  The public
+ * rig_cache.t keeps the wall clock time applications used to read.
+ */
+#define HL_CACHE_TIME(r, t) (&RIG_INTERNAL(r)->cache_time.t)
+#define HL_CACHE_SET(r, t) hl_cache_entry_set(HL_CACHE_TIME(r, t), &(r)->state.cache.t)
+#define HL_CACHE_INVALIDATE(r, t) hl_cache_entry_invalidate(HL_CACHE_TIME(r, t), &(r)->state.cache.t)
+
 extern HAMLIB_EXPORT(vfo_t) vfo_fixup(RIG *rig, vfo_t vfo);
 
+extern HAMLIB_EXPORT(void) rig_cache_settings_reset(RIG *rig);
+
+extern HAMLIB_EXPORT(int) rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq);
+extern HAMLIB_EXPORT(int) rig_set_cache_mode(RIG *rig, vfo_t vfo, rmode_t mode,
+                                             pbwidth_t width);
+
 extern HAMLIB_EXPORT(int) parse_hoststr(char *host, char hoststr[256], char port[6]);
 
+/* longest rig_debug() message kept for rigerror() */
+#define DEBUGMSG_LEN 1024
+extern int debugmsg_recent(char *buf, int buflen, int count);
+
 #ifdef PRId64
 /** \brief printf(3) format to be used for long long (64bits) type */
 #  define PRIll PRId64
@@ -151,19 +198,21 @@ void errmsg(int err, char *s, const char *func, const char *file, int line);
                        } while(0)
 
 #if 0 // 5.0
-    elapsed_ms(&rig->state.cache.time_freqMainC, HAMLIB_ELAPSED_INVALIDATE);
+    HL_CACHE_INVALIDATE(rig, time_freqMainC);
 #endif
 #define CACHE_RESET {\
-    elapsed_ms(&rig->state.cache.time_freq, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_freqCurr, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_freqMainA, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_freqMainB, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_freqSubA, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_freqSubB, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_vfo, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_INVALIDATE);\
-    elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_INVALIDATE);\
+    HL_CACHE_INVALIDATE(rig, time_freq);\
+    HL_CACHE_INVALIDATE(rig, time_freqCurr);\
+    HL_CACHE_INVALIDATE(rig, time_freqMainA);\
+    HL_CACHE_INVALIDATE(rig, time_freqMainB);\
+    HL_CACHE_INVALIDATE(rig, time_freqSubA);\
+    HL_CACHE_INVALIDATE(rig, time_freqSubB);\
+    HL_CACHE_INVALIDATE(rig, time_freqMem);\
+    HL_CACHE_INVALIDATE(rig, time_vfo);\
+    HL_CACHE_INVALIDATE(rig, time_mode);\
+    HL_CACHE_INVALIDATE(rig, time_ptt);\
+    HL_CACHE_INVALIDATE(rig, time_split);\
+    rig_cache_settings_reset(rig);\
      }
 
 __END_DECLS
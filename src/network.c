@@ -77,6 +77,7 @@
 #include <hamlib/rig.h>
 #include "network.h"
 #include "misc.h"
+#include "iofunc.h"
 
 
 #ifdef __MINGW32__
@@ -141,6 +142,8 @@ int network_open(hamlib_port_t *rp, int default_port)
 
     ENTERFUNC;
 
+    port_rxbuf_reset(rp);
+
 #ifdef __MINGW32__
     WSADATA wsadata;
 
@@ -299,6 +302,8 @@ void network_flush(hamlib_port_t *rp)
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    port_rxbuf_reset(rp);
+
     for (;;)
     {
         int ret;
@@ -57,6 +57,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -71,6 +72,7 @@
 #include "cm108.h"
 #include "gpio.h"
 #include "misc.h"
+#include "state.h"
 #include "sprintflst.h"
 
 /**
@@ -280,6 +282,12 @@ int foreach_opened_rig(int (*cfunc)(RIG *, rig_ptr_t), rig_ptr_t data)
 #endif /* !DOC_HIDDEN */
 
 
+// deprecated, no longer written: rigerror() now appends its own ring of
+// recent messages.  Still defined so applications linking them keep working
+char debugmsgsave[DEBUGMSGSAVE_SIZE];
+char debugmsgsave2[DEBUGMSGSAVE_SIZE];
+char debugmsgsave3[DEBUGMSGSAVE_SIZE];
+
 /**
  * \brief get string describing the error code
  * \param errnum    The error code
@@ -291,12 +299,11 @@ int foreach_opened_rig(int (*cfunc)(RIG *, rig_ptr_t), rig_ptr_t data)
  *
  * \todo support gettext/localization
  */
-char debugmsgsave[DEBUGMSGSAVE_SIZE] = "No message";
-char debugmsgsave2[DEBUGMSGSAVE_SIZE] = "No message";
-char debugmsgsave3[DEBUGMSGSAVE_SIZE] = "No message";
-
 const char *HAMLIB_API rigerror(int errnum)
 {
+    static char msg[80 + 1 + 3 * DEBUGMSG_LEN];
+    int len;
+
     errnum = abs(errnum);
 
     if (errnum >= ERROR_TBL_SZ)
@@ -305,14 +312,15 @@ const char *HAMLIB_API rigerror(int errnum)
         return "ERR_OUT_OF_RANGE";
     }
 
-    static char msg[DEBUGMSGSAVE_SIZE * 3];
-    // we have to remove LF from debugmsgsave since calling function controls LF
-    char *p = &debugmsgsave[strlen(debugmsgsave) - 1];
+    // append the last few debug messages to help error reports
+    len = snprintf(msg, sizeof(msg), "%.80s\n", rigerror_table[errnum]);
+    debugmsg_recent(msg + len, sizeof(msg) - len, 3);
 
-    if (*p == '\n') { *p = 0; }
+    // we have to remove LF from the last message since calling function controls LF
+    len = strlen(msg);
+
+    if (msg[len - 1] == '\n') { msg[len - 1] = 0; }
 
-    snprintf(msg, sizeof(msg), "%.80s\n%.15000s%.15000s%.15000s", rigerror_table[errnum],
-             debugmsgsave3,debugmsgsave2, debugmsgsave);
     return msg;
 }
 
@@ -393,6 +401,14 @@ RIG *HAMLIB_API rig_init(rig_model_t rig_model)
         return(NULL);
     }
 
+    rig->state.internal = calloc(1, sizeof(struct rig_internal));
+
+    if (rig->state.internal == NULL)
+    {
+        free(rig);
+        return(NULL);
+    }
+
     /* caps is const, so we need to tell compiler
        that we know what we are doing */
     rig->caps = (struct rig_caps *) caps;
@@ -459,6 +475,8 @@ RIG *HAMLIB_API rig_init(rig_model_t rig_model)
     rs->poll_interval = 500;
     rs->lo_freq = 0;
     rs->cache.timeout_ms = 500;  // 500ms cache timeout by default
+    RIG_INTERNAL(rig)->cache_timeout_ms_meter = 50; // meters move, keep them short
+    RIG_INTERNAL(rig)->cache_timeout_ms_trn = 10000; // the rig reports changes itself
 
     // We are using range_list1 as the default
     // Eventually we will have separate model number for different rig variations
@@ -612,6 +630,7 @@ RIG *HAMLIB_API rig_init(rig_model_t rig_model)
                       "%s: backend_init failed!\n",
                       __func__);
             /* cleanup and exit */
+            free(rig->state.internal);
             free(rig);
             return(NULL);
         }
@@ -1078,6 +1097,11 @@ int HAMLIB_API rig_close(RIG *rig)
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    if (RIG_INTERNAL(rig)->async)
+    {
+        rig_async_close(rig);
+    }
+
     if (rs->transceive != RIG_TRN_OFF)
     {
         rig_set_trn(rig, RIG_TRN_OFF);
@@ -1196,6 +1220,9 @@ int HAMLIB_API rig_close(RIG *rig)
 
     rs->comm_state = 0;
 
+    /* a closed rig has nothing to offer other threads */
+    rig_publish_cache(rig);
+
     RETURNFUNC(RIG_OK);
 }
 
@@ -1238,6 +1265,11 @@ int HAMLIB_API rig_cleanup(RIG *rig)
         rig->caps->rig_cleanup(rig);
     }
 
+    port_priv_free(&rig->state.rigport);
+    port_priv_free(&rig->state.pttport);
+    port_priv_free(&rig->state.dcdport);
+
+    free(rig->state.internal);
     free(rig);
 
     RETURNFUNC(RIG_OK);
@@ -1321,8 +1353,34 @@ int HAMLIB_API rig_get_twiddle(RIG *rig, int *seconds)
     RETURNFUNC(RIG_OK);
 }
 
+/*
+ * Cache timeout for one kind of entry.  While transceive frames are
+ * decoded the rig reports changes itself, so what it has sent stays
+ * good for longer.
+ */
+static int cache_item_timeout_ms(const RIG *rig, hamlib_cache_t item)
+{
+    const struct rig_state *rs = &rig->state;
+
+    if (rs->cache.timeout_ms > 0
+            && rs->transceive == RIG_TRN_RIG
+            && rig->caps->decode_event
+            && (RIG_INTERNAL(rig)->cache_trn_items & (1 << item)))
+    {
+        return RIG_INTERNAL(rig)->cache_timeout_ms_trn;
+    }
+
+    return rs->cache.timeout_ms;
+}
+
+static int cache_timeout_ms(const RIG *rig, hamlib_cache_t item)
+{
+    return hl_cache_timeout_ms(rig, cache_item_timeout_ms(rig, item));
+}
+
+//! @cond Doxygen_Suppress
 /* caching prototype to be fully implemented in 4.1 */
-static int set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
+int HAMLIB_API rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
 {
     rig_debug(RIG_DEBUG_TRACE, "%s:  vfo=%s, current_vfo=%s\n", __func__,
               rig_strvfo(vfo), rig_strvfo(rig->state.current_vfo));
@@ -1331,7 +1389,7 @@ static int set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
     {
         // if CURR then update this before we figure out the real VFO
         rig->state.cache.freqCurr = freq;
-        elapsed_ms(&rig->state.cache.time_freqCurr, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqCurr);
         vfo = rig->state.current_vfo;
     }
 
@@ -1341,54 +1399,54 @@ static int set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
     switch (vfo)
     {
     case RIG_VFO_ALL: // we'll use NONE to reset all VFO caches
-        elapsed_ms(&rig->state.cache.time_freqCurr, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&rig->state.cache.time_freqMainA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&rig->state.cache.time_freqMainB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&rig->state.cache.time_freqSubA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&rig->state.cache.time_freqSubB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&rig->state.cache.time_freqMem, HAMLIB_ELAPSED_INVALIDATE);
+        HL_CACHE_INVALIDATE(rig, time_freqCurr);
+        HL_CACHE_INVALIDATE(rig, time_freqMainA);
+        HL_CACHE_INVALIDATE(rig, time_freqMainB);
+        HL_CACHE_INVALIDATE(rig, time_freqSubA);
+        HL_CACHE_INVALIDATE(rig, time_freqSubB);
+        HL_CACHE_INVALIDATE(rig, time_freqMem);
         break;
 
     case RIG_VFO_CURR:
         rig->state.cache.freqCurr = freq;
-        elapsed_ms(&rig->state.cache.time_freqCurr, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqCurr);
         break;
 
     case RIG_VFO_A:
     case RIG_VFO_MAIN:
     case RIG_VFO_MAIN_A:
         rig->state.cache.freqMainA = freq;
-        elapsed_ms(&rig->state.cache.time_freqMainA, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqMainA);
         break;
 
     case RIG_VFO_B:
     case RIG_VFO_MAIN_B:
     case RIG_VFO_SUB:
         rig->state.cache.freqMainB = freq;
-        elapsed_ms(&rig->state.cache.time_freqMainB, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqMainB);
         break;
 
 #if 0 // 5.0
 
     case RIG_VFO_C: // is there a MainC/SubC we need to cover?
         rig->state.cache.freqMainC = freq;
-        elapsed_ms(&rig->state.cache.time_freqMainC, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqMainC);
         break;
 #endif
 
     case RIG_VFO_SUB_A:
         rig->state.cache.freqSubA = freq;
-        elapsed_ms(&rig->state.cache.time_freqSubA, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqSubA);
         break;
 
     case RIG_VFO_SUB_B:
         rig->state.cache.freqSubB = freq;
-        elapsed_ms(&rig->state.cache.time_freqSubB, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqSubB);
         break;
 
     case RIG_VFO_MEM:
         rig->state.cache.freqMem = freq;
-        elapsed_ms(&rig->state.cache.time_freqMem, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_freqMem);
         break;
 
     default:
@@ -1400,75 +1458,121 @@ static int set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
     RETURNFUNC(RIG_OK);
 }
 
-/* caching prototype to be fully implemented in 4.1 */
-static int get_cache_freq(RIG *rig, vfo_t vfo, freq_t *freq, int *cache_ms)
+
+/* store a mode as rig_get_mode() does */
+int HAMLIB_API rig_set_cache_mode(RIG *rig, vfo_t vfo, rmode_t mode,
+                                  pbwidth_t width)
 {
-    rig_debug(RIG_DEBUG_TRACE, "%s:  vfo=%s, current_vfo=%s\n", __func__,
-              rig_strvfo(vfo), rig_strvfo(rig->state.current_vfo));
+    struct rig_state *rs = &rig->state;
 
-    if (vfo == RIG_VFO_CURR) { vfo = rig->state.current_vfo; }
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo=%s, mode=%s, width=%ld\n", __func__,
+              rig_strvfo(vfo), rig_strrmode(mode), (long)width);
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: get vfo=%s\n", __func__, rig_strvfo(vfo));
+    if (vfo == RIG_VFO_CURR || vfo == rs->current_vfo)
+    {
+        rs->current_mode = mode;
+        rs->current_width = width;
+    }
+
+    rs->cache.mode = mode;
+
+    if (vfo == RIG_VFO_B || vfo == RIG_VFO_SUB || vfo == RIG_VFO_MAIN_B)
+    {
+        rs->cache.widthB = width;
+    }
+    else
+    {
+        rs->cache.width = width;
+    }
+
+    rs->cache.vfo_mode = vfo;
+    HL_CACHE_SET(rig, time_mode);
+
+    return RIG_OK;
+}
+//! @endcond
+
+/* cache entry of the freq of a VFO, NULL for a VFO that has none */
+static struct rig_cache_time *cache_freq_entry(RIG *rig, vfo_t vfo,
+        freq_t **freq)
+{
+    struct rig_cache *cache = &rig->state.cache;
 
     // VFO_C to be implemented
     switch (vfo)
     {
     case RIG_VFO_CURR:
-        *freq = rig->state.cache.freqCurr;
-        *cache_ms = elapsed_ms(&rig->state.cache.time_freqCurr, HAMLIB_ELAPSED_GET);
-        break;
+        *freq = &cache->freqCurr;
+        return HL_CACHE_TIME(rig, time_freqCurr);
 
     case RIG_VFO_A:
     case RIG_VFO_MAIN:
     case RIG_VFO_MAIN_A:
-        *freq = rig->state.cache.freqMainA;
-        *cache_ms = elapsed_ms(&rig->state.cache.time_freqMainA, HAMLIB_ELAPSED_GET);
-        break;
+        *freq = &cache->freqMainA;
+        return HL_CACHE_TIME(rig, time_freqMainA);
 
     case RIG_VFO_B:
     case RIG_VFO_SUB:
-        *freq = rig->state.cache.freqMainB;
-        *cache_ms = elapsed_ms(&rig->state.cache.time_freqMainB, HAMLIB_ELAPSED_GET);
-        break;
+        *freq = &cache->freqMainB;
+        return HL_CACHE_TIME(rig, time_freqMainB);
 
     case RIG_VFO_SUB_A:
-        *freq = rig->state.cache.freqSubA;
-        *cache_ms = elapsed_ms(&rig->state.cache.time_freqSubA, HAMLIB_ELAPSED_GET);
-        break;
+        *freq = &cache->freqSubA;
+        return HL_CACHE_TIME(rig, time_freqSubA);
 
     case RIG_VFO_SUB_B:
-        *freq = rig->state.cache.freqSubB;
-        *cache_ms = elapsed_ms(&rig->state.cache.time_freqSubB, HAMLIB_ELAPSED_GET);
-        break;
+        *freq = &cache->freqSubB;
+        return HL_CACHE_TIME(rig, time_freqSubB);
 
 #if 0 // 5.0
 
     case RIG_VFO_C:
         //case RIG_VFO_MAINC: // not used by any rig yet
-        *freq = rig->state.cache.freqMainC;
-        *cache_ms = elapsed_ms(&rig->state.cache.time_freqMainC, HAMLIB_ELAPSED_GET);
-        break;
+        *freq = &cache->freqMainC;
+        return HL_CACHE_TIME(rig, time_freqMainC);
 #endif
 
 #if 0 // no known rigs use this yet
 
     case RIG_VFO_SUBC:
-        *freq = rig->state.cache.freqSubC;
-        *cache_ms = rig->state.cache.time_freqSubC;
-        break;
+        *freq = &cache->freqSubC;
+        return HL_CACHE_TIME(rig, time_freqSubC);
 #endif
 
     case RIG_VFO_MEM:
-        *freq = rig->state.cache.freqMem;
-        *cache_ms = elapsed_ms(&rig->state.cache.time_freqMem, HAMLIB_ELAPSED_GET);
-        break;
+        *freq = &cache->freqMem;
+        return HL_CACHE_TIME(rig, time_freqMem);
 
     default:
+        return NULL;
+    }
+}
+
+/* caching prototype to be fully implemented in 4.1 */
+static int get_cache_freq(RIG *rig, vfo_t vfo, freq_t *freq, int *cache_ms)
+{
+    struct rig_cache_time *t;
+    freq_t *cached;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s:  vfo=%s, current_vfo=%s\n", __func__,
+              rig_strvfo(vfo), rig_strvfo(rig->state.current_vfo));
+
+    if (vfo == RIG_VFO_CURR) { vfo = rig->state.current_vfo; }
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: get vfo=%s\n", __func__, rig_strvfo(vfo));
+
+    t = cache_freq_entry(rig, vfo, &cached);
+
+    if (!t)
+    {
         rig_debug(RIG_DEBUG_ERR, "%s: unknown vfo?, vfo=%s\n", __func__,
                   rig_strvfo(vfo));
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    *freq = *cached;
+    *cache_ms = hl_cache_age_ms(t);
+
     rig_debug(RIG_DEBUG_TRACE, "%s: vfo=%s, freq=%.0f\n", __func__, rig_strvfo(vfo),
               (double)*freq);
     RETURNFUNC(RIG_OK);
@@ -1507,7 +1611,7 @@ int twiddling(RIG *rig)
 
             rig->state.twiddle_time = time(NULL); // update last twiddle time
             rig->state.current_freq = curr_freq; // we have a new freq to remember
-            set_cache_freq(rig, RIG_VFO_CURR, curr_freq);
+            rig_set_cache_freq(rig, RIG_VFO_CURR, curr_freq);
         }
 
         elapsed = time(NULL) - rig->state.twiddle_time;
@@ -1593,7 +1697,7 @@ int HAMLIB_API rig_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
 
             if (retcode != RIG_OK) { RETURNFUNC(retcode); }
 
-            set_cache_freq(rig, RIG_VFO_ALL, (freq_t)0);
+            rig_set_cache_freq(rig, RIG_VFO_ALL, (freq_t)0);
 
             if (caps->get_freq)
             {
@@ -1681,8 +1785,8 @@ int HAMLIB_API rig_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
 #endif
            )
         {
-            elapsed_ms(&rig->state.cache.time_freq, HAMLIB_ELAPSED_INVALIDATE);
-            set_cache_freq(rig, RIG_VFO_ALL, (freq_t)0);
+            HL_CACHE_INVALIDATE(rig, time_freq);
+            rig_set_cache_freq(rig, RIG_VFO_ALL, (freq_t)0);
             retcode = rig_get_freq(rig, vfo, &freq_new);
 
             if (retcode != RIG_OK) { RETURNFUNC(retcode); }
@@ -1700,10 +1804,10 @@ int HAMLIB_API rig_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     // update our current freq too
     if (vfo == RIG_VFO_CURR || vfo == rig->state.current_vfo) { rig->state.current_freq = freq_new; }
 
-    elapsed_ms(&(rig->state.cache.time_freq), HAMLIB_ELAPSED_SET);
+    HL_CACHE_SET(rig, time_freq);
     rig->state.cache.freq = freq_new;
     //future 4.1 caching
-    set_cache_freq(rig, vfo, freq_new);
+    rig_set_cache_freq(rig, vfo, freq_new);
     rig->state.cache.vfo_freq = vfo;
 
     RETURNFUNC(retcode);
@@ -1791,17 +1895,18 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 
 
     //future 4.1 caching
-    cache_ms = 10000;
+    cache_ms = INT_MAX;
     get_cache_freq(rig, vfo, freq, &cache_ms);
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check1 age=%dms\n", __func__, cache_ms);
     //future 4.1 caching needs to check individual VFO timeouts
-    //cache_ms = elapsed_ms(&rig->state.cache.time_freq, HAMLIB_ELAPSED_GET);
+    //cache_ms = hl_cache_age_ms(HL_CACHE_TIME(rig, time_freq));
     //rig_debug(RIG_DEBUG_TRACE, "%s: cache check2 age=%dms\n", __func__, cache_ms);
 
-    if (freq != 0 && cache_ms < rig->state.cache.timeout_ms)
+    if (freq != 0 && cache_ms < cache_timeout_ms(rig, HAMLIB_CACHE_FREQ))
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: %s cache hit age=%dms, freq=%.0f\n", __func__,
                   rig_strvfo(vfo), cache_ms, *freq);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.hits[HAMLIB_CACHE_FREQ], 1);
         RETURNFUNC(RIG_OK);
     }
     else
@@ -1809,6 +1914,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
         rig_debug(RIG_DEBUG_TRACE,
                   "%s: cache miss age=%dms, cached_vfo=%s, asked_vfo=%s\n", __func__, cache_ms,
                   rig_strvfo(rig->state.cache.vfo_freq), rig_strvfo(vfo));
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.misses[HAMLIB_CACHE_FREQ], 1);
     }
 
     caps = rig->caps;
@@ -1837,7 +1943,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
         {
             rig->state.cache.freq = *freq;
             //future 4.1 caching
-            set_cache_freq(rig, vfo, *freq);
+            rig_set_cache_freq(rig, vfo, *freq);
             rig->state.cache.vfo_freq = *freq;
         }
     }
@@ -1863,12 +1969,12 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 
         if (RIG_OK == retcode)
         {
-            cache_ms = elapsed_ms(&(rig->state.cache.time_freq), HAMLIB_ELAPSED_SET);
-            rig_debug(RIG_DEBUG_TRACE, "%s: cache reset age=%dms, vfo=%s, freq=%.0f\n",
-                      __func__, cache_ms, rig_strvfo(vfo), *freq);
+            HL_CACHE_SET(rig, time_freq);
+            rig_debug(RIG_DEBUG_TRACE, "%s: cache reset vfo=%s, freq=%.0f\n",
+                      __func__, rig_strvfo(vfo), *freq);
             rig->state.cache.freq = *freq;
             //future 4.1 caching
-            set_cache_freq(rig, vfo, *freq);
+            rig_set_cache_freq(rig, vfo, *freq);
             rig->state.cache.vfo_freq = vfo;
             /* return the first error code */
             retcode = rc2;
@@ -1893,12 +1999,12 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     }
 
 
-    cache_ms = elapsed_ms(&(rig->state.cache.time_freq), HAMLIB_ELAPSED_SET);
-    rig_debug(RIG_DEBUG_TRACE, "%s: cache reset age=%dms, vfo=%s, freq=%.0f\n",
-              __func__, cache_ms, rig_strvfo(vfo), *freq);
+    HL_CACHE_SET(rig, time_freq);
+    rig_debug(RIG_DEBUG_TRACE, "%s: cache reset vfo=%s, freq=%.0f\n",
+              __func__, rig_strvfo(vfo), *freq);
     rig->state.cache.freq = *freq;
     //future 4.1 caching
-    set_cache_freq(rig, vfo, *freq);
+    rig_set_cache_freq(rig, vfo, *freq);
     rig->state.cache.vfo_freq = vfo;
 
     RETURNFUNC(retcode);
@@ -2022,7 +2128,7 @@ int HAMLIB_API rig_set_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
     }
 
     rig->state.cache.vfo_mode = mode; // is this still needed?
-    elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_SET);
+    HL_CACHE_SET(rig, time_mode);
 
     RETURNFUNC(retcode);
 }
@@ -2070,13 +2176,14 @@ int HAMLIB_API rig_get_mode(RIG *rig,
         RETURNFUNC(-RIG_ENAVAIL);
     }
 
-    cache_ms = elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_GET);
+    cache_ms = hl_cache_age_ms(HL_CACHE_TIME(rig, time_mode));
     rig_debug(RIG_DEBUG_TRACE, "%s: %s cache check age=%dms\n", __func__,
               rig_strvfo(vfo), cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms && rig->state.cache.vfo_mode == vfo)
+    if (cache_ms < cache_timeout_ms(rig, HAMLIB_CACHE_MODE) && rig->state.cache.vfo_mode == vfo)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.hits[HAMLIB_CACHE_MODE], 1);
         *mode = rig->state.cache.mode;
         *width = rig->state.cache.width;
 
@@ -2090,6 +2197,7 @@ int HAMLIB_API rig_get_mode(RIG *rig,
     else
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.misses[HAMLIB_CACHE_MODE], 1);
     }
 
     if ((caps->targetable_vfo & RIG_TARGETABLE_MODE)
@@ -2160,7 +2268,7 @@ int HAMLIB_API rig_get_mode(RIG *rig,
         rig->state.cache.vfo_mode = vfo;
     }
 
-    cache_ms = elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_SET);
+    HL_CACHE_SET(rig, time_mode);
 
     RETURNFUNC(retcode);
 }
@@ -2402,12 +2510,12 @@ int HAMLIB_API rig_set_vfo(RIG *rig, vfo_t vfo)
     }
     else // don't expire cache if we just read it
     {
-        elapsed_ms(&rig->state.cache.time_freq, HAMLIB_ELAPSED_INVALIDATE);
+        HL_CACHE_INVALIDATE(rig, time_freq);
     }
 
     // expire several cached items when we switch VFOs
-    elapsed_ms(&rig->state.cache.time_vfo, HAMLIB_ELAPSED_INVALIDATE);
-    elapsed_ms(&rig->state.cache.time_mode, HAMLIB_ELAPSED_INVALIDATE);
+    HL_CACHE_INVALIDATE(rig, time_vfo);
+    HL_CACHE_INVALIDATE(rig, time_mode);
 
     rig_debug(RIG_DEBUG_TRACE, "%s: return %d, vfo=%s\n", __func__, retcode,
               rig_strvfo(vfo));
@@ -2453,18 +2561,20 @@ int HAMLIB_API rig_get_vfo(RIG *rig, vfo_t *vfo)
         RETURNFUNC(-RIG_ENAVAIL);
     }
 
-    cache_ms = elapsed_ms(&rig->state.cache.time_vfo, HAMLIB_ELAPSED_GET);
+    cache_ms = hl_cache_age_ms(HL_CACHE_TIME(rig, time_vfo));
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms)
+    if (cache_ms < cache_timeout_ms(rig, HAMLIB_CACHE_VFO))
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.hits[HAMLIB_CACHE_VFO], 1);
         *vfo = rig->state.cache.vfo;
         RETURNFUNC(RIG_OK);
     }
     else
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.misses[HAMLIB_CACHE_VFO], 1);
     }
 
     retcode = caps->get_vfo(rig, vfo);
@@ -2473,11 +2583,11 @@ int HAMLIB_API rig_get_vfo(RIG *rig, vfo_t *vfo)
     {
         rig->state.current_vfo = *vfo;
         rig->state.cache.vfo = *vfo;
-        cache_ms = elapsed_ms(&rig->state.cache.time_vfo, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_vfo);
     }
     else
     {
-        cache_ms = elapsed_ms(&rig->state.cache.time_vfo, HAMLIB_ELAPSED_INVALIDATE);
+        HL_CACHE_INVALIDATE(rig, time_vfo);
     }
 
     if (retcode != RIG_OK)
@@ -2550,7 +2660,7 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
                 hl_usleep(50*1000);  // give PTT a chance to do it's thing
 
                 // don't use the cached value and check to see if it worked
-                elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_INVALIDATE);
+                HL_CACHE_INVALIDATE(rig, time_ptt);
 
                 tptt = -1;
                 // IC-9700 is failing on get_ptt right after set_ptt in split mode
@@ -2725,7 +2835,7 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
     }
 
     rig->state.cache.ptt = ptt;
-    elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+    HL_CACHE_SET(rig, time_ptt);
 
     if (retcode != RIG_OK) { rig_debug(RIG_DEBUG_ERR, "%s: return code=%d\n", __func__, retcode); }
 
@@ -2763,18 +2873,20 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         RETURNFUNC(-RIG_EINVAL);
     }
 
-    cache_ms = elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_GET);
+    cache_ms = hl_cache_age_ms(HL_CACHE_TIME(rig, time_ptt));
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms)
+    if (cache_ms < cache_timeout_ms(rig, HAMLIB_CACHE_PTT))
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.hits[HAMLIB_CACHE_PTT], 1);
         *ptt = rig->state.cache.ptt;
         RETURNFUNC(RIG_OK);
     }
     else
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.misses[HAMLIB_CACHE_PTT], 1);
     }
 
     caps = rig->caps;
@@ -2798,7 +2910,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             if (retcode == RIG_OK)
             {
                 rig->state.cache.ptt = *ptt;
-                elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+                HL_CACHE_SET(rig, time_ptt);
             }
 
             RETURNFUNC(retcode);
@@ -2826,7 +2938,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             /* return the first error code */
             retcode = rc2;
             rig->state.cache.ptt = *ptt;
-            elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+            HL_CACHE_SET(rig, time_ptt);
         }
 
         RETURNFUNC(retcode);
@@ -2838,7 +2950,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+                HL_CACHE_SET(rig, time_ptt);
                 rig->state.cache.ptt = *ptt;
             }
 
@@ -2859,7 +2971,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         }
 
         rig->state.cache.ptt = *ptt;
-        elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_ptt);
         RETURNFUNC(retcode);
 
     case RIG_PTT_SERIAL_DTR:
@@ -2869,7 +2981,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+                HL_CACHE_SET(rig, time_ptt);
                 rig->state.cache.ptt = *ptt;
             }
 
@@ -2890,7 +3002,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         }
 
         rig->state.cache.ptt = *ptt;
-        elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_ptt);
         RETURNFUNC(retcode);
 
     case RIG_PTT_PARALLEL:
@@ -2900,7 +3012,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+                HL_CACHE_SET(rig, time_ptt);
                 rig->state.cache.ptt = *ptt;
             }
 
@@ -2911,7 +3023,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
         if (retcode == RIG_OK)
         {
-            elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+            HL_CACHE_SET(rig, time_ptt);
             rig->state.cache.ptt = *ptt;
         }
 
@@ -2924,7 +3036,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+                HL_CACHE_SET(rig, time_ptt);
                 rig->state.cache.ptt = *ptt;
             }
 
@@ -2935,7 +3047,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
         if (retcode == RIG_OK)
         {
-            elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+            HL_CACHE_SET(rig, time_ptt);
             rig->state.cache.ptt = *ptt;
         }
 
@@ -2949,14 +3061,14 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+                HL_CACHE_SET(rig, time_ptt);
                 rig->state.cache.ptt = *ptt;
             }
 
             RETURNFUNC(retcode);
         }
 
-        elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_ptt);
         RETURNFUNC(gpio_ptt_get(&rig->state.pttport, ptt));
 
     case RIG_PTT_NONE:
@@ -2966,7 +3078,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
         RETURNFUNC(-RIG_EINVAL);
     }
 
-    elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_SET);
+    HL_CACHE_SET(rig, time_ptt);
     RETURNFUNC(RIG_OK);
 }
 
@@ -4009,7 +4121,7 @@ int HAMLIB_API rig_set_split_vfo(RIG *rig,
 
         rig->state.cache.split = split;
         rig->state.cache.split_vfo = tx_vfo;
-        elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_split);
         RETURNFUNC(retcode);
     }
 
@@ -4044,7 +4156,7 @@ int HAMLIB_API rig_set_split_vfo(RIG *rig,
 
     rig->state.cache.split = split;
     rig->state.cache.split_vfo = tx_vfo;
-    elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
+    HL_CACHE_SET(rig, time_split);
     RETURNFUNC(retcode);
 }
 
@@ -4094,12 +4206,13 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
         RETURNFUNC(-RIG_ENAVAIL);
     }
 
-    cache_ms = elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_GET);
+    cache_ms = hl_cache_age_ms(HL_CACHE_TIME(rig, time_split));
     rig_debug(RIG_DEBUG_TRACE, "%s: cache check age=%dms\n", __func__, cache_ms);
 
-    if (cache_ms < rig->state.cache.timeout_ms)
+    if (cache_ms < cache_timeout_ms(rig, HAMLIB_CACHE_SPLIT))
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.hits[HAMLIB_CACHE_SPLIT], 1);
         *split = rig->state.cache.split;
         *tx_vfo = rig->state.cache.split_vfo;
         RETURNFUNC(RIG_OK);
@@ -4107,6 +4220,7 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
     else
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.misses[HAMLIB_CACHE_SPLIT], 1);
     }
 
     /* overridden by backend at will */
@@ -4118,7 +4232,7 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
         retcode = caps->get_split_vfo(rig, vfo, split, tx_vfo);
         rig->state.cache.split = *split;
         rig->state.cache.split_vfo = *tx_vfo;
-        elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_split);
         RETURNFUNC(retcode);
     }
 
@@ -4155,7 +4269,7 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
     {
         rig->state.cache.split = *split;
         rig->state.cache.split_vfo = *tx_vfo;
-        elapsed_ms(&rig->state.cache.time_split, HAMLIB_ELAPSED_SET);
+        HL_CACHE_SET(rig, time_split);
     }
 
     RETURNFUNC(retcode);
@@ -5515,7 +5629,7 @@ static int wait_morse_ptt(RIG *rig, vfo_t vfo)
         int retval;
         rig_debug(RIG_DEBUG_TRACE, "%s: loop#%d until ptt=0, ptt=%d\n", __func__, loops,
                   pttStatus);
-        elapsed_ms(&rig->state.cache.time_ptt, HAMLIB_ELAPSED_INVALIDATE);
+        HL_CACHE_INVALIDATE(rig, time_ptt);
         retval = rig_get_ptt(rig, vfo, &pttStatus);
 
         if (retval != RIG_OK)
@@ -5806,6 +5920,433 @@ int HAMLIB_API rig_get_vfo_list(RIG *rig, char *buf, int buflen)
     RETURNFUNC(RIG_OK);
 }
 
+/* the whole snapshot is in the cache and fresh enough */
+static int snapshot_cached(RIG *rig)
+{
+    const struct rig_cache *cache = &rig->state.cache;
+    freq_t freq;
+    int freq_ms;
+
+    if (get_cache_freq(rig, RIG_VFO_CURR, &freq, &freq_ms) != RIG_OK)
+    {
+        return 0;
+    }
+
+    return hl_cache_age_ms(HL_CACHE_TIME(rig, time_vfo)) < cache_timeout_ms(rig, HAMLIB_CACHE_VFO)
+           && freq_ms < cache_timeout_ms(rig, HAMLIB_CACHE_FREQ)
+           && hl_cache_age_ms(HL_CACHE_TIME(rig, time_mode)) < cache_timeout_ms(rig, HAMLIB_CACHE_MODE)
+           && cache->vfo_mode == RIG_VFO_CURR
+           && hl_cache_age_ms(HL_CACHE_TIME(rig, time_ptt)) < cache_timeout_ms(rig, HAMLIB_CACHE_PTT)
+           && hl_cache_age_ms(HL_CACHE_TIME(rig, time_split)) < cache_timeout_ms(rig, HAMLIB_CACHE_SPLIT);
+}
+
+
+/* one transaction through the backend hook, stored as the getters would */
+static int snapshot_backend(RIG *rig, rig_snapshot_t *snap)
+{
+    struct rig_state *rs = &rig->state;
+    int retcode;
+
+    memset(snap, 0, sizeof(*snap));
+    snap->mode = RIG_MODE_NONE;
+
+    retcode = rig->caps->get_snapshot(rig, snap);
+
+    if (retcode != RIG_OK)
+    {
+        return retcode;
+    }
+
+    rs->current_vfo = snap->vfo;
+    rs->cache.vfo = snap->vfo;
+    HL_CACHE_SET(rig, time_vfo);
+
+    rig_set_cache_freq(rig, RIG_VFO_CURR, snap->freq);
+
+    rs->cache.split = snap->split;
+    rs->cache.split_vfo = snap->tx_vfo;
+    HL_CACHE_SET(rig, time_split);
+
+    /* the rig only knows about its own PTT line */
+    if (rs->pttport.type.ptt == RIG_PTT_RIG
+            || rs->pttport.type.ptt == RIG_PTT_RIG_MICDATA)
+    {
+        rs->cache.ptt = snap->ptt;
+        HL_CACHE_SET(rig, time_ptt);
+    }
+    else
+    {
+        retcode = rig_get_ptt(rig, RIG_VFO_CURR, &snap->ptt);
+
+        if (retcode != RIG_OK && retcode != -RIG_ENAVAIL)
+        {
+            return retcode;
+        }
+    }
+
+    if (snap->mode != RIG_MODE_NONE)
+    {
+        rig_set_cache_mode(rig, RIG_VFO_CURR, snap->mode, snap->width);
+        return RIG_OK;
+    }
+
+    return rig_get_mode(rig, RIG_VFO_CURR, &snap->mode, &snap->width);
+}
+
+
+/**
+ * \brief get the state of the current VFO at once
+ * \param rig   The rig handle
+ * \param snap  The location where to store the state
+ *
+ * Retrieves the current VFO with its frequency, mode and passband, the
+ * PTT status and the split status with the TX VFO.  Served from the cache
+ * when every item is fresh, otherwise rigs providing a get_snapshot hook
+ * read them all in one transaction and the others go through the usual
+ * getters, which use the cache item by item.  A backend that cannot answer
+ * at the moment returns -RIG_ENAVAIL from its hook to get the latter.  Split and PTT read as off
+ * on rigs that cannot report them.
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ *
+ * \sa rig_get_vfo(), rig_get_freq(), rig_get_mode(), rig_get_ptt(),
+ * rig_get_split_vfo()
+ */
+int HAMLIB_API rig_get_state_snapshot(RIG *rig, rig_snapshot_t *snap)
+{
+    int retcode;
+
+    ENTERFUNC;
+
+    if (CHECK_RIG_ARG(rig) || !snap)
+    {
+        RETURNFUNC(-RIG_EINVAL);
+    }
+
+    /* the backend may decline, e.g. when its answer would be ambiguous */
+    if (rig->caps->get_snapshot && !snapshot_cached(rig))
+    {
+        retcode = snapshot_backend(rig, snap);
+
+        if (retcode != -RIG_ENAVAIL)
+        {
+            RETURNFUNC(retcode);
+        }
+    }
+
+    retcode = rig_get_vfo(rig, &snap->vfo);
+
+    if (retcode == -RIG_ENAVAIL)
+    {
+        snap->vfo = rig->state.current_vfo;
+    }
+    else if (retcode != RIG_OK)
+    {
+        RETURNFUNC(retcode);
+    }
+
+    retcode = rig_get_freq(rig, RIG_VFO_CURR, &snap->freq);
+
+    if (retcode != RIG_OK)
+    {
+        RETURNFUNC(retcode);
+    }
+
+    retcode = rig_get_mode(rig, RIG_VFO_CURR, &snap->mode, &snap->width);
+
+    if (retcode != RIG_OK)
+    {
+        RETURNFUNC(retcode);
+    }
+
+    retcode = rig_get_ptt(rig, RIG_VFO_CURR, &snap->ptt);
+
+    if (retcode == -RIG_ENAVAIL)
+    {
+        snap->ptt = RIG_PTT_OFF;
+    }
+    else if (retcode != RIG_OK)
+    {
+        RETURNFUNC(retcode);
+    }
+
+    retcode = rig_get_split_vfo(rig, RIG_VFO_CURR, &snap->split, &snap->tx_vfo);
+
+    if (retcode == -RIG_ENAVAIL)
+    {
+        snap->split = RIG_SPLIT_OFF;
+        snap->tx_vfo = snap->vfo;
+    }
+    else if (retcode != RIG_OK)
+    {
+        RETURNFUNC(retcode);
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
+//! @cond Doxygen_Suppress
+
+/* publish one entry the way the getter would serve it on a cache hit */
+static void cache_pub_item(RIG *rig, struct rig_cache_pub *pub,
+                           hamlib_cache_t item, const struct rig_cache_time *t,
+                           int usable)
+{
+    if (usable && t->valid)
+    {
+        pub->time[item] = *t;
+        pub->timeout_ms[item] = cache_item_timeout_ms(rig, item);
+    }
+    else
+    {
+        pub->timeout_ms[item] = 0;
+    }
+}
+//! @endcond
+
+
+/**
+ * \brief publish the cached state of the current VFO for other threads
+ * \param rig   The rig handle
+ *
+ * Copies the cache entries rig_get_vfo(), rig_get_freq(), rig_get_mode(),
+ * rig_get_ptt() and rig_get_split_vfo() would use for RIG_VFO_CURR, with
+ * their time stamps, where rig_get_published_cache() can read them while
+ * this thread is busy talking to the rig.  Call it from the thread that
+ * uses the rig after each call that may have changed the cache, the
+ * transceive events of rig_fire_freq_event() and friends publish on their
+ * own.  Publishing a closed rig withdraws everything.
+ */
+void HAMLIB_API rig_publish_cache(RIG *rig)
+{
+    struct rig_cache *cache;
+    struct rig_cache_pub *pub;
+    struct rig_cache_time *t_freq;
+    freq_t *freq;
+    unsigned long seq;
+    int is_open;
+
+    if (!rig || !rig->caps)
+    {
+        return;
+    }
+
+    cache = &rig->state.cache;
+    pub = &RIG_INTERNAL(rig)->cache_pub;
+    is_open = rig->state.comm_state;
+
+    /* an even count nobody else moved is ours, the event thread may race us */
+    do
+    {
+        seq = pub->seq & ~1UL;
+    }
+    while (!HL_ATOMIC_CAS(pub->seq, seq, seq + 1));
+
+    HL_BARRIER();
+
+    pub->snap.vfo = cache->vfo;
+    cache_pub_item(rig, pub, HAMLIB_CACHE_VFO, HL_CACHE_TIME(rig, time_vfo),
+                   is_open && rig->caps->get_vfo);
+
+    t_freq = cache_freq_entry(rig, rig->state.current_vfo, &freq);
+
+    if (t_freq)
+    {
+        pub->snap.freq = *freq;
+    }
+
+    cache_pub_item(rig, pub, HAMLIB_CACHE_FREQ, t_freq ? t_freq : HL_CACHE_TIME(rig, time_freq),
+                   is_open && t_freq);
+
+    pub->snap.mode = cache->mode;
+    pub->snap.width = cache->width;
+    cache_pub_item(rig, pub, HAMLIB_CACHE_MODE, HL_CACHE_TIME(rig, time_mode),
+                   is_open && rig->caps->get_mode
+                   && cache->vfo_mode == RIG_VFO_CURR);
+
+    pub->snap.ptt = cache->ptt;
+    cache_pub_item(rig, pub, HAMLIB_CACHE_PTT, HL_CACHE_TIME(rig, time_ptt), is_open);
+
+    pub->snap.split = cache->split;
+    pub->snap.tx_vfo = cache->split_vfo;
+    cache_pub_item(rig, pub, HAMLIB_CACHE_SPLIT, HL_CACHE_TIME(rig, time_split),
+                   is_open && rig->caps->get_split_vfo);
+
+    HL_BARRIER();
+    pub->seq = seq + 2;
+}
+
+
+/**
+ * \brief read the state published by rig_publish_cache()
+ * \param rig   The rig handle
+ * \param snap  The location where to store the state
+ *
+ * Takes no lock and never touches the rig, so it may be called from any
+ * thread while another one is using the rig.  Only the items flagged in
+ * the return value are valid; each one holds what the matching getter for
+ * RIG_VFO_CURR would answer from its cache right now.  snap->freq and
+ * snap->width are those of the current VFO.
+ *
+ * \return (1 << HAMLIB_CACHE_VFO), (1 << HAMLIB_CACHE_FREQ), ... ORed for
+ * the items still within their cache timeout, 0 if none, otherwise a
+ * negative value if an error occurred.
+ *
+ * \sa rig_publish_cache(), rig_get_state_snapshot()
+ */
+int HAMLIB_API rig_get_published_cache(RIG *rig, rig_snapshot_t *snap)
+{
+    const struct rig_cache_pub *pub;
+    struct rig_cache_time time[HAMLIB_CACHE_SPLIT + 1];
+    int timeout_ms[HAMLIB_CACHE_SPLIT + 1];
+    unsigned long seq;
+    int items = 0;
+    int i;
+
+    if (!rig || !rig->caps || !snap)
+    {
+        return -RIG_EINVAL;
+    }
+
+    pub = &RIG_INTERNAL(rig)->cache_pub;
+
+    do
+    {
+        seq = pub->seq;
+        HL_BARRIER();
+        *snap = pub->snap;
+        memcpy(time, pub->time, sizeof(time));
+        memcpy(timeout_ms, pub->timeout_ms, sizeof(timeout_ms));
+        HL_BARRIER();
+    }
+    while ((seq & 1) || seq != pub->seq);
+
+    for (i = HAMLIB_CACHE_VFO; i <= HAMLIB_CACHE_SPLIT; i++)
+    {
+        if (timeout_ms[i] > 0 && hl_cache_age_ms(&time[i]) < timeout_ms[i])
+        {
+            items |= 1 << i;
+        }
+    }
+
+    return items;
+}
+
+
+/**
+ * \brief get the traffic statistics of the rig port
+ * \param rig   The rig handle
+ * \param stats Buffer to receive a copy of the statistics
+ *
+ * Copies the counters and latency histograms of the rig port, collected
+ * since the rig was opened.  Use rig_port_stats_percentile() to turn a
+ * histogram into latencies.  The copy is taken without locking, so
+ * counters may be off by the transaction in progress.
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ */
+int HAMLIB_API rig_get_port_stats(RIG *rig, rig_port_stats_t *stats)
+{
+    if (CHECK_RIG_ARG(rig) || !stats)
+    {
+        return -RIG_EINVAL;
+    }
+
+    port_get_stats(&rig->state.rigport, stats);
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief get the cache hit and miss counts
+ * \param rig   The rig handle
+ * \param stats Buffer to receive a copy of the counts
+ *
+ * Copies how many reads of the VFO, frequency, mode, PTT and split, and
+ * of the levels, funcs and parms, the cache has answered and how many had
+ * to go to the rig, since rig_init().  Reads the cache does not cover at
+ * all are not counted.  Like rig_get_port_stats() the copy is taken
+ * without locking.
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ */
+int HAMLIB_API rig_get_cache_stats(RIG *rig, rig_cache_stats_t *stats)
+{
+    if (!rig || !rig->caps || !stats)
+    {
+        return -RIG_EINVAL;
+    }
+
+    memcpy(stats, &RIG_INTERNAL(rig)->cache_stats, sizeof(*stats));
+
+    return RIG_OK;
+}
+
+
+/**
+ * \brief get the lowest latency counted in a port statistics bucket
+ * \param bucket Bucket index, 0 to RIG_PORT_STATS_BUCKETS
+ *
+ * \return the latency in microseconds, bucket RIG_PORT_STATS_BUCKETS gives
+ * the upper bound of the last bucket
+ */
+unsigned long HAMLIB_API rig_port_stats_bucket_us(int bucket)
+{
+    if (bucket < 8)
+    {
+        return bucket < 0 ? 0 : bucket;
+    }
+
+    return (unsigned long)(4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+
+/**
+ * \brief get a percentile from a port statistics histogram
+ * \param histogram One of the histograms of rig_port_stats_t
+ * \param percent   Percentile wanted, e.g. 99.0
+ *
+ * \return the upper bound in microseconds of the bucket holding the
+ * percentile, 0 if the histogram is empty
+ */
+unsigned long HAMLIB_API rig_port_stats_percentile(const unsigned int
+        *histogram, double percent)
+{
+    unsigned long total = 0;
+    unsigned long count = 0;
+    int i;
+
+    for (i = 0; i < RIG_PORT_STATS_BUCKETS; i++)
+    {
+        total += histogram[i];
+    }
+
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < RIG_PORT_STATS_BUCKETS - 1; i++)
+    {
+        count += histogram[i];
+
+        if (count * 100.0 >= total * percent)
+        {
+            break;
+        }
+    }
+
+    return rig_port_stats_bucket_us(i + 1);
+}
+
+
 /**
  * \brief get the Hamlib license
  *
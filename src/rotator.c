@@ -599,6 +599,8 @@ int HAMLIB_API rot_cleanup(ROT *rot)
         rot->caps->rot_cleanup(rot);
     }
 
+    port_priv_free(&rot->state.rotport);
+
     free(rot);
 
     return RIG_OK;
@@ -81,6 +81,7 @@
 #include <hamlib/rig.h>
 #include "serial.h"
 #include "misc.h"
+#include "iofunc.h"
 
 #ifdef HAVE_SYS_IOCCOM_H
 #  include <sys/ioccom.h>
@@ -148,6 +149,7 @@ int HAMLIB_API serial_open(hamlib_port_t *rp)
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    port_rxbuf_reset(rp);
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s: %s\n", __func__, rp->pathname);
 
@@ -628,6 +630,8 @@ int HAMLIB_API serial_flush(hamlib_port_t *p)
 {
     ENTERFUNC;
 
+    port_rxbuf_reset(p);
+
     if (p->fd == uh_ptt_fd || p->fd == uh_radio_fd || p->flushx)
     {
         unsigned char buf[32];
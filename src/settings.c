@@ -42,12 +42,125 @@
 
 #include <hamlib/rig.h>
 #include "cal.h"
+#include "misc.h"
+#include "state.h"
 
 
 #ifndef DOC_HIDDEN
 
 #  define CHECK_RIG_ARG(r) (!(r) || !(r)->caps || !(r)->state.comm_state)
 
+/* levels that are measurements rather than settings */
+#  define CACHE_LEVEL_METERS (RIG_LEVEL_READONLY_LIST|RIG_LEVEL_RFPOWER_METER_WATTS)
+
+/*
+ * Cache slot of a single level or func for vfo, NULL if it is not cached.
+ * RIG_VFO_CURR is resolved through current_vfo, a rig that never
+ * reported its VFO is treated as a single VFO rig.
+ */
+static struct rig_cache_setting *cache_setting(RIG *rig,
+        struct rig_cache_setting table[][RIG_SETTING_MAX],
+        vfo_t vfo,
+        setting_t setting)
+{
+    int idx;
+
+    if (setting == 0 || (setting & (setting - 1)) != 0)
+    {
+        return NULL;
+    }
+
+    idx = rig_setting2idx(setting);
+
+    if (vfo == RIG_VFO_CURR)
+    {
+        vfo = rig->state.current_vfo;
+    }
+
+    switch (vfo)
+    {
+    case RIG_VFO_CURR:
+    case RIG_VFO_NONE:
+    case RIG_VFO_A:
+    case RIG_VFO_MAIN:
+    case RIG_VFO_MAIN_A:
+        return &table[0][idx];
+
+    case RIG_VFO_B:
+    case RIG_VFO_SUB:
+    case RIG_VFO_MAIN_B:
+        return &table[1][idx];
+
+    default:
+        return NULL;
+    }
+}
+
+
+/* a set on any VFO invalidates all of them, many rigs share their levels */
+static void cache_setting_invalidate(struct rig_cache_setting
+                                     table[][RIG_SETTING_MAX],
+                                     int vfos,
+                                     setting_t setting)
+{
+    int i, v;
+
+    for (i = 0; i < RIG_SETTING_MAX; i++)
+    {
+        if (setting & rig_idx2setting(i))
+        {
+            for (v = 0; v < vfos; v++)
+            {
+                hl_cache_invalidate(&table[v][i].time);
+            }
+        }
+    }
+}
+
+
+static int cache_setting_get(RIG *rig,
+                             const struct rig_cache_setting *entry,
+                             int meter,
+                             value_t *val)
+{
+    int ttl = rig->state.cache.timeout_ms;
+
+    if (meter && RIG_INTERNAL(rig)->cache_timeout_ms_meter < ttl)
+    {
+        ttl = RIG_INTERNAL(rig)->cache_timeout_ms_meter;
+    }
+
+    ttl = hl_cache_timeout_ms(rig, ttl);
+
+    if (!entry)
+    {
+        return 0;
+    }
+
+    if (hl_cache_age_ms(&entry->time) >= ttl)
+    {
+        HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.setting_misses, 1);
+        return 0;
+    }
+
+    HL_ATOMIC_ADD(RIG_INTERNAL(rig)->cache_stats.setting_hits, 1);
+    *val = entry->val;
+    return 1;
+}
+
+
+static void cache_setting_put(struct rig_cache_setting *entry,
+                              const value_t *val)
+{
+    if (!entry)
+    {
+        return;
+    }
+
+    entry->val = *val;
+    hl_cache_set(&entry->time);
+}
+
 #endif /* !DOC_HIDDEN */
 
 
@@ -88,6 +201,9 @@ int HAMLIB_API rig_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
         return -RIG_ENAVAIL;
     }
 
+    cache_setting_invalidate(RIG_INTERNAL(rig)->settings.level, HAMLIB_CACHE_SETTING_VFOS,
+                             level);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_LEVEL)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -114,6 +230,64 @@ int HAMLIB_API rig_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
 }
 
 
+/* rig_get_level() past the argument checks and the cache */
+static int get_level_direct(RIG *rig, vfo_t vfo, setting_t level,
+                            value_t *val)
+{
+    const struct rig_caps *caps = rig->caps;
+    int retcode;
+    vfo_t curr_vfo;
+
+    /*
+     * Special case(frontend emulation): calibrated S-meter reading
+     */
+    if (level == RIG_LEVEL_STRENGTH
+            && (caps->has_get_level & RIG_LEVEL_STRENGTH) == 0
+            && rig_has_get_level(rig, RIG_LEVEL_RAWSTR)
+            && rig->state.str_cal.size)
+    {
+
+        value_t rawstr;
+
+        retcode = rig_get_level(rig, vfo, RIG_LEVEL_RAWSTR, &rawstr);
+
+        if (retcode != RIG_OK)
+        {
+            return retcode;
+        }
+
+        val->i = (int)rig_raw2val(rawstr.i, &rig->state.str_cal);
+        return RIG_OK;
+    }
+
+
+    if ((caps->targetable_vfo & RIG_TARGETABLE_LEVEL)
+            || vfo == RIG_VFO_CURR
+            || vfo == rig->state.current_vfo)
+    {
+
+        return caps->get_level(rig, vfo, level, val);
+    }
+
+    if (!caps->set_vfo)
+    {
+        return -RIG_ENTARGET;
+    }
+
+    curr_vfo = rig->state.current_vfo;
+    retcode = caps->set_vfo(rig, vfo);
+
+    if (retcode != RIG_OK)
+    {
+        return retcode;
+    }
+
+    retcode = caps->get_level(rig, vfo, level, val);
+    caps->set_vfo(rig, curr_vfo);
+    return retcode;
+}
+
+
 /**
  * \brief get the value of a level
  * \param rig   The rig handle
@@ -122,6 +296,9 @@ int HAMLIB_API rig_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
  * \param val   The location where to store the value of \a level
  *
  *  Retrieves the value of a \a level.
+ *  Values read within the cache timeout are returned from the cache,
+ *  meters (#RIG_LEVEL_READONLY_LIST) use the shorter #HAMLIB_CACHE_METER
+ *  timeout. rig_set_level() invalidates the cached value.
  *  The level value \a val can be a float or an integer. See #value_t
  *  for more information.
  *
@@ -141,8 +318,8 @@ int HAMLIB_API rig_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
 int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
 {
     const struct rig_caps *caps;
+    struct rig_cache_setting *entry;
     int retcode;
-    vfo_t curr_vfo;
 
     // too verbose
     //rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -159,52 +336,20 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
         return -RIG_ENAVAIL;
     }
 
-    /*
-     * Special case(frontend emulation): calibrated S-meter reading
-     */
-    if (level == RIG_LEVEL_STRENGTH
-            && (caps->has_get_level & RIG_LEVEL_STRENGTH) == 0
-            && rig_has_get_level(rig, RIG_LEVEL_RAWSTR)
-            && rig->state.str_cal.size)
-    {
-
-        value_t rawstr;
-
-        retcode = rig_get_level(rig, vfo, RIG_LEVEL_RAWSTR, &rawstr);
-
-        if (retcode != RIG_OK)
-        {
-            return retcode;
-        }
-
-        val->i = (int)rig_raw2val(rawstr.i, &rig->state.str_cal);
-        return RIG_OK;
-    }
-
-
-    if ((caps->targetable_vfo & RIG_TARGETABLE_LEVEL)
-            || vfo == RIG_VFO_CURR
-            || vfo == rig->state.current_vfo)
-    {
-
-        return caps->get_level(rig, vfo, level, val);
-    }
+    entry = cache_setting(rig, RIG_INTERNAL(rig)->settings.level, vfo, level);
 
-    if (!caps->set_vfo)
+    if (cache_setting_get(rig, entry, (level & CACHE_LEVEL_METERS) != 0, val))
     {
-        return -RIG_ENTARGET;
+        return RIG_OK;
     }
 
-    curr_vfo = rig->state.current_vfo;
-    retcode = caps->set_vfo(rig, vfo);
+    retcode = get_level_direct(rig, vfo, level, val);
 
-    if (retcode != RIG_OK)
+    if (retcode == RIG_OK)
     {
-        return retcode;
+        cache_setting_put(entry, val);
     }
 
-    retcode = caps->get_level(rig, vfo, level, val);
-    caps->set_vfo(rig, curr_vfo);
     return retcode;
 }
 
@@ -239,6 +384,8 @@ int HAMLIB_API rig_set_parm(RIG *rig, setting_t parm, value_t val)
         return -RIG_ENAVAIL;
     }
 
+    cache_setting_invalidate(&RIG_INTERNAL(rig)->settings.parm, 1, parm);
+
     return rig->caps->set_parm(rig, parm, val);
 }
 
@@ -250,6 +397,7 @@ int HAMLIB_API rig_set_parm(RIG *rig, setting_t parm, value_t val)
  * \param val   The location where to store the value of \a parm
  *
  *  Retrieves the value of a \a parm.
+ *  Values read within the cache timeout are returned from the cache.
  *  The parameter value \a val can be a float or an integer. See #value_t
  *  for more information.
  *
@@ -261,6 +409,9 @@ int HAMLIB_API rig_set_parm(RIG *rig, setting_t parm, value_t val)
  */
 int HAMLIB_API rig_get_parm(RIG *rig, setting_t parm, value_t *val)
 {
+    struct rig_cache_setting *entry = NULL;
+    int retcode;
+
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
     if (CHECK_RIG_ARG(rig) || !val)
@@ -273,7 +424,24 @@ int HAMLIB_API rig_get_parm(RIG *rig, setting_t parm, value_t *val)
         return -RIG_ENAVAIL;
     }
 
-    return rig->caps->get_parm(rig, parm, val);
+    if (parm != 0 && (parm & (parm - 1)) == 0)
+    {
+        entry = &RIG_INTERNAL(rig)->settings.parm[rig_setting2idx(parm)];
+    }
+
+    if (cache_setting_get(rig, entry, (parm & RIG_PARM_READONLY_LIST) != 0, val))
+    {
+        return RIG_OK;
+    }
+
+    retcode = rig->caps->get_parm(rig, parm, val);
+
+    if (retcode == RIG_OK)
+    {
+        cache_setting_put(entry, val);
+    }
+
+    return retcode;
 }
 
 
@@ -492,6 +660,9 @@ int HAMLIB_API rig_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
         return -RIG_ENAVAIL;
     }
 
+    cache_setting_invalidate(RIG_INTERNAL(rig)->settings.func, HAMLIB_CACHE_SETTING_VFOS,
+                             func);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_FUNC)
             || vfo == RIG_VFO_CURR
             || vfo == rig->state.current_vfo)
@@ -526,6 +697,41 @@ int HAMLIB_API rig_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
 }
 
 
+/* rig_get_func() past the argument checks and the cache */
+static int get_func_direct(RIG *rig, vfo_t vfo, setting_t func, int *status)
+{
+    const struct rig_caps *caps = rig->caps;
+    int retcode;
+    vfo_t curr_vfo;
+
+    if ((caps->targetable_vfo & RIG_TARGETABLE_FUNC)
+            || vfo == RIG_VFO_CURR
+            || vfo == rig->state.current_vfo)
+    {
+
+        return caps->get_func(rig, vfo, func, status);
+    }
+
+    if (!caps->set_vfo)
+    {
+        return -RIG_ENTARGET;
+    }
+
+    curr_vfo = rig->state.current_vfo;
+    retcode = caps->set_vfo(rig, vfo);
+
+    if (retcode != RIG_OK)
+    {
+        return retcode;
+    }
+
+    retcode = caps->get_func(rig, vfo, func, status);
+    caps->set_vfo(rig, curr_vfo);
+
+    return retcode;
+}
+
+
 /**
  * \brief get the status of functions of the radio
  * \param rig   The rig handle
@@ -534,6 +740,7 @@ int HAMLIB_API rig_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
  * \param status    The location where to store the function status
  *
  *  Retrieves the status (on/off) of a function of the radio.
+ *  A status read within the cache timeout is returned from the cache.
  *  Upon return, \a status will hold the status of the function,
  *  The value pointer to by the \a status argument is a non null
  *  value for "on", "off" otherwise, much as TRUE/FALSE
@@ -548,8 +755,9 @@ int HAMLIB_API rig_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
 int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
 {
     const struct rig_caps *caps;
+    struct rig_cache_setting *entry;
+    value_t val;
     int retcode;
-    vfo_t curr_vfo;
 
     // too verbose
     //rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -566,30 +774,22 @@ int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
         return -RIG_ENAVAIL;
     }
 
-    if ((caps->targetable_vfo & RIG_TARGETABLE_FUNC)
-            || vfo == RIG_VFO_CURR
-            || vfo == rig->state.current_vfo)
-    {
+    entry = cache_setting(rig, RIG_INTERNAL(rig)->settings.func, vfo, func);
 
-        return caps->get_func(rig, vfo, func, status);
-    }
-
-    if (!caps->set_vfo)
+    if (cache_setting_get(rig, entry, 0, &val))
     {
-        return -RIG_ENTARGET;
+        *status = val.i;
+        return RIG_OK;
     }
 
-    curr_vfo = rig->state.current_vfo;
-    retcode = caps->set_vfo(rig, vfo);
+    retcode = get_func_direct(rig, vfo, func, status);
 
-    if (retcode != RIG_OK)
+    if (retcode == RIG_OK)
     {
-        return retcode;
+        val.i = *status;
+        cache_setting_put(entry, &val);
     }
 
-    retcode = caps->get_func(rig, vfo, func, status);
-    caps->set_vfo(rig, curr_vfo);
-
     return retcode;
 }
 
@@ -948,4 +1148,25 @@ int HAMLIB_API rig_setting2idx(setting_t s)
     return 0;
 }
 
+
+//! @cond Doxygen_Suppress
+/* forget all cached levels, funcs and parms, used by CACHE_RESET */
+void HAMLIB_API rig_cache_settings_reset(RIG *rig)
+{
+    struct rig_cache_settings *cache = &RIG_INTERNAL(rig)->settings;
+    int i, v;
+
+    for (i = 0; i < RIG_SETTING_MAX; i++)
+    {
+        for (v = 0; v < HAMLIB_CACHE_SETTING_VFOS; v++)
+        {
+            hl_cache_invalidate(&cache->level[v][i].time);
+            hl_cache_invalidate(&cache->func[v][i].time);
+        }
+
+        hl_cache_invalidate(&cache->parm[i].time);
+    }
+}
+//! @endcond
+
 /*! @} */
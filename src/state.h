@@ -0,0 +1,102 @@
+/*
+ *  Hamlib Interface - frontend state kept out of the public rig_state
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _STATE_H
+#define _STATE_H 1
+
+#include <hamlib/rig.h>
+
+/*
+ * Current VFO entries of the cache as published for other threads.
+ * Written by rig_publish_cache() under a sequence count that is odd while
+ * the copy changes, read by rig_get_published_cache() without a lock.
+ */
+struct rig_cache_pub
+{
+    volatile unsigned long seq;
+    rig_snapshot_t snap;
+    struct rig_cache_time time[HAMLIB_CACHE_SPLIT + 1]; // time stamps of the copied entries
+    int timeout_ms[HAMLIB_CACHE_SPLIT + 1]; // their cache timeouts, 0 when not published
+};
+
+/*
+ * Time stamps of the rig_cache entries, same names as the struct timespec
+ * members of rig_cache, see HL_CACHE_SET()
+ */
+struct rig_cache_times
+{
+    struct rig_cache_time time_freq;
+    struct rig_cache_time time_freqCurr;
+    struct rig_cache_time time_freqMainA;
+    struct rig_cache_time time_freqMainB;
+#if 0
+    struct rig_cache_time time_freqMainC;
+#endif
+    struct rig_cache_time time_freqSubA;
+    struct rig_cache_time time_freqSubB;
+    struct rig_cache_time time_freqMem;
+    struct rig_cache_time time_vfo;
+    struct rig_cache_time time_mode;
+    struct rig_cache_time time_ptt;
+    struct rig_cache_time time_split;
+};
+
+/* cached value of one level, func or parm */
+struct rig_cache_setting
+{
+    value_t val;                // level/parm value, func status in val.i
+    struct rig_cache_time time; // when val was read from the rig
+};
+
+/*
+ * Levels and funcs are cached for two VFOs, indexed by rig_setting2idx():
+ * [0] for VFO_A, VFO_MAIN and VFO_MAINA, [1] for VFO_B, VFO_SUB and VFO_MAINB
+ */
+#define HAMLIB_CACHE_SETTING_VFOS 2
+
+/* the level, func and parm cache, only settings.c goes in there */
+struct rig_cache_settings
+{
+    struct rig_cache_setting level[HAMLIB_CACHE_SETTING_VFOS][RIG_SETTING_MAX];
+    struct rig_cache_setting func[HAMLIB_CACHE_SETTING_VFOS][RIG_SETTING_MAX];
+    struct rig_cache_setting parm[RIG_SETTING_MAX];
+};
+
+/*
+ * What the frontend keeps for a rig behind rig_state.internal, so that
+ * the public structs keep the layout applications were built against.
+ * Allocated by rig_init(), freed by rig_cleanup().
+ */
+struct rig_internal
+{
+    struct rig_async *async;            // see rig_async_open()
+    struct rig_cache_times cache_time;  // see HL_CACHE_TIME()
+    struct rig_cache_time cache_request; // arrival of the request being served
+    struct rig_cache_pub cache_pub;     // see rig_publish_cache()
+    rig_cache_stats_t cache_stats;      // see rig_get_cache_stats()
+    int cache_timeout_ms_meter;         // for read-only levels and parms
+    int cache_timeout_ms_trn;           // for entries fed by transceive frames
+    int cache_trn_items;                // (1 << hamlib_cache_t) seen in transceive frames
+    struct rig_cache_settings settings; // see rig_get_level() and friends
+};
+
+#define RIG_INTERNAL(r) ((struct rig_internal *)(r)->state.internal)
+
+#endif /* _STATE_H */
@@ -0,0 +1,375 @@
+/*
+ *  Hamlib Interface - wire capture ring
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/**
+ * \addtogroup rig
+ * @{
+ */
+
+/**
+ * \file wirecap.c
+ * \brief Binary capture of the traffic on a rig port
+ *
+ * Every frame passed through write_block(), read_block() and read_string()
+ * on an open rig port is copied with a time stamp into a fixed size ring.
+ * The oldest frames are dropped when the ring is full, so it can stay on
+ * all the time at the cost of one memcpy per frame.  rig_wirecap_dump()
+ * writes the ring out as a pcap file, one packet per frame.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#include <hamlib/rig.h>
+#include "wirecap.h"
+#include "iofunc.h"
+
+//! @cond Doxygen_Suppress
+#define WIRECAP_SIZE        65536   /* bytes of history kept per port */
+#define WIRECAP_FRAME_MAX   4096    /* longer frames are truncated */
+
+#define CHECK_RIG_ARG(r) (!(r) || !(r)->caps || !(r)->state.comm_state)
+
+struct wirecap_hdr
+{
+    uint32_t sec;
+    uint32_t usec;
+    uint16_t len;
+    uint8_t dir;
+    uint8_t pad;
+};
+
+/* pcap file header and packet header, written in host byte order */
+struct pcap_file_hdr
+{
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t network;
+};
+
+struct pcap_rec_hdr
+{
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+
+struct wirecap
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif
+    unsigned long head;         /* bytes ever written */
+    unsigned long tail;         /* start of the oldest frame */
+    unsigned char data[WIRECAP_SIZE];
+};
+
+#ifdef HAVE_PTHREAD
+#  define WIRECAP_LOCK(w) pthread_mutex_lock(&(w)->lock)
+#  define WIRECAP_UNLOCK(w) pthread_mutex_unlock(&(w)->lock)
+#else
+#  define WIRECAP_LOCK(w)
+#  define WIRECAP_UNLOCK(w)
+#endif
+
+
+static void ring_put(struct wirecap *w,
+                     unsigned long off,
+                     const void *src,
+                     int len)
+{
+    int pos = off % WIRECAP_SIZE;
+    int n = len < WIRECAP_SIZE - pos ? len : WIRECAP_SIZE - pos;
+
+    memcpy(&w->data[pos], src, n);
+    memcpy(&w->data[0], (const unsigned char *)src + n, len - n);
+}
+
+
+static void ring_get(const struct wirecap *w,
+                     unsigned long off,
+                     void *dst,
+                     int len)
+{
+    int pos = off % WIRECAP_SIZE;
+    int n = len < WIRECAP_SIZE - pos ? len : WIRECAP_SIZE - pos;
+
+    memcpy(dst, &w->data[pos], n);
+    memcpy((unsigned char *)dst + n, &w->data[0], len - n);
+}
+
+
+/*
+ * Start capturing on a port that carries CAT traffic.
+ * Called by port_open(), a failed allocation just leaves capture off.
+ */
+void wirecap_open(hamlib_port_t *p)
+{
+    struct port_priv *pp = port_priv(p);
+    struct wirecap *w;
+
+    switch (p->type.rig)
+    {
+    case RIG_PORT_SERIAL:
+    case RIG_PORT_DEVICE:
+    case RIG_PORT_NETWORK:
+    case RIG_PORT_UDP_NETWORK:
+    case RIG_PORT_USB:
+        break;
+
+    default:
+        return;
+    }
+
+    if (!pp)
+    {
+        return;
+    }
+
+    if (pp->wirecap)
+    {
+        w = pp->wirecap;
+        WIRECAP_LOCK(w);
+        w->head = w->tail = 0;
+        WIRECAP_UNLOCK(w);
+        return;
+    }
+
+    w = calloc(1, sizeof(struct wirecap));
+
+    if (!w)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: no memory, capture disabled\n", __func__);
+        return;
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&w->lock, NULL);
+#endif
+
+    pp->wirecap = w;
+}
+
+
+/* the ring of a port, NULL when capture is off */
+static struct wirecap *port_wirecap(const hamlib_port_t *p)
+{
+    const struct port_priv *pp = port_priv_get(p);
+
+    return pp ? pp->wirecap : NULL;
+}
+
+
+void wirecap_close(hamlib_port_t *p)
+{
+    struct port_priv *pp = port_priv_get(p);
+    struct wirecap *w = port_wirecap(p);
+
+    if (!w)
+    {
+        return;
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_destroy(&w->lock);
+#endif
+    free(w);
+    pp->wirecap = NULL;
+}
+
+
+/*
+ * Append one frame, dropping the oldest frames to make room.
+ */
+void wirecap_record(hamlib_port_t *p, int dir, const void *buf, int len)
+{
+    struct wirecap *w = port_wirecap(p);
+    struct wirecap_hdr hdr;
+    struct timeval tv;
+    int need;
+
+    if (!w || len < 0)
+    {
+        return;
+    }
+
+    if (len > WIRECAP_FRAME_MAX)
+    {
+        len = WIRECAP_FRAME_MAX;
+    }
+
+    gettimeofday(&tv, NULL);
+    hdr.sec = tv.tv_sec;
+    hdr.usec = tv.tv_usec;
+    hdr.len = len;
+    hdr.dir = dir;
+    hdr.pad = 0;
+
+    need = sizeof(hdr) + len;
+
+    WIRECAP_LOCK(w);
+
+    while (w->head + need - w->tail > WIRECAP_SIZE)
+    {
+        struct wirecap_hdr old;
+
+        ring_get(w, w->tail, &old, sizeof(old));
+        w->tail += sizeof(old) + old.len;
+    }
+
+    ring_put(w, w->head, &hdr, sizeof(hdr));
+    ring_put(w, w->head + sizeof(hdr), buf, len);
+    w->head += need;
+
+    WIRECAP_UNLOCK(w);
+}
+
+
+/*
+ * Write the ring to fp in pcap format: LINKTYPE_USER0, each packet is
+ * one direction byte (enum rig_wirecap_dir_e) followed by the frame.
+ */
+int wirecap_dump(hamlib_port_t *p, FILE *fp)
+{
+    struct wirecap *w = port_wirecap(p);
+    struct pcap_file_hdr file_hdr;
+    unsigned char frame[WIRECAP_FRAME_MAX];
+    unsigned long off;
+    int count = 0;
+
+    if (!w)
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    memset(&file_hdr, 0, sizeof(file_hdr));
+    file_hdr.magic = 0xa1b2c3d4;    /* microsecond time stamps */
+    file_hdr.version_major = 2;
+    file_hdr.version_minor = 4;
+    file_hdr.snaplen = WIRECAP_FRAME_MAX + 1;
+    file_hdr.network = RIG_WIRECAP_LINKTYPE;
+
+    if (fwrite(&file_hdr, sizeof(file_hdr), 1, fp) != 1)
+    {
+        return -RIG_EIO;
+    }
+
+    WIRECAP_LOCK(w);
+
+    for (off = w->tail; off < w->head;)
+    {
+        struct wirecap_hdr hdr;
+        struct pcap_rec_hdr rec;
+        unsigned char dir;
+
+        ring_get(w, off, &hdr, sizeof(hdr));
+        ring_get(w, off + sizeof(hdr), frame, hdr.len);
+        off += sizeof(hdr) + hdr.len;
+
+        rec.ts_sec = hdr.sec;
+        rec.ts_usec = hdr.usec;
+        rec.incl_len = rec.orig_len = hdr.len + 1;
+        dir = hdr.dir;
+
+        if (fwrite(&rec, sizeof(rec), 1, fp) != 1
+                || fwrite(&dir, 1, 1, fp) != 1
+                || fwrite(frame, 1, hdr.len, fp) != hdr.len)
+        {
+            WIRECAP_UNLOCK(w);
+            return -RIG_EIO;
+        }
+
+        count++;
+    }
+
+    WIRECAP_UNLOCK(w);
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: wrote %d frames\n", __func__, count);
+
+    return RIG_OK;
+}
+//! @endcond
+
+
+/**
+ * \brief Save the recent traffic of the rig port to a file
+ * \param rig   The rig handle
+ * \param path  Name of the file to create
+ *
+ * Writes the frames sent to and received from the rig since it was opened,
+ * as far as they still fit in the capture ring, to \a path in pcap format.
+ * The link type is #RIG_WIRECAP_LINKTYPE and every packet starts with one
+ * byte from enum rig_wirecap_dir_e followed by the frame as it was passed
+ * to write_block() or returned by read_block()/read_string().
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately).
+ */
+int HAMLIB_API rig_wirecap_dump(RIG *rig, const char *path)
+{
+    FILE *fp;
+    int retval;
+
+    if (CHECK_RIG_ARG(rig) || !path)
+    {
+        return -RIG_EINVAL;
+    }
+
+    if (!port_wirecap(&rig->state.rigport))
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    fp = fopen(path, "wb");
+
+    if (!fp)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot create %s\n", __func__, path);
+        return -RIG_EIO;
+    }
+
+    retval = wirecap_dump(&rig->state.rigport, fp);
+
+    if (fclose(fp) != 0 && retval == RIG_OK)
+    {
+        retval = -RIG_EIO;
+    }
+
+    return retval;
+}
+
+/** @} */
@@ -0,0 +1,38 @@
+/*
+ *  Hamlib Interface - wire capture ring
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _WIRECAP_H
+#define _WIRECAP_H 1
+
+#include <stdio.h>
+#include <hamlib/rig.h>
+
+
+extern void wirecap_open(hamlib_port_t *p);
+extern void wirecap_close(hamlib_port_t *p);
+
+extern void wirecap_record(hamlib_port_t *p,
+                           int dir,
+                           const void *buf,
+                           int len);
+
+extern int wirecap_dump(hamlib_port_t *p, FILE *fp);
+
+#endif /* _WIRECAP_H */
@@ -45,6 +45,7 @@ void list_models();
 int print_conf_list(const struct confparams *cfp, rig_ptr_t data);
 int set_conf(AMP *my_amp, char *conf_parms);
 
+void ampctl_print_metrics(FILE *fout, const char *prefix);
 int ampctl_parse(AMP *my_amp, FILE *fin, FILE *fout, char *argv[], int argc);
 
 #endif  /* AMPCTL_PARSE_H */
@@ -63,8 +63,10 @@
 
 #include <hamlib/amplifier.h>
 #include "misc.h"
+#include "iofunc.h"
 
 #include "ampctl_parse.h"
+#include "metrics.h"
 
 struct handle_data
 {
@@ -78,13 +80,15 @@ void *handle_socket(void *arg);
 
 void usage();
 
+static void print_metrics(FILE *fout);
+
 /*
  * Reminder: when adding long options,
  * keep up to date SHORT_OPTIONS, usage()'s output and man page. thanks.
  * NB: do NOT use -W since it's reserved by POSIX.
  * TODO: add an option to read from a file
  */
-#define SHORT_OPTIONS "m:r:s:C:t:T:LuvhVlZ"
+#define SHORT_OPTIONS "m:r:s:C:t:T:M:LuvhVlZ"
 static struct option long_options[] =
 {
     {"model",           1, 0, 'm'},
@@ -97,6 +101,7 @@ static struct option long_options[] =
     {"show-conf",       0, 0, 'L'},
     {"dump-caps",       0, 0, 'u'},
     {"debug-time-stamps", 0, 0, 'Z'},
+    {"metrics-port",    1, 0, 'M'},
     {"verbose",         0, 0, 'v'},
     {"help",            0, 0, 'h'},
     {"version",         0, 0, 'V'},
@@ -108,11 +113,15 @@ int prompt = 0 ;        /* Daemon mode for rigparse return string */
 
 const char *portno = "4531";
 const char *src_addr = NULL;    /* INADDR_ANY */
+const char *metrics_port = NULL;    /* no metrics listener */
 
 char send_cmd_term = '\r';      /* send_cmd termination char */
 
 #define MAXCONFLEN 1024
 
+static AMP *metrics_amp;
+static unsigned long client_count;
+
 
 static void handle_error(enum rig_debug_level_e lvl, const char *msg)
 {
@@ -281,6 +290,16 @@ int main(int argc, char *argv[])
             src_addr = optarg;
             break;
 
+        case 'M':
+            if (!optarg)
+            {
+                usage();    /* wrong arg count */
+                exit(1);
+            }
+
+            metrics_port = optarg;
+            break;
+
         case 'v':
             verbose++;
             break;
@@ -513,6 +532,14 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    metrics_amp = my_amp;
+
+    if (metrics_port && metrics_start(src_addr, metrics_port, print_metrics) < 0)
+    {
+        fprintf(stderr, "ampctld: cannot serve metrics on port %s\n", metrics_port);
+        exit(1);
+    }
+
 #ifdef SIGPIPE
     /* Ignore SIGPIPE as we will handle it at the write()/send() calls
        that will consequently fail with EPIPE. All child threads will
@@ -657,6 +684,8 @@ void *handle_socket(void *arg)
         goto handle_exit;
     }
 
+    HL_ATOMIC_ADD(client_count, 1);
+
     do
     {
         retcode = ampctl_parse(handle_data_arg->amp, fsockin, fsockout, NULL, 0);
@@ -688,6 +717,8 @@ void *handle_socket(void *arg)
               host,
               serv);
 
+    HL_ATOMIC_ADD(client_count, -1);
+
     fclose(fsockin);
 #ifndef __MINGW32__
     fclose(fsockout);
@@ -708,6 +739,26 @@ handle_exit:
 }
 
 
+/* the --metrics-port exposition, run by the metrics thread */
+static void print_metrics(FILE *fout)
+{
+    char labels[64];
+    char *label = labels;
+    rig_port_stats_t stats;
+
+    snprintf(labels, sizeof(labels), "model=\"%u\"",
+             (unsigned)metrics_amp->caps->amp_model);
+
+    ampctl_print_metrics(fout, "ampctld");
+
+    metrics_family(fout, "ampctld", "clients", "gauge", "Connected clients.");
+    fprintf(fout, "ampctld_clients %ld\n", (long)client_count);
+
+    port_get_stats(&metrics_amp->state.ampport, &stats);
+    metrics_print_ports(fout, "ampctld", 1, &label, &stats);
+}
+
+
 void usage()
 {
     printf("Usage: ampctld [OPTION]... [COMMAND]...\n"
@@ -725,6 +776,7 @@ void usage()
         "  -u, --dump-caps               dump capabilities and exit\n"
         "  -v, --verbose                 set verbose mode, cumulative\n"
         "  -Z, --debug-time-stamps       enable time stamps for debug messages\n"
+        "  -M, --metrics-port=NUM        serve Prometheus metrics over HTTP on port NUM\n"
         "  -h, --help                    display this help and exit\n"
         "  -V, --version                 output version information and exit\n\n",
         portno);
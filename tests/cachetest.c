@@ -1,6 +1,6 @@
 /*  This program does a number of iterations of v f m t s
  *  By Michael Black W9MDB
- *  This simulates what WSJT-X and JTDX do
+ *  This simulates what WSJT-X and JTDX do, plus the RF power poll of loggers
  *  Used in testing caching effects that have been added
  *  Original performance against dummy device with 20ms delays showed
  *  about 50 calls/sec to get frequency.  After caching was added can
@@ -20,6 +20,9 @@
  *      ./cachetest 1 "" 0 5700 500
  *      Elapsed 0.872sec
  *
+ *  With a cache timeout the cost of a rig_get_freq() cache hit is printed
+ *  last, about 50ns on a Linux box
+ *
  *      ic-706mkiig  -- no cache
  *      ./cachetest 3011 /dev/ttyUSB0 19200 12 0
  *      Elapsed 1.182sec
@@ -32,6 +35,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <hamlib/rig.h>
 #include <hamlib/riglist.h>
 #include "sprintflst.h"
@@ -155,11 +159,43 @@ int main(int argc, char *argv[])
                split,
                rig_strvfo(vfo));
 #endif
+
+        if (rig_has_get_level(my_rig, RIG_LEVEL_RFPOWER))
+        {
+            value_t power;
+
+            elapsed_ms(&start, HAMLIB_ELAPSED_SET);
+            retcode = rig_get_level(my_rig, RIG_VFO_CURR, RIG_LEVEL_RFPOWER, &power);
+
+            if (retcode != RIG_OK) { printf("Get rfpower failed?? Err=%s\n", rigerror(retcode)); }
+
+            printf("%4dms: rfpower=%.2f\n", (int)elapsed_ms(&start, HAMLIB_ELAPSED_GET),
+                   power.f);
+        }
     }
 
     printf("Elapsed %gsec\n", (int)elapsed_ms(&startall,
             HAMLIB_ELAPSED_GET) / 1000.0);
 
+    if (cache_timeout > 0)
+    {
+        /* cost of a cache hit, the first call refreshes the entry */
+        const int hits = 100000;
+        struct timespec t1, t2;
+
+        rig_get_freq(my_rig, RIG_VFO_CURR, &freq);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        for (i = 0; i < hits; ++i)
+        {
+            rig_get_freq(my_rig, RIG_VFO_CURR, &freq);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        printf("Cache hit %.1fns/call\n", ((t2.tv_sec - t1.tv_sec) * 1e9
+                + (t2.tv_nsec - t1.tv_nsec)) / hits);
+    }
+
     rig_close(my_rig);
     return 0;
 
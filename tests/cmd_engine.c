@@ -0,0 +1,550 @@
+/*
+ * cmd_engine.c - argument reading and replies shared by the rigctl, rotctl
+ *                and ampctl parsers
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <errno.h>
+
+#ifdef HAVE_LIBREADLINE
+#  if defined(HAVE_READLINE_READLINE_H)
+#    include <readline/readline.h>
+#  elif defined(HAVE_READLINE_H)    /* !defined(HAVE_READLINE_READLINE_H) */
+#    include <readline.h>
+#  else                             /* !defined(HAVE_READLINE_H) */
+extern char *readline();
+#  endif                            /* HAVE_READLINE_H */
+#else
+/* no readline */
+#endif                              /* HAVE_LIBREADLINE */
+
+#ifdef HAVE_READLINE_HISTORY
+#  if defined(HAVE_READLINE_HISTORY_H)
+#    include <readline/history.h>
+#  elif defined(HAVE_HISTORY_H)
+#    include <history.h>
+#  else                             /* !defined(HAVE_HISTORY_H) */
+extern void add_history();
+#  endif                            /* defined(HAVE_READLINE_HISTORY_H) */
+/* no history */
+#endif                              /* HAVE_READLINE_HISTORY */
+
+#include <hamlib/rig.h>
+
+#include "cmd_engine.h"
+
+#ifdef HAVE_LIBREADLINE
+static char *input_line;    /* the last line readline() returned */
+#endif
+
+#ifdef HAVE_READLINE_HISTORY
+static char *hist_buf;      /* the command as typed, for the history */
+static size_t hist_size;
+#endif
+
+
+static void prompt_arg(FILE *fout, const char *arg_name)
+{
+    fprintf(fout, "%s: ", arg_name);
+    fflush(fout);
+}
+
+
+/*
+ * This scanf works even in presence of signals (timer, SIGIO, ..)
+ */
+int cmd_scanfc(FILE *fin, const char *format, void *p)
+{
+    do
+    {
+        int ret;
+        *(char *)p = 0;
+
+        ret = fscanf(fin, format, p);
+
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (!feof(fin))
+            {
+                rig_debug(RIG_DEBUG_ERR,
+                          "fscanf: parsing '%s' with '%s'\n",
+                          (char *)p,
+                          format);
+            }
+        }
+
+        if (ret < 1) { rig_debug(RIG_DEBUG_TRACE, "%s: ret=%d\n", __func__, ret); }
+
+        if (ferror(fin)) { rig_debug(RIG_DEBUG_TRACE, "%s: errno=%d, %s\n", __func__, errno, strerror(errno)); }
+
+        return ret;
+    }
+    while (1);
+}
+
+
+/*
+ * function to get the next word from the command line or from stdin
+ * until stdin exhausted. stdin is read if the special token '-' is
+ * found on the command line.  buffer holds maxlen chars and the '\0'.
+ *
+ * returns EOF when words exhausted
+ * returns <0 is error number
+ * returns >=0 when successful
+ */
+int cmd_next_word(char *buffer, int maxlen, int argc, char *argv[],
+                  int newline)
+{
+    int ret;
+    char c;
+    char format[32];
+    static int reading_stdin;
+
+    if (!reading_stdin)
+    {
+        if (optind >= argc)
+        {
+            return EOF;
+        }
+        else if (newline && '-' == argv[optind][0] && 1 == strlen(argv[optind]))
+        {
+            ++optind;
+            reading_stdin = 1;
+        }
+    }
+
+    if (reading_stdin)
+    {
+        /* the first char goes to c, the rest after it */
+        snprintf(format, sizeof(format), " %%c%%%d[^ \t\n#]", maxlen - 1);
+
+        do
+        {
+            do
+            {
+                ret = scanf(format, &c, &buffer[1]);
+            }
+            while (EINTR == ret);
+
+            if (ret > 0 && '#' == c)
+            {
+                do
+                {
+                    ret = scanf("%*[^\n]");
+                }
+                while (EINTR == ret);   /* consume comments */
+
+                ret = 0;
+            }
+        }
+        while (!ret);
+
+        if (EOF == ret)
+        {
+            reading_stdin = 0;
+        }
+        else if (ret < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "scanf: %s\n", strerror(errno));
+            reading_stdin = 0;
+        }
+        else
+        {
+            buffer[0] = c;
+            buffer[1 == ret ? 1 : maxlen] = '\0';
+
+            if (newline)
+            {
+                putchar('\n');
+            }
+
+            fputs(buffer, stdout);
+            putchar(' ');
+        }
+    }
+
+    if (!reading_stdin)
+    {
+        if (optind < argc)
+        {
+            strncpy(buffer, argv[optind++], maxlen);
+            buffer[maxlen] = '\0';
+            ret = 1;
+        }
+        else
+        {
+            ret = EOF;
+        }
+    }
+
+    return ret;
+}
+
+
+#ifdef HAVE_LIBREADLINE
+/*
+ * Frees the line read before and reads the next one, newline stripped.
+ * NULL on EOF (Ctl-D).
+ */
+char *cmd_rl_getline(const char *prompt)
+{
+    if (input_line)
+    {
+        free(input_line);
+        input_line = NULL;
+    }
+
+    /* Action!  Returns typed line with newline stripped. */
+    input_line = readline(prompt);
+
+    return input_line;
+}
+#endif
+
+
+/*
+ * The command as typed goes to the readline history once all of it is
+ * read: cmd_rl_history_begin() before the command name, then
+ * cmd_rl_history_add() for the name and each word, then
+ * cmd_rl_history_end().
+ */
+void cmd_rl_history_begin(size_t size)
+{
+#ifdef HAVE_READLINE_HISTORY
+    free(hist_buf);
+    hist_buf = calloc(size, sizeof(char));
+    hist_size = hist_buf ? size : 0;
+#endif
+}
+
+
+/* at most n chars of word, after a blank unless it is the first */
+void cmd_rl_history_add(const char *word, size_t n)
+{
+#ifdef HAVE_READLINE_HISTORY
+
+    if (hist_buf)
+    {
+        size_t len = strlen(hist_buf);
+
+        snprintf(hist_buf + len, hist_size - len, "%s%.*s", len ? " " : "",
+                 (int)n, word);
+    }
+
+#endif
+}
+
+
+void cmd_rl_history_end(void)
+{
+#ifdef HAVE_READLINE_HISTORY
+
+    if (hist_buf)
+    {
+        add_history(hist_buf);
+        free(hist_buf);
+        hist_buf = NULL;
+    }
+
+#endif
+}
+
+
+#ifdef HAVE_LIBREADLINE
+/*
+ * An argument from the line typed with the command, or else from one
+ * typed at its prompt.  The line was split with strtok() up to the
+ * command name.
+ */
+static char *rl_read_arg(const struct cmd_proto *proto, FILE *fout,
+                         const char *arg_name, enum cmd_arg_how how,
+                         char *buf, int *retcode)
+{
+    const char *delim = how == CMD_ARG_WORD || how == CMD_ARG_VFO ? " " : "";
+    size_t max = how == CMD_ARG_VFO ? MAXNAMSIZ - 1 : proto->maxargsz;
+    char *word = strtok(NULL, delim);
+    int j;
+
+    if (!word)
+    {
+        char pmptstr[strlen(arg_name) + 3];
+        char *line;
+
+        snprintf(pmptstr, sizeof(pmptstr), "%s: ", arg_name);
+        line = cmd_rl_getline(pmptstr);
+
+        if (!line)
+        {
+            fprintf(fout, "\n");
+            fflush(fout);
+            *retcode = 1;
+            return NULL;
+        }
+
+        /* Blank line entered */
+        if (line[0] == '\0')
+        {
+            fprintf(fout, "? for help, q to quit.\n");
+            fflush(fout);
+            *retcode = 0;
+            return NULL;
+        }
+
+        /* Get the first token of input, the rest, if any, will be
+         * used later.
+         */
+        word = strtok(line, delim);
+
+        if (!word)
+        {
+            fprintf(fout, "\n");
+            fflush(fout);
+            *retcode = 1;
+            return NULL;
+        }
+    }
+
+    if (strlen(word) > max)
+    {
+        word[max] = '\0';
+    }
+
+    cmd_rl_history_add(word, max);
+
+    /* Sanity check, VFO names are alpha only. */
+    for (j = 0; how == CMD_ARG_VFO && word[j] != '\0'; j++)
+    {
+        if (!isalpha((int)word[j]))
+        {
+            word[j] = '\0';
+            break;
+        }
+    }
+
+    strcpy(buf, word);
+
+    return buf;
+}
+#endif
+
+
+/* an argument from a client, a script or the terminal without readline */
+static char *fin_read_arg(const struct cmd_proto *proto,
+                          const struct cmd_source *src, const char *arg_name,
+                          enum cmd_arg_how how, char *buf, int *retcode)
+{
+    FILE *fin = src->fin;
+    char *nl;
+
+    if (how == CMD_ARG_WORD || how == CMD_ARG_VFO)
+    {
+        char format[16];
+
+        if (!proto->prompt_at_eol)
+        {
+            if (src->prompt)
+            {
+                prompt_arg(src->fout, arg_name);
+            }
+        }
+        else
+        {
+            int c = fgetc(fin);
+
+            /* the blank before the word is for fscanf() to skip */
+            if (c == '\n')
+            {
+                if (src->prompt)
+                {
+                    prompt_arg(src->fout, arg_name);
+                }
+            }
+            else if (c != EOF)
+            {
+                ungetc(c, fin);
+            }
+        }
+
+        snprintf(format, sizeof(format), "%%%ds", proto->maxargsz);
+
+        if (cmd_scanfc(fin, format, buf) < 1)
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan for '%s'\n", __func__,
+                      arg_name);
+            *retcode = -1;
+            return NULL;
+        }
+
+        return buf;
+    }
+
+    if (!proto->prompt_at_eol && src->prompt)
+    {
+        prompt_arg(src->fout, arg_name);
+    }
+
+    if (fgets(buf, proto->maxargsz, fin) == NULL)
+    {
+        *retcode = -1;
+        return NULL;
+    }
+
+    if (buf[0] == '\n')
+    {
+        if (proto->prompt_at_eol && src->prompt)
+        {
+            prompt_arg(src->fout, arg_name);
+        }
+
+        if (fgets(buf, proto->maxargsz, fin) == NULL)
+        {
+            *retcode = -1;
+            return NULL;
+        }
+    }
+
+    nl = strchr(buf, '\n');
+
+    if (nl)
+    {
+        *nl = '\0';    /* chomp */
+    }
+
+    /* skip the blank after the command */
+    return how == CMD_ARG_LINE && buf[0] == ' ' ? buf + 1 : buf;
+}
+
+
+/**
+ * \brief Read one argument of a command
+ * \param proto    the protocol
+ * \param src      where the command came from
+ * \param cmd_name for the error message when the command line runs out
+ * \param arg_name what the prompt asks for
+ * \param how      a word or the rest of the line
+ * \param buf      proto->maxargsz + 1 chars for the argument
+ * \param retcode  set when NULL is returned
+ *
+ * Takes the argument from the readline line or prompt, from fin when
+ * interactive, else from the command line (or stdin after '-').
+ *
+ * \return the argument, in buf, or NULL if the parser has to return
+ * *retcode instead: -1 when fin ended, 1 when there is nothing more to
+ * read, 0 when a blank line was typed at the prompt.
+ */
+char *cmd_read_arg(const struct cmd_proto *proto,
+                   const struct cmd_source *src, const char *cmd_name,
+                   const char *arg_name, enum cmd_arg_how how, char *buf,
+                   int *retcode)
+{
+    int ret;
+
+#ifdef HAVE_LIBREADLINE
+
+    if (src->interactive && src->prompt)
+    {
+        return rl_read_arg(proto, src->fout, arg_name, how, buf, retcode);
+    }
+
+#endif
+
+    if (src->interactive)
+    {
+        return fin_read_arg(proto, src, arg_name, how, buf, retcode);
+    }
+
+    ret = cmd_next_word(buf, proto->maxargsz, src->argc, src->argv, 0);
+
+    if (EOF == ret)
+    {
+        fprintf(stderr, "Invalid arg for command '%s'\n", cmd_name);
+        *retcode = 1;
+        return NULL;
+    }
+    else if (ret < 0)
+    {
+        *retcode = ret;
+        return NULL;
+    }
+
+    return buf;
+}
+
+
+/*
+ * Extended Response protocol: the command name and its arguments, the
+ * NULL ones left out, ahead of the reply
+ */
+void cmd_reply_begin(FILE *fout, const char *name, const char *const args[],
+                     int nargs, char sep)
+{
+    int i;
+
+    fprintf(fout, "%s:", name);
+
+    for (i = 0; i < nargs; i++)
+    {
+        if (args[i])
+        {
+            fprintf(fout, " %s", args[i]);
+        }
+    }
+
+    fputc(sep, fout);
+}
+
+
+/*
+ * The end of a reply.  A daemon client gets the status line after an
+ * error, and after success when the command had no output of its own or
+ * the extended response was asked for; the extended response ends there.
+ * Elsewhere only errors get a line.
+ */
+void cmd_reply_end(const struct cmd_proto *proto, FILE *fout, int daemon,
+                   const char *name, int retcode, int has_output,
+                   int *ext_resp, char *resp_sep)
+{
+    if (retcode != RIG_OK && !daemon)
+    {
+        fprintf(fout, "%s: error = %s\n", name, rigerror(retcode));
+    }
+    else if (daemon && (retcode != RIG_OK || *ext_resp || !has_output))
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: %s%d\n", __func__, proto->rprt,
+                  retcode);
+        fprintf(fout, "%s%d\n", proto->rprt, retcode);
+        *ext_resp = 0;
+        *resp_sep = '\n';
+    }
+
+    fflush(fout);
+}
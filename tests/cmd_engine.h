@@ -0,0 +1,92 @@
+/*
+ * cmd_engine.h - argument reading and replies shared by the rigctl, rotctl
+ *                and ampctl parsers
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef CMD_ENGINE_H
+#define CMD_ENGINE_H
+
+#include <stdio.h>
+
+#define MAXNAMSIZ 32    /* longest command or VFO name, with its terminator */
+
+/* test_table flags, the same in the three parsers */
+#define ARG_IN1  0x01
+#define ARG_OUT1 0x02
+#define ARG_IN2  0x04
+#define ARG_OUT2 0x08
+#define ARG_IN3  0x10
+#define ARG_OUT3 0x20
+#define ARG_IN4  0x40
+#define ARG_OUT4 0x80
+#define ARG_IN_LINE 0x4000
+
+#define ARG_NONE    0
+#define ARG_IN  (ARG_IN1|ARG_IN2|ARG_IN3|ARG_IN4)
+#define ARG_OUT (ARG_OUT1|ARG_OUT2|ARG_OUT3|ARG_OUT4)
+
+/* what the rigctl, rotctl and ampctl protocols do differently */
+struct cmd_proto
+{
+    const char *rprt;       /* reply status prefix, NETRIGCTL_RET and friends */
+    int maxargsz;           /* longest argument, buffers hold one char more */
+    int prompt_at_eol;      /* prompt for an argument only once its line ended */
+};
+
+/* where the words of a command come from */
+struct cmd_source
+{
+    FILE *fin;              /* interactive: the client or the terminal */
+    FILE *fout;             /* for the prompts */
+    int interactive;
+    int prompt;
+    int argc;               /* not interactive: the command line */
+    char **argv;
+};
+
+/* how cmd_read_arg() takes an argument */
+enum cmd_arg_how
+{
+    CMD_ARG_WORD,           /* up to the next blank */
+    CMD_ARG_LINE,           /* the rest of the line, one leading blank dropped */
+    CMD_ARG_LINE_RAW,       /* the rest of the line as it is */
+    CMD_ARG_VFO             /* a word, typed ones cut at the first non-letter */
+};
+
+int cmd_scanfc(FILE *fin, const char *format, void *p);
+int cmd_next_word(char *buffer, int maxlen, int argc, char *argv[],
+                  int newline);
+
+char *cmd_rl_getline(const char *prompt);
+void cmd_rl_history_begin(size_t size);
+void cmd_rl_history_add(const char *word, size_t n);
+void cmd_rl_history_end(void);
+
+char *cmd_read_arg(const struct cmd_proto *proto,
+                   const struct cmd_source *src, const char *cmd_name,
+                   const char *arg_name, enum cmd_arg_how how, char *buf,
+                   int *retcode);
+
+void cmd_reply_begin(FILE *fout, const char *name, const char *const args[],
+                     int nargs, char sep);
+void cmd_reply_end(const struct cmd_proto *proto, FILE *fout, int daemon,
+                   const char *name, int retcode, int has_output,
+                   int *ext_resp, char *resp_sep);
+
+#endif  /* CMD_ENGINE_H */
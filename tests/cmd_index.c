@@ -0,0 +1,264 @@
+/*
+ * cmd_index.c - command lookup shared by the rigctl, rotctl and ampctl parsers
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include <hamlib/rig.h>
+
+#include "cmd_index.h"
+
+#define SEED_MAX    65535
+
+
+static const struct cmd_index_row *row_at(const struct cmd_index *idx, int i)
+{
+    return (const struct cmd_index_row *)(idx->table + i * idx->stride);
+}
+
+
+/* FNV-1a over at most maxlen chars, with a final mix for the low bits */
+static unsigned int name_hash(const char *name, size_t maxlen,
+                              unsigned int seed)
+{
+    unsigned int h = 2166136261u ^ (seed * 0x9e3779b9u);
+    size_t i;
+
+    for (i = 0; i < maxlen && name[i] != '\0'; i++)
+    {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+
+    return h;
+}
+
+
+static int name_slot(const struct cmd_index *idx, const char *name,
+                     unsigned int seed)
+{
+    return name_hash(name, idx->maxlen, seed) & (CMD_INDEX_SLOTS - 1);
+}
+
+
+/*
+ * Find a seed for each bucket, biggest buckets first, that sends all of
+ * its names to slots still free.  Returns -1 if some bucket has none.
+ */
+static int place_names(struct cmd_index *idx, const short *rows, int nrows)
+{
+    short bucket_of[CMD_INDEX_SLOTS / 2];
+    int size[CMD_INDEX_BUCKETS];
+    int done[CMD_INDEX_BUCKETS];
+    int i, b;
+
+    memset(size, 0, sizeof(size));
+    memset(done, 0, sizeof(done));
+
+    for (i = 0; i < nrows; i++)
+    {
+        bucket_of[i] = name_hash(row_at(idx, rows[i])->name, idx->maxlen, 0)
+                       % CMD_INDEX_BUCKETS;
+        size[bucket_of[i]]++;
+    }
+
+    for (;;)
+    {
+        int slots[CMD_INDEX_SLOTS / 2];
+        int best = -1;
+        unsigned int seed;
+
+        for (b = 0; b < CMD_INDEX_BUCKETS; b++)
+        {
+            if (!done[b] && size[b] > 0 && (best < 0 || size[b] > size[best]))
+            {
+                best = b;
+            }
+        }
+
+        if (best < 0)
+        {
+            return 0;
+        }
+
+        for (seed = 1; seed <= SEED_MAX; seed++)
+        {
+            int n = 0;
+            int j;
+
+            for (i = 0; i < nrows; i++)
+            {
+                int slot;
+
+                if (bucket_of[i] != best)
+                {
+                    continue;
+                }
+
+                slot = name_slot(idx, row_at(idx, rows[i])->name, seed);
+
+                if (idx->by_name[slot] >= 0)
+                {
+                    break;
+                }
+
+                for (j = 0; j < n && slots[j] != slot; j++);
+
+                if (j < n)
+                {
+                    break;
+                }
+
+                slots[n++] = slot;
+            }
+
+            if (i == nrows)
+            {
+                break;
+            }
+        }
+
+        if (seed > SEED_MAX)
+        {
+            return -1;
+        }
+
+        for (i = 0; i < nrows; i++)
+        {
+            if (bucket_of[i] == best)
+            {
+                idx->by_name[name_slot(idx, row_at(idx, rows[i])->name, seed)] =
+                    rows[i];
+            }
+        }
+
+        idx->seed[best] = seed;
+        done[best] = 1;
+    }
+}
+
+
+/*
+ * Index table, whose rows are stride bytes apart.  Like the linear scans
+ * it replaces, the first row wins when a command char or a name is used
+ * twice.
+ */
+void cmd_index_build(struct cmd_index *idx, const void *table, size_t stride,
+                     size_t maxlen)
+{
+    short rows[CMD_INDEX_SLOTS / 2];
+    int nrows = 0;
+    int i;
+
+    memset(idx, 0, sizeof(*idx));
+    memset(idx->by_cmd, 0xff, sizeof(idx->by_cmd));
+    memset(idx->by_name, 0xff, sizeof(idx->by_name));
+    idx->table = table;
+    idx->stride = stride;
+    idx->maxlen = maxlen;
+
+    for (i = 0; row_at(idx, i)->cmd != 0; i++)
+    {
+        const struct cmd_index_row *row = row_at(idx, i);
+        int j;
+
+        if (idx->by_cmd[row->cmd] < 0)
+        {
+            idx->by_cmd[row->cmd] = i;
+        }
+
+        for (j = 0; j < nrows
+                && strncmp(row_at(idx, rows[j])->name, row->name, maxlen); j++);
+
+        if (j < nrows)
+        {
+            continue;
+        }
+
+        if (nrows == CMD_INDEX_SLOTS / 2)
+        {
+            idx->linear = 1;
+            break;
+        }
+
+        rows[nrows++] = i;
+    }
+
+    if (!idx->linear && place_names(idx, rows, nrows) < 0)
+    {
+        idx->linear = 1;
+    }
+
+    if (idx->linear)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: no perfect hash for %d names, "
+                  "falling back to a linear scan\n", __func__, nrows);
+    }
+}
+
+
+const void *cmd_index_find_cmd(const struct cmd_index *idx, int cmd)
+{
+    if (cmd <= 0 || cmd > 255 || idx->by_cmd[cmd] < 0)
+    {
+        return NULL;
+    }
+
+    return row_at(idx, idx->by_cmd[cmd]);
+}
+
+
+const void *cmd_index_find_name(const struct cmd_index *idx, const char *name)
+{
+    const struct cmd_index_row *row;
+    int i;
+
+    if (idx->linear)
+    {
+        for (i = 0; row_at(idx, i)->cmd != 0; i++)
+        {
+            if (!strncmp(name, row_at(idx, i)->name, idx->maxlen))
+            {
+                return row_at(idx, i);
+            }
+        }
+
+        return NULL;
+    }
+
+    i = name_hash(name, idx->maxlen, 0) % CMD_INDEX_BUCKETS;
+    i = idx->by_name[name_slot(idx, name, idx->seed[i])];
+
+    if (i < 0)
+    {
+        return NULL;
+    }
+
+    row = row_at(idx, i);
+
+    return strncmp(name, row->name, idx->maxlen) ? NULL : row;
+}
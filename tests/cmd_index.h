@@ -0,0 +1,60 @@
+/*
+ * cmd_index.h - command lookup shared by the rigctl, rotctl and ampctl parsers
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef CMD_INDEX_H
+#define CMD_INDEX_H
+
+#include <stddef.h>
+
+#define CMD_INDEX_SLOTS     512     /* power of two, twice the longest table */
+#define CMD_INDEX_BUCKETS   128
+
+/*
+ * Index over a parser's test_list[].  Each row of the table has to start
+ * with the members of struct cmd_index_row and the table ends with a row
+ * whose cmd is 0.  Short commands are looked up directly by their char,
+ * long names through a perfect hash computed once by cmd_index_build():
+ * the first hash picks a bucket, the bucket's seed picks a slot that no
+ * other name uses.  Lookups neither allocate nor scan the table.
+ */
+struct cmd_index_row
+{
+    unsigned char cmd;
+    const char *name;
+};
+
+struct cmd_index
+{
+    const char *table;
+    size_t stride;              /* size of one table row */
+    size_t maxlen;              /* names are compared up to this length */
+    int linear;                 /* no perfect hash found, scan the table */
+    short by_cmd[256];          /* row of each command char, -1 if none */
+    short by_name[CMD_INDEX_SLOTS];
+    unsigned short seed[CMD_INDEX_BUCKETS];
+};
+
+void cmd_index_build(struct cmd_index *idx, const void *table, size_t stride,
+                     size_t maxlen);
+const void *cmd_index_find_cmd(const struct cmd_index *idx, int cmd);
+const void *cmd_index_find_name(const struct cmd_index *idx,
+                                const char *name);
+
+#endif  /* CMD_INDEX_H */
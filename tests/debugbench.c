@@ -0,0 +1,91 @@
+/*
+ * Hamlib debugbench program
+ *
+ * Measures what rig_debug() costs when its level is disabled, on its own
+ * and inside a cached rig_get_freq() on the dummy rig, which goes through
+ * ENTERFUNC/RETURNFUNC and a handful of trace messages per call.
+ *
+ *  Usage: debugbench [loops]
+ *      loops  number of calls per measurement (default 1000000)
+ *
+ * Example output on a Linux box, debug level none:
+ *      rig_debug(TRACE):           3.3 ns/call
+ *      rig_get_freq (cached):     71.8 ns/call
+ * With the former debugmsgsave copies on every call these were 1477 ns
+ * and 19264 ns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hamlib/rig.h>
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int main(int argc, char *argv[])
+{
+    RIG *my_rig;
+    freq_t freq;
+    double t1, t2;
+    int loops = 1000000;
+    int retcode;
+    int i;
+
+    if (argc > 1) { loops = atoi(argv[1]); }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    t1 = now_ns();
+
+    for (i = 0; i < loops; i++)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: loop %d of %d\n", __func__, i, loops);
+    }
+
+    t2 = now_ns();
+    printf("rig_debug(TRACE):      %8.1f ns/call\n", (t2 - t1) / loops);
+
+    my_rig = rig_init(RIG_MODEL_DUMMY);
+
+    if (!my_rig)
+    {
+        fprintf(stderr, "Unknown rig num\n");
+        exit(1);
+    }
+
+    retcode = rig_open(my_rig);
+
+    if (retcode != RIG_OK)
+    {
+        printf("rig_open: error = %s\n", rigerror(retcode));
+        exit(2);
+    }
+
+    rig_set_freq(my_rig, RIG_VFO_CURR, 14074000);
+    /* keep the whole run a cache hit */
+    rig_set_cache_timeout_ms(my_rig, HAMLIB_CACHE_ALL, 60000);
+
+    t1 = now_ns();
+
+    for (i = 0; i < loops; i++)
+    {
+        rig_get_freq(my_rig, RIG_VFO_CURR, &freq);
+    }
+
+    t2 = now_ns();
+    printf("rig_get_freq (cached): %8.1f ns/call\n", (t2 - t1) / loops);
+
+    rig_close(my_rig);
+    rig_cleanup(my_rig);
+
+    return 0;
+}
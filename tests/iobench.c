@@ -0,0 +1,269 @@
+/*
+ * Hamlib iobench program
+ *
+ * Measures the cost of one CAT transaction (command out, ';' terminated
+ * reply in) through write_block()/read_string() against a pty that answers
+ * like a Kenwood rig answering "IF;".
+ *
+ * For comparison the same transaction is also run through the historic
+ * select() + one byte read() loop so the before/after numbers come from
+ * the same machine.  On Linux the syscalls issued by the client thread are
+ * counted by wrapping read/write/select/poll in this executable.
+ *
+ *  Usage: iobench [loops] [chunk]
+ *      loops  number of transactions per method (default 2000)
+ *      chunk  reply is written in pieces of this many bytes, 0 = all at once
+ *             use a small value to mimic a slow serial line
+ *
+ * Example output on a Linux box with chunk=0:
+ *      select+read(1):  77.0 syscalls/transaction
+ *      read_string():    3.0 syscalls/transaction
+ */
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <poll.h>
+
+#include <hamlib/rig.h>
+#include "iofunc.h"
+
+#ifdef __linux__
+#include <dlfcn.h>
+#endif
+
+#define IF_REPLY "IF00014074000     -000000 0002000011 ;"
+
+static int chunk;
+
+#ifdef __linux__
+/*
+ * Count the syscalls issued by the measuring thread only, the responder
+ * thread goes through the same wrappers.
+ */
+static __thread int counting;
+static __thread long nsyscalls;
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+    static ssize_t (*real_read)(int, void *, size_t);
+
+    if (!real_read) { real_read = dlsym(RTLD_NEXT, "read"); }
+
+    if (counting) { nsyscalls++; }
+
+    return real_read(fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+    static ssize_t (*real_write)(int, const void *, size_t);
+
+    if (!real_write) { real_write = dlsym(RTLD_NEXT, "write"); }
+
+    if (counting) { nsyscalls++; }
+
+    return real_write(fd, buf, count);
+}
+
+int select(int n, fd_set *r, fd_set *w, fd_set *e, struct timeval *tv)
+{
+    static int (*real_select)(int, fd_set *, fd_set *, fd_set *,
+                              struct timeval *);
+
+    if (!real_select) { real_select = dlsym(RTLD_NEXT, "select"); }
+
+    if (counting) { nsyscalls++; }
+
+    return real_select(n, r, w, e, tv);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    static int (*real_poll)(struct pollfd *, nfds_t, int);
+
+    if (!real_poll) { real_poll = dlsym(RTLD_NEXT, "poll"); }
+
+    if (counting) { nsyscalls++; }
+
+    return real_poll(fds, nfds, timeout);
+}
+#endif
+
+
+/* answer every ';' terminated command with IF_REPLY */
+static void *responder(void *arg)
+{
+    int fd = *(int *)arg;
+    char c;
+
+    while (read(fd, &c, 1) == 1)
+    {
+        int len = strlen(IF_REPLY);
+        int i;
+
+        if (c != ';') { continue; }
+
+        if (chunk <= 0)
+        {
+            if (write(fd, IF_REPLY, len) != len) { break; }
+
+            continue;
+        }
+
+        for (i = 0; i < len; i += chunk)
+        {
+            int n = len - i < chunk ? len - i : chunk;
+
+            if (write(fd, IF_REPLY + i, n) != n) { return NULL; }
+
+            usleep(100);
+        }
+    }
+
+    return NULL;
+}
+
+
+/* the pre-buffering read_string() loop */
+static int legacy_transaction(hamlib_port_t *p, char *buf, int buflen)
+{
+    int total = 0;
+
+    if (write(p->fd, "IF;", 3) != 3) { return -RIG_EIO; }
+
+    while (total < buflen - 1)
+    {
+        fd_set rfds;
+        struct timeval tv;
+
+        tv.tv_sec = p->timeout / 1000;
+        tv.tv_usec = (p->timeout % 1000) * 1000;
+        FD_ZERO(&rfds);
+        FD_SET(p->fd, &rfds);
+
+        if (select(p->fd + 1, &rfds, NULL, NULL, &tv) <= 0) { return -RIG_ETIMEOUT; }
+
+        if (read(p->fd, &buf[total], 1) != 1) { return -RIG_EIO; }
+
+        if (buf[total++] == ';') { break; }
+    }
+
+    buf[total] = 0;
+    return total;
+}
+
+
+static int hamlib_transaction(hamlib_port_t *p, char *buf, int buflen)
+{
+    int retval = write_block(p, "IF;", 3);
+
+    if (retval != RIG_OK) { return retval; }
+
+    return read_string(p, buf, buflen, ";", 1);
+}
+
+
+static void run(const char *name,
+                int (*transaction)(hamlib_port_t *, char *, int),
+                hamlib_port_t *p,
+                int loops)
+{
+    struct timeval tv1, tv2;
+    double elapsed;
+    char buf[64];
+    int i;
+
+#ifdef __linux__
+    nsyscalls = 0;
+    counting = 1;
+#endif
+    gettimeofday(&tv1, NULL);
+
+    for (i = 0; i < loops; i++)
+    {
+        int retval = transaction(p, buf, sizeof(buf));
+
+        if (retval != strlen(IF_REPLY))
+        {
+            fprintf(stderr, "%s: bad reply %d '%s'\n", name, retval, buf);
+            exit(1);
+        }
+    }
+
+    gettimeofday(&tv2, NULL);
+#ifdef __linux__
+    counting = 0;
+#endif
+
+    elapsed = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+
+    printf("%-16s %8.1f us/transaction", name, elapsed * 1e6 / loops);
+#ifdef __linux__
+    printf(" %6.1f syscalls/transaction", (double)nsyscalls / loops);
+#endif
+    printf("\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    hamlib_port_t port;
+    struct termios tio;
+    pthread_t thread;
+    int loops = 2000;
+    int master;
+
+    if (argc > 1) { loops = atoi(argv[1]); }
+
+    if (argc > 2) { chunk = atoi(argv[2]); }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+
+    memset(&port, 0, sizeof(port));
+    port.type.rig = RIG_PORT_DEVICE;
+    port.timeout = 1000;
+    strncpy(port.pathname, ptsname(master), HAMLIB_FILPATHLEN - 1);
+
+    if (port_open(&port) != RIG_OK)
+    {
+        fprintf(stderr, "cannot open %s\n", port.pathname);
+        return 1;
+    }
+
+    tcgetattr(port.fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(port.fd, TCSANOW, &tio);
+
+    pthread_create(&thread, NULL, responder, &master);
+
+    printf("%d transactions of %d byte replies, chunk=%d\n",
+           loops, (int)strlen(IF_REPLY), chunk);
+
+    run("select+read(1):", legacy_transaction, &port, loops);
+    run("read_string():", hamlib_transaction, &port, loops);
+
+    port_close(&port, RIG_PORT_DEVICE);
+    close(master);
+
+    return 0;
+}
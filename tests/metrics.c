@@ -0,0 +1,508 @@
+/*
+ * metrics.c - Prometheus endpoint shared by rigctld, rotctld and ampctld
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * A daemon started with --metrics-port answers "GET /metrics" on that
+ * port with its counters in the Prometheus text format.  One thread
+ * accepts the scrapes and serves them one at a time; the counters it
+ * reports are bumped lock-free by the threads doing the work and read
+ * here without any lock, so a scrape never holds up a command.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+
+#ifdef HAVE_NETINET_IN_H
+#  include <netinet/in.h>
+#endif
+
+#ifdef HAVE_SYS_SOCKET_H
+#  include <sys/socket.h>
+#endif
+
+#ifdef HAVE_NETDB_H
+#  include <netdb.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#include <hamlib/rig.h>
+
+#include "misc.h"
+#include "metrics.h"
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_SYS_SOCKET_H) \
+    && defined(HAVE_OPEN_MEMSTREAM)
+#  define METRICS_SERVER 1
+#endif
+
+
+unsigned long metrics_now_us(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+
+/* bucket i counts up to 4^i us, the last one the rest */
+static int metrics_bucket(unsigned long us)
+{
+    unsigned long le = 1;
+    int i;
+
+    for (i = 0; i < METRICS_BUCKETS && us > le; i++)
+    {
+        le <<= 2;
+    }
+
+    return i;
+}
+
+
+void metrics_cmd_record(struct cmd_metrics *m, unsigned long us, int failed)
+{
+    HL_ATOMIC_ADD(m->count, 1);
+    HL_ATOMIC_ADD(m->sum_us, us);
+    HL_ATOMIC_ADD(m->bucket[metrics_bucket(us)], 1);
+
+    if (failed)
+    {
+        HL_ATOMIC_ADD(m->errors, 1);
+    }
+}
+
+
+void metrics_family(FILE *fout, const char *prefix, const char *name,
+                    const char *type, const char *help)
+{
+    fprintf(fout, "# HELP %s_%s %s\n", prefix, name, help);
+    fprintf(fout, "# TYPE %s_%s %s\n", prefix, name, type);
+}
+
+
+/* bucket[] holds METRICS_BUCKETS + 1 plain, not cumulative, counts */
+void metrics_histogram(FILE *fout, const char *prefix, const char *name,
+                       const char *labels, const unsigned long *bucket,
+                       unsigned long sum_us)
+{
+    const char *sep = *labels ? "," : "";
+    unsigned long count = 0;
+    unsigned long le = 1;
+    int i;
+
+    for (i = 0; i < METRICS_BUCKETS; i++)
+    {
+        count += bucket[i];
+        fprintf(fout, "%s_%s_bucket{%s%sle=\"%g\"} %lu\n", prefix, name,
+                labels, sep, le / 1e6, count);
+        le <<= 2;
+    }
+
+    count += bucket[METRICS_BUCKETS];
+    fprintf(fout, "%s_%s_bucket{%s%sle=\"+Inf\"} %lu\n", prefix, name, labels,
+            sep, count);
+    fprintf(fout, "%s_%s_sum{%s} %.6f\n", prefix, name, labels, sum_us / 1e6);
+    fprintf(fout, "%s_%s_count{%s} %lu\n", prefix, name, labels, count);
+}
+
+
+/*
+ * A rig_port_stats_t histogram, whose buckets split every power of two
+ * in four, folded into the 4^i bounds, which fall on bucket edges.
+ */
+void metrics_port_histogram(FILE *fout, const char *prefix, const char *name,
+                            const char *labels, const unsigned int *hist,
+                            unsigned long sum_us)
+{
+    unsigned long bucket[METRICS_BUCKETS + 1];
+    int i;
+
+    memset(bucket, 0, sizeof(bucket));
+
+    for (i = 0; i < RIG_PORT_STATS_BUCKETS; i++)
+    {
+        bucket[metrics_bucket(rig_port_stats_bucket_us(i + 1))] += hist[i];
+    }
+
+    metrics_histogram(fout, prefix, name, labels, bucket, sum_us);
+}
+
+
+/* m[] is indexed by command char, commands never run are left out */
+void metrics_print_cmds(FILE *fout, const char *prefix,
+                        const struct cmd_index *idx,
+                        const struct cmd_metrics *m)
+{
+    char labels[64];
+    int c;
+
+    metrics_family(fout, prefix, "commands_total", "counter",
+                   "Commands run, by command.");
+
+    for (c = 1; c < 256; c++)
+    {
+        const struct cmd_index_row *row = cmd_index_find_cmd(idx, c);
+
+        if (row && m[c].count)
+        {
+            fprintf(fout, "%s_commands_total{cmd=\"%s\"} %lu\n", prefix,
+                    row->name, m[c].count);
+        }
+    }
+
+    metrics_family(fout, prefix, "command_errors_total", "counter",
+                   "Commands that returned an error, by command.");
+
+    for (c = 1; c < 256; c++)
+    {
+        const struct cmd_index_row *row = cmd_index_find_cmd(idx, c);
+
+        if (row && m[c].count)
+        {
+            fprintf(fout, "%s_command_errors_total{cmd=\"%s\"} %lu\n", prefix,
+                    row->name, m[c].errors);
+        }
+    }
+
+    metrics_family(fout, prefix, "command_duration_seconds", "histogram",
+                   "Time from parsing a command to its reply, by command.");
+
+    for (c = 1; c < 256; c++)
+    {
+        const struct cmd_index_row *row = cmd_index_find_cmd(idx, c);
+
+        if (row && m[c].count)
+        {
+            snprintf(labels, sizeof(labels), "cmd=\"%s\"", row->name);
+            metrics_histogram(fout, prefix, "command_duration_seconds", labels,
+                              m[c].bucket, m[c].sum_us);
+        }
+    }
+}
+
+
+/* one set of port counters for each of the n devices, told apart by labels */
+void metrics_print_ports(FILE *fout, const char *prefix, int n,
+                         char *const labels[],
+                         const rig_port_stats_t stats[])
+{
+    int i;
+
+    metrics_family(fout, prefix, "port_writes_total", "counter",
+                   "Frames sent to the device.");
+
+    for (i = 0; i < n; i++)
+    {
+        fprintf(fout, "%s_port_writes_total{%s} %lu\n", prefix, labels[i],
+                stats[i].writes);
+    }
+
+    metrics_family(fout, prefix, "port_reads_total", "counter",
+                   "Frames received from the device.");
+
+    for (i = 0; i < n; i++)
+    {
+        fprintf(fout, "%s_port_reads_total{%s} %lu\n", prefix, labels[i],
+                stats[i].reads);
+    }
+
+    metrics_family(fout, prefix, "port_timeouts_total", "counter",
+                   "Reads from the device that timed out.");
+
+    for (i = 0; i < n; i++)
+    {
+        fprintf(fout, "%s_port_timeouts_total{%s} %lu\n", prefix, labels[i],
+                stats[i].timeouts);
+    }
+
+    metrics_family(fout, prefix, "port_retries_total", "counter",
+                   "Commands sent again by the backend after a failure.");
+
+    for (i = 0; i < n; i++)
+    {
+        fprintf(fout, "%s_port_retries_total{%s} %lu\n", prefix, labels[i],
+                stats[i].retries);
+    }
+
+    metrics_family(fout, prefix, "port_reply_seconds", "histogram",
+                   "Time from a write to the end of the frame read back.");
+
+    for (i = 0; i < n; i++)
+    {
+        metrics_port_histogram(fout, prefix, "port_reply_seconds", labels[i],
+                               stats[i].complete_us, stats[i].complete_sum_us);
+    }
+}
+
+
+#ifdef METRICS_SERVER
+
+static int metrics_sock = -1;
+static metrics_cb_t metrics_cb;
+
+
+static int send_all(int sock, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(sock, buf, len, 0);
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            return -1;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+
+static void metrics_serve(int sock)
+{
+    struct timeval tv = { 2, 0 };
+    char req[1024];
+    char hdr[256];
+    const char *status = "200 OK";
+    char *body = NULL;
+    size_t body_len = 0;
+    size_t len = 0;
+    FILE *fp;
+    int n;
+
+    /* neither a silent nor a stalled scraper may hold up the next one */
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (char *)&tv, sizeof(tv));
+
+    /* the request line is all we look at, headers are read and dropped */
+    while (len < sizeof(req) - 1)
+    {
+        ssize_t got = recv(sock, req + len, sizeof(req) - 1 - len, 0);
+
+        if (got <= 0)
+        {
+            break;
+        }
+
+        len += got;
+        req[len] = '\0';
+
+        if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+        {
+            break;
+        }
+    }
+
+    req[len] = '\0';
+
+    if (strncmp(req, "GET ", 4) != 0)
+    {
+        status = "405 Method Not Allowed";
+    }
+    else if (strncmp(req + 4, "/metrics ", 9) != 0
+             && strncmp(req + 4, "/ ", 2) != 0)
+    {
+        status = "404 Not Found";
+    }
+    else
+    {
+        fp = open_memstream(&body, &body_len);
+
+        if (!fp)
+        {
+            status = "500 Internal Server Error";
+        }
+        else
+        {
+            metrics_cb(fp);
+            fclose(fp);
+        }
+    }
+
+    n = snprintf(hdr, sizeof(hdr),
+                 "HTTP/1.0 %s\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %lu\r\n"
+                 "Connection: close\r\n\r\n",
+                 status, (unsigned long)body_len);
+
+    if (send_all(sock, hdr, n) == 0 && body_len)
+    {
+        send_all(sock, body, body_len);
+    }
+
+    free(body);
+}
+
+
+static void *metrics_thread(void *arg)
+{
+    for (;;)
+    {
+        int sock = accept(metrics_sock, NULL, NULL);
+
+        if (sock < 0)
+        {
+            if (errno != EINTR && errno != EAGAIN)
+            {
+                rig_debug(RIG_DEBUG_ERR, "%s: accept: %s\n", __func__,
+                          strerror(errno));
+                hl_usleep(100 * 1000);
+            }
+
+            continue;
+        }
+
+        metrics_serve(sock);
+        close(sock);
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Listen for scrapes on addr and port, cb writes the metrics.  Without
+ * addr only local scrapers get in, on 127.0.0.1.  Returns -1 when the
+ * port cannot be opened.
+ */
+int metrics_start(const char *addr, const char *port, metrics_cb_t cb)
+{
+    struct addrinfo hints, *result, *res;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int reuseaddr = 1;
+    int retcode;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    retcode = getaddrinfo(addr ? addr : "127.0.0.1", port, &hints, &result);
+
+    if (retcode != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: getaddrinfo: %s\n", __func__,
+                  gai_strerror(retcode));
+        return -1;
+    }
+
+    for (res = result; res; res = res->ai_next)
+    {
+        metrics_sock = socket(res->ai_family, res->ai_socktype,
+                              res->ai_protocol);
+
+        if (metrics_sock < 0)
+        {
+            continue;
+        }
+
+        setsockopt(metrics_sock, SOL_SOCKET, SO_REUSEADDR,
+                   (char *)&reuseaddr, sizeof(reuseaddr));
+
+#ifdef IPV6_V6ONLY
+
+        if (res->ai_family == AF_INET6)
+        {
+            int sockopt = 0;
+
+            setsockopt(metrics_sock, IPPROTO_IPV6, IPV6_V6ONLY,
+                       (char *)&sockopt, sizeof(sockopt));
+        }
+
+#endif
+
+        if (bind(metrics_sock, res->ai_addr, res->ai_addrlen) == 0
+                && listen(metrics_sock, 4) == 0)
+        {
+            break;
+        }
+
+        close(metrics_sock);
+        metrics_sock = -1;
+    }
+
+    freeaddrinfo(result);
+
+    if (metrics_sock < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot listen on port %s\n", __func__,
+                  port);
+        return -1;
+    }
+
+    metrics_cb = cb;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    retcode = pthread_create(&thread, &attr, metrics_thread, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (retcode != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pthread_create: %s\n", __func__,
+                  strerror(retcode));
+        close(metrics_sock);
+        metrics_sock = -1;
+        return -1;
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: serving metrics on port %s\n", __func__,
+              port);
+
+    return 0;
+}
+
+#else
+
+int metrics_start(const char *addr, const char *port, metrics_cb_t cb)
+{
+    rig_debug(RIG_DEBUG_ERR, "%s: not supported on this platform\n",
+              __func__);
+    return -1;
+}
+
+#endif  /* METRICS_SERVER */
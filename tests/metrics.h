@@ -0,0 +1,68 @@
+/*
+ * metrics.h - Prometheus endpoint shared by rigctld, rotctld and ampctld
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+#include <hamlib/rig.h>
+
+#include "cmd_index.h"
+
+/* histogram bounds are 4^i us, 1 us to 16.8 s, plus one for +Inf */
+#define METRICS_BUCKETS     13
+
+/*
+ * Counters of one command, kept by the parsers for each command char.
+ * Updated without locks, so a scrape may see a command half counted.
+ */
+struct cmd_metrics
+{
+    unsigned long count;
+    unsigned long errors;
+    unsigned long sum_us;
+    unsigned long bucket[METRICS_BUCKETS + 1];
+};
+
+/* writes the whole text exposition to fout */
+typedef void (*metrics_cb_t)(FILE *fout);
+
+int metrics_start(const char *addr, const char *port, metrics_cb_t cb);
+
+unsigned long metrics_now_us(void);
+void metrics_cmd_record(struct cmd_metrics *m, unsigned long us, int failed);
+
+void metrics_family(FILE *fout, const char *prefix, const char *name,
+                    const char *type, const char *help);
+void metrics_histogram(FILE *fout, const char *prefix, const char *name,
+                       const char *labels, const unsigned long *bucket,
+                       unsigned long sum_us);
+void metrics_port_histogram(FILE *fout, const char *prefix, const char *name,
+                            const char *labels, const unsigned int *hist,
+                            unsigned long sum_us);
+void metrics_print_cmds(FILE *fout, const char *prefix,
+                        const struct cmd_index *idx,
+                        const struct cmd_metrics *m);
+void metrics_print_ports(FILE *fout, const char *prefix, int n,
+                         char *const labels[],
+                         const rig_port_stats_t stats[]);
+
+#endif  /* METRICS_H */
@@ -0,0 +1,133 @@
+/*
+ * Hamlib parsebench program
+ *
+ * Measures what rigctld spends per command on parsing and dispatch, by
+ * running command lines through rigctl_parse_buf() on the dummy rig with
+ * every reply going to /dev/null.  Short commands, long names from the
+ * start and the end of the command table and a command with arguments
+ * are timed separately, the rig call itself is a cache hit.
+ *
+ *  Usage: parsebench [loops]
+ *      loops  number of commands per round (default 200000), the best of
+ *             5 rounds is reported
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hamlib/rig.h>
+
+#include "rigctl_parse.h"
+
+#define ROUNDS  5
+
+static const char *const bench_cmds[] =
+{
+    "f\n",
+    "\\get_freq\n",
+    "\\get_vfo_list\n",
+    "\\get_level AF\n",
+    NULL
+};
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int main(int argc, char *argv[])
+{
+    RIG *my_rig;
+    FILE *fout;
+    int loops = 200000;
+    int retcode;
+    int i, j;
+
+    if (argc > 1) { loops = atoi(argv[1]); }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    my_rig = rig_init(RIG_MODEL_DUMMY);
+
+    if (!my_rig)
+    {
+        fprintf(stderr, "Unknown rig num\n");
+        exit(1);
+    }
+
+    retcode = rig_open(my_rig);
+
+    if (retcode != RIG_OK)
+    {
+        printf("rig_open: error = %s\n", rigerror(retcode));
+        exit(2);
+    }
+
+    /* keep the whole run a cache hit */
+    rig_set_cache_timeout_ms(my_rig, HAMLIB_CACHE_ALL, 60000);
+
+    fout = fopen("/dev/null", "w");
+
+    if (!fout)
+    {
+        perror("/dev/null");
+        exit(3);
+    }
+
+    for (j = 0; bench_cmds[j]; j++)
+    {
+        size_t len = strlen(bench_cmds[j]);
+        char buf[64];
+        int vfo_opt = 0;
+        int ext_resp = 0;
+        char resp_sep = '\n';
+        struct rigctl_client_state cs;
+        double best = 0;
+        int round;
+
+        memset(&cs, 0, sizeof(cs));
+
+        /* best of a few rounds, the first ones also warm up the caches */
+        for (round = 0; round < ROUNDS; round++)
+        {
+            double t1 = now_ns();
+
+            for (i = 0; i < loops; i++)
+            {
+                /* the parser cuts tokens in place, give it a fresh copy */
+                memcpy(buf, bench_cmds[j], len + 1);
+                rigctl_parse_buf(my_rig, buf, len, fout, &vfo_opt, '\r',
+                                 &ext_resp, &resp_sep, &cs, &retcode);
+            }
+
+            t1 = now_ns() - t1;
+
+            if (round == 0 || t1 < best)
+            {
+                best = t1;
+            }
+        }
+
+        if (retcode != 0)
+        {
+            printf("%.*s: error = %d\n", (int)len - 1, bench_cmds[j], retcode);
+            exit(4);
+        }
+
+        printf("%-16.*s %8.1f ns/command\n", (int)len - 1, bench_cmds[j],
+               best / loops);
+    }
+
+    fclose(fout);
+    rig_close(my_rig);
+    rig_cleanup(my_rig);
+
+    return 0;
+}
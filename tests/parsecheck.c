@@ -0,0 +1,274 @@
+/*
+ * Hamlib parsecheck program
+ *
+ * Checks that rigctld's rigctl_parse_buf() reads commands the same way
+ * rigctl_parse() does.  Each script is run through rigctl_parse() from a
+ * FILE, through rigctl_parse_buf() all at once and through
+ * rigctl_parse_buf() a byte at a time, as if every byte came in its own
+ * read, each time on a freshly opened dummy rig, and the three outputs
+ * have to match.
+ *
+ *  Usage: parsecheck [-v]
+ *      -v  print the output of every script
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hamlib/rig.h>
+
+#include "rigctl_parse.h"
+
+struct check_script
+{
+    const char *name;
+    const char *input;
+    int whole_only;     /* set_channel reads its fields from what is there */
+};
+
+static const struct check_script scripts[] =
+{
+    {
+        "pipelined",
+        "F 14074000\nf\nM USB 2400\nm\nV VFOB\nv\nV VFOA\nt\n",
+        0
+    },
+    {
+        "extended response",
+        "+f\n;m\n+\\get_freq\n|\\get_mode\n,\\get_vfo\n+F 7074000\n",
+        0
+    },
+    {
+        "long names",
+        "\\set_freq 3573000\n\\get_freq\n\\set_mode LSB 1800\n\\get_mode\n"
+        "\\chk_vfo\n\\get_vfo_info VFOA\n\\get_level AF\n",
+        0
+    },
+    {
+        "comments and blank lines",
+        "# a comment\nf\n\n\r\n#F 1\n  \nm\n#\n",
+        0
+    },
+    {
+        "unknown and bad arguments",
+        "F nonsense\nf\nM FOO 0\nm\n\\no_such_command\nf\n",
+        0
+    },
+    {
+        "set_channel",
+        "H 0\n0 1 145000000 FM 15000 145600000 FM 15000 0 + 600000 12500"
+        " 0 0 0 885 0 0 0 0 0 TEST\nh 0 1\nf\n",
+        1
+    },
+    { NULL, NULL, 0 }
+};
+
+static int verbose;
+
+
+static RIG *open_rig(void)
+{
+    RIG *rig = rig_init(RIG_MODEL_DUMMY);
+
+    if (!rig)
+    {
+        fprintf(stderr, "Unknown rig num\n");
+        exit(1);
+    }
+
+    if (rig_open(rig) != RIG_OK)
+    {
+        fprintf(stderr, "rig_open failed\n");
+        exit(2);
+    }
+
+    return rig;
+}
+
+
+static void close_rig(RIG *rig)
+{
+    rig_close(rig);
+    rig_cleanup(rig);
+}
+
+
+/*
+ * What the rigctld fallback does, output in a malloc'ed string.  A failed
+ * command returns 2, on which rigctld reopens the rig and goes on, the
+ * dummy rig needs no reopening.
+ */
+static char *run_file(const char *input)
+{
+    RIG *rig = open_rig();
+    FILE *fin = fmemopen((void *)input, strlen(input), "r");
+    char *out = NULL;
+    size_t out_len = 0;
+    FILE *fout = open_memstream(&out, &out_len);
+    int vfo_opt = 0;
+    int ext_resp = 0;
+    char resp_sep = '\n';
+    struct rigctl_client_state cs;
+    int retcode;
+
+    if (!fin || !fout)
+    {
+        perror("parsecheck");
+        exit(3);
+    }
+
+    memset(&cs, 0, sizeof(cs));
+
+    do
+    {
+        retcode = rigctl_parse(rig, fin, fout, NULL, 0, NULL, 1, 0, &vfo_opt,
+                               '\r', &ext_resp, &resp_sep, &cs);
+    }
+    while ((retcode == 0 || retcode == 2 || retcode == -RIG_ENAVAIL)
+            && !feof(fin));
+
+    fclose(fin);
+    fclose(fout);
+    close_rig(rig);
+
+    return out;
+}
+
+
+/*
+ * What the rigctld worker does, the input arriving chunk bytes at a time
+ * and the parser called again as long as it has whole commands.
+ */
+static char *run_buf(const char *input, size_t chunk)
+{
+    RIG *rig = open_rig();
+    size_t in_len = strlen(input);
+    size_t fed = 0;
+    char *buf = malloc(in_len + 1);
+    size_t len = 0;
+    char *out = NULL;
+    size_t out_len = 0;
+    FILE *fout = open_memstream(&out, &out_len);
+    int vfo_opt = 0;
+    int ext_resp = 0;
+    char resp_sep = '\n';
+    struct rigctl_client_state cs;
+    int retcode;
+
+    if (!buf || !fout)
+    {
+        perror("parsecheck");
+        exit(3);
+    }
+
+    memset(&cs, 0, sizeof(cs));
+
+    while (fed < in_len || len > 0)
+    {
+        size_t used;
+
+        if (fed < in_len)
+        {
+            size_t n = in_len - fed < chunk ? in_len - fed : chunk;
+
+            memcpy(buf + len, input + fed, n);
+            fed += n;
+            len += n;
+        }
+
+        do
+        {
+            used = rigctl_parse_buf(rig, buf, len, fout, &vfo_opt, '\r',
+                                    &ext_resp, &resp_sep, &cs, &retcode);
+
+            if (retcode != 0 && retcode != -1 && retcode != 2
+                    && retcode != -RIG_ENAVAIL)
+            {
+                len = 0;
+                fed = in_len;
+                break;
+            }
+
+            memmove(buf, buf + used, len - used);
+            len -= used;
+        }
+        while (used > 0 && len > 0);
+
+        /* a last line without its end never makes a whole command */
+        if (fed == in_len && used == 0)
+        {
+            break;
+        }
+    }
+
+    free(buf);
+    fclose(fout);
+    close_rig(rig);
+
+    return out;
+}
+
+
+static int compare(const char *name, const char *how, const char *want,
+                   const char *got)
+{
+    if (!strcmp(want, got))
+    {
+        return 0;
+    }
+
+    printf("%s: rigctl_parse_buf() %s differs\n"
+           "--- rigctl_parse()\n%s"
+           "--- rigctl_parse_buf()\n%s---\n", name, how, want, got);
+
+    return 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int failed = 0;
+    int i;
+
+    if (argc > 1 && !strcmp(argv[1], "-v"))
+    {
+        verbose = 1;
+    }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    for (i = 0; scripts[i].name; i++)
+    {
+        const struct check_script *s = &scripts[i];
+        char *want = run_file(s->input);
+        char *got = run_buf(s->input, strlen(s->input));
+
+        if (verbose)
+        {
+            printf("=== %s\n%s", s->name, want);
+        }
+
+        failed += compare(s->name, "whole", want, got);
+        free(got);
+
+        if (!s->whole_only)
+        {
+            got = run_buf(s->input, 1);
+            failed += compare(s->name, "a byte at a time", want, got);
+            free(got);
+        }
+
+        free(want);
+    }
+
+    if (failed)
+    {
+        printf("%d mismatches\n", failed);
+        return 1;
+    }
+
+    printf("rigctl_parse() and rigctl_parse_buf() agree on %d scripts\n", i);
+
+    return 0;
+}
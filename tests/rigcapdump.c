@@ -0,0 +1,533 @@
+/*
+ * rigcapdump - decode a capture written by rig_wirecap_dump()
+ *
+ *  Copyright (c) 2021 by the Hamlib group
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation; either version 2
+ *   of the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <hamlib/rig.h>
+
+
+enum framing_e
+{
+    FRAMING_HEX,
+    FRAMING_KENWOOD,
+    FRAMING_NEWCAT,
+    FRAMING_CIV
+};
+
+struct cmd_name
+{
+    const char *cmd;
+    const char *name;
+};
+
+/* the commands seen most in traces, anything else is printed raw */
+static const struct cmd_name kenwood_cmds[] =
+{
+    { "AG", "AF gain" },
+    { "AI", "auto information" },
+    { "FA", "VFO A frequency" },
+    { "FB", "VFO B frequency" },
+    { "FR", "RX VFO" },
+    { "FT", "TX VFO" },
+    { "FW", "filter width" },
+    { "ID", "model id" },
+    { "IF", "information" },
+    { "KS", "keyer speed" },
+    { "MD", "mode" },
+    { "PC", "output power" },
+    { "PS", "power status" },
+    { "RG", "RF gain" },
+    { "RX", "receive" },
+    { "SM", "S meter" },
+    { "TX", "transmit" },
+    { NULL, NULL }
+};
+
+static const struct cmd_name newcat_cmds[] =
+{
+    { "AG", "AF gain" },
+    { "AI", "auto information" },
+    { "FA", "VFO A frequency" },
+    { "FB", "VFO B frequency" },
+    { "FR", "function RX" },
+    { "FT", "function TX" },
+    { "ID", "model id" },
+    { "IF", "information" },
+    { "KS", "keyer speed" },
+    { "MD", "mode" },
+    { "PC", "output power" },
+    { "PS", "power status" },
+    { "RG", "RF gain" },
+    { "SH", "width" },
+    { "SM", "S meter" },
+    { "ST", "split" },
+    { "TX", "transmit" },
+    { "VS", "VFO select" },
+    { NULL, NULL }
+};
+
+static const struct
+{
+    int cmd;
+    const char *name;
+} civ_cmds[] =
+{
+    { 0x00, "transceive frequency" },
+    { 0x01, "transceive mode" },
+    { 0x03, "read frequency" },
+    { 0x04, "read mode" },
+    { 0x05, "set frequency" },
+    { 0x06, "set mode" },
+    { 0x07, "select VFO" },
+    { 0x0f, "split" },
+    { 0x14, "level" },
+    { 0x15, "meter" },
+    { 0x16, "function" },
+    { 0x19, "read id" },
+    { 0x1a, "extended" },
+    { 0x1c, "PTT/tuner" },
+    { 0xfa, "NG" },
+    { 0xfb, "OK" },
+    { -1, NULL }
+};
+
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [OPTION]... FILE\n"
+           "Decode a capture saved by the dump_wirecap command.\n\n",
+           name);
+
+    printf(
+        "  -p, --protocol=NAME   kenwood, newcat, civ or hex (default hex)\n"
+        "  -h, --help            display this help and exit\n"
+        "  -V, --version         output version information and exit\n\n"
+    );
+}
+
+
+static const char *lookup(const struct cmd_name *table, const char *cmd)
+{
+    for (; table->cmd; table++)
+    {
+        if (strncmp(table->cmd, cmd, 2) == 0)
+        {
+            return table->name;
+        }
+    }
+
+    return NULL;
+}
+
+
+static const char *lookup_civ(int cmd)
+{
+    int i;
+
+    for (i = 0; civ_cmds[i].name; i++)
+    {
+        if (civ_cmds[i].cmd == cmd)
+        {
+            return civ_cmds[i].name;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void print_hex(const unsigned char *buf, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+    {
+        printf("%s%02x", i ? " " : "", buf[i]);
+    }
+}
+
+
+/*
+ * Kenwood and Yaesu newcat frames are ';' terminated ASCII commands,
+ * a two letter command followed by its parameters.
+ */
+static void decode_ascii(const struct cmd_name *table, int dir,
+                         const unsigned char *buf, int len)
+{
+    int start = 0;
+    int i;
+
+    for (i = 0; i <= len; i++)
+    {
+        const char *cmd = (const char *)buf + start;
+        const char *name;
+        int n = i - start;
+
+        if (i < len && buf[i] != ';')
+        {
+            continue;
+        }
+
+        start = i + 1;
+
+        if (n == 0)
+        {
+            continue;
+        }
+
+        if (n == 1 && cmd[0] == '?')
+        {
+            printf("    ?; (command rejected)\n");
+            continue;
+        }
+
+        if (i == len)
+        {
+            printf("    %.*s (no terminator)\n", n, cmd);
+            continue;
+        }
+
+        name = n >= 2 ? lookup(table, cmd) : NULL;
+
+        printf("    %.*s;", n, cmd);
+
+        if (name)
+        {
+            printf(" %s", name);
+
+            if (dir == RIG_WIRECAP_TX)
+            {
+                printf(n == 2 ? " read" : " set");
+            }
+
+            if ((cmd[1] == 'A' || cmd[1] == 'B') && cmd[0] == 'F' && n > 2)
+            {
+                printf(" %.0f Hz", atof(cmd + 2));
+            }
+        }
+
+        printf("\n");
+    }
+}
+
+
+static double civ_freq(const unsigned char *bcd, int len)
+{
+    double f = 0;
+    int i;
+
+    /* little endian BCD, least significant byte first */
+    for (i = len - 1; i >= 0; i--)
+    {
+        f = f * 100 + (bcd[i] >> 4) * 10 + (bcd[i] & 0x0f);
+    }
+
+    return f;
+}
+
+
+/*
+ * Icom CI-V frames: FE FE <to> <from> <cmd> [<subcmd>] [<data>] FD
+ */
+static void decode_civ(const unsigned char *buf, int len)
+{
+    int i = 0;
+
+    while (i < len)
+    {
+        int start, end;
+        const char *name;
+
+        if (i + 1 >= len || buf[i] != 0xfe || buf[i + 1] != 0xfe)
+        {
+            printf("    garbage ");
+            print_hex(buf + i, len - i);
+            printf("\n");
+            return;
+        }
+
+        start = i;
+
+        for (end = i + 2; end < len && buf[end] != 0xfd && buf[end] != 0xfc; end++)
+            ;
+
+        if (end == len)
+        {
+            printf("    truncated ");
+            print_hex(buf + start, len - start);
+            printf("\n");
+            return;
+        }
+
+        if (buf[end] == 0xfc)
+        {
+            printf("    collision\n");
+            i = end + 1;
+            continue;
+        }
+
+        if (end - start < 5)
+        {
+            printf("    short frame ");
+            print_hex(buf + start, end - start + 1);
+            printf("\n");
+            i = end + 1;
+            continue;
+        }
+
+        name = lookup_civ(buf[start + 4]);
+
+        printf("    to=%02x from=%02x cmd=%02x", buf[start + 2], buf[start + 3],
+               buf[start + 4]);
+
+        if (name)
+        {
+            printf(" (%s)", name);
+        }
+
+        if (end - start > 5)
+        {
+            printf(" data=");
+            print_hex(buf + start + 5, end - start - 5);
+        }
+
+        switch (buf[start + 4])
+        {
+        case 0x00:
+        case 0x03:
+        case 0x05:
+            if (end - start - 5 >= 4)
+            {
+                printf(" %.0f Hz", civ_freq(buf + start + 5, end - start - 5));
+            }
+
+            break;
+        }
+
+        printf("\n");
+        i = end + 1;
+    }
+}
+
+
+static uint32_t swap32(uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"protocol", 1, 0, 'p'},
+        {"help",     0, 0, 'h'},
+        {"version",  0, 0, 'V'},
+        {0, 0, 0, 0}
+    };
+    enum framing_e framing = FRAMING_HEX;
+    unsigned char prev_tx[4096];
+    unsigned char frame[65536];
+    uint32_t file_hdr[6];
+    int prev_tx_len = -1;
+    int swapped;
+    FILE *fp;
+
+    while (1)
+    {
+        int c = getopt_long(argc, argv, "p:hV", long_options, NULL);
+
+        if (c == -1)
+        {
+            break;
+        }
+
+        switch (c)
+        {
+        case 'p':
+            if (!strcmp(optarg, "kenwood")) { framing = FRAMING_KENWOOD; }
+            else if (!strcmp(optarg, "newcat")) { framing = FRAMING_NEWCAT; }
+            else if (!strcmp(optarg, "civ")) { framing = FRAMING_CIV; }
+            else if (!strcmp(optarg, "hex")) { framing = FRAMING_HEX; }
+            else
+            {
+                fprintf(stderr, "Unknown protocol '%s'\n", optarg);
+                exit(1);
+            }
+
+            break;
+
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+
+        case 'V':
+            printf("rigcapdump, %s\n", hamlib_version);
+            exit(0);
+
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    fp = fopen(argv[optind], "rb");
+
+    if (!fp)
+    {
+        perror(argv[optind]);
+        exit(1);
+    }
+
+    /* magic, version, thiszone, sigfigs, snaplen, network */
+    if (fread(file_hdr, sizeof(file_hdr), 1, fp) != 1)
+    {
+        fprintf(stderr, "%s: not a capture file\n", argv[optind]);
+        exit(1);
+    }
+
+    if (file_hdr[0] == 0xa1b2c3d4)
+    {
+        swapped = 0;
+    }
+    else if (file_hdr[0] == 0xd4c3b2a1)
+    {
+        swapped = 1;
+    }
+    else
+    {
+        fprintf(stderr, "%s: not a pcap file\n", argv[optind]);
+        exit(1);
+    }
+
+    if ((swapped ? swap32(file_hdr[5]) : file_hdr[5]) != RIG_WIRECAP_LINKTYPE)
+    {
+        fprintf(stderr, "%s: not a Hamlib capture\n", argv[optind]);
+        exit(1);
+    }
+
+    while (1)
+    {
+        static const char *dir_names[] = { "TX", "RX", "TO" };
+        uint32_t rec[4];    /* ts_sec, ts_usec, incl_len, orig_len */
+        char tbuf[32];
+        time_t t;
+        int len;
+        int dir;
+        int echo = 0;
+
+        if (fread(rec, sizeof(rec), 1, fp) != 1)
+        {
+            break;
+        }
+
+        if (swapped)
+        {
+            int i;
+
+            for (i = 0; i < 4; i++) { rec[i] = swap32(rec[i]); }
+        }
+
+        len = rec[2];
+
+        if (len < 1 || len > sizeof(frame) || fread(frame, len, 1, fp) != 1)
+        {
+            fprintf(stderr, "truncated capture\n");
+            break;
+        }
+
+        dir = frame[0];
+        len--;
+
+        t = rec[0];
+        strftime(tbuf, sizeof(tbuf), "%H:%M:%S", gmtime(&t));
+
+        /* CI-V interfaces echo every command back */
+        if (dir == RIG_WIRECAP_RX && len == prev_tx_len
+                && memcmp(frame + 1, prev_tx, len) == 0)
+        {
+            echo = 1;
+        }
+
+        printf("%s.%06u %s %4d bytes%s: ", tbuf, (unsigned)rec[1],
+               dir < 3 ? dir_names[dir] : "??", len, echo ? " (echo)" : "");
+
+        if (framing == FRAMING_HEX || framing == FRAMING_CIV || len == 0)
+        {
+            print_hex(frame + 1, len);
+        }
+        else
+        {
+            printf("%.*s", len, frame + 1);
+        }
+
+        printf("\n");
+
+        if (dir == RIG_WIRECAP_TX)
+        {
+            prev_tx_len = len < sizeof(prev_tx) ? len : -1;
+
+            if (prev_tx_len >= 0) { memcpy(prev_tx, frame + 1, len); }
+        }
+
+        if (echo)
+        {
+            continue;
+        }
+
+        switch (framing)
+        {
+        case FRAMING_KENWOOD:
+            decode_ascii(kenwood_cmds, dir, frame + 1, len);
+            break;
+
+        case FRAMING_NEWCAT:
+            decode_ascii(newcat_cmds, dir, frame + 1, len);
+            break;
+
+        case FRAMING_CIV:
+            decode_civ(frame + 1, len);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return 0;
+}
@@ -152,6 +152,9 @@ int main(int argc, char *argv[])
     char send_cmd_term = '\r';  /* send_cmd termination char */
     int ext_resp = 0;
     char resp_sep = '\n';
+    struct rigctl_client_state client_state;
+
+    memset(&client_state, 0, sizeof(client_state));
 
     while (1)
     {
@@ -528,6 +531,9 @@ int main(int argc, char *argv[])
         exit(0);
     }
 
+    /* the user at the keyboard may write any file */
+    rigctl_set_dump_wirecap_cb(rig_wirecap_dump);
+
     retcode = rig_open(my_rig);
 
     if (retcode != RIG_OK)
@@ -609,7 +615,7 @@ int main(int argc, char *argv[])
     {
         retcode = rigctl_parse(my_rig, stdin, stdout, argv, argc, NULL,
                                interactive, prompt, &vfo_opt, send_cmd_term,
-                               &ext_resp, &resp_sep);
+                               &ext_resp, &resp_sep, &client_state);
 
         if (retcode == 2)
         {
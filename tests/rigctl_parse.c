@@ -36,31 +36,6 @@
 #include <ctype.h>
 #include <errno.h>
 
-#ifdef HAVE_LIBREADLINE
-#  if defined(HAVE_READLINE_READLINE_H)
-#    include <readline/readline.h>
-#  elif defined(HAVE_READLINE_H)    /* !defined(HAVE_READLINE_READLINE_H) */
-#    include <readline.h>
-#  else                             /* !defined(HAVE_READLINE_H) */
-extern char *readline();
-#  endif                            /* HAVE_READLINE_H */
-#else
-/* no readline */
-#endif                              /* HAVE_LIBREADLINE */
-
-#ifdef HAVE_READLINE_HISTORY
-#  if defined(HAVE_READLINE_HISTORY_H)
-#    include <readline/history.h>
-#  elif defined(HAVE_HISTORY_H)
-#    include <history.h>
-#  else                             /* !defined(HAVE_HISTORY_H) */
-extern void add_history();
-extern int write_history();
-extern int read_history();
-#  endif                            /* defined(HAVE_READLINE_HISTORY_H) */
-/* no history */
-#endif                              /* HAVE_READLINE_HISTORY */
-
 
 #include <hamlib/rig.h>
 #include "misc.h"
@@ -69,48 +44,41 @@ extern int read_history();
 #include "sprintflst.h"
 
 #include "rigctl_parse.h"
+#include "cmd_index.h"
+#include "cmd_engine.h"
+#include "metrics.h"
 
 /* Hash table implementation See:  http://uthash.sourceforge.net/ */
 #include "uthash.h"
 
-#define STR1(S) #S
-#define STR(S) STR1(S)
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
 
-#define MAXNAMSIZ 32
 #define MAXNBOPT 100    /* max number of different options */
 #define MAXARGSZ 511
 
-#define ARG_IN1  0x01
-#define ARG_OUT1 0x02
-#define ARG_IN2  0x04
-#define ARG_OUT2 0x08
-#define ARG_IN3  0x10
-#define ARG_OUT3 0x20
-#define ARG_IN4  0x40
-#define ARG_OUT4 0x80
-#define ARG_IN_LINE 0x4000
 #define ARG_NOVFO 0x8000
 
-#define ARG_IN  (ARG_IN1|ARG_IN2|ARG_IN3|ARG_IN4)
-#define ARG_OUT (ARG_OUT1|ARG_OUT2|ARG_OUT3|ARG_OUT4)
+static queue_stats_cb_t queue_stats_cb;
+static subscribe_cb_t subscribe_cb;
+static select_rig_cb_t select_rig_cb;
+static dump_wirecap_cb_t dump_wirecap_cb;
 
-static int chk_vfo_executed;
+/* indexed by enum rigctl_sub_item_e */
+static const char *const subscribe_items[RIGCTL_SUB_ITEMS] =
+{
+    "freq", "mode", "vfo", "ptt", "split"
+};
 
-/* variables for readline support */
 #ifdef HAVE_LIBREADLINE
-static char *input_line = (char *)NULL;
-static char *result = (char *)NULL;
-static char *parsed_input[sizeof(char *) * 5];
 static const int have_rl = 1;
-
-#ifdef HAVE_READLINE_HISTORY
-static char *rp_hist_buf = (char *)NULL;
-#endif
-
 #else                               /* no readline */
 static const int have_rl = 0;
 #endif
 
+static const struct cmd_proto rig_proto = { NETRIGCTL_RET, MAXARGSZ, 1 };
+
 
 struct test_table
 {
@@ -129,7 +97,8 @@ struct test_table
                        vfo_t,
                        const char *,
                        const char *,
-                       const char *);
+                       const char *,
+                       struct rigctl_client_state *);
     int flags;
     const char *arg1;
     const char *arg2;
@@ -154,7 +123,8 @@ struct test_table
                                                     vfo_t vfo,          \
                                                     const char *arg1,   \
                                                     const char *arg2,   \
-                                                    const char *arg3)
+                                                    const char *arg3,   \
+                                                    struct rigctl_client_state *cs)
 
 declare_proto_rig(set_freq);
 declare_proto_rig(get_freq);
@@ -215,6 +185,7 @@ declare_proto_rig(get_info);
 declare_proto_rig(dump_caps);
 declare_proto_rig(dump_conf);
 declare_proto_rig(dump_state);
+declare_proto_rig(dump_state2);
 declare_proto_rig(set_ant);
 declare_proto_rig(get_ant);
 declare_proto_rig(reset);
@@ -234,6 +205,12 @@ declare_proto_rig(get_twiddle);
 declare_proto_rig(set_uplink);
 declare_proto_rig(set_cache);
 declare_proto_rig(get_cache);
+declare_proto_rig(dump_wirecap);
+declare_proto_rig(get_port_stats);
+declare_proto_rig(get_queue_stats);
+declare_proto_rig(subscribe);
+declare_proto_rig(get_snapshot);
+declare_proto_rig(select_rig);
 declare_proto_rig(halt);
 declare_proto_rig(pause);
 
@@ -325,6 +302,13 @@ static struct test_table test_list[] =
     { 0x97, "uplink",           ACTION(set_uplink),     ARG_IN | ARG_NOVFO, "1=Sub, 2=Main" },
     { 0x95, "set_cache",        ACTION(set_cache),      ARG_IN | ARG_NOVFO, "Timeout (msecs)" },
     { 0x96, "get_cache",        ACTION(get_cache),      ARG_OUT | ARG_NOVFO, "Timeout (msecs)" },
+    { 0x98, "dump_wirecap",     ACTION(dump_wirecap),   ARG_IN | ARG_NOVFO, "File" },
+    { 0x99, "get_port_stats",   ACTION(get_port_stats), ARG_OUT | ARG_NOVFO, "Port stats" },
+    { 0x9a, "get_queue_stats",  ACTION(get_queue_stats), ARG_OUT | ARG_NOVFO, "Queue stats" },
+    { 0x9b, "subscribe",        ACTION(subscribe),      ARG_IN1 | ARG_IN_LINE | ARG_NOVFO, "Items" },
+    { 0x9c, "get_snapshot",     ACTION(get_snapshot),   ARG_OUT | ARG_NOVFO, "VFO", "Frequency", "Mode", "Passband" },
+    { 0x9d, "select_rig",       ACTION(select_rig),     ARG_IN | ARG_NOVFO, "Rig" },
+    { 0x9e, "dump_state2",      ACTION(dump_state2),    ARG_IN1 | ARG_OUT | ARG_NOVFO, "Hash" },
     { '2',  "power2mW",         ACTION(power2mW),       ARG_IN1 | ARG_IN2 | ARG_IN3 | ARG_OUT1 | ARG_NOVFO, "Power [0.0..1.0]", "Frequency", "Mode", "Power mW" },
     { '4',  "mW2power",         ACTION(mW2power),       ARG_IN1 | ARG_IN2 | ARG_IN3 | ARG_OUT1 | ARG_NOVFO, "Pwr mW", "Freq", "Mode", "Power [0.0..1.0]" },
     { '1',  "dump_caps",        ACTION(dump_caps),      ARG_NOVFO },
@@ -340,24 +324,48 @@ static struct test_table test_list[] =
 };
 
 
-static struct test_table *find_cmd_entry(int cmd)
+static struct cmd_index cmd_idx;
+static struct cmd_metrics cmd_metrics[256];   /* by command char */
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t cmd_idx_once = PTHREAD_ONCE_INIT;
+#endif
+
+static void build_cmd_index(void)
 {
-    int i;
+    cmd_index_build(&cmd_idx, test_list, sizeof(test_list[0]), MAXNAMSIZ);
+}
 
-    for (i = 0; test_list[i].cmd != 0x00; i++)
-    {
-        if (test_list[i].cmd == cmd)
-        {
-            break;
-        }
-    }
 
-    if (test_list[i].cmd == 0x00)
+/* the index is built on first use, from whichever thread gets there first */
+static const struct cmd_index *get_cmd_index(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_once(&cmd_idx_once, build_cmd_index);
+#else
+    static int built;
+
+    if (!built)
     {
-        return NULL;
+        build_cmd_index();
+        built = 1;
     }
 
-    return &test_list[i];
+#endif
+    return &cmd_idx;
+}
+
+
+/* Prometheus text for the commands run so far, see metrics_print_cmds() */
+void rigctl_print_metrics(FILE *fout, const char *prefix)
+{
+    metrics_print_cmds(fout, prefix, get_cmd_index(), cmd_metrics);
+}
+
+
+static struct test_table *find_cmd_entry(int cmd)
+{
+    return (struct test_table *)cmd_index_find_cmd(get_cmd_index(), cmd);
 }
 
 
@@ -437,201 +445,126 @@ void hash_delete_all()
     }
 }
 
-#ifdef HAVE_LIBREADLINE
-/* Frees allocated memory and sets pointers to NULL before calling readline
- * and then parses the input into space separated tokens.
- */
-static void rp_getline(const char *s)
+static char parse_arg(const char *arg)
 {
-    int i;
+    const struct cmd_index_row *row = cmd_index_find_name(get_cmd_index(), arg);
 
-    /* free allocated memory and set pointers to NULL */
-    if (input_line)
-    {
-        free(input_line);
-        input_line = (char *)NULL;
-    }
+    return row ? row->cmd : 0;
+}
 
-    if (result)
-    {
-        result = (char *)NULL;
-    }
 
-    for (i = 0; i < 5; i++)
-    {
-        parsed_input[i] = NULL;
-    }
+#define fprintf_flush(f, a...)        \
+    ({ fprintf((f), a);               \
+       fflush((f));                   \
+                                      \
+    })
 
-    /* Action!  Returns typed line with newline stripped. */
-    input_line = readline(s);
-}
-#endif
 
 /*
- * TODO: use Lex?
+ * Run one command read by rigctl_parse() or rigctl_parse_buf() and
+ * write its reply
  */
-static char parse_arg(const char *arg)
+static int rigctl_run(RIG *my_rig, FILE *fin, FILE *fout, sync_cb_t sync_cb,
+                      int interactive, int prompt, int *vfo_opt,
+                      char send_cmd_term, int *ext_resp_ptr,
+                      char *resp_sep_ptr, struct rigctl_client_state *cs,
+                      unsigned char cmd, const struct test_table *cmd_entry,
+                      vfo_t vfo, const char *p1, const char *p2, const char *p3)
 {
-    int i;
+    unsigned long start_us;
+    int retcode;
 
-    for (i = 0; test_list[i].cmd != 0x00; i++)
-    {
-        if (!strncmp(arg, test_list[i].name, MAXNAMSIZ))
-        {
-            return test_list[i].cmd;
-        }
-    }
-
-    return 0;
-}
+    ENTERFUNC;
 
+    if (sync_cb) { sync_cb(1); }    /* lock if necessary */
 
-/*
- * This scanf works even in presence of signals (timer, SIGIO, ..)
- */
-static int scanfc(FILE *fin, const char *format, void *p)
-{
-    do
+    if (!prompt)
     {
-        int ret;
-        *(char *)p = 0;
-
-        ret = fscanf(fin, format, p);
+        rig_debug(RIG_DEBUG_TRACE,
+                  "rigctl(d): %c '%s' '%s' '%s' '%s'\n",
+                  cmd,
+                  rig_strvfo(vfo),
+                  p1 ? p1 : "",
+                  p2 ? p2 : "",
+                  p3 ? p3 : "");
+    }
 
-        if (ret < 0)
-        {
-            if (errno == EINTR)
-            {
-                continue;
-            }
+    /*
+     * Extended Response protocol: output received command name and arguments
+     * response.  Don't send command header on '\chk_vfo' command.
+     */
+    if (interactive && *ext_resp_ptr && !prompt && cmd != 0xf0)
+    {
+        const char *args[] = { *vfo_opt ? rig_strvfo(vfo) : NULL, p1, p2, p3 };
 
-            if (!feof(fin))
-            {
-                rig_debug(RIG_DEBUG_ERR,
-                          "fscanf: parsing '%s' with '%s'\n",
-                          (char *)p,
-                          format);
-            }
-        }
+        cmd_reply_begin(fout, cmd_entry->name, args, 4, *resp_sep_ptr);
+    }
 
-        if (ret < 1) { rig_debug(RIG_DEBUG_TRACE, "%s: ret=%d\n", __func__, ret); }
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
+    start_us = metrics_now_us();
+    retcode = (*cmd_entry->rig_routine)(my_rig,
+                                        fout,
+                                        fin,
+                                        interactive,
+                                        prompt,
+                                        vfo_opt,
+                                        send_cmd_term,
+                                        *ext_resp_ptr,
+                                        *resp_sep_ptr,
+                                        cmd_entry,
+                                        vfo,
+                                        p1,
+                                        p2 ? p2 : "",
+                                        p3 ? p3 : "",
+                                        cs);
 
-        if (ferror(fin)) { rig_debug(RIG_DEBUG_TRACE, "%s: errno=%d, %s\n", __func__, errno, strerror(errno)); }
+    metrics_cmd_record(&cmd_metrics[cmd_entry->cmd], metrics_now_us() - start_us,
+                       retcode != RIG_OK);
 
-        return ret;
-    }
-    while (1);
-}
+    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
 
+    if (retcode == RIG_EIO)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: RIG_EIO?\n", __func__);
 
-/*
- * function to get the next word from the command line or from stdin
- * until stdin exhausted. stdin is read if the special token '-' is
- * found on the command line.
- *
- * returns EOF when words exhausted
- * returns <0 is error number
- * returns >=0 when successful
- */
-static int next_word(char *buffer, int argc, char *argv[], int newline)
-{
-    int ret;
-    char c;
-    static int reading_stdin;
+        if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
 
-    if (!reading_stdin)
-    {
-        if (optind >= argc)
-        {
-            return EOF;
-        }
-        else if (newline && '-' == argv[optind][0] && 1 == strlen(argv[optind]))
-        {
-            ++optind;
-            reading_stdin = 1;
-        }
+        RETURNFUNC(retcode);
     }
 
-    if (reading_stdin)
+    /* '\chk_vfo' answers without a status line */
+    if (retcode != RIG_OK || cmd != 0xf0)
     {
-        do
-        {
-            do
-            {
-                ret = scanf(" %c%" STR(MAXARGSZ) "[^ \t\n#]", &c, &buffer[1]);
-            }
-            while (EINTR == ret);
-
-            if (ret > 0 && '#' == c)
-            {
-                do
-                {
-                    ret = scanf("%*[^\n]");
-                }
-                while (EINTR == ret);   /* consume comments */
-
-                ret = 0;
-            }
-        }
-        while (!ret);
+        cmd_reply_end(&rig_proto, fout, interactive && !prompt, cmd_entry->name,
+                      retcode, cmd_entry->flags & ARG_OUT, ext_resp_ptr,
+                      resp_sep_ptr);
+    }
 
-        if (EOF == ret)
-        {
-            reading_stdin = 0;
-        }
-        else if (ret < 0)
-        {
-            rig_debug(RIG_DEBUG_ERR, "scanf: %s\n", strerror(errno));
-            reading_stdin = 0;
-        }
-        else
-        {
-            buffer[0] = c;
-            buffer[1 == ret ? 1 : MAXARGSZ] = '\0';
+    fflush(fout);
 
-            if (newline)
-            {
-                putchar('\n');
-            }
+    rig_debug(RIG_DEBUG_TRACE, "%s: retcode=%d\n", __func__, retcode);
 
-            fputs(buffer, stdout);
-            putchar(' ');
-        }
-    }
+    if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
 
-    if (!reading_stdin)
+    if (retcode == -RIG_ENAVAIL)
     {
-        if (optind < argc)
-        {
-            strncpy(buffer, argv[optind++], MAXARGSZ);
-            buffer[MAXARGSZ] = '\0';
-            ret = 1;
-        }
-        else
-        {
-            ret = EOF;
-        }
+        RETURNFUNC(retcode);
     }
 
-    return ret;
+    RETURNFUNC(retcode != RIG_OK ? 2 : 0);
 }
 
 
-#define fprintf_flush(f, a...)        \
-    ({ fprintf((f), a);               \
-       fflush((f));                   \
-                                      \
-    })
-
-
 int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
                  sync_cb_t sync_cb,
                  int interactive, int prompt, int *vfo_opt, char send_cmd_term,
-                 int *ext_resp_ptr, char *resp_sep_ptr)
+                 int *ext_resp_ptr, char *resp_sep_ptr,
+                 struct rigctl_client_state *cs)
 {
     int retcode;        /* generic return code from functions */
     unsigned char cmd;
     struct test_table *cmd_entry = NULL;
+    struct cmd_source src = { fin, fout, interactive, prompt, argc, argv };
 
     char command[MAXARGSZ + 1];
     char arg1[MAXARGSZ + 1], *p1 = NULL;
@@ -649,8 +582,6 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
 
         if (interactive)
         {
-            static int last_was_ret = 1;
-
             if (prompt)
             {
                 fprintf_flush(fout, "\nRig command: ");
@@ -658,7 +589,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
 
             do
             {
-                if ((retcode = scanfc(fin, "%c", &cmd)) < 1)
+                if ((retcode = cmd_scanfc(fin, "%c", &cmd)) < 1)
                 {
                     rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#1? retcode=%d\n", __func__,
                               retcode);
@@ -678,7 +609,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
                 {
                     *ext_resp_ptr = 1;
 
-                    if (scanfc(fin, "%c", &cmd) < 1)
+                    if (cmd_scanfc(fin, "%c", &cmd) < 1)
                     {
                         rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#2?\n", __func__);
                         RETURNFUNC(-1);
@@ -701,7 +632,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
                     *ext_resp_ptr = 1;
                     *resp_sep_ptr = cmd;
 
-                    if (scanfc(fin, "%c", &cmd) < 1)
+                    if (cmd_scanfc(fin, "%c", &cmd) < 1)
                     {
                         rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#3?\n", __func__);
                         RETURNFUNC(-1);
@@ -725,7 +656,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
                 {
                     char cmd_name[MAXNAMSIZ], *pcmd = cmd_name;
 
-                    if (scanfc(fin, "%c", pcmd) < 1)
+                    if (cmd_scanfc(fin, "%c", pcmd) < 1)
                     {
                         rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#4?\n", __func__);
                         RETURNFUNC(-1);
@@ -747,7 +678,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
 
                 if (cmd == 0x0a || cmd == 0x0d)
                 {
-                    if (last_was_ret)
+                    if (!cs->in_line)
                     {
                         if (prompt)
                         {
@@ -758,19 +689,19 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
                         RETURNFUNC(0);
                     }
 
-                    last_was_ret = 1;
+                    cs->in_line = 0;
                 }
             }
             while (cmd == 0x0a || cmd == 0x0d);
 
-            last_was_ret = 0;
+            cs->in_line = 1;
 
             /* comment line */
             if (cmd == '#')
             {
                 while (cmd != '\n' && cmd != '\r')
                 {
-                    if (scanfc(fin, "%c", &cmd) < 1)
+                    if (cmd_scanfc(fin, "%c", &cmd) < 1)
                     {
                         rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#6?\n", __func__);
                         RETURNFUNC(-1);
@@ -803,7 +734,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
         else
         {
             /* parse rest of command line */
-            retcode = next_word(command, argc, argv, 1);
+            retcode = cmd_next_word(command, MAXARGSZ, argc, argv, 1);
 
             if (EOF == retcode)
             {
@@ -834,370 +765,107 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
 
             RETURNFUNC(0);
         }
+    }
 
-        if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
-        {
-            if (interactive)
-            {
-                arg1[0] = fgetc(fin);
-                arg1[1] = 0;
+#ifdef HAVE_LIBREADLINE
 
-                if (prompt && arg1[0] == 0x0a)
-                {
-                    fprintf_flush(fout, "VFO: ");
-                }
+    if (interactive && prompt && have_rl)
+    {
+        char *input_line;
+        char *result;
+        int j;
 
-                if (scanfc(fin, "%s", arg1) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#7?\n", __func__);
-                    RETURNFUNC(-1);
-                }
+        /* Minimum space for 32+1+32+1+128+1+128+1+128+1 = 453 chars, so
+         * allocate 512 chars cleared to zero for safety.
+         */
+        cmd_rl_history_begin(512);
 
-                vfo = rig_parse_vfo(arg1);
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
+        input_line = cmd_rl_getline("\nRig command: ");
 
-                if (EOF == retcode)
-                {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                }
-                else if (retcode < 0)
-                {
-                    RETURNFUNC(retcode);
-                }
+        /* EOF (Ctl-D) received on empty input line, bail out gracefully. */
+        if (!input_line)
+        {
+            fprintf_flush(fout, "\n");
+            RETURNFUNC(1);
+        }
 
-                vfo = rig_parse_vfo(arg1);
-            }
+        /* Q or q to quit */
+        if (!(strncasecmp(input_line, "q", 1)))
+        {
+            RETURNFUNC(1);
         }
 
-        rig_debug(RIG_DEBUG_TRACE, "%s: debug1\n", __func__);
+        /* '?' for help */
+        if (!(strncmp(input_line, "?", 1)))
+        {
+            usage_rig(fout);
+            fflush(fout);
+            RETURNFUNC(0);
+        }
 
-        if ((cmd_entry->flags & ARG_IN_LINE)
-                && (cmd_entry->flags & ARG_IN1)
-                && cmd_entry->arg1)
+        /* '#' for comment */
+        if (!(strncmp(input_line, "#", 1)))
         {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug2\n", __func__);
+            RETURNFUNC(0);
+        }
 
-            if (interactive)
-            {
-                char *nl;
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug2a\n", __func__);
+        /* Blank line entered */
+        if (!(strcmp(input_line, "")))
+        {
+            fprintf(fout, "? for help, q to quit.\n");
+            fflush(fout);
+            RETURNFUNC(0);
+        }
 
+        rig_debug(RIG_DEBUG_TRACE, "%s: input_line: %s\n", __func__, input_line);
 
-                if (fgets(arg1, MAXARGSZ, fin) == NULL)
-                {
-                    RETURNFUNC(-1);
-                }
+        /* Split input_line on any number of spaces to get the command token
+         * Tabs are intercepted by readline for completion and a newline
+         * causes readline to return the typed text.  If more than one
+         * argument is given, it will be parsed out later.
+         */
+        result = strtok(input_line, " ");
 
-                if (arg1[0] == 0xa)
-                {
-                    rig_debug(RIG_DEBUG_TRACE, "%s: debug2b\n", __func__);
+        if (!result)
+        {
+            /* Oops!  Invoke GDB!! */
+            fprintf_flush(fout, "\n");
+            RETURNFUNC(1);
+        }
 
-                    if (prompt)
-                    {
-                        fprintf_flush(fout, "%s: ", cmd_entry->arg1);
-                    }
+        /* At this point result holds the typed text of the command
+         * with surrounding space characters removed.  If Readline History is
+         * available, copy the command string into a history buffer.
+         */
 
-                    if (fgets(arg1, MAXARGSZ, fin) == NULL)
-                    {
-                        RETURNFUNC(-1);
-                    }
-                }
+        /* Single character command */
+        if ((strlen(result) == 1) && (*result != '\\'))
+        {
+            cmd = *result;
 
-                nl = strchr(arg1, 0xa);
+            /* Store what is typed, not validated, for history. */
+            cmd_rl_history_add(result, 1);
+        }
+        /* Test the command token */
+        else if ((*result == '\\') && (strlen(result) > 1))
+        {
+            char cmd_name[MAXNAMSIZ];
 
-                if (nl)
-                {
-                    *nl = '\0';    /* chomp */
-                }
+            /* if there is no terminating '\0' character in the source string,
+             * srncpy() doesn't add one even if the supplied length is less
+             * than the destination array.  Truncate the source string here.
+             */
+            if (strlen(result + 1) >= MAXNAMSIZ)
+            {
+                *(result + MAXNAMSIZ) = '\0';
+            }
 
-                if (cmd == 'b')
-                {
-                    p1 = arg1; /* CW must accept a space argument */
-                }
-                else   /* skip a space arg if first arg...but why? */
-                {
-                    p1 = arg1[0] == ' ' ? arg1 + 1 : arg1;
-                }
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    RETURNFUNC(1);
-                }
-                else if (retcode < 0)
-                {
-                    RETURNFUNC(retcode);
-                }
-
-                p1 = arg1;
-            }
-        }
-        else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
-        {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug3\n", __func__);
-
-            if (interactive)
-            {
-                arg1[0] = fgetc(fin);
-                arg1[1] = 0;
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug4 arg1=%c\n", __func__, arg1[0]);
-
-                if (prompt && arg1[0] == 0x0a)
-                {
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg1);
-                }
-
-                if (scanfc(fin, "%s", arg1) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#8?\n", __func__);
-                    RETURNFUNC(-1);
-                }
-
-                p1 = arg1;
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    RETURNFUNC(1);
-                }
-                else if (retcode < 0)
-                {
-                    RETURNFUNC(retcode);
-                }
-
-                p1 = arg1;
-            }
-        }
-
-        rig_debug(RIG_DEBUG_TRACE, "%s: debug5\n", __func__);
-
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN2)
-                && cmd_entry->arg2)
-        {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug6\n", __func__);
-
-            if (interactive)
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug7\n", __func__);
-
-                if (prompt)
-                {
-                    rig_debug(RIG_DEBUG_TRACE, "%s: debug8\n", __func__);
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg2);
-                }
-
-                if (scanfc(fin, "%s", arg2) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#9?\n", __func__);
-                    RETURNFUNC(-1);
-                }
-
-                p2 = arg2;
-            }
-            else
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug9\n", __func__);
-                retcode = next_word(arg2, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr, "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    RETURNFUNC(1);
-                }
-                else if (retcode < 0)
-                {
-                    RETURNFUNC(retcode);
-                }
-
-                p2 = arg2;
-            }
-        }
-
-        rig_debug(RIG_DEBUG_TRACE, "%s: debug10\n", __func__);
-
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN3)
-                && cmd_entry->arg3)
-        {
-            rig_debug(RIG_DEBUG_TRACE, "%s: debug11\n", __func__);
-
-            if (interactive)
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug12\n", __func__);
-
-                if (prompt)
-                {
-                    rig_debug(RIG_DEBUG_TRACE, "%s: debug13\n", __func__);
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg3);
-                }
-
-                if (scanfc(fin, "%s", arg3) < 1)
-                {
-                    rig_debug(RIG_DEBUG_WARN, "%s: nothing to scan#10?\n", __func__);
-                    RETURNFUNC(-1);
-                }
-
-                p3 = arg3;
-            }
-            else
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: debug14\n", __func__);
-                retcode = next_word(arg3, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr,
-                            "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    RETURNFUNC(1);
-                }
-                else if (retcode < 0)
-                {
-                    RETURNFUNC(retcode);
-                }
-
-                p3 = arg3;
-            }
-        }
-    }
-
-#ifdef HAVE_LIBREADLINE
-
-    if (interactive && prompt && have_rl)
-    {
-        int j, x;
-
-#ifdef HAVE_READLINE_HISTORY
-        /* Minimum space for 32+1+32+1+128+1+128+1+128+1 = 453 chars, so
-         * allocate 512 chars cleared to zero for safety.
-         */
-        rp_hist_buf = (char *)calloc(512, sizeof(char));
-#endif
-
-        rp_getline("\nRig command: ");
-
-        /* EOF (Ctl-D) received on empty input line, bail out gracefully. */
-        if (!input_line)
-        {
-            fprintf_flush(fout, "\n");
-            RETURNFUNC(1);
-        }
-
-        /* Q or q to quit */
-        if (!(strncasecmp(input_line, "q", 1)))
-        {
-            RETURNFUNC(1);
-        }
-
-        /* '?' for help */
-        if (!(strncmp(input_line, "?", 1)))
-        {
-            usage_rig(fout);
-            fflush(fout);
-            RETURNFUNC(0);
-        }
-
-        /* '#' for comment */
-        if (!(strncmp(input_line, "#", 1)))
-        {
-            RETURNFUNC(0);
-        }
-
-        /* Blank line entered */
-        if (!(strcmp(input_line, "")))
-        {
-            fprintf(fout, "? for help, q to quit.\n");
-            fflush(fout);
-            RETURNFUNC(0);
-        }
-
-        rig_debug(RIG_DEBUG_TRACE, "%s: input_line: %s\n", __func__, input_line);
-
-        /* Split input_line on any number of spaces to get the command token
-         * Tabs are intercepted by readline for completion and a newline
-         * causes readline to return the typed text.  If more than one
-         * argument is given, it will be parsed out later.
-         */
-        result = strtok(input_line, " ");
-
-        /* parsed_input stores pointers into input_line where the token strings
-         * start.
-         */
-        if (result)
-        {
-            parsed_input[0] = result;
-        }
-        else
-        {
-            /* Oops!  Invoke GDB!! */
-            fprintf_flush(fout, "\n");
-            RETURNFUNC(1);
-        }
-
-        /* At this point parsed_input contains the typed text of the command
-         * with surrounding space characters removed.  If Readline History is
-         * available, copy the command string into a history buffer.
-         */
-
-        /* Single character command */
-        if ((strlen(parsed_input[0]) == 1) && (*parsed_input[0] != '\\'))
-        {
-            cmd = *parsed_input[0];
-
-#ifdef HAVE_READLINE_HISTORY
-
-            /* Store what is typed, not validated, for history. */
-            if (rp_hist_buf)
-            {
-                strncpy(rp_hist_buf, parsed_input[0], 1);
-            }
-
-#endif
-        }
-        /* Test the command token, parsed_input[0] */
-        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) > 1))
-        {
-            char cmd_name[MAXNAMSIZ];
-
-            /* if there is no terminating '\0' character in the source string,
-             * srncpy() doesn't add one even if the supplied length is less
-             * than the destination array.  Truncate the source string here.
-             */
-            if (strlen(parsed_input[0] + 1) >= MAXNAMSIZ)
-            {
-                *(parsed_input[0] + MAXNAMSIZ) = '\0';
-            }
-
-#ifdef HAVE_READLINE_HISTORY
+            cmd_rl_history_add(result, MAXNAMSIZ);
 
-            if (rp_hist_buf)
-            {
-                strncpy(rp_hist_buf, parsed_input[0], MAXNAMSIZ);
-            }
-
-#endif
             /* The starting position of the source string is the first
              * character past the initial '\'.
              */
-            snprintf(cmd_name, sizeof(cmd_name), "%s", parsed_input[0] + 1);
+            snprintf(cmd_name, sizeof(cmd_name), "%s", result + 1);
 
             /* Sanity check as valid multiple character commands consist of
              * alphanumeric characters and the underscore ('_') character.
@@ -1215,7 +883,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
             cmd = parse_arg(cmd_name);
         }
         /* Single '\' entered, prompt again */
-        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) == 1))
+        else if ((*result == '\\') && (strlen(result) == 1))
         {
             RETURNFUNC(0);
         }
@@ -1232,7 +900,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
         {
             if (cmd == '\0')
             {
-                fprintf(stderr, "Command '%s' not found!\n", parsed_input[0]);
+                fprintf(stderr, "Command '%s' not found!\n", result);
             }
             else
             {
@@ -1241,498 +909,468 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
 
             RETURNFUNC(0);
         }
+    }
 
-        /* If vfo_opt is enabled (-o|--vfo) check if already given
-         * or prompt for it.
-         */
-        if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
+#endif // HAVE_LIBREADLINE
+
+    /* If vfo_opt is enabled (-o|--vfo) the VFO comes first. */
+    if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
+    {
+        if (!cmd_read_arg(&rig_proto, &src, cmd_entry->name, "VFO", CMD_ARG_VFO,
+                          arg1, &retcode))
         {
-            /* Check if VFO was given with command. */
-            result = strtok(NULL, " ");
+            RETURNFUNC(retcode);
+        }
 
-            if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            /* Need to prompt if a VFO string was not given. */
-            else
-            {
-                x = 0;
-                rp_getline("VFO: ");
+        vfo = rig_parse_vfo(arg1);
 
-                if (!input_line)
-                {
-                    fprintf_flush(fout, "\n");
-                    RETURNFUNC(1);
-                }
+        if (vfo == RIG_VFO_NONE && interactive && prompt && have_rl)
+        {
+            fprintf(stderr,
+                    "Warning:  VFO '%s' unrecognized, using 'currVFO' instead.\n",
+                    arg1);
+            vfo = RIG_VFO_CURR;
+        }
+    }
 
-                /* Blank line entered */
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    RETURNFUNC(0);
-                }
+    if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
+    {
+        enum cmd_arg_how how = CMD_ARG_WORD;
 
-                /* Get the first token of input, the rest, if any, will be
-                 * used later.
-                 */
-                result = strtok(input_line, " ");
+        if (cmd_entry->flags & ARG_IN_LINE)
+        {
+            /* CW must accept a space argument */
+            how = cmd == 'b' ? CMD_ARG_LINE_RAW : CMD_ARG_LINE;
+        }
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    RETURNFUNC(1);
-                }
-            }
+        p1 = cmd_read_arg(&rig_proto, &src, cmd_entry->name, cmd_entry->arg1,
+                          how, arg1, &retcode);
 
-            /* VFO name tokens are presently quite short.  Truncate excessively
-             * long strings.
-             */
-            if (strlen(parsed_input[x]) >= MAXNAMSIZ)
-            {
-                *(parsed_input[x] + (MAXNAMSIZ - 1)) = '\0';
-            }
+        if (!p1)
+        {
+            RETURNFUNC(retcode);
+        }
+    }
 
-#ifdef HAVE_READLINE_HISTORY
+    if (p1
+            && p1[0] != '?'
+            && (cmd_entry->flags & ARG_IN2)
+            && cmd_entry->arg2)
+    {
+        p2 = cmd_read_arg(&rig_proto, &src, cmd_entry->name, cmd_entry->arg2,
+                          CMD_ARG_WORD, arg2, &retcode);
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXNAMSIZ);
-            }
+        if (!p2)
+        {
+            RETURNFUNC(retcode);
+        }
+    }
 
-#endif
+    if (p1
+            && p1[0] != '?'
+            && (cmd_entry->flags & ARG_IN3)
+            && cmd_entry->arg3)
+    {
+        p3 = cmd_read_arg(&rig_proto, &src, cmd_entry->name, cmd_entry->arg3,
+                          CMD_ARG_WORD, arg3, &retcode);
 
-            /* Sanity check, VFO names are alpha only. */
-            for (j = 0; j < MAXNAMSIZ && parsed_input[x][j] != '\0'; j++)
-            {
-                if (!(isalpha((int)parsed_input[x][j])))
-                {
-                    parsed_input[x][j] = '\0';
+        if (!p3)
+        {
+            RETURNFUNC(retcode);
+        }
+    }
 
-                    break;
-                }
-            }
+    cmd_rl_history_end();
 
-            vfo = rig_parse_vfo(parsed_input[x]);
+    RETURNFUNC(rigctl_run(my_rig, fin, fout, sync_cb, interactive, prompt,
+                          vfo_opt, send_cmd_term, ext_resp_ptr, resp_sep_ptr,
+                          cs, cmd, cmd_entry, vfo, p1, p2, p3));
+}
 
-            if (vfo == RIG_VFO_NONE)
-            {
-                fprintf(stderr,
-                        "Warning:  VFO '%s' unrecognized, using 'currVFO' instead.\n",
-                        parsed_input[x]);
-                vfo = RIG_VFO_CURR;
-            }
-        }
 
-        /* \send_cmd, \send_morse */
-        if ((cmd_entry->flags & ARG_IN_LINE)
-                && (cmd_entry->flags & ARG_IN1)
-                && cmd_entry->arg1)
-        {
-            /* Check for a non-existent delimiter so as to not break up
-             * remaining line into separate tokens (spaces OK).
-             */
-            result = strtok(NULL, "\0");
+/*
+ * Read position in a rigctld receive buffer.  The words a command keeps
+ * are terminated in place by cursor_apply() once all of them are read,
+ * cursor_restore() puts the characters overwritten back.
+ */
+struct buf_cursor
+{
+    char *buf;
+    size_t len;
+    size_t pos;
+    int ncut;
+    struct
+    {
+        size_t off;
+        char c;
+    } cut[6];
+};
 
-            if (*vfo_opt && result)
-            {
-                x = 2;
-                parsed_input[x] = result;
-            }
-            else if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
-                x = 0;
 
-                strcpy(pmptstr, cmd_entry->arg1);
-                strcat(pmptstr, ": ");
+static void cursor_cut(struct buf_cursor *bc, size_t off)
+{
+    bc->cut[bc->ncut++].off = off;
+}
 
-                rp_getline(pmptstr);
 
-                /* Blank line entered */
-                if (input_line && !(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    RETURNFUNC(0);
-                }
+static void cursor_apply(struct buf_cursor *bc)
+{
+    int i;
 
-                if (input_line)
-                {
-                    parsed_input[x] = input_line;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    RETURNFUNC(1);
-                }
-            }
+    for (i = 0; i < bc->ncut; i++)
+    {
+        bc->cut[i].c = bc->buf[bc->cut[i].off];
+        bc->buf[bc->cut[i].off] = '\0';
+    }
+}
 
-            /* The arg1 array size is MAXARGSZ + 1 so truncate it to fit if larger. */
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
 
-#ifdef HAVE_READLINE_HISTORY
+static void cursor_restore(struct buf_cursor *bc)
+{
+    while (bc->ncut > 0)
+    {
+        bc->ncut--;
+        bc->buf[bc->cut[bc->ncut].off] = bc->cut[bc->ncut].c;
+    }
+}
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
 
-#endif
-            strcpy(arg1, parsed_input[x]);
-            p1 = arg1;
-        }
+/* like fgetc(), -1 at the end of the buffer */
+static int cursor_getc(struct buf_cursor *bc)
+{
+    return bc->pos < bc->len ? (unsigned char)bc->buf[bc->pos++] : -1;
+}
 
-        /* Normal argument parsing. */
-        else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
-        {
-            result = strtok(NULL, " ");
 
-            if (*vfo_opt && result)
-            {
-                x = 2;
-                parsed_input[x] = result;
-            }
-            else if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
-                x = 0;
+/*
+ * like scanf("%s"), NULL at the end of the buffer, or when the word runs
+ * up to it and may go on in the next read
+ */
+static char *cursor_word(struct buf_cursor *bc)
+{
+    char *word;
 
-                strcpy(pmptstr, cmd_entry->arg1);
-                strcat(pmptstr, ": ");
+    while (bc->pos < bc->len && isspace((unsigned char)bc->buf[bc->pos]))
+    {
+        bc->pos++;
+    }
 
-                rp_getline(pmptstr);
+    if (bc->pos == bc->len)
+    {
+        return NULL;
+    }
 
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    RETURNFUNC(0);
-                }
+    word = bc->buf + bc->pos;
 
-                result = strtok(input_line, " ");
+    while (bc->pos < bc->len && !isspace((unsigned char)bc->buf[bc->pos]))
+    {
+        bc->pos++;
+    }
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    RETURNFUNC(1);
-                }
-            }
+    return bc->pos < bc->len ? word : NULL;
+}
 
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
 
-#ifdef HAVE_READLINE_HISTORY
+/* the word just read is an argument, terminate it when the command runs */
+static char *cursor_keep(struct buf_cursor *bc, char *word)
+{
+    if (word)
+    {
+        size_t n = bc->buf + bc->pos - word;
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
+        cursor_cut(bc, word - bc->buf + (n > MAXARGSZ ? MAXARGSZ : n));
+    }
 
-#endif
-            strcpy(arg1, parsed_input[x]);
-            p1 = arg1;
-        }
+    return word;
+}
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN2)
-                && cmd_entry->arg2)
-        {
 
-            result = strtok(NULL, " ");
+/* like fgets() of MAXARGSZ and chomp, NULL until the line is all there */
+static char *cursor_line(struct buf_cursor *bc)
+{
+    char *line = bc->buf + bc->pos;
+    size_t n = bc->len - bc->pos;
+    char *nl;
 
-            if (*vfo_opt && result)
-            {
-                x = 3;
-                parsed_input[x] = result;
-            }
-            else if (result)
-            {
-                x = 2;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg2) + 3)];
-                x = 0;
+    if (n == 0)
+    {
+        return NULL;
+    }
 
-                strcpy(pmptstr, cmd_entry->arg2);
-                strcat(pmptstr, ": ");
+    if (n > MAXARGSZ - 1)
+    {
+        n = MAXARGSZ - 1;
+    }
 
-                rp_getline(pmptstr);
+    nl = memchr(line, '\n', n);
 
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    RETURNFUNC(0);
-                }
+    if (!nl && n < MAXARGSZ - 1)
+    {
+        return NULL;
+    }
 
-                result = strtok(input_line, " ");
+    n = nl ? nl - line + 1 : n;
+    bc->pos += n;
+    cursor_cut(bc, nl ? (size_t)(nl - bc->buf) : bc->pos);
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    RETURNFUNC(1);
-                }
-            }
+    return line;
+}
 
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
 
-#ifdef HAVE_READLINE_HISTORY
+/*
+ * rigctld flavour of rigctl_parse(): reads the next command straight out
+ * of buf[0..len), which must have room for one more byte, and runs it.
+ * Same syntax as rigctl_parse() with a FILE, but the words are not copied
+ * and no stdio is involved on the way in.
+ *
+ * Returns the number of bytes used and stores rigctl_parse()'s return
+ * value in *retcode, or returns 0 with *retcode = -1 when buf does not
+ * hold a whole command yet.
+ */
+size_t rigctl_parse_buf(RIG *my_rig, char *buf, size_t len, FILE *fout,
+                        int *vfo_opt, char send_cmd_term, int *ext_resp_ptr,
+                        char *resp_sep_ptr, struct rigctl_client_state *cs,
+                        int *retcode)
+{
+    struct buf_cursor bc;
+    const struct test_table *cmd_entry;
+    char *p1 = NULL, *p2 = NULL, *p3 = NULL;
+    vfo_t vfo = RIG_VFO_CURR;
+    FILE *fin = NULL;
+    int cmd;
 
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
+    bc.buf = buf;
+    bc.len = len;
+    bc.pos = 0;
+    bc.ncut = 0;
 
-#endif
-            strcpy(arg2, parsed_input[x]);
-            p2 = arg2;
-        }
+    *retcode = -1;
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN3)
-                && cmd_entry->arg3)
+    do
+    {
+        if ((cmd = cursor_getc(&bc)) < 0)
         {
+            return 0;
+        }
 
-            result = strtok(NULL, " ");
+        /* Extended Response and its separator, as in rigctl_parse() */
+        if (cmd == '+')
+        {
+            *ext_resp_ptr = 1;
 
-            if (*vfo_opt && result)
-            {
-                x = 4;
-                parsed_input[x] = result;
-            }
-            else if (result)
+            if ((cmd = cursor_getc(&bc)) < 0)
             {
-                x = 3;
-                parsed_input[x] = result;
+                return 0;
             }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg3) + 3)];
-                x = 0;
-
-                strcpy(pmptstr, cmd_entry->arg3);
-                strcat(pmptstr, ": ");
+        }
 
-                rp_getline(pmptstr);
+        if (cmd != '\\' && cmd != '_' && cmd != '#' && cmd != '(' && cmd != ')'
+                && ispunct(cmd))
+        {
+            *ext_resp_ptr = 1;
+            *resp_sep_ptr = cmd;
 
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    RETURNFUNC(0);
-                }
+            if ((cmd = cursor_getc(&bc)) < 0)
+            {
+                return 0;
+            }
+        }
 
-                result = strtok(input_line, " ");
+        /* command by name */
+        if (cmd == '\\')
+        {
+            char *name = buf + bc.pos;
+            char *word;
+            char saved;
+            int c;
 
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    RETURNFUNC(1);
-                }
+            if ((c = cursor_getc(&bc)) < 0 || !(word = cursor_word(&bc)))
+            {
+                return 0;
             }
 
-            if (strlen(parsed_input[x]) > MAXARGSZ)
+            /* the first character is taken as is, blank or not */
+            if (word != name + 1)
             {
-                parsed_input[x][MAXARGSZ] = '\0';
+                char cmd_name[MAXNAMSIZ];
+
+                cmd_name[0] = c;
+                strncpy(cmd_name + 1, word, MAXNAMSIZ - 2);
+                cmd_name[MAXNAMSIZ - 1] = '\0';
+                cmd_name[1 + strcspn(cmd_name + 1, " \t\n\r\f\v")] = '\0';
+                cmd = (unsigned char)parse_arg(cmd_name);
+                break;
             }
 
-#ifdef HAVE_READLINE_HISTORY
+            saved = buf[bc.pos];
+            buf[bc.pos] = '\0';
+            cmd = (unsigned char)parse_arg(name);
+            buf[bc.pos] = saved;
+            break;
+        }
 
-            if (rp_hist_buf)
+        if (cmd == '\n' || cmd == '\r')
+        {
+            if (!cs->in_line)
             {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
+                *retcode = 0;
+                return bc.pos;
             }
 
-#endif
-            strcpy(arg3, parsed_input[x]);
-            p3 = arg3;
+            cs->in_line = 0;
         }
+    }
+    while (cmd == '\n' || cmd == '\r');
 
-#ifdef HAVE_READLINE_HISTORY
+    cs->in_line = 1;
 
-        if (rp_hist_buf)
+    /* comment line */
+    if (cmd == '#')
+    {
+        do
         {
-            add_history(rp_hist_buf);
-            free(rp_hist_buf);
-            rp_hist_buf = (char *)NULL;
+            if ((cmd = cursor_getc(&bc)) < 0)
+            {
+                return 0;
+            }
         }
+        while (cmd != '\n' && cmd != '\r');
 
-#endif
+        *retcode = 0;
+        return bc.pos;
     }
 
-#endif // HAVE_LIBREADLINE
-
-    if (sync_cb) { sync_cb(1); }    /* lock if necessary */
-
-    if (!prompt)
-    {
-        rig_debug(RIG_DEBUG_TRACE,
-                  "rigctl(d): %c '%s' '%s' '%s' '%s'\n",
-                  cmd,
-                  rig_strvfo(vfo),
-                  p1 ? p1 : "",
-                  p2 ? p2 : "",
-                  p3 ? p3 : "");
-    }
-
-    /*
-     * Extended Response protocol: output received command name and arguments
-     * response.  Don't send command header on '\chk_vfo' command.
-     */
-    if (interactive && *ext_resp_ptr && !prompt && cmd != 0xf0)
-    {
-        char a1[MAXARGSZ + 2];
-        char a2[MAXARGSZ + 2];
-        char a3[MAXARGSZ + 2];
-        char vfo_str[MAXARGSZ + 2];
-
-        *vfo_opt == 0 ? vfo_str[0] = '\0' : snprintf(vfo_str,
-                                     sizeof(vfo_str),
-                                     " %s",
-                                     rig_strvfo(vfo));
+    my_rig->state.vfo_opt = *vfo_opt;
 
-        p1 == NULL ? a1[0] = '\0' : snprintf(a1, sizeof(a1), " %s", p1);
-        p2 == NULL ? a2[0] = '\0' : snprintf(a2, sizeof(a2), " %s", p2);
-        p3 == NULL ? a3[0] = '\0' : snprintf(a3, sizeof(a3), " %s", p3);
+    if (cmd == 'Q' || cmd == 'q')
+    {
+        fprintf(fout, "%s0\n", NETRIGCTL_RET);
+        *retcode = 1;
+        return bc.pos;
+    }
 
-        fprintf(fout,
-                "%s:%s%s%s%s%c",
-                cmd_entry->name,
-                vfo_str,
-                a1,
-                a2,
-                a3,
-                *resp_sep_ptr);
+    if (cmd == '?')
+    {
+        usage_rig(fout);
+        *retcode = 0;
+        return bc.pos;
     }
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
-    retcode = (*cmd_entry->rig_routine)(my_rig,
-                                        fout,
-                                        fin,
-                                        interactive,
-                                        prompt,
-                                        vfo_opt,
-                                        send_cmd_term,
-                                        *ext_resp_ptr,
-                                        *resp_sep_ptr,
-                                        cmd_entry,
-                                        vfo,
-                                        p1,
-                                        p2 ? p2 : "",
-                                        p3 ? p3 : "");
+    cmd_entry = find_cmd_entry(cmd);
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: vfo_opt=%d\n", __func__, *vfo_opt);
+    if (!cmd_entry)
+    {
+        if (cmd != ' ')
+        {
+            fprintf(stderr, "Command '%c' not found!\n", cmd);
+        }
 
-    if (retcode == RIG_EIO)
+        *retcode = 0;
+        return bc.pos;
+    }
+
+    if (!(cmd_entry->flags & ARG_NOVFO) && *vfo_opt)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: RIG_EIO?\n", __func__);
+        char *arg;
+        char saved;
 
-        if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
+        if (cursor_getc(&bc) < 0 || !(arg = cursor_word(&bc)))
+        {
+            return 0;
+        }
 
-        RETURNFUNC(retcode);
+        saved = buf[bc.pos];
+        buf[bc.pos] = '\0';
+        vfo = rig_parse_vfo(arg);
+        buf[bc.pos] = saved;
     }
 
-    if (retcode != RIG_OK)
+    if ((cmd_entry->flags & ARG_IN_LINE)
+            && (cmd_entry->flags & ARG_IN1)
+            && cmd_entry->arg1)
     {
-        /* only for rigctld */
-        if (interactive && !prompt)
+        p1 = cursor_line(&bc);
+
+        /* an empty line, the text is on the next one */
+        if (p1 && *p1 == '\n')
         {
-            rig_debug(RIG_DEBUG_TRACE, "%s: return#1 "NETRIGCTL_RET "%d\n", __func__,
-                      retcode);
-            fprintf(fout, NETRIGCTL_RET "%d\n", retcode);
-            *ext_resp_ptr = 0;
-            *resp_sep_ptr = '\n';
+            bc.ncut--;
+            p1 = cursor_line(&bc);
         }
-        else
+
+        if (!p1)
+        {
+            return 0;
+        }
+
+        if (cmd != 'b' && p1[0] == ' ')
         {
-            fprintf(fout,
-                    "%s: error = %s\n",
-                    cmd_entry->name,
-                    rigerror(retcode));
+            p1++;
         }
     }
-    else
+    else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
     {
-        /* only for rigctld */
-        if (interactive && !prompt)
+        if (cursor_getc(&bc) < 0 || !(p1 = cursor_keep(&bc, cursor_word(&bc))))
         {
-            /* netrigctl RIG_OK */
-            if (!(cmd_entry->flags & ARG_OUT)
-                    && !*ext_resp_ptr && cmd != 0xf0)
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: return#2 "NETRIGCTL_RET "0\n", __func__);
-                fprintf(fout, NETRIGCTL_RET "0\n");
-            }
+            return 0;
+        }
+    }
 
-            /* Extended Response protocol */
-            else if (*ext_resp_ptr && cmd != 0xf0)
-            {
-                rig_debug(RIG_DEBUG_TRACE, "%s: return#3 "NETRIGCTL_RET "0\n", __func__);
-                fprintf(fout, NETRIGCTL_RET "0\n");
-                *ext_resp_ptr = 0;
-                *resp_sep_ptr = '\n';
-            }
+    if (p1 && p1[0] != '?' && (cmd_entry->flags & ARG_IN2) && cmd_entry->arg2)
+    {
+        if (!(p2 = cursor_keep(&bc, cursor_word(&bc))))
+        {
+            return 0;
         }
     }
 
-    fflush(fout);
+    if (p1 && p1[0] != '?' && (cmd_entry->flags & ARG_IN3) && cmd_entry->arg3)
+    {
+        if (!(p3 = cursor_keep(&bc, cursor_word(&bc))))
+        {
+            return 0;
+        }
+    }
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: retcode=%d\n", __func__, retcode);
+    cursor_apply(&bc);
 
-    if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
+    /* set_channel reads its fields as it goes */
+    if (cmd_entry->rig_routine == ACTION(set_channel))
+    {
+        size_t off = bc.pos;
 
-    if (retcode == -RIG_ENAVAIL)
+        if (bc.ncut && bc.cut[bc.ncut - 1].off == off && off < len)
+        {
+            off++;
+        }
+
+        fin = fmemopen(buf + off, len - off, "r");
+
+        if (!fin)
+        {
+            cursor_restore(&bc);
+            *retcode = -RIG_ENOMEM;
+            return len;
+        }
+
+        bc.pos = off;
+    }
+
+    *retcode = rigctl_run(my_rig, fin, fout, NULL, 1, 0, vfo_opt,
+                          send_cmd_term, ext_resp_ptr, resp_sep_ptr, cs, cmd,
+                          cmd_entry, vfo, p1, p2, p3);
+
+    if (fin)
     {
-        RETURNFUNC(retcode);
+        long used = ftell(fin);
+
+        bc.pos += used > 0 ? used : 0;
+        fclose(fin);
     }
 
-    RETURNFUNC(retcode != RIG_OK ? 2 : 0);
+    cursor_restore(&bc);
+
+    return bc.pos;
 }
 
 
@@ -2253,7 +1891,7 @@ declare_proto_rig(get_vfo_info)
 /* '\get_vfo_list' */
 declare_proto_rig(get_vfo_list)
 {
-    static char prntbuf[256];
+    char prntbuf[256];
 
     ENTERFUNC;
 
@@ -3574,7 +3212,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "Bank Num: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.bank_num));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.bank_num));
     }
 
 #if 0
@@ -3586,7 +3224,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "vfo (VFOA,MEM,etc...): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%s", s));
+        CHKSCN1ARG(cmd_scanfc(fin, "%s", s));
         chan.vfo = rig_parse_vfo(s);
     }
 
@@ -3599,7 +3237,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "ant: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.ant));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.ant));
     }
 
     if (mem_caps->freq)
@@ -3609,7 +3247,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "Frequency: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%"SCNfreq, &chan.freq));
+        CHKSCN1ARG(cmd_scanfc(fin, "%"SCNfreq, &chan.freq));
     }
 
     if (mem_caps->mode)
@@ -3619,7 +3257,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "mode (FM,LSB,etc...): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%s", s));
+        CHKSCN1ARG(cmd_scanfc(fin, "%s", s));
         chan.mode = rig_parse_mode(s);
     }
 
@@ -3630,7 +3268,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "width: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%ld", &chan.width));
+        CHKSCN1ARG(cmd_scanfc(fin, "%ld", &chan.width));
     }
 
     if (mem_caps->tx_freq)
@@ -3640,7 +3278,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "tx freq: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%"SCNfreq, &chan.tx_freq));
+        CHKSCN1ARG(cmd_scanfc(fin, "%"SCNfreq, &chan.tx_freq));
     }
 
     if (mem_caps->tx_mode)
@@ -3650,7 +3288,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "tx mode (FM,LSB,etc...): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%s", s));
+        CHKSCN1ARG(cmd_scanfc(fin, "%s", s));
         chan.tx_mode = rig_parse_mode(s);
     }
 
@@ -3661,7 +3299,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "tx width: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%ld", &chan.tx_width));
+        CHKSCN1ARG(cmd_scanfc(fin, "%ld", &chan.tx_width));
     }
 
     if (mem_caps->split)
@@ -3671,7 +3309,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "split (0,1): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &status));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &status));
         chan.split = status;
     }
 
@@ -3682,7 +3320,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "tx vfo (VFOA,MEM,etc...): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%s", s));
+        CHKSCN1ARG(cmd_scanfc(fin, "%s", s));
         chan.tx_vfo = rig_parse_vfo(s);
     }
 
@@ -3693,7 +3331,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "rptr shift (+-0): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%s", s));
+        CHKSCN1ARG(cmd_scanfc(fin, "%s", s));
         chan.rptr_shift = rig_parse_rptr_shift(s);
     }
 
@@ -3704,7 +3342,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "rptr offset: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%ld", &chan.rptr_offs));
+        CHKSCN1ARG(cmd_scanfc(fin, "%ld", &chan.rptr_offs));
     }
 
     if (mem_caps->tuning_step)
@@ -3714,7 +3352,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "tuning step: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%ld", &chan.tuning_step));
+        CHKSCN1ARG(cmd_scanfc(fin, "%ld", &chan.tuning_step));
     }
 
     if (mem_caps->rit)
@@ -3724,7 +3362,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "rit (Hz,0=off): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%ld", &chan.rit));
+        CHKSCN1ARG(cmd_scanfc(fin, "%ld", &chan.rit));
     }
 
     if (mem_caps->xit)
@@ -3734,7 +3372,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "xit (Hz,0=off): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%ld", &chan.xit));
+        CHKSCN1ARG(cmd_scanfc(fin, "%ld", &chan.xit));
     }
 
     if (mem_caps->funcs)
@@ -3744,7 +3382,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "funcs: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%lx", &chan.funcs));
+        CHKSCN1ARG(cmd_scanfc(fin, "%lx", &chan.funcs));
     }
 
 #if 0
@@ -3764,7 +3402,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "ctcss tone freq in tenth of Hz (0=off): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.ctcss_tone));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.ctcss_tone));
     }
 
     if (mem_caps->ctcss_sql)
@@ -3774,7 +3412,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "ctcss sql freq in tenth of Hz (0=off): ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.ctcss_sql));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.ctcss_sql));
     }
 
     if (mem_caps->dcs_code)
@@ -3784,7 +3422,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "dcs code: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.dcs_code));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.dcs_code));
     }
 
     if (mem_caps->dcs_sql)
@@ -3794,7 +3432,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "dcs sql: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.dcs_sql));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.dcs_sql));
     }
 
     if (mem_caps->scan_group)
@@ -3804,7 +3442,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "scan group: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.scan_group));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.scan_group));
     }
 
     if (mem_caps->flags)
@@ -3814,7 +3452,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "flags: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%d", &chan.flags));
+        CHKSCN1ARG(cmd_scanfc(fin, "%d", &chan.flags));
     }
 
     if (mem_caps->channel_desc)
@@ -3824,7 +3462,7 @@ declare_proto_rig(set_channel)
             fprintf_flush(fout, "channel desc: ");
         }
 
-        CHKSCN1ARG(scanfc(fin, "%s", s));
+        CHKSCN1ARG(cmd_scanfc(fin, "%s", s));
         strcpy(chan.channel_desc, s);
     }
 
@@ -4203,14 +3841,15 @@ declare_proto_rig(dump_caps)
 }
 
 
-/* For rigctld internal use */
-declare_proto_rig(dump_state)
+/*
+ * Writes the dump_state text, with the protocol 1 "setting=value"
+ * fields when proto1 is set
+ */
+static void dump_state_text(RIG *rig, FILE *fout, int proto1)
 {
     int i;
     struct rig_state *rs = &rig->state;
 
-    ENTERFUNC;
-
     /*
      * - Protocol version
      */
@@ -4307,7 +3946,7 @@ declare_proto_rig(dump_state)
     // protocol 1 allows fields can be listed/processed in any order
     // protocol 1 fields can be multi-line -- just write the thing to allow for it
     // backward compatible as new values will just generate warnings
-    if (chk_vfo_executed) // for 3.3 compatiblility
+    if (proto1)
     {
         fprintf(fout, "vfo_ops=0x%x\n", rig->caps->vfo_ops);
         fprintf(fout, "ptt_type=0x%x\n", rig->state.pttport.type.ptt);
@@ -4323,8 +3962,81 @@ declare_proto_rig(dump_state)
     gran_t level_gran[RIG_SETTING_MAX];   /*!< level granularity */
     gran_t parm_gran[RIG_SETTING_MAX];  /*!< parm granularity */
 #endif
+}
+
+
+/* For rigctld internal use */
+declare_proto_rig(dump_state)
+{
+    ENTERFUNC;
+
+    dump_state_text(rig, fout, cs->chk_vfo_executed); // for 3.3 compatiblility
+
+    RETURNFUNC(RIG_OK);
+}
+
+
+/*
+ * '0x9e' -- dump_state in one reply for netrigctl: a header line
+ * "DUMP_STATE2 <hash> <length>" followed by length bytes of protocol 1
+ * dump_state text.  The argument is '#' and the hash the client already
+ * holds; when it matches the body is left out and length is 0.  The '#'
+ * makes servers without this command skip the argument as a comment.
+ */
+declare_proto_rig(dump_state2)
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+    char *body = NULL;
+    size_t body_len = 0;
+    unsigned long long hash = 0xcbf29ce484222325ULL;   /* FNV-1a */
+    char hash_str[17];
+    const char *known;
+    FILE *fp;
+    size_t i;
+
+    ENTERFUNC;
+
+    fp = open_memstream(&body, &body_len);
+
+    if (!fp)
+    {
+        RETURNFUNC(-RIG_ENOMEM);
+    }
+
+    dump_state_text(rig, fp, 1);
+    fclose(fp);
+
+    for (i = 0; i < body_len; i++)
+    {
+        hash ^= (unsigned char)body[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    snprintf(hash_str, sizeof(hash_str), "%016llx", hash);
+
+    known = arg1[0] == '#' ? arg1 + 1 : arg1;
+
+    if (!strcmp(known, hash_str))
+    {
+        fprintf(fout, "DUMP_STATE2 %s 0\n", hash_str);
+    }
+    else
+    {
+        fprintf(fout, "DUMP_STATE2 %s %lu\n", hash_str, (unsigned long)body_len);
+        fwrite(body, 1, body_len, fout);
+    }
+
+    free(body);
+
+    /* same as chk_vfo, the client speaks protocol 1 */
+    cs->chk_vfo_executed = 1;
 
     RETURNFUNC(RIG_OK);
+#else
+    ENTERFUNC;
+
+    RETURNFUNC(-RIG_ENIMPL);
+#endif
 }
 
 
@@ -4791,7 +4503,7 @@ declare_proto_rig(chk_vfo)
 
     fprintf(fout, "%d\n", rig->state.vfo_opt);
 
-    chk_vfo_executed = 1; // this allows us to control dump_state version
+    cs->chk_vfo_executed = 1; // this allows us to control dump_state version
 
     RETURNFUNC(RIG_OK);
 }
@@ -4913,3 +4625,242 @@ declare_proto_rig(get_cache)
 
     RETURNFUNC(RIG_OK);
 }
+
+
+/* '0x98' */
+declare_proto_rig(dump_wirecap)
+{
+    ENTERFUNC;
+
+    if (!dump_wirecap_cb)
+    {
+        RETURNFUNC(-RIG_ENAVAIL);
+    }
+
+    RETURNFUNC(dump_wirecap_cb(rig, arg1));
+}
+
+
+/*
+ * Set by the program to allow dump_wirecap, the file name comes from
+ * whoever sends the command
+ */
+void rigctl_set_dump_wirecap_cb(dump_wirecap_cb_t cb)
+{
+    dump_wirecap_cb = cb;
+}
+
+
+/* '0x99' */
+declare_proto_rig(get_port_stats)
+{
+    rig_port_stats_t stats;
+    int status;
+
+    ENTERFUNC;
+
+    status = rig_get_port_stats(rig, &stats);
+
+    if (status != RIG_OK)
+    {
+        RETURNFUNC(status);
+    }
+
+    fprintf(fout, "Writes: %lu\n", stats.writes);
+    fprintf(fout, "Reads: %lu\n", stats.reads);
+    fprintf(fout, "Timeouts: %lu\n", stats.timeouts);
+    fprintf(fout, "Retries: %lu\n", stats.retries);
+    fprintf(fout, "First byte us p50/p90/p99/max: %lu %lu %lu %lu\n",
+            rig_port_stats_percentile(stats.first_byte_us, 50),
+            rig_port_stats_percentile(stats.first_byte_us, 90),
+            rig_port_stats_percentile(stats.first_byte_us, 99),
+            stats.first_byte_max_us);
+    fprintf(fout, "Complete us p50/p90/p99/max: %lu %lu %lu %lu\n",
+            rig_port_stats_percentile(stats.complete_us, 50),
+            rig_port_stats_percentile(stats.complete_us, 90),
+            rig_port_stats_percentile(stats.complete_us, 99),
+            stats.complete_max_us);
+
+    RETURNFUNC(RIG_OK);
+}
+
+
+/* '0x9a' */
+declare_proto_rig(get_queue_stats)
+{
+    ENTERFUNC;
+
+    if (!queue_stats_cb)
+    {
+        RETURNFUNC(-RIG_ENAVAIL);
+    }
+
+    RETURNFUNC(queue_stats_cb(fout));
+}
+
+
+/*
+ * Set by a server that queues commands, answers get_queue_stats
+ */
+void rigctl_set_queue_stats_cb(queue_stats_cb_t cb)
+{
+    queue_stats_cb = cb;
+}
+
+
+/*
+ * '0x9b'
+ * Items are space separated, each optionally followed by ":ms", the
+ * minimum time between two notifications.  "none" subscribes to nothing.
+ */
+declare_proto_rig(subscribe)
+{
+    int min_ms[RIGCTL_SUB_ITEMS];
+    const char *p = arg1;
+    int i;
+
+    ENTERFUNC;
+
+    if (!subscribe_cb)
+    {
+        RETURNFUNC(-RIG_ENAVAIL);
+    }
+
+    for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+    {
+        min_ms[i] = -1;
+    }
+
+    for (;;)
+    {
+        char item[MAXNAMSIZ];
+        size_t n;
+        int ms = 0;
+
+        p += strspn(p, " \t");
+        n = strcspn(p, " \t:");
+
+        if (n == 0)
+        {
+            break;
+        }
+
+        if (n >= sizeof(item))
+        {
+            RETURNFUNC(-RIG_EINVAL);
+        }
+
+        memcpy(item, p, n);
+        item[n] = '\0';
+        p += n;
+
+        if (*p == ':')
+        {
+            p++;
+            n = strcspn(p, " \t");
+
+            if (sscanf(p, "%d", &ms) != 1 || ms < 0)
+            {
+                RETURNFUNC(-RIG_EINVAL);
+            }
+
+            p += n;
+        }
+
+        if (!strcmp(item, "none"))
+        {
+            continue;
+        }
+
+        for (i = 0; i < RIGCTL_SUB_ITEMS && strcmp(item, subscribe_items[i]); i++);
+
+        if (i == RIGCTL_SUB_ITEMS)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: unknown item '%s'\n", __func__, item);
+            RETURNFUNC(-RIG_EINVAL);
+        }
+
+        min_ms[i] = ms;
+    }
+
+    RETURNFUNC(subscribe_cb(min_ms));
+}
+
+
+/*
+ * Set by a server that can push notifications, answers subscribe
+ */
+void rigctl_set_subscribe_cb(subscribe_cb_t cb)
+{
+    subscribe_cb = cb;
+}
+
+
+/* '0x9c' */
+declare_proto_rig(get_snapshot)
+{
+    rig_snapshot_t snap;
+    char value[7][64];
+    const char *label[7] =
+    {
+        cmd->arg1, cmd->arg2, cmd->arg3, cmd->arg4, "PTT", "Split", "TX VFO"
+    };
+    int status;
+    int i;
+
+    ENTERFUNC;
+
+    status = rig_get_state_snapshot(rig, &snap);
+
+    if (status != RIG_OK)
+    {
+        RETURNFUNC(status);
+    }
+
+    snprintf(value[0], sizeof(value[0]), "%s", rig_strvfo(snap.vfo));
+    snprintf(value[1], sizeof(value[1]), "%"PRIll, (int64_t)snap.freq);
+    snprintf(value[2], sizeof(value[2]), "%s", rig_strrmode(snap.mode));
+    snprintf(value[3], sizeof(value[3]), "%ld", snap.width);
+    snprintf(value[4], sizeof(value[4]), "%d", snap.ptt);
+    snprintf(value[5], sizeof(value[5]), "%d", snap.split);
+    snprintf(value[6], sizeof(value[6]), "%s", rig_strvfo(snap.tx_vfo));
+
+    for (i = 0; i < 7; i++)
+    {
+        if ((interactive && prompt) || (interactive && !prompt && ext_resp))
+        {
+            fprintf(fout, "%s: ", label[i]);
+        }
+
+        fprintf(fout, "%s%c", value[i], resp_sep);
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
+
+/* '0x9d' */
+declare_proto_rig(select_rig)
+{
+    int rig_num;
+
+    ENTERFUNC;
+
+    if (!select_rig_cb)
+    {
+        RETURNFUNC(-RIG_ENAVAIL);
+    }
+
+    CHKSCN1ARG(sscanf(arg1, "%d", &rig_num));
+
+    RETURNFUNC(select_rig_cb(rig_num));
+}
+
+
+/*
+ * Set by a server driving several rigs, answers select_rig
+ */
+void rigctl_set_select_rig_cb(select_rig_cb_t cb)
+{
+    select_rig_cb = cb;
+}
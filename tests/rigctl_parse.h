@@ -46,8 +46,51 @@ int print_conf_list(const struct confparams *cfp, rig_ptr_t data);
 int set_conf(RIG *my_rig, char *conf_parms);
 
 typedef void (*sync_cb_t)(int);
+typedef int (*queue_stats_cb_t)(FILE *);
+void rigctl_set_queue_stats_cb(queue_stats_cb_t cb);
+
+/* items of the subscribe command */
+enum rigctl_sub_item_e
+{
+    RIGCTL_SUB_FREQ,
+    RIGCTL_SUB_MODE,
+    RIGCTL_SUB_VFO,
+    RIGCTL_SUB_PTT,
+    RIGCTL_SUB_SPLIT,
+    RIGCTL_SUB_ITEMS
+};
+
+/* min_ms[item] is the minimum notification interval, -1 if not wanted */
+typedef int (*subscribe_cb_t)(const int *min_ms);
+void rigctl_set_subscribe_cb(subscribe_cb_t cb);
+
+/* rig_num counts from 1 in the order the rigs were given */
+typedef int (*select_rig_cb_t)(int rig_num);
+void rigctl_set_select_rig_cb(select_rig_cb_t cb);
+
+/* saves the capture of rig to file, see rig_wirecap_dump() */
+typedef int (*dump_wirecap_cb_t)(RIG *rig, const char *file);
+void rigctl_set_dump_wirecap_cb(dump_wirecap_cb_t cb);
+
+/*
+ * What the parser keeps between the commands of one client, one per
+ * connection so clients served by different threads don't share it.
+ * Start zeroed.
+ */
+struct rigctl_client_state
+{
+    int in_line;            /* the current line has a command, see '\n' */
+    int chk_vfo_executed;   /* sent chk_vfo, gets the newer dump_state */
+};
+
 int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc, sync_cb_t sync_cb,
                  int interactive, int prompt, int * vfo_mode, char send_cmd_term,
-                 int * ext_resp_ptr, char * resp_sep_ptr);
+                 int * ext_resp_ptr, char * resp_sep_ptr,
+                 struct rigctl_client_state *cs);
+void rigctl_print_metrics(FILE *fout, const char *prefix);
+size_t rigctl_parse_buf(RIG *my_rig, char *buf, size_t len, FILE *fout,
+                        int *vfo_opt, char send_cmd_term, int *ext_resp_ptr,
+                        char *resp_sep_ptr, struct rigctl_client_state *cs,
+                        int *retcode);
 
 #endif  /* RIGCTL_PARSE_H */
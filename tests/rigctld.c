@@ -39,6 +39,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <signal.h>
+#include <limits.h>
 
 #include <getopt.h>
 
@@ -62,6 +63,10 @@
 #  endif
 #endif
 
+#ifdef HAVE_POLL_H
+#  include <poll.h>
+#endif
+
 #ifdef HAVE_NETDB_H
 #  include <netdb.h>
 #endif
@@ -70,6 +75,14 @@
 #  include <pthread.h>
 #endif
 
+#ifdef HAVE_FCNTL_H
+#  include <fcntl.h>
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#  include <sys/epoll.h>
+#endif
+
 #include <hamlib/rig.h>
 #include <hamlibdatetime.h>
 #include "misc.h"
@@ -78,6 +91,7 @@
 #include "sprintflst.h"
 
 #include "rigctl_parse.h"
+#include "metrics.h"
 
 
 /*
@@ -85,7 +99,7 @@
  *      keep up to date SHORT_OPTIONS, usage()'s output and man page. thanks.
  * TODO: add an option to read from a file
  */
-#define SHORT_OPTIONS "m:r:p:d:P:D:s:c:T:t:C:W:x:z:lLuovhVZ"
+#define SHORT_OPTIONS "m:r:p:d:P:D:s:c:T:t:C:W:x:z:M:w:lLuovhVZ"
 static struct option long_options[] =
 {
     {"model",           1, 0, 'm'},
@@ -109,10 +123,24 @@ static struct option long_options[] =
     {"twiddle_timeout", 1, 0, 'W'},
     {"uplink",          1, 0, 'x'},
     {"debug-time-stamps", 0, 0, 'Z'},
+    {"metrics-port",    1, 0, 'M'},
+    {"wirecap-dir",     1, 0, 'w'},
     {0, 0, 0, 0}
 };
 
 
+/*
+ * Where the platform has them, all client sockets are served from one
+ * epoll (or poll) loop and the rig is driven by a worker thread fed from
+ * a queue, see serve_clients().  Otherwise every client gets its own
+ * thread running handle_socket().
+ */
+#if defined(HAVE_PTHREAD) && defined(HAVE_POLL_H) \
+    && defined(HAVE_FMEMOPEN) && defined(HAVE_OPEN_MEMSTREAM)
+#  define RIGCTLD_EVENT_LOOP 1
+#endif
+
+
 struct handle_data
 {
     RIG *rig;
@@ -126,8 +154,18 @@ struct handle_data
 void *handle_socket(void *arg);
 void usage(void);
 
+struct rig_def;
 
-#ifdef HAVE_PTHREAD
+static int listen_socket(const char *port);
+
+static void print_metrics(FILE *fout);
+
+#ifdef RIGCTLD_EVENT_LOOP
+static int serve_clients(struct rig_def *defs, int nrigs, int vfo_mode);
+#endif
+
+
+#if defined(HAVE_PTHREAD) && !defined(RIGCTLD_EVENT_LOOP)
 static unsigned client_count;
 #endif
 
@@ -142,8 +180,32 @@ static int volatile ctrl_c;
 
 const char *portno = "4532";
 const char *src_addr = NULL; /* INADDR_ANY */
+const char *metrics_port = NULL;    /* no metrics listener */
+const char *wirecap_dir = NULL;     /* dump_wirecap refused */
 
 #define MAXCONFLEN 1024
+#define RIGCTLD_MAX_RIGS 16
+
+/* a -m/--model option and the rig options given along with it */
+struct rig_def
+{
+    rig_model_t model;
+    int model_set;
+    const char *rig_file, *ptt_file, *dcd_file;
+    ptt_type_t ptt_type;
+    dcd_type_t dcd_type;
+    int serial_rate;
+    char *civaddr;          /* NULL means no need to set conf */
+    char conf_parms[MAXCONFLEN];
+    const char *portno;     /* own listening port, NULL if none */
+    int sock_listen;
+    RIG *rig;
+    unsigned long clients;  /* connected now, for the metrics */
+    unsigned long reopens;
+};
+
+static struct rig_def *rig_list;    /* main()'s, for print_metrics() */
+static int rig_count;
 
 static void sync_callback(int lock)
 {
@@ -229,38 +291,61 @@ static void handle_error(enum rig_debug_level_e lvl, const char *msg)
 }
 
 
+/*
+ * dump_wirecap from a client: a plain file name, saved in the directory
+ * given with --wirecap-dir and nowhere else
+ */
+static int dump_wirecap(RIG *rig, const char *file)
+{
+    char path[HAMLIB_FILPATHLEN];
+
+    if (!file[0] || file[0] == '.' || strchr(file, '/') || strchr(file, '\\'))
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: refusing '%s'\n", __func__, file);
+        return -RIG_EINVAL;
+    }
+
+    if (snprintf(path, sizeof(path), "%s/%s", wirecap_dir, file) >= (int)sizeof(path))
+    {
+        return -RIG_EINVAL;
+    }
+
+    return rig_wirecap_dump(rig, path);
+}
+
+
 int main(int argc, char *argv[])
 {
-    rig_model_t my_model = RIG_MODEL_DUMMY;
+    struct rig_def rig_defs[RIGCTLD_MAX_RIGS];
+    struct rig_def *def = rig_defs;
+    int nrigs = 1;
 
     int retcode;        /* generic return code from functions */
 
     int show_conf = 0;
     int dump_caps_opt = 0;
-    const char *rig_file = NULL, *ptt_file = NULL, *dcd_file = NULL;
-    ptt_type_t ptt_type = RIG_PTT_NONE;
-    dcd_type_t dcd_type = RIG_DCD_NONE;
-    int serial_rate = 0;
-    char *civaddr = NULL;   /* NULL means no need to set conf */
-    char conf_parms[MAXCONFLEN] = "";
-
-    struct addrinfo hints, *result, *saved_result;
-    int sock_listen;
-    int reuseaddr = 1;
     int twiddle_timeout = 0;
     int uplink = 0;
-    char host[NI_MAXHOST];
-    char serv[NI_MAXSERV];
 #if HAVE_SIGACTION
     struct sigaction act;
 #endif
 
+#ifndef RIGCTLD_EVENT_LOOP
+    char host[NI_MAXHOST];
+    char serv[NI_MAXSERV];
 #ifdef HAVE_PTHREAD
     pthread_t thread;
     pthread_attr_t attr;
 #endif
     struct handle_data *arg;
+#endif
     int vfo_mode = 0; /* vfo_mode=0 means target VFO is current VFO */
+    int i;
+
+    memset(rig_defs, 0, sizeof(rig_defs));
+    rig_defs[0].model = RIG_MODEL_DUMMY;
+    rig_defs[0].ptt_type = RIG_PTT_NONE;
+    rig_defs[0].dcd_type = RIG_DCD_NONE;
 
     while (1)
     {
@@ -296,7 +381,23 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            my_model = atoi(optarg);
+            /* every further -m starts the options of another rig */
+            if (def->model_set)
+            {
+                if (nrigs == RIGCTLD_MAX_RIGS)
+                {
+                    fprintf(stderr, "At most %d rigs can be served\n",
+                            RIGCTLD_MAX_RIGS);
+                    exit(1);
+                }
+
+                def = &rig_defs[nrigs++];
+                def->ptt_type = RIG_PTT_NONE;
+                def->dcd_type = RIG_DCD_NONE;
+            }
+
+            def->model = atoi(optarg);
+            def->model_set = 1;
             break;
 
         case 'r':
@@ -306,7 +407,7 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            rig_file = optarg;
+            def->rig_file = optarg;
             break;
 
         case 'p':
@@ -316,7 +417,7 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            ptt_file = optarg;
+            def->ptt_file = optarg;
             break;
 
         case 'd':
@@ -326,7 +427,7 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            dcd_file = optarg;
+            def->dcd_file = optarg;
             break;
 
         case 'P':
@@ -338,40 +439,40 @@ int main(int argc, char *argv[])
 
             if (!strcmp(optarg, "RIG"))
             {
-                ptt_type = RIG_PTT_RIG;
+                def->ptt_type = RIG_PTT_RIG;
             }
             else if (!strcmp(optarg, "DTR"))
             {
-                ptt_type = RIG_PTT_SERIAL_DTR;
+                def->ptt_type = RIG_PTT_SERIAL_DTR;
             }
             else if (!strcmp(optarg, "RTS"))
             {
-                ptt_type = RIG_PTT_SERIAL_RTS;
+                def->ptt_type = RIG_PTT_SERIAL_RTS;
             }
             else if (!strcmp(optarg, "PARALLEL"))
             {
-                ptt_type = RIG_PTT_PARALLEL;
+                def->ptt_type = RIG_PTT_PARALLEL;
             }
             else if (!strcmp(optarg, "CM108"))
             {
-                ptt_type = RIG_PTT_CM108;
+                def->ptt_type = RIG_PTT_CM108;
             }
             else if (!strcmp(optarg, "GPIO"))
             {
-                ptt_type = RIG_PTT_GPIO;
+                def->ptt_type = RIG_PTT_GPIO;
             }
             else if (!strcmp(optarg, "GPION"))
             {
-                ptt_type = RIG_PTT_GPION;
+                def->ptt_type = RIG_PTT_GPION;
             }
             else if (!strcmp(optarg, "NONE"))
             {
-                ptt_type = RIG_PTT_NONE;
+                def->ptt_type = RIG_PTT_NONE;
             }
             else
             {
                 puts("Unrecognised PTT type, using NONE");
-                ptt_type = RIG_PTT_NONE;
+                def->ptt_type = RIG_PTT_NONE;
             }
 
             break;
@@ -385,44 +486,44 @@ int main(int argc, char *argv[])
 
             if (!strcmp(optarg, "RIG"))
             {
-                dcd_type = RIG_DCD_RIG;
+                def->dcd_type = RIG_DCD_RIG;
             }
             else if (!strcmp(optarg, "DSR"))
             {
-                dcd_type = RIG_DCD_SERIAL_DSR;
+                def->dcd_type = RIG_DCD_SERIAL_DSR;
             }
             else if (!strcmp(optarg, "CTS"))
             {
-                dcd_type = RIG_DCD_SERIAL_CTS;
+                def->dcd_type = RIG_DCD_SERIAL_CTS;
             }
             else if (!strcmp(optarg, "CD"))
             {
-                dcd_type = RIG_DCD_SERIAL_CAR;
+                def->dcd_type = RIG_DCD_SERIAL_CAR;
             }
             else if (!strcmp(optarg, "PARALLEL"))
             {
-                dcd_type = RIG_DCD_PARALLEL;
+                def->dcd_type = RIG_DCD_PARALLEL;
             }
             else if (!strcmp(optarg, "CM108"))
             {
-                dcd_type = RIG_DCD_CM108;
+                def->dcd_type = RIG_DCD_CM108;
             }
             else if (!strcmp(optarg, "GPIO"))
             {
-                dcd_type = RIG_DCD_GPIO;
+                def->dcd_type = RIG_DCD_GPIO;
             }
             else if (!strcmp(optarg, "GPION"))
             {
-                dcd_type = RIG_DCD_GPION;
+                def->dcd_type = RIG_DCD_GPION;
             }
             else if (!strcmp(optarg, "NONE"))
             {
-                dcd_type = RIG_DCD_NONE;
+                def->dcd_type = RIG_DCD_NONE;
             }
             else
             {
                 puts("Unrecognised DCD type, using NONE");
-                dcd_type = RIG_DCD_NONE;
+                def->dcd_type = RIG_DCD_NONE;
             }
 
             break;
@@ -434,7 +535,7 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            civaddr = optarg;
+            def->civaddr = optarg;
             break;
 
         case 's':
@@ -444,7 +545,7 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            if (sscanf(optarg, "%d%1s", &serial_rate, dummy) != 1)
+            if (sscanf(optarg, "%d%1s", &def->serial_rate, dummy) != 1)
             {
                 fprintf(stderr, "Invalid baud rate of %s\n", optarg);
                 exit(1);
@@ -459,19 +560,19 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            if (*conf_parms != '\0')
+            if (*def->conf_parms != '\0')
             {
-                strcat(conf_parms, ",");
+                strcat(def->conf_parms, ",");
             }
 
-            if (strlen(conf_parms) + strlen(optarg) > MAXCONFLEN - 24)
+            if (strlen(def->conf_parms) + strlen(optarg) > MAXCONFLEN - 24)
             {
                 printf("Length of conf_parms exceeds internal maximum of %d\n",
                        MAXCONFLEN - 24);
                 return 1;
             }
 
-            strncat(conf_parms, optarg, MAXCONFLEN - strlen(conf_parms));
+            strncat(def->conf_parms, optarg, MAXCONFLEN - strlen(def->conf_parms));
             break;
 
         case 't':
@@ -481,7 +582,7 @@ int main(int argc, char *argv[])
                 exit(1);
             }
 
-            portno = optarg;
+            def->portno = optarg;
             break;
 
         case 'T':
@@ -494,6 +595,26 @@ int main(int argc, char *argv[])
             src_addr = optarg;
             break;
 
+        case 'M':
+            if (!optarg)
+            {
+                usage();    /* wrong arg count */
+                exit(1);
+            }
+
+            metrics_port = optarg;
+            break;
+
+        case 'w':
+            if (!optarg)
+            {
+                usage();    /* wrong arg count */
+                exit(1);
+            }
+
+            wirecap_dir = optarg;
+            break;
+
         case 'o':
             vfo_mode++;
             rig_debug(RIG_DEBUG_ERR, "%s: #0 vfo_mode=%d\n", __func__, vfo_mode);
@@ -548,6 +669,16 @@ int main(int argc, char *argv[])
         }
     }
 
+#ifndef RIGCTLD_EVENT_LOOP
+
+    if (nrigs > 1)
+    {
+        fprintf(stderr, "Serving several rigs is not supported on this platform\n");
+        exit(1);
+    }
+
+#endif
+
     if (!vfo_mode)
     {
         printf("Recommend using --vfo switch for rigctld if client supports it\n");
@@ -561,120 +692,135 @@ int main(int argc, char *argv[])
     rig_debug(RIG_DEBUG_VERBOSE, "%s",
               "Report bugs to <hamlib-developer@lists.sourceforge.net>\n\n");
 
-    my_rig = rig_init(my_model);
-
-    if (!my_rig)
+    for (i = 0; i < nrigs; i++)
     {
-        fprintf(stderr,
-                "Unknown rig num %u, or initialization error.\n",
-                my_model);
+        RIG *rig;
 
-        fprintf(stderr, "Please check with --list option.\n");
-        exit(2);
-    }
+        def = &rig_defs[i];
 
-    retcode = set_conf(my_rig, conf_parms);
+        rig = def->rig = rig_init(def->model);
 
-    if (retcode != RIG_OK)
-    {
-        fprintf(stderr, "Config parameter error: %s\n", rigerror(retcode));
-        exit(2);
-    }
+        if (!rig)
+        {
+            fprintf(stderr,
+                    "Unknown rig num %u, or initialization error.\n",
+                    def->model);
 
-    if (rig_file)
-    {
-        strncpy(my_rig->state.rigport.pathname, rig_file, HAMLIB_FILPATHLEN - 1);
-    }
+            fprintf(stderr, "Please check with --list option.\n");
+            exit(2);
+        }
 
-    my_rig->state.twiddle_timeout = twiddle_timeout;
-    my_rig->state.uplink = uplink;
-    rig_debug(RIG_DEBUG_TRACE, "%s: twiddle=%d, uplink=%d, twiddle_rit=%d\n",
-              __func__,
-              my_rig->state.twiddle_timeout, my_rig->state.uplink, my_rig->state.twiddle_rit);
+        retcode = set_conf(rig, def->conf_parms);
 
-    /*
-     * ex: RIG_PTT_PARALLEL and /dev/parport0
-     */
-    if (ptt_type != RIG_PTT_NONE)
-    {
-        my_rig->state.pttport.type.ptt = ptt_type;
-    }
+        if (retcode != RIG_OK)
+        {
+            fprintf(stderr, "Config parameter error: %s\n", rigerror(retcode));
+            exit(2);
+        }
 
-    if (dcd_type != RIG_DCD_NONE)
-    {
-        my_rig->state.dcdport.type.dcd = dcd_type;
-    }
+        if (def->rig_file)
+        {
+            strncpy(rig->state.rigport.pathname, def->rig_file, HAMLIB_FILPATHLEN - 1);
+        }
 
-    if (ptt_file)
-    {
-        strncpy(my_rig->state.pttport.pathname, ptt_file, HAMLIB_FILPATHLEN - 1);
-    }
+        rig->state.twiddle_timeout = twiddle_timeout;
+        rig->state.uplink = uplink;
+        rig_debug(RIG_DEBUG_TRACE, "%s: twiddle=%d, uplink=%d, twiddle_rit=%d\n",
+                  __func__,
+                  rig->state.twiddle_timeout, rig->state.uplink, rig->state.twiddle_rit);
 
-    if (dcd_file)
-    {
-        strncpy(my_rig->state.dcdport.pathname, dcd_file, HAMLIB_FILPATHLEN - 1);
-    }
+        /*
+         * ex: RIG_PTT_PARALLEL and /dev/parport0
+         */
+        if (def->ptt_type != RIG_PTT_NONE)
+        {
+            rig->state.pttport.type.ptt = def->ptt_type;
+        }
 
-    /* FIXME: bound checking and port type == serial */
-    if (serial_rate != 0)
-    {
-        my_rig->state.rigport.parm.serial.rate = serial_rate;
-    }
+        if (def->dcd_type != RIG_DCD_NONE)
+        {
+            rig->state.dcdport.type.dcd = def->dcd_type;
+        }
 
-    if (civaddr)
-    {
-        rig_set_conf(my_rig, rig_token_lookup(my_rig, "civaddr"), civaddr);
-    }
+        if (def->ptt_file)
+        {
+            strncpy(rig->state.pttport.pathname, def->ptt_file, HAMLIB_FILPATHLEN - 1);
+        }
 
-    /*
-     * print out conf parameters
-     */
-    if (show_conf)
-    {
-        rig_token_foreach(my_rig, print_conf_list, (rig_ptr_t)my_rig);
-    }
+        if (def->dcd_file)
+        {
+            strncpy(rig->state.dcdport.pathname, def->dcd_file, HAMLIB_FILPATHLEN - 1);
+        }
 
-    /*
-     * print out conf parameters, and exits immediately
-     * We may be interested only in only caps, and rig_open may fail.
-     */
-    if (dump_caps_opt)
-    {
-        dumpcaps(my_rig, stdout);
-        rig_cleanup(my_rig); /* if you care about memory */
-        exit(0);
-    }
+        /* FIXME: bound checking and port type == serial */
+        if (def->serial_rate != 0)
+        {
+            rig->state.rigport.parm.serial.rate = def->serial_rate;
+        }
 
-    /* open and close rig connection to check early for issues */
-    retcode = rig_open(my_rig);
+        if (def->civaddr)
+        {
+            rig_set_conf(rig, rig_token_lookup(rig, "civaddr"), def->civaddr);
+        }
 
-    if (retcode != RIG_OK)
-    {
-        fprintf(stderr, "rig_open: error = %s \n", rigerror(retcode));
-        exit(2);
-    }
+        /*
+         * print out conf parameters
+         */
+        if (show_conf)
+        {
+            rig_token_foreach(rig, print_conf_list, (rig_ptr_t)rig);
+        }
 
-    if (verbose > RIG_DEBUG_ERR)
-    {
-        printf("Opened rig model %u, '%s'\n",
-               my_rig->caps->rig_model,
-               my_rig->caps->model_name);
-    }
+        /*
+         * print out conf parameters, and exits immediately
+         * We may be interested only in only caps, and rig_open may fail.
+         */
+        if (dump_caps_opt)
+        {
+            dumpcaps(rig, stdout);
+            rig_cleanup(rig); /* if you care about memory */
+
+            if (i == nrigs - 1)
+            {
+                exit(0);
+            }
+
+            continue;
+        }
 
-    rig_debug(RIG_DEBUG_VERBOSE, "Backend version: %s, Status: %s\n",
-              my_rig->caps->version, rig_strstatus(my_rig->caps->status));
+        /* open and close rig connection to check early for issues */
+        retcode = rig_open(rig);
+
+        if (retcode != RIG_OK)
+        {
+            fprintf(stderr, "rig_open: error = %s \n", rigerror(retcode));
+            exit(2);
+        }
+
+        if (verbose > RIG_DEBUG_ERR)
+        {
+            printf("Opened rig model %u, '%s'\n",
+                   rig->caps->rig_model,
+                   rig->caps->model_name);
+        }
+
+        rig_debug(RIG_DEBUG_VERBOSE, "Backend version: %s, Status: %s\n",
+                  rig->caps->version, rig_strstatus(rig->caps->status));
 
 #if 0
-    rig_close(my_rig);          /* we will reopen for clients */
+        rig_close(rig);          /* we will reopen for clients */
 
-    if (verbose > RIG_DEBUG_ERR)
-    {
-        printf("Closed rig model %d, '%s - will reopen for clients'\n",
-               my_rig->caps->rig_model,
-               my_rig->caps->model_name);
-    }
+        if (verbose > RIG_DEBUG_ERR)
+        {
+            printf("Closed rig model %d, '%s - will reopen for clients'\n",
+                   rig->caps->rig_model,
+                   rig->caps->model_name);
+        }
 
 #endif
+    }
+
+    my_rig = rig_defs[0].rig;
 
 #ifdef __MINGW32__
 #  ifndef SO_OPENTYPE
@@ -704,108 +850,31 @@ int main(int argc, char *argv[])
 #endif
 
     /*
-     * Prepare listening socket
+     * Prepare listening sockets, the first rig always has one
      */
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_UNSPEC;    /* Allow IPv4 or IPv6 */
-    hints.ai_socktype = SOCK_STREAM;/* TCP socket */
-    hints.ai_flags = AI_PASSIVE;    /* For wildcard IP address */
-    hints.ai_protocol = 0;          /* Any protocol */
-
-    retcode = getaddrinfo(src_addr, portno, &hints, &result);
-
-    if (retcode == 0 && result->ai_family == AF_INET6)
-    {
-        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV6\n", __func__);
-    }
-    else if (retcode == 0)
-    {
-        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV4\n", __func__);
-    }
-    else
-    {
-        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(retcode));
-        exit(2);
-    }
-
-    saved_result = result;
-
-    do
+    for (i = 0; i < nrigs; i++)
     {
-        sock_listen = socket(result->ai_family,
-                             result->ai_socktype,
-                             result->ai_protocol);
-
-        if (sock_listen < 0)
-        {
-            handle_error(RIG_DEBUG_ERR, "socket");
-            freeaddrinfo(saved_result);     /* No longer needed */
-            exit(2);
-        }
-
-        if (setsockopt(sock_listen,
-                       SOL_SOCKET,
-                       SO_REUSEADDR,
-                       (char *)&reuseaddr,
-                       sizeof(reuseaddr))
-                < 0)
-        {
-
-            handle_error(RIG_DEBUG_ERR, "setsockopt");
-            freeaddrinfo(saved_result);     /* No longer needed */
-            exit(1);
-        }
-
-#ifdef IPV6_V6ONLY
-
-        if (AF_INET6 == result->ai_family)
-        {
-            /* allow IPv4 mapped to IPv6 clients Windows and BSD default
-               this to 1 (i.e. disallowed) and we prefer it off */
-            int sockopt = 0;
-
-            if (setsockopt(sock_listen,
-                           IPPROTO_IPV6,
-                           IPV6_V6ONLY,
-                           (char *)&sockopt,
-                           sizeof(sockopt))
-                    < 0)
-            {
-
-                handle_error(RIG_DEBUG_ERR, "setsockopt");
-                freeaddrinfo(saved_result);     /* No longer needed */
-                exit(1);
-            }
-        }
+        def = &rig_defs[i];
+        def->sock_listen = -1;
 
-#endif
-
-        if (0 == bind(sock_listen, result->ai_addr, result->ai_addrlen))
+        if (i == 0 || def->portno)
         {
-            break;
+            def->sock_listen = listen_socket(def->portno ? def->portno : portno);
         }
-
-        handle_error(RIG_DEBUG_WARN, "binding failed (trying next interface)");
-#ifdef __MINGW32__
-        closesocket(sock_listen);
-#else
-        close(sock_listen);
-#endif
     }
-    while ((result = result->ai_next) != NULL);
 
-    freeaddrinfo(saved_result);     /* No longer needed */
+    rig_list = rig_defs;
+    rig_count = nrigs;
 
-    if (NULL == result)
+    if (metrics_port && metrics_start(src_addr, metrics_port, print_metrics) < 0)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: bind error - no available interface\n", __func__);
+        fprintf(stderr, "rigctld: cannot serve metrics on port %s\n", metrics_port);
         exit(1);
     }
 
-    if (listen(sock_listen, 4) < 0)
+    if (wirecap_dir)
     {
-        handle_error(RIG_DEBUG_ERR, "listening");
-        exit(1);
+        rigctl_set_dump_wirecap_cb(dump_wirecap);
     }
 
 #if HAVE_SIGACTION
@@ -861,13 +930,29 @@ int main(int argc, char *argv[])
 #endif
 #endif
 
+#ifdef RIGCTLD_EVENT_LOOP
+    serve_clients(rig_defs, nrigs, vfo_mode);
+
+    for (i = 1; i < nrigs; i++)
+    {
+        rig_close(rig_defs[i].rig);
+        rig_cleanup(rig_defs[i].rig);
+    }
+
+    rig_close(my_rig); /* close port */
+#else
+
     /*
      * main loop accepting connections
      */
     do
     {
+#ifdef HAVE_POLL_H
+        struct pollfd pfd;
+#else
         fd_set set;
         struct timeval timeout;
+#endif
 
         arg = malloc(sizeof(struct handle_data));
 
@@ -877,16 +962,23 @@ int main(int argc, char *argv[])
             exit(1);
         }
 
-        /* use select to allow for periodic checks for CTRL+C */
+        /* wait with a timeout to allow for periodic checks for CTRL+C */
+#ifdef HAVE_POLL_H
+        pfd.fd = rig_defs[0].sock_listen;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        retcode = poll(&pfd, 1, 5000);
+#else
         FD_ZERO(&set);
-        FD_SET(sock_listen, &set);
+        FD_SET(rig_defs[0].sock_listen, &set);
         timeout.tv_sec = 5;
         timeout.tv_usec = 0;
-        retcode = select(sock_listen + 1, &set, NULL, NULL, &timeout);
+        retcode = select(rig_defs[0].sock_listen + 1, &set, NULL, NULL, &timeout);
+#endif
 
         if (-1 == retcode)
         {
-            rig_debug(RIG_DEBUG_ERR, "%s: select\n", __func__);
+            rig_debug(RIG_DEBUG_ERR, "%s: select/poll\n", __func__);
         }
         else if (!retcode)
         {
@@ -900,7 +992,7 @@ int main(int argc, char *argv[])
             arg->rig = my_rig;
             arg->clilen = sizeof(arg->cli_addr);
             arg->vfo_mode = vfo_mode;
-            arg->sock = accept(sock_listen,
+            arg->sock = accept(rig_defs[0].sock_listen,
                                (struct sockaddr *)&arg->cli_addr,
                                &arg->clilen);
 
@@ -962,6 +1054,7 @@ int main(int argc, char *argv[])
 #else
     rig_close(my_rig); /* close port */
 #endif
+#endif /* RIGCTLD_EVENT_LOOP */
     rig_cleanup(my_rig); /* if you care about memory */
 
 #ifdef __MINGW32__
@@ -971,6 +1064,123 @@ int main(int argc, char *argv[])
     return 0;
 }
 
+
+/*
+ * Bind and listen on port of the listening address, exits on failure
+ */
+static int listen_socket(const char *port)
+{
+    struct addrinfo hints, *result, *saved_result;
+    int sock_listen;
+    int reuseaddr = 1;
+    int retcode;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;    /* Allow IPv4 or IPv6 */
+    hints.ai_socktype = SOCK_STREAM;/* TCP socket */
+    hints.ai_flags = AI_PASSIVE;    /* For wildcard IP address */
+    hints.ai_protocol = 0;          /* Any protocol */
+
+    retcode = getaddrinfo(src_addr, port, &hints, &result);
+
+    if (retcode == 0 && result->ai_family == AF_INET6)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV6\n", __func__);
+    }
+    else if (retcode == 0)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV4\n", __func__);
+    }
+    else
+    {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(retcode));
+        exit(2);
+    }
+
+    saved_result = result;
+
+    do
+    {
+        sock_listen = socket(result->ai_family,
+                             result->ai_socktype,
+                             result->ai_protocol);
+
+        if (sock_listen < 0)
+        {
+            handle_error(RIG_DEBUG_ERR, "socket");
+            freeaddrinfo(saved_result);     /* No longer needed */
+            exit(2);
+        }
+
+        if (setsockopt(sock_listen,
+                       SOL_SOCKET,
+                       SO_REUSEADDR,
+                       (char *)&reuseaddr,
+                       sizeof(reuseaddr))
+                < 0)
+        {
+
+            handle_error(RIG_DEBUG_ERR, "setsockopt");
+            freeaddrinfo(saved_result);     /* No longer needed */
+            exit(1);
+        }
+
+#ifdef IPV6_V6ONLY
+
+        if (AF_INET6 == result->ai_family)
+        {
+            /* allow IPv4 mapped to IPv6 clients Windows and BSD default
+               this to 1 (i.e. disallowed) and we prefer it off */
+            int sockopt = 0;
+
+            if (setsockopt(sock_listen,
+                           IPPROTO_IPV6,
+                           IPV6_V6ONLY,
+                           (char *)&sockopt,
+                           sizeof(sockopt))
+                    < 0)
+            {
+
+                handle_error(RIG_DEBUG_ERR, "setsockopt");
+                freeaddrinfo(saved_result);     /* No longer needed */
+                exit(1);
+            }
+        }
+
+#endif
+
+        if (0 == bind(sock_listen, result->ai_addr, result->ai_addrlen))
+        {
+            break;
+        }
+
+        handle_error(RIG_DEBUG_WARN, "binding failed (trying next interface)");
+#ifdef __MINGW32__
+        closesocket(sock_listen);
+#else
+        close(sock_listen);
+#endif
+    }
+    while ((result = result->ai_next) != NULL);
+
+    freeaddrinfo(saved_result);     /* No longer needed */
+
+    if (NULL == result)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: bind error - no available interface\n", __func__);
+        exit(1);
+    }
+
+    if (listen(sock_listen, SOMAXCONN) < 0)
+    {
+        handle_error(RIG_DEBUG_ERR, "listening");
+        exit(1);
+    }
+
+    return sock_listen;
+}
+
+
 static FILE *get_fsockout(struct handle_data *handle_data_arg)
 {
 #ifdef __MINGW32__
@@ -1012,6 +1222,9 @@ void *handle_socket(void *arg)
     char send_cmd_term = '\r';  /* send_cmd termination char */
     int ext_resp = 0;
     char resp_sep = '\n';
+    struct rigctl_client_state client_state;
+
+    memset(&client_state, 0, sizeof(client_state));
 
     fsockin = get_fsockin(handle_data_arg);
 
@@ -1032,6 +1245,8 @@ void *handle_socket(void *arg)
         goto handle_exit;
     }
 
+    HL_ATOMIC_ADD(rig_list[0].clients, 1);
+
 #ifdef HAVE_PTHREAD
     sync_callback(1);
 
@@ -1071,7 +1286,8 @@ void *handle_socket(void *arg)
                   handle_data_arg->vfo_mode);
         retcode = rigctl_parse(handle_data_arg->rig, fsockin, fsockout, NULL, 0,
                                sync_callback,
-                               1, 0, &handle_data_arg->vfo_mode, send_cmd_term, &ext_resp, &resp_sep);
+                               1, 0, &handle_data_arg->vfo_mode, send_cmd_term, &ext_resp, &resp_sep,
+                               &client_state);
 
         if (retcode != 0) { rig_debug(RIG_DEBUG_ERR, "%s: rigctl_parse retcode=%d\n", __func__, retcode); }
 
@@ -1093,6 +1309,7 @@ void *handle_socket(void *arg)
         {
             int retry = 3;
             rig_debug(RIG_DEBUG_ERR, "%s: i/o error\n", __func__)
+            HL_ATOMIC_ADD(rig_list[0].reopens, 1);
 
             do
             {
@@ -1186,6 +1403,8 @@ void *handle_socket(void *arg)
               host,
               serv);
 
+    HL_ATOMIC_ADD(rig_list[0].clients, -1);
+
 handle_exit:
 
 // for MINGW we close the handle before fclose
@@ -1215,6 +1434,2033 @@ handle_exit:
 }
 
 
+#ifdef RIGCTLD_EVENT_LOOP
+
+/*
+ * Event loop server
+ *
+ * The main thread owns the sockets: it accepts, reads whatever arrived
+ * into the client's input buffer and writes back whatever output is
+ * pending, never blocking on anything.  Each rig has its own worker
+ * thread.  Once a client has a complete line it goes on the queue of the
+ * worker of the rig it talks to, which runs rigctl_parse_buf() over the
+ * buffered lines and hands the output back.  Only the worker talks to
+ * its rig, so commands from
+ * different clients are serialized by the queue instead of a lock held
+ * around every command.  The worker lock only guards the queue and the
+ * client buffers and is never held across rig I/O.
+ */
+
+#define CLIENT_INBUF_MAX    65536   /* longest accepted line */
+#define EV_BATCH            32
+
+/*
+ * Scheduling classes.  The worker runs one command at a time.  High
+ * class commands go first, so keying and tuning wait for at most the
+ * command already on the wire.  The others go by earliest deadline,
+ * queueing time plus the budget of their class, and once one is past its
+ * deadline it may slip in between two high class commands, so a stream
+ * of set_freq from a tuning knob cannot starve the panadapter.
+ */
+enum sched_class_e
+{
+    SCHED_HIGH,     /* set_ptt, stop_morse, set_freq */
+    SCHED_NORMAL,
+    SCHED_LOW,      /* get_level and info queries */
+    SCHED_CLASSES
+};
+
+static const int sched_budget_ms[SCHED_CLASSES] = { 0, 100, 500 };
+static const char *const sched_class_name[SCHED_CLASSES] =
+{
+    "high", "normal", "low"
+};
+
+/*
+ * Subscriptions.  The worker polls every item someone subscribed to once
+ * per period, through the cache, by running the matching get command in
+ * extended response format.  Whoever subscribed gets that block when it
+ * differs from the last one sent to them.
+ */
+#define SUB_POLL_MS         100     /* shortest poll period */
+
+static const char *const sub_command[RIGCTL_SUB_ITEMS] =
+{
+    "+\\get_freq\n",
+    "+\\get_mode\n",
+    "+\\get_vfo\n",
+    "+\\get_ptt\n",
+    "+\\get_split_vfo\n"
+};
+
+struct sched_stats
+{
+    unsigned long count;
+    unsigned long max_us;
+    unsigned long sum_us;
+    unsigned int wait_us[RIG_PORT_STATS_BUCKETS];   /* queue wait histogram */
+    int depth;                                      /* queued now */
+};
+
+#define EV_IN   1
+#define EV_OUT  2
+
+/* first member of everything registered with the event loop */
+enum ev_kind_e
+{
+    EV_KIND_CLIENT = 1,
+    EV_KIND_LISTEN,
+    EV_KIND_NOTIFY
+};
+
+struct rig_worker;
+
+struct client
+{
+    int ev_kind;
+    int sock;
+    char host[NI_MAXHOST];
+    char serv[NI_MAXSERV];
+    struct rig_worker *worker;
+
+    /*
+     * rigctl_parse() state, used by the worker, and by the main thread
+     * while the client is not queued
+     */
+    int vfo_mode;
+    int ext_resp;
+    char resp_sep;
+    struct rigctl_client_state parse_state;
+
+    /* below here guarded by worker->lock */
+    char *in;               /* received, not yet parsed */
+    size_t in_len, in_size;
+    char *out;              /* parsed, not yet sent */
+    size_t out_off, out_len, out_size;
+    int in_ready;           /* a line arrived since the last parse */
+    struct rig_cache_time in_time;  /* when the last line arrived */
+    int queued;             /* on the worker queue or being parsed */
+    int eof;                /* peer sent its last byte */
+    int quit;               /* close once the output is sent */
+    int on_done;            /* on the done list */
+    int move_to;            /* worker asked for by select_rig, -1 if none */
+    int sched_class;        /* class of the next command */
+    struct timespec queued_at;
+    int subscribed;         /* on the subscriber list */
+    int sub_min_ms[RIGCTL_SUB_ITEMS];   /* -1 when not subscribed */
+    char *sub_last[RIGCTL_SUB_ITEMS];   /* last notification sent */
+    struct timespec sub_sent[RIGCTL_SUB_ITEMS];
+    struct client *next_sub;
+    struct client *next_queued;
+    struct client *next_done;
+
+    /* main thread only */
+    int closed;
+    int events;
+    struct client *prev, *next;
+};
+
+struct rig_worker
+{
+    int ev_kind;
+    RIG *rig;
+    struct rig_def *def;            /* counters for the metrics */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct client *head[SCHED_CLASSES];     /* clients with lines to parse */
+    struct client *tail[SCHED_CLASSES];
+    struct client *done;            /* parsed, for the main thread */
+    struct sched_stats stats[SCHED_CLASSES];
+    int last_high;                  /* the previous command was high class */
+    struct client *subs;            /* clients with subscriptions */
+    int poll_ms;
+    struct timespec next_poll;
+    FILE *out_fp;                   /* reply of the command being run */
+    char *out_buf;
+    size_t out_size;
+    int notify[2];                  /* worker -> main thread wake up */
+    unsigned long cached_reads;     /* answered by the main thread */
+    int stop;
+};
+
+/* a listening port, its clients start out on worker */
+struct listener
+{
+    int ev_kind;
+    int sock;
+    struct rig_worker *worker;
+};
+
+struct evloop
+{
+#ifdef HAVE_SYS_EPOLL_H
+    int epfd;
+#else
+    struct pollfd *pfd;
+    void **ptr;
+    int n, size;
+#endif
+};
+
+struct ev_event
+{
+    void *ptr;
+    int events;
+};
+
+static struct rig_worker *workers;  /* one per rig, in command line order */
+static int nworkers;
+static __thread struct client *worker_client;  /* being parsed by the worker */
+
+
+static int set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int evloop_init(struct evloop *ev)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    ev->epfd = epoll_create1(EPOLL_CLOEXEC);
+    return ev->epfd < 0 ? -1 : 0;
+#else
+    memset(ev, 0, sizeof(*ev));
+    return 0;
+#endif
+}
+
+
+static void evloop_cleanup(struct evloop *ev)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    close(ev->epfd);
+#else
+    free(ev->pfd);
+    free(ev->ptr);
+#endif
+}
+
+
+/* add fd to the set, or change the events watched if already there */
+static int evloop_set(struct evloop *ev, int fd, void *ptr, int events,
+                      int add)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event e;
+
+    memset(&e, 0, sizeof(e));
+    e.events = (events & EV_IN ? EPOLLIN : 0) | (events & EV_OUT ? EPOLLOUT : 0);
+    e.data.ptr = ptr;
+
+    return epoll_ctl(ev->epfd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &e);
+#else
+    int i;
+
+    for (i = 0; i < ev->n && ev->pfd[i].fd != fd; i++);
+
+    if (i == ev->n)
+    {
+        if (ev->n == ev->size)
+        {
+            int size = ev->size ? ev->size * 2 : 16;
+            struct pollfd *pfd = realloc(ev->pfd, size * sizeof(*pfd));
+            void **p;
+
+            if (!pfd)
+            {
+                return -1;
+            }
+
+            ev->pfd = pfd;
+            p = realloc(ev->ptr, size * sizeof(*p));
+
+            if (!p)
+            {
+                return -1;
+            }
+
+            ev->ptr = p;
+            ev->size = size;
+        }
+
+        ev->n++;
+    }
+
+    ev->pfd[i].fd = fd;
+    ev->pfd[i].events = (events & EV_IN ? POLLIN : 0)
+                        | (events & EV_OUT ? POLLOUT : 0);
+    ev->pfd[i].revents = 0;
+    ev->ptr[i] = ptr;
+
+    return 0;
+#endif
+}
+
+
+static void evloop_del(struct evloop *ev, int fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    epoll_ctl(ev->epfd, EPOLL_CTL_DEL, fd, NULL);
+#else
+    int i;
+
+    for (i = 0; i < ev->n; i++)
+    {
+        if (ev->pfd[i].fd == fd)
+        {
+            ev->n--;
+            ev->pfd[i] = ev->pfd[ev->n];
+            ev->ptr[i] = ev->ptr[ev->n];
+            break;
+        }
+    }
+
+#endif
+}
+
+
+/* errors and hang ups are reported as EV_IN, the read will see them */
+static int evloop_wait(struct evloop *ev, struct ev_event *out, int max,
+                       int timeout_ms)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event e[EV_BATCH];
+    int i, n;
+
+    n = epoll_wait(ev->epfd, e, max < EV_BATCH ? max : EV_BATCH, timeout_ms);
+
+    for (i = 0; i < n; i++)
+    {
+        out[i].ptr = e[i].data.ptr;
+        out[i].events = (e[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP) ? EV_IN : 0)
+                        | (e[i].events & EPOLLOUT ? EV_OUT : 0);
+    }
+
+    return n;
+#else
+    int i, n;
+
+    n = poll(ev->pfd, ev->n, timeout_ms);
+
+    if (n <= 0)
+    {
+        return n;
+    }
+
+    for (i = 0, n = 0; i < ev->n && n < max; i++)
+    {
+        short r = ev->pfd[i].revents;
+
+        if (!r)
+        {
+            continue;
+        }
+
+        out[n].ptr = ev->ptr[i];
+        out[n].events = (r & (POLLIN | POLLERR | POLLHUP | POLLNVAL) ? EV_IN : 0)
+                        | (r & POLLOUT ? EV_OUT : 0);
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+
+static int buf_append(char **buf, size_t *len, size_t *size,
+                      const char *data, size_t n)
+{
+    if (*len + n > *size)
+    {
+        size_t size_new = *size ? *size : 256;
+        char *p;
+
+        while (size_new < *len + n)
+        {
+            size_new *= 2;
+        }
+
+        p = realloc(*buf, size_new);
+
+        if (!p)
+        {
+            return -1;
+        }
+
+        *buf = p;
+        *size = size_new;
+    }
+
+    memcpy(*buf + *len, data, n);
+    *len += n;
+
+    return 0;
+}
+
+
+/* class of the first command in buf, going by its name only */
+static int sched_class(const char *buf, size_t len)
+{
+    static const char *const high[] = { "set_ptt", "stop_morse", "set_freq", NULL };
+    static const char *const low[] =
+    {
+        "get_level", "get_info", "dump_caps", "dump_conf", "dump_state",
+        "dump_state2", "get_port_stats", "get_queue_stats", NULL
+    };
+    char name[32];
+    size_t i = 0, n = 0;
+    int k;
+
+    while (i < len && isspace((unsigned char)buf[i])) { i++; }
+
+    /* extended response prefix, see rigctl_parse() */
+    if (i < len && buf[i] != '\\' && buf[i] != '_'
+            && ispunct((unsigned char)buf[i]))
+    {
+        i++;
+    }
+
+    if (i == len)
+    {
+        return SCHED_NORMAL;
+    }
+
+    if (buf[i] != '\\')
+    {
+        switch (buf[i])
+        {
+        case 'T':
+        case 'F':
+            return SCHED_HIGH;
+
+        case 'l':
+        case '_':
+        case '1':
+        case '3':
+            return SCHED_LOW;
+
+        default:
+            return SCHED_NORMAL;
+        }
+    }
+
+    for (i++; i < len && n < sizeof(name) - 1
+            && !isspace((unsigned char)buf[i]); i++)
+    {
+        name[n++] = buf[i];
+    }
+
+    name[n] = '\0';
+
+    for (k = 0; high[k]; k++)
+    {
+        if (!strcmp(name, high[k])) { return SCHED_HIGH; }
+    }
+
+    for (k = 0; low[k]; k++)
+    {
+        if (!strcmp(name, low[k])) { return SCHED_LOW; }
+    }
+
+    return SCHED_NORMAL;
+}
+
+
+/*
+ * Whether buf holds anything but reads: lower case commands and the get,
+ * dump and chk long names.  Only used to tell whether a subscriber may
+ * have changed what it subscribed to, a false positive costs nothing.
+ */
+static int has_set_command(const char *buf, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len)
+    {
+        while (i < len && isspace((unsigned char)buf[i])) { i++; }
+
+        if (i == len)
+        {
+            break;
+        }
+
+        if (buf[i] != '#')
+        {
+            /* extended response prefix, see rigctl_parse() */
+            if (buf[i] != '\\' && buf[i] != '_' && ispunct((unsigned char)buf[i]))
+            {
+                i++;
+            }
+
+            if (i < len && buf[i] == '\\')
+            {
+                const char *name = buf + i + 1;
+                size_t n = len - i - 1;
+
+                if (!(n >= 4 && !strncmp(name, "get_", 4))
+                        && !(n >= 5 && !strncmp(name, "dump_", 5))
+                        && !(n >= 4 && !strncmp(name, "chk_", 4)))
+                {
+                    return 1;
+                }
+            }
+            else if (i < len && isupper((unsigned char)buf[i]))
+            {
+                return 1;
+            }
+        }
+
+        while (i < len && buf[i] != '\n') { i++; }
+    }
+
+    return 0;
+}
+
+
+/* worker->lock held */
+static void worker_enqueue(struct rig_worker *w, struct client *c)
+{
+    int cl = sched_class(c->in, c->in_len);
+
+    c->queued = 1;
+    c->sched_class = cl;
+    c->next_queued = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &c->queued_at);
+
+    if (w->tail[cl])
+    {
+        w->tail[cl]->next_queued = c;
+    }
+    else
+    {
+        w->head[cl] = c;
+    }
+
+    w->tail[cl] = c;
+    w->stats[cl].depth++;
+    pthread_cond_signal(&w->cond);
+}
+
+
+static long ts_diff_us(const struct timespec *a, const struct timespec *b)
+{
+    return (a->tv_sec - b->tv_sec) * 1000000L
+           + (a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+
+/*
+ * Take the queued client with the earliest deadline, NULL if none.
+ * worker->lock held.
+ */
+static struct client *worker_dequeue(struct rig_worker *w)
+{
+    struct timespec now;
+    struct client *c;
+    long best = 0;
+    int cl = -1;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (i = SCHED_HIGH + 1; i < SCHED_CLASSES; i++)
+    {
+        long deadline;
+
+        if (!w->head[i])
+        {
+            continue;
+        }
+
+        deadline = sched_budget_ms[i] * 1000L - ts_diff_us(&now, &w->head[i]->queued_at);
+
+        if (cl < 0 || deadline < best)
+        {
+            best = deadline;
+            cl = i;
+        }
+    }
+
+    if (w->head[SCHED_HIGH] && (cl < 0 || !w->last_high || best > 0))
+    {
+        cl = SCHED_HIGH;
+    }
+
+    if (cl < 0)
+    {
+        return NULL;
+    }
+
+    w->last_high = cl == SCHED_HIGH;
+
+    c = w->head[cl];
+    w->head[cl] = c->next_queued;
+
+    if (!w->head[cl])
+    {
+        w->tail[cl] = NULL;
+    }
+
+    {
+        struct sched_stats *st = &w->stats[cl];
+        unsigned long us = ts_diff_us(&now, &c->queued_at);
+        int b;
+
+        for (b = RIG_PORT_STATS_BUCKETS - 1;
+                b > 0 && rig_port_stats_bucket_us(b) > us; b--);
+
+        st->count++;
+        st->sum_us += us;
+        st->wait_us[b]++;
+        st->depth--;
+
+        if (us > st->max_us)
+        {
+            st->max_us = us;
+        }
+    }
+
+    return c;
+}
+
+
+/*
+ * Run the first command in buf, which has room for one more byte, with
+ * the reply going to the worker's output stream.  Returns how many bytes
+ * it used up, 0 if the command is cut short by the end of buf and has to
+ * wait for more input.
+ */
+static size_t client_parse(struct client *c, char *buf, size_t len,
+                           const char **out, size_t *out_len, int *quit)
+{
+    struct rig_worker *w = c->worker;
+    RIG *rig = w->rig;
+    char send_cmd_term = '\r';  /* send_cmd termination char */
+    size_t pos;
+    int retcode;
+
+    rewind(w->out_fp);
+
+    pos = rigctl_parse_buf(rig, buf, len, w->out_fp, &c->vfo_mode,
+                           send_cmd_term, &c->ext_resp, &c->resp_sep,
+                           &c->parse_state, &retcode);
+
+    if (retcode != 0 && retcode != -1)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: rigctl_parse retcode=%d\n", __func__, retcode);
+    }
+
+    // if we get a hard error we try to reopen the rig again
+    // this should cover short dropouts that can occur
+    if (retcode == -RIG_EIO || retcode == 2)
+    {
+        int retry = 3;
+        rig_debug(RIG_DEBUG_ERR, "%s: i/o error\n", __func__);
+        HL_ATOMIC_ADD(w->def->reopens, 1);
+
+        do
+        {
+            retcode = rig_close(rig);
+            hl_usleep(1000 * 1000);
+            rig_debug(RIG_DEBUG_ERR, "%s: rig_close retcode=%d\n", __func__, retcode);
+            retcode = rig_open(rig);
+            rig_debug(RIG_DEBUG_ERR, "%s: rig_open retcode=%d\n", __func__, retcode);
+        }
+        while (retry-- > 0 && retcode != RIG_OK);
+
+        retcode = 0;
+    }
+
+    if (retcode != 0 && retcode != -1 && retcode != -RIG_ENAVAIL)
+    {
+        *quit = 1;
+        pos = len;
+    }
+
+    fflush(w->out_fp);
+    *out = w->out_buf;
+    *out_len = w->out_size;
+
+    return pos;
+}
+
+
+/* hand c back to the main thread, worker->lock held */
+static void worker_done(struct rig_worker *w, struct client *c)
+{
+    char b = 0;
+
+    if (c->on_done)
+    {
+        return;
+    }
+
+    c->on_done = 1;
+    c->next_done = w->done;
+    w->done = c;
+
+    if (write(w->notify[1], &b, 1) < 0 && errno != EAGAIN)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: notify: %s\n", __func__, strerror(errno));
+    }
+}
+
+
+/* worker->lock held */
+static void worker_unsubscribe(struct rig_worker *w, struct client *c)
+{
+    struct client **pc;
+    int i;
+
+    for (pc = &w->subs; *pc; pc = &(*pc)->next_sub)
+    {
+        if (*pc == c)
+        {
+            *pc = c->next_sub;
+            break;
+        }
+    }
+
+    c->subscribed = 0;
+
+    for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+    {
+        c->sub_min_ms[i] = -1;
+        free(c->sub_last[i]);
+        c->sub_last[i] = NULL;
+    }
+}
+
+
+/* subscribe command, runs on the worker */
+static int client_subscribe(const int *min_ms)
+{
+    struct client *c = worker_client;
+    struct rig_worker *w;
+    struct client *s;
+    int any = 0;
+    int i;
+
+    if (!c)
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    w = c->worker;
+
+    pthread_mutex_lock(&w->lock);
+
+    worker_unsubscribe(w, c);
+
+    for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+    {
+        c->sub_min_ms[i] = min_ms[i];
+        any |= min_ms[i] >= 0;
+    }
+
+    if (any)
+    {
+        c->subscribed = 1;
+        c->next_sub = w->subs;
+        w->subs = c;
+    }
+
+    /* poll as often as the most demanding subscriber needs */
+    w->poll_ms = INT_MAX;
+
+    for (s = w->subs; s; s = s->next_sub)
+    {
+        for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+        {
+            int ms = s->sub_min_ms[i] < SUB_POLL_MS ? SUB_POLL_MS : s->sub_min_ms[i];
+
+            if (s->sub_min_ms[i] >= 0 && ms < w->poll_ms)
+            {
+                w->poll_ms = ms;
+            }
+        }
+    }
+
+    /* the current values go out right away */
+    clock_gettime(CLOCK_MONOTONIC, &w->next_poll);
+
+    pthread_mutex_unlock(&w->lock);
+
+    return RIG_OK;
+}
+
+
+/*
+ * select_rig command, runs on the worker.  The main thread hands the
+ * client over once this command is answered, see worker_collect().
+ */
+static int client_select_rig(int rig_num)
+{
+    struct client *c = worker_client;
+    struct rig_worker *w;
+
+    if (!c || rig_num < 1 || rig_num > nworkers)
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    w = c->worker;
+
+    if (&workers[rig_num - 1] == w)
+    {
+        return RIG_OK;
+    }
+
+    pthread_mutex_lock(&w->lock);
+
+    /* subscriptions are polled by the worker, they stay behind */
+    worker_unsubscribe(w, c);
+    c->move_to = rig_num - 1;
+
+    pthread_mutex_unlock(&w->lock);
+
+    return RIG_OK;
+}
+
+
+/* reply of one command, as a NUL terminated string */
+static char *worker_run_command(struct rig_worker *w, const char *cmd)
+{
+    char in[64];
+    int vfo_opt = 0;
+    int ext_resp = 0;
+    char resp_sep = '\n';
+    struct rigctl_client_state cs;
+    int retcode;
+
+    memset(&cs, 0, sizeof(cs));
+    strncpy(in, cmd, sizeof(in) - 1);
+    in[sizeof(in) - 1] = '\0';
+
+    rewind(w->out_fp);
+    rigctl_parse_buf(w->rig, in, strlen(in), w->out_fp, &vfo_opt, '\r',
+                     &ext_resp, &resp_sep, &cs, &retcode);
+    fflush(w->out_fp);
+
+    return strndup(w->out_buf, w->out_size);
+}
+
+
+/*
+ * Poll the subscribed items and notify whoever has not seen the new
+ * value yet.  worker->lock held, dropped while the rig is polled.
+ */
+static void worker_poll_subs(struct rig_worker *w)
+{
+    char *block[RIGCTL_SUB_ITEMS] = { NULL };
+    struct timespec now;
+    struct client *c;
+    int wanted = 0;
+    int i;
+
+    for (c = w->subs; c; c = c->next_sub)
+    {
+        for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+        {
+            if (c->sub_min_ms[i] >= 0)
+            {
+                wanted |= 1 << i;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&w->lock);
+
+    for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+    {
+        if (wanted & (1 << i))
+        {
+            block[i] = worker_run_command(w, sub_command[i]);
+        }
+    }
+
+    pthread_mutex_lock(&w->lock);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (c = w->subs; c; c = c->next_sub)
+    {
+        int pushed = 0;
+
+        if (c->closed || c->quit)
+        {
+            continue;
+        }
+
+        for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+        {
+            char *copy;
+
+            if (c->sub_min_ms[i] < 0 || !block[i] || !*block[i])
+            {
+                continue;
+            }
+
+            if (c->sub_last[i]
+                    && (!strcmp(c->sub_last[i], block[i])
+                        || ts_diff_us(&now, &c->sub_sent[i]) < c->sub_min_ms[i] * 1000L))
+            {
+                continue;
+            }
+
+            copy = strdup(block[i]);
+
+            if (!copy || buf_append(&c->out, &c->out_len, &c->out_size, block[i],
+                                    strlen(block[i])) < 0)
+            {
+                free(copy);
+                continue;
+            }
+
+            free(c->sub_last[i]);
+            c->sub_last[i] = copy;
+            c->sub_sent[i] = now;
+            pushed = 1;
+        }
+
+        if (pushed)
+        {
+            worker_done(w, c);
+        }
+    }
+
+    for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+    {
+        free(block[i]);
+    }
+
+    w->next_poll = now;
+    w->next_poll.tv_sec += w->poll_ms / 1000;
+    w->next_poll.tv_nsec += (w->poll_ms % 1000) * 1000000L;
+
+    if (w->next_poll.tv_nsec >= 1000000000L)
+    {
+        w->next_poll.tv_sec++;
+        w->next_poll.tv_nsec -= 1000000000L;
+    }
+}
+
+
+/* a complete line left to parse, or anything at all once input ended */
+static int client_has_command(const struct client *c)
+{
+    size_t i;
+
+    for (i = 0; i < c->in_len; i++)
+    {
+        if (!isspace((unsigned char)c->in[i]))
+        {
+            return c->eof || memchr(c->in + i, '\n', c->in_len - i) != NULL;
+        }
+    }
+
+    return 0;
+}
+
+
+static void *worker_thread(void *arg)
+{
+    struct rig_worker *w = arg;
+
+    rig_publish_cache(w->rig);
+
+    pthread_mutex_lock(&w->lock);
+
+    while (!w->stop)
+    {
+        struct client *c;
+        struct rig_cache_time in_time;
+        const char *out = NULL;
+        char *buf;
+        size_t len, buf_len, buf_size, used = 0, out_len = 0;
+        int quit = 0;
+
+        if (w->subs && !w->head[SCHED_HIGH])
+        {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            if (ts_diff_us(&now, &w->next_poll) >= 0)
+            {
+                worker_poll_subs(w);
+                rig_publish_cache(w->rig);
+                continue;
+            }
+        }
+
+        c = worker_dequeue(w);
+
+        if (!c && w->subs)
+        {
+            struct timespec now, until;
+            long us;
+
+            /* the condition variable runs on the wall clock */
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            us = ts_diff_us(&w->next_poll, &now);
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += us / 1000000;
+            until.tv_nsec += (us % 1000000) * 1000;
+
+            if (until.tv_nsec >= 1000000000L)
+            {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+
+            pthread_cond_timedwait(&w->cond, &w->lock, &until);
+            continue;
+        }
+
+        if (!c)
+        {
+            pthread_cond_wait(&w->cond, &w->lock);
+            continue;
+        }
+
+        /* complete lines only, unless nothing more will come */
+        for (len = c->in_len; len > 0 && !c->eof && c->in[len - 1] != '\n'; len--);
+
+        c->in_ready = 0;
+        in_time = c->in_time;
+
+        /* parse in the receive buffer itself, client_read() starts a new one */
+        buf = len ? c->in : NULL;
+        buf_len = c->in_len;
+        buf_size = c->in_size;
+
+        if (buf)
+        {
+            c->in = NULL;
+            c->in_len = c->in_size = 0;
+
+            if (buf_size == len)
+            {
+                char *p = realloc(buf, buf_size + 1);
+
+                if (p)
+                {
+                    buf = p;
+                    buf_size++;
+                }
+                else
+                {
+                    c->in = buf;
+                    c->in_len = buf_len;
+                    c->in_size = buf_size;
+                    buf = NULL;
+                    quit = 1;
+                }
+            }
+        }
+
+        pthread_mutex_unlock(&w->lock);
+
+        /*
+         * Single flight: whatever the rig reported after these lines
+         * arrived answers them, so clients asking for the same thing
+         * while one read is on the wire all get that read's result.
+         */
+        if (buf)
+        {
+            worker_client = c;
+            rig_set_cache_request_time(w->rig, &in_time);
+            used = client_parse(c, buf, len, &out, &out_len, &quit);
+            rig_set_cache_request_time(w->rig, NULL);
+            worker_client = NULL;
+
+            /* before the reply goes out, so the client's next read sees it */
+            rig_publish_cache(w->rig);
+        }
+
+        pthread_mutex_lock(&w->lock);
+
+        /*
+         * The subscriber may have changed an item back to what it was last
+         * sent, which the next poll would not report.  Forget what was
+         * sent so the poll repeats the current values.
+         */
+        if (buf && c->subscribed && has_set_command(buf, used))
+        {
+            int i;
+
+            for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+            {
+                free(c->sub_last[i]);
+                c->sub_last[i] = NULL;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &w->next_poll);
+        }
+
+        if (buf)
+        {
+            size_t i;
+
+            /* a leftover of blanks only is not worth keeping */
+            for (i = used; i < len && isspace((unsigned char)buf[i]); i++);
+
+            if (i == len)
+            {
+                used = len;
+            }
+
+            /* what is left goes back in front of what arrived meanwhile */
+            memmove(buf, buf + used, buf_len - used);
+            buf_len -= used;
+
+            if (c->in_len && buf_append(&buf, &buf_len, &buf_size, c->in,
+                                        c->in_len) < 0)
+            {
+                quit = 1;
+            }
+
+            free(c->in);
+            c->in = buf;
+            c->in_len = buf_len;
+            c->in_size = buf_size;
+
+            if (out_len && buf_append(&c->out, &c->out_len, &c->out_size, out,
+                                      out_len) < 0)
+            {
+                quit = 1;
+            }
+        }
+
+        c->quit |= quit;
+        c->queued = 0;
+
+        /* next command of a pipelining client queues up behind the others */
+        if (!c->quit && !c->closed && c->move_to < 0
+                && (c->in_ready || (used && client_has_command(c))))
+        {
+            worker_enqueue(w, c);
+        }
+
+        if (out_len || !c->queued)
+        {
+            worker_done(w, c);
+        }
+    }
+
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+
+static int worker_start(struct rig_worker *w, RIG *rig)
+{
+    int retcode;
+
+    memset(w, 0, sizeof(*w));
+    w->ev_kind = EV_KIND_NOTIFY;
+    w->rig = rig;
+
+    if (pipe(w->notify) < 0)
+    {
+        handle_error(RIG_DEBUG_ERR, "pipe");
+        return -1;
+    }
+
+    set_nonblock(w->notify[0]);
+    set_nonblock(w->notify[1]);
+
+    w->out_fp = open_memstream(&w->out_buf, &w->out_size);
+
+    if (!w->out_fp)
+    {
+        handle_error(RIG_DEBUG_ERR, "open_memstream");
+        close(w->notify[0]);
+        close(w->notify[1]);
+        return -1;
+    }
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    retcode = pthread_create(&w->thread, NULL, worker_thread, w);
+
+    if (retcode != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pthread_create: %s\n", __func__,
+                  strerror(retcode));
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        close(w->notify[0]);
+        close(w->notify[1]);
+        fclose(w->out_fp);
+        free(w->out_buf);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* lets the command being parsed finish, the rest of the queue is dropped */
+static void worker_stop(struct rig_worker *w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_join(w->thread, NULL);
+
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    close(w->notify[0]);
+    close(w->notify[1]);
+    fclose(w->out_fp);
+    free(w->out_buf);
+}
+
+
+/* get_queue_stats, runs on the worker */
+static int print_queue_stats(FILE *fout)
+{
+    struct rig_worker *w;
+    struct sched_stats stats[SCHED_CLASSES];
+    unsigned long cached_reads;
+    int i;
+
+    if (!worker_client)
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    w = worker_client->worker;
+
+    pthread_mutex_lock(&w->lock);
+    memcpy(stats, w->stats, sizeof(stats));
+    cached_reads = w->cached_reads;
+    pthread_mutex_unlock(&w->lock);
+
+    for (i = 0; i < SCHED_CLASSES; i++)
+    {
+        unsigned long pct[3];
+        const double percent[3] = { 50, 90, 99 };
+        int k;
+
+        /* bucket bounds, the real maximum can be lower */
+        for (k = 0; k < 3; k++)
+        {
+            pct[k] = rig_port_stats_percentile(stats[i].wait_us, percent[k]);
+
+            if (pct[k] > stats[i].max_us)
+            {
+                pct[k] = stats[i].max_us;
+            }
+        }
+
+        fprintf(fout, "Queue %s commands: %lu\n", sched_class_name[i],
+                stats[i].count);
+        fprintf(fout, "Queue %s wait us p50/p90/p99/max: %lu %lu %lu %lu\n",
+                sched_class_name[i], pct[0], pct[1], pct[2], stats[i].max_us);
+    }
+
+    fprintf(fout, "Cached reads: %lu\n", cached_reads);
+
+    return RIG_OK;
+}
+
+
+/* the queue part of print_metrics(), labels by rig */
+static void print_queue_metrics(FILE *fout, char *const labels[])
+{
+    struct sched_stats stats[RIGCTLD_MAX_RIGS][SCHED_CLASSES];
+    unsigned long cached_reads[RIGCTLD_MAX_RIGS];
+    char buf[128];
+    int n, i;
+
+    for (n = 0; n < nworkers; n++)
+    {
+        pthread_mutex_lock(&workers[n].lock);
+        memcpy(stats[n], workers[n].stats, sizeof(stats[n]));
+        cached_reads[n] = workers[n].cached_reads;
+        pthread_mutex_unlock(&workers[n].lock);
+    }
+
+    metrics_family(fout, "rigctld", "cached_reads_total", "counter",
+                   "Reads answered from the cache without queueing.");
+
+    for (n = 0; n < nworkers; n++)
+    {
+        fprintf(fout, "rigctld_cached_reads_total{%s} %lu\n", labels[n],
+                cached_reads[n]);
+    }
+
+    metrics_family(fout, "rigctld", "queue_depth", "gauge",
+                   "Clients waiting on the worker queue.");
+
+    for (n = 0; n < nworkers; n++)
+    {
+        for (i = 0; i < SCHED_CLASSES; i++)
+        {
+            fprintf(fout, "rigctld_queue_depth{%s,class=\"%s\"} %d\n", labels[n],
+                    sched_class_name[i], stats[n][i].depth);
+        }
+    }
+
+    metrics_family(fout, "rigctld", "queue_wait_seconds", "histogram",
+                   "Time commands waited on the worker queue.");
+
+    for (n = 0; n < nworkers; n++)
+    {
+        for (i = 0; i < SCHED_CLASSES; i++)
+        {
+            snprintf(buf, sizeof(buf), "%s,class=\"%s\"", labels[n],
+                     sched_class_name[i]);
+            metrics_port_histogram(fout, "rigctld", "queue_wait_seconds", buf,
+                                   stats[n][i].wait_us, stats[n][i].sum_us);
+        }
+    }
+}
+
+
+static void client_close(struct evloop *ev, struct client *c)
+{
+    evloop_del(ev, c->sock);
+    close(c->sock);
+    c->closed = 1;
+    HL_ATOMIC_ADD(c->worker->def->clients, -1);
+
+    rig_debug(RIG_DEBUG_VERBOSE, "Connection closed from %s:%s\n",
+              c->host, c->serv);
+}
+
+
+/*
+ * Send what can be sent, close when done, and watch the socket for what
+ * the client is waiting on next.  worker->lock held.
+ */
+static void client_update(struct evloop *ev, struct client *c)
+{
+    int events;
+
+    if (c->closed)
+    {
+        return;
+    }
+
+    while (c->out_off < c->out_len)
+    {
+        ssize_t n = send(c->sock, c->out + c->out_off, c->out_len - c->out_off, 0);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                handle_error(RIG_DEBUG_WARN, "send");
+                client_close(ev, c);
+                return;
+            }
+
+            break;
+        }
+
+        c->out_off += n;
+    }
+
+    if (c->out_off == c->out_len)
+    {
+        c->out_off = c->out_len = 0;
+    }
+    else if (c->out_off > 0)
+    {
+        memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+        c->out_len -= c->out_off;
+        c->out_off = 0;
+    }
+
+    if ((c->quit || c->eof) && !c->queued && !c->out_len)
+    {
+        client_close(ev, c);
+        return;
+    }
+
+    events = (c->quit || c->eof ? 0 : EV_IN) | (c->out_len ? EV_OUT : 0);
+
+    if (events != c->events)
+    {
+        evloop_set(ev, c->sock, c, events, 0);
+        c->events = events;
+    }
+}
+
+
+/*
+ * Plain reads of the current VFO, answered from the cache the worker
+ * publishes in the reply format rigctl_parse() uses without extended
+ * response and VFO arguments.
+ */
+static const struct
+{
+    const char *line;
+    int item;
+} cached_reads[] =
+{
+    { "f\n", HAMLIB_CACHE_FREQ },
+    { "\\get_freq\n", HAMLIB_CACHE_FREQ },
+    { "m\n", HAMLIB_CACHE_MODE },
+    { "\\get_mode\n", HAMLIB_CACHE_MODE },
+    { "v\n", HAMLIB_CACHE_VFO },
+    { "\\get_vfo\n", HAMLIB_CACHE_VFO },
+    { "t\n", HAMLIB_CACHE_PTT },
+    { "\\get_ptt\n", HAMLIB_CACHE_PTT },
+    { "s\n", HAMLIB_CACHE_SPLIT },
+    { "\\get_split_vfo\n", HAMLIB_CACHE_SPLIT },
+    { NULL, 0 }
+};
+
+
+/*
+ * Answer the reads at the front of the input that the published cache
+ * still covers, so they do not wait behind a command on the wire.  Stops
+ * at the first line that needs the worker, which keeps the replies in
+ * order.  Returns the number of lines answered.  worker->lock held, c
+ * not queued.
+ */
+static int client_answer_cached(struct rig_worker *w, struct client *c)
+{
+    rig_snapshot_t snap;
+    size_t pos = 0;
+    int items = -1;
+    int answered = 0;
+
+    if (c->vfo_mode || c->ext_resp || c->resp_sep != '\n')
+    {
+        return 0;
+    }
+
+    while (pos < c->in_len)
+    {
+        const char *line = c->in + pos;
+        const char *nl = memchr(line, '\n', c->in_len - pos);
+        char reply[64];
+        size_t len;
+        int n, i;
+
+        if (!nl)
+        {
+            break;
+        }
+
+        len = nl - line + 1;
+
+        for (i = 0; cached_reads[i].line; i++)
+        {
+            if (strlen(cached_reads[i].line) == len
+                    && !memcmp(cached_reads[i].line, line, len))
+            {
+                break;
+            }
+        }
+
+        if (!cached_reads[i].line)
+        {
+            break;
+        }
+
+        if (items < 0)
+        {
+            items = rig_get_published_cache(w->rig, &snap);
+        }
+
+        if (items < 0 || !(items & (1 << cached_reads[i].item)))
+        {
+            break;
+        }
+
+        switch (cached_reads[i].item)
+        {
+        case HAMLIB_CACHE_FREQ:
+            n = snprintf(reply, sizeof(reply), "%"PRIll"\n", (int64_t)snap.freq);
+            break;
+
+        case HAMLIB_CACHE_MODE:
+            n = snprintf(reply, sizeof(reply), "%s\n%ld\n",
+                         rig_strrmode(snap.mode), snap.width);
+            break;
+
+        case HAMLIB_CACHE_VFO:
+            n = snprintf(reply, sizeof(reply), "%s\n", rig_strvfo(snap.vfo));
+            break;
+
+        case HAMLIB_CACHE_PTT:
+            n = snprintf(reply, sizeof(reply), "%d\n", snap.ptt);
+            break;
+
+        default:
+            n = snprintf(reply, sizeof(reply), "%d\n%s\n", snap.split,
+                         rig_strvfo(snap.tx_vfo));
+            break;
+        }
+
+        if (buf_append(&c->out, &c->out_len, &c->out_size, reply, n) < 0)
+        {
+            c->quit = 1;
+            break;
+        }
+
+        pos += len;
+        answered++;
+    }
+
+    if (pos)
+    {
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= pos;
+        w->cached_reads += answered;
+    }
+
+    return answered;
+}
+
+
+static void client_read(struct evloop *ev, struct client *c)
+{
+    struct rig_worker *w = c->worker;
+    char buf[4096];
+    int got_line = 0;
+
+    pthread_mutex_lock(&w->lock);
+
+    for (;;)
+    {
+        ssize_t n = recv(c->sock, buf, sizeof(buf), 0);
+
+        if (n > 0)
+        {
+            if (c->in_len + n > CLIENT_INBUF_MAX
+                    || buf_append(&c->in, &c->in_len, &c->in_size, buf, n) < 0)
+            {
+                rig_debug(RIG_DEBUG_ERR, "%s: input too long from %s:%s\n",
+                          __func__, c->host, c->serv);
+                client_close(ev, c);
+                break;
+            }
+
+            if (memchr(buf, '\n', n))
+            {
+                hl_cache_set(&c->in_time);
+                got_line = 1;
+            }
+
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+
+        if (n < 0)
+        {
+            handle_error(RIG_DEBUG_WARN, "recv");
+            client_close(ev, c);
+            break;
+        }
+
+        /* orderly shutdown, parse what is left and send the replies */
+        c->eof = 1;
+
+        if (c->in_len > 0)
+        {
+            hl_cache_set(&c->in_time);
+            got_line = 1;
+        }
+
+        break;
+    }
+
+    if (got_line && !c->closed && !c->quit)
+    {
+        int answered = 0;
+
+        if (!c->queued && c->move_to < 0)
+        {
+            answered = client_answer_cached(w, c);
+        }
+
+        if (!answered || client_has_command(c))
+        {
+            c->in_ready = 1;
+
+            if (!c->queued && c->move_to < 0)
+            {
+                worker_enqueue(w, c);
+            }
+        }
+    }
+
+    client_update(ev, c);
+
+    pthread_mutex_unlock(&w->lock);
+}
+
+
+static struct client *client_accept(struct evloop *ev, int sock_listen,
+                                    struct rig_worker *w, int vfo_mode)
+{
+    struct sockaddr_storage cli_addr;
+    socklen_t clilen = sizeof(cli_addr);
+    struct client *c;
+    int sock;
+    int retcode;
+
+    sock = accept(sock_listen, (struct sockaddr *)&cli_addr, &clilen);
+
+    if (sock < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            handle_error(RIG_DEBUG_ERR, "accept");
+        }
+
+        return NULL;
+    }
+
+    c = calloc(1, sizeof(struct client));
+
+    if (!c || set_nonblock(sock) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot set up client\n", __func__);
+        free(c);
+        close(sock);
+        return NULL;
+    }
+
+    c->ev_kind = EV_KIND_CLIENT;
+    c->sock = sock;
+    c->worker = w;
+    c->move_to = -1;
+    c->vfo_mode = vfo_mode;
+    c->resp_sep = '\n';
+
+    for (retcode = 0; retcode < RIGCTL_SUB_ITEMS; retcode++)
+    {
+        c->sub_min_ms[retcode] = -1;
+    }
+
+    if ((retcode = getnameinfo((struct sockaddr const *)&cli_addr,
+                               clilen,
+                               c->host,
+                               sizeof(c->host),
+                               c->serv,
+                               sizeof(c->serv),
+                               NI_NOFQDN))
+            < 0)
+    {
+        rig_debug(RIG_DEBUG_WARN,
+                  "Peer lookup error: %s",
+                  gai_strerror(retcode));
+    }
+
+    if (evloop_set(ev, sock, c, EV_IN, 1) < 0)
+    {
+        handle_error(RIG_DEBUG_ERR, "evloop_set");
+        free(c);
+        close(sock);
+        return NULL;
+    }
+
+    c->events = EV_IN;
+    HL_ATOMIC_ADD(w->def->clients, 1);
+
+    rig_debug(RIG_DEBUG_VERBOSE,
+              "Connection opened from %s:%s\n",
+              c->host,
+              c->serv);
+
+    return c;
+}
+
+
+/*
+ * Send what the worker has finished, and move the clients that selected
+ * another rig over to that rig's worker.
+ */
+static void worker_collect(struct evloop *ev, struct rig_worker *w)
+{
+    struct client *c, *next, *moving = NULL;
+    char b[64];
+
+    while (read(w->notify[0], b, sizeof(b)) > 0);
+
+    pthread_mutex_lock(&w->lock);
+
+    for (c = w->done; c; c = next)
+    {
+        next = c->next_done;
+        c->on_done = 0;
+
+        if (c->move_to >= 0 && !c->queued)
+        {
+            c->next_done = moving;
+            moving = c;
+        }
+        else
+        {
+            client_update(ev, c);
+        }
+    }
+
+    w->done = NULL;
+    pthread_mutex_unlock(&w->lock);
+
+    for (c = moving; c; c = next)
+    {
+        next = c->next_done;
+
+        /* no worker has a hold on the client, it is ours to move */
+        w = &workers[c->move_to];
+
+        if (!c->closed)
+        {
+            HL_ATOMIC_ADD(c->worker->def->clients, -1);
+            HL_ATOMIC_ADD(w->def->clients, 1);
+        }
+
+        c->worker = w;
+
+        pthread_mutex_lock(&w->lock);
+        c->move_to = -1;
+
+        if (!c->closed && !c->quit && client_has_command(c))
+        {
+            worker_enqueue(w, c);
+        }
+
+        client_update(ev, c);
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+
+static int serve_clients(struct rig_def *defs, int nrigs, int vfo_mode)
+{
+    struct evloop ev;
+    struct listener listeners[RIGCTLD_MAX_RIGS];
+    struct client *clients = NULL;
+    struct client *c;
+    int i;
+
+    if (evloop_init(&ev) < 0)
+    {
+        handle_error(RIG_DEBUG_ERR, "event loop");
+        return -1;
+    }
+
+    workers = calloc(nrigs, sizeof(struct rig_worker));
+
+    if (!workers)
+    {
+        evloop_cleanup(&ev);
+        return -1;
+    }
+
+    /* a hung rig only holds up its own worker */
+    for (nworkers = 0; nworkers < nrigs; nworkers++)
+    {
+        if (worker_start(&workers[nworkers], defs[nworkers].rig) < 0)
+        {
+            while (nworkers > 0)
+            {
+                worker_stop(&workers[--nworkers]);
+            }
+
+            free(workers);
+            workers = NULL;
+            evloop_cleanup(&ev);
+            return -1;
+        }
+
+        workers[nworkers].def = &defs[nworkers];
+        evloop_set(&ev, workers[nworkers].notify[0], &workers[nworkers], EV_IN, 1);
+    }
+
+    for (i = 0; i < nrigs; i++)
+    {
+        listeners[i].ev_kind = EV_KIND_LISTEN;
+        listeners[i].sock = defs[i].sock_listen;
+        listeners[i].worker = &workers[i];
+
+        if (listeners[i].sock < 0)
+        {
+            continue;
+        }
+
+        if (set_nonblock(listeners[i].sock) < 0)
+        {
+            handle_error(RIG_DEBUG_ERR, "event loop");
+        }
+
+        evloop_set(&ev, listeners[i].sock, &listeners[i], EV_IN, 1);
+    }
+
+    rigctl_set_queue_stats_cb(print_queue_stats);
+    rigctl_set_subscribe_cb(client_subscribe);
+
+    if (nrigs > 1)
+    {
+        rigctl_set_select_rig_cb(client_select_rig);
+    }
+
+    /* wait with a timeout to allow for periodic checks for CTRL+C */
+    while (!ctrl_c)
+    {
+        struct ev_event events[EV_BATCH];
+        struct client *next;
+        int n;
+
+        n = evloop_wait(&ev, events, EV_BATCH, 5000);
+
+        if (n < 0 && errno != EINTR)
+        {
+            handle_error(RIG_DEBUG_ERR, "evloop_wait");
+            break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            int kind = *(int *)events[i].ptr;
+
+            if (kind == EV_KIND_LISTEN)
+            {
+                struct listener *l = events[i].ptr;
+
+                while ((c = client_accept(&ev, l->sock, l->worker, vfo_mode)))
+                {
+                    c->next = clients;
+
+                    if (clients)
+                    {
+                        clients->prev = c;
+                    }
+
+                    clients = c;
+                }
+            }
+            else if (kind == EV_KIND_NOTIFY)
+            {
+                worker_collect(&ev, events[i].ptr);
+            }
+            else
+            {
+                c = events[i].ptr;
+
+                if (c->closed)
+                {
+                    continue;
+                }
+
+                if (events[i].events & EV_IN)
+                {
+                    client_read(&ev, c);
+                }
+                else
+                {
+                    pthread_mutex_lock(&c->worker->lock);
+                    client_update(&ev, c);
+                    pthread_mutex_unlock(&c->worker->lock);
+                }
+            }
+        }
+
+        /* free closed clients once their worker is done with them */
+        for (c = clients; c; c = next)
+        {
+            struct rig_worker *w = c->worker;
+
+            next = c->next;
+
+            if (!c->closed)
+            {
+                continue;
+            }
+
+            pthread_mutex_lock(&w->lock);
+
+            if (c->queued || c->on_done || c->move_to >= 0)
+            {
+                pthread_mutex_unlock(&w->lock);
+                continue;
+            }
+
+            worker_unsubscribe(w, c);
+            pthread_mutex_unlock(&w->lock);
+
+            if (c->prev)
+            {
+                c->prev->next = c->next;
+            }
+            else
+            {
+                clients = c->next;
+            }
+
+            if (c->next)
+            {
+                c->next->prev = c->prev;
+            }
+
+            free(c->in);
+            free(c->out);
+            free(c);
+        }
+    }
+
+    /* print_metrics() stops looking at the workers */
+    i = nworkers;
+    nworkers = 0;
+
+    while (i > 0)
+    {
+        worker_stop(&workers[--i]);
+    }
+
+    rigctl_set_queue_stats_cb(NULL);
+    rigctl_set_subscribe_cb(NULL);
+    rigctl_set_select_rig_cb(NULL);
+
+    for (c = clients; c; c = clients)
+    {
+        clients = c->next;
+
+        if (!c->closed)
+        {
+            close(c->sock);
+        }
+
+        worker_unsubscribe(c->worker, c);
+        free(c->in);
+        free(c->out);
+        free(c);
+    }
+
+    free(workers);
+    workers = NULL;
+    nworkers = 0;
+    evloop_cleanup(&ev);
+
+    return 0;
+}
+
+#endif /* RIGCTLD_EVENT_LOOP */
+
+
+/*
+ * The --metrics-port exposition.  Runs in the metrics thread and reads
+ * the counters as they are, without stopping anyone.
+ */
+static void print_metrics(FILE *fout)
+{
+    static const char *const item_name[HAMLIB_CACHE_SPLIT + 1] =
+    {
+        NULL, "vfo", "freq", "mode", "ptt", "split"
+    };
+    char label_buf[RIGCTLD_MAX_RIGS][64];
+    char *labels[RIGCTLD_MAX_RIGS];
+    rig_port_stats_t port[RIGCTLD_MAX_RIGS];
+    rig_cache_stats_t cache[RIGCTLD_MAX_RIGS];
+    int i, k;
+
+    for (i = 0; i < rig_count; i++)
+    {
+        snprintf(label_buf[i], sizeof(label_buf[i]), "rig=\"%d\",model=\"%u\"",
+                 i + 1, (unsigned)rig_list[i].rig->caps->rig_model);
+        labels[i] = label_buf[i];
+
+        memset(&port[i], 0, sizeof(port[i]));
+        memset(&cache[i], 0, sizeof(cache[i]));
+        rig_get_port_stats(rig_list[i].rig, &port[i]);
+        rig_get_cache_stats(rig_list[i].rig, &cache[i]);
+    }
+
+    rigctl_print_metrics(fout, "rigctld");
+
+    metrics_family(fout, "rigctld", "clients", "gauge", "Connected clients.");
+
+    for (i = 0; i < rig_count; i++)
+    {
+        fprintf(fout, "rigctld_clients{%s} %ld\n", labels[i],
+                (long)rig_list[i].clients);
+    }
+
+    metrics_family(fout, "rigctld", "reopens_total", "counter",
+                   "Times the rig was closed and opened again after an I/O error.");
+
+    for (i = 0; i < rig_count; i++)
+    {
+        fprintf(fout, "rigctld_reopens_total{%s} %lu\n", labels[i],
+                rig_list[i].reopens);
+    }
+
+    metrics_family(fout, "rigctld", "cache_hits_total", "counter",
+                   "Reads answered from the rig cache, by item.");
+
+    for (i = 0; i < rig_count; i++)
+    {
+        for (k = HAMLIB_CACHE_VFO; k <= HAMLIB_CACHE_SPLIT; k++)
+        {
+            fprintf(fout, "rigctld_cache_hits_total{%s,item=\"%s\"} %lu\n",
+                    labels[i], item_name[k], cache[i].hits[k]);
+        }
+
+        fprintf(fout, "rigctld_cache_hits_total{%s,item=\"setting\"} %lu\n",
+                labels[i], cache[i].setting_hits);
+    }
+
+    metrics_family(fout, "rigctld", "cache_misses_total", "counter",
+                   "Reads that had to ask the rig, by item.");
+
+    for (i = 0; i < rig_count; i++)
+    {
+        for (k = HAMLIB_CACHE_VFO; k <= HAMLIB_CACHE_SPLIT; k++)
+        {
+            fprintf(fout, "rigctld_cache_misses_total{%s,item=\"%s\"} %lu\n",
+                    labels[i], item_name[k], cache[i].misses[k]);
+        }
+
+        fprintf(fout, "rigctld_cache_misses_total{%s,item=\"setting\"} %lu\n",
+                labels[i], cache[i].setting_misses);
+    }
+
+#ifdef RIGCTLD_EVENT_LOOP
+    print_queue_metrics(fout, labels);
+#endif
+
+    metrics_print_ports(fout, "rigctld", rig_count, labels, port);
+}
+
+
 void usage(void)
 {
     printf("Usage: rigctld [OPTION]...\n"
@@ -1222,7 +3468,9 @@ void usage(void)
 
 
     printf(
-        "  -m, --model=ID                select radio model number. See model list\n"
+        "  -m, --model=ID                select radio model number. See model list,\n"
+        "                                repeat to serve several radios, each followed\n"
+        "                                by its own -r, -p, -d, -P, -D, -s, -c, -C, -t\n"
         "  -r, --rig-file=DEVICE         set device of the radio to operate on\n"
         "  -p, --ptt-file=DEVICE         set device of the PTT device to operate on\n"
         "  -d, --dcd-file=DEVICE         set device of the DCD device to operate on\n"
@@ -1242,6 +3490,8 @@ void usage(void)
         "  -W, --twiddle_rit             suppress VFOB getfreq so RIT can be twiddled"
         "  -x, --uplink                  set uplink get_freq ignore, 1=Sub, 2=Main\n"
         "  -Z, --debug-time-stamps       enable time stamps for debug messages\n"
+        "  -M, --metrics-port=NUM        serve Prometheus metrics over HTTP on port NUM\n"
+        "  -w, --wirecap-dir=DIR         allow dump_wirecap, saving to files in DIR\n"
         "  -h, --help                    display this help and exit\n"
         "  -V, --version                 output version information and exit\n\n",
         portno);
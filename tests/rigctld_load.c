@@ -0,0 +1,639 @@
+/*
+ * Hamlib rigctld_load program
+ *
+ * Load generator for rigctld.  Runs a number of concurrent TCP clients,
+ * each replaying the traffic of a typical rigctld user, and reports the
+ * throughput and the reply latency per command class as JSON, so two
+ * builds of rigctld can be compared under the same load.
+ *
+ * The traffic mixes, each a loop of commands with the pauses real
+ * programs leave between them:
+ *      wsjtx       v f m t s, once a second, like the WSJT-X poll loop
+ *      logger      f m twice a second
+ *      contest     bursts of set_freq from a tuning knob, keying in between
+ *      panadapter  f and S meter reads every 50 ms
+ *      all         the above, clients take them in turn (default)
+ *
+ *  Usage: rigctld_load [-h host] [-p port] [-c clients] [-t seconds]
+ *                      [-x mix] [-f] [-s rigctld] [-l ms]
+ *      -h host     rigctld to load (default localhost)
+ *      -p port     its TCP port (default 4532)
+ *      -c clients  concurrent clients (default 8)
+ *      -t seconds  how long to run (default 10)
+ *      -x mix      traffic mix, see above
+ *      -f          flood, leave out the pauses
+ *      -s rigctld  start this rigctld on the dummy rig first, on -p port,
+ *                  and stop it at the end
+ *      -l ms       time each dummy rig command takes with -s (default 20),
+ *                  see the dummy rig's cmd_delay
+ *
+ * Example:
+ *      rigctld_load -s ./rigctld -c 32 -x all -t 30 > after.json
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MAX_CLIENTS     1024
+
+enum load_class_e
+{
+    LOAD_READ,      /* v f m t s */
+    LOAD_TUNE,      /* set_freq */
+    LOAD_PTT,       /* set_ptt */
+    LOAD_METER,     /* get_level */
+    LOAD_CLASSES
+};
+
+static const char *const class_name[LOAD_CLASSES] =
+{
+    "read", "tune", "ptt", "meter"
+};
+
+/*
+ * One command of a mix.  lines is how many lines a good reply has in the
+ * default protocol, an error is always the one RPRT line.  A "%ld" in cmd
+ * is a frequency moving up with every use.
+ */
+struct step
+{
+    const char *cmd;
+    int lines;
+    int cls;
+    int pause_ms;       /* after the reply */
+};
+
+static const struct step mix_wsjtx[] =
+{
+    { "v\n", 1, LOAD_READ, 0 },
+    { "f\n", 1, LOAD_READ, 0 },
+    { "m\n", 2, LOAD_READ, 0 },
+    { "t\n", 1, LOAD_READ, 0 },
+    { "s\n", 2, LOAD_READ, 1000 },
+    { NULL }
+};
+
+static const struct step mix_logger[] =
+{
+    { "f\n", 1, LOAD_READ, 0 },
+    { "m\n", 2, LOAD_READ, 500 },
+    { NULL }
+};
+
+static const struct step mix_contest[] =
+{
+    { "F %ld\n", 1, LOAD_TUNE, 20 },
+    { "F %ld\n", 1, LOAD_TUNE, 20 },
+    { "F %ld\n", 1, LOAD_TUNE, 20 },
+    { "F %ld\n", 1, LOAD_TUNE, 20 },
+    { "F %ld\n", 1, LOAD_TUNE, 200 },
+    { "T 1\n", 1, LOAD_PTT, 500 },
+    { "T 0\n", 1, LOAD_PTT, 0 },
+    { "f\n", 1, LOAD_READ, 1000 },
+    { NULL }
+};
+
+static const struct step mix_panadapter[] =
+{
+    { "f\n", 1, LOAD_READ, 0 },
+    { "l STRENGTH\n", 1, LOAD_METER, 50 },
+    { NULL }
+};
+
+static const struct
+{
+    const char *name;
+    const struct step *steps;
+} mixes[] =
+{
+    { "wsjtx", mix_wsjtx },
+    { "logger", mix_logger },
+    { "contest", mix_contest },
+    { "panadapter", mix_panadapter },
+    { NULL }
+};
+
+/* latencies of one class, in us */
+struct samples
+{
+    double *us;
+    size_t n, size;
+    unsigned long errors;
+};
+
+struct load_client
+{
+    pthread_t thread;
+    const struct step *steps;
+    long freq;
+    int failed;
+    struct samples s[LOAD_CLASSES];
+};
+
+static const char *host = "localhost";
+static const char *port = "4532";
+static int flood;
+static double deadline;
+
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+static int connect_rigctld(void)
+{
+    struct addrinfo hints, *res, *ai;
+    int sock = -1;
+    int one = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+    {
+        return -1;
+    }
+
+    for (ai = res; ai; ai = ai->ai_next)
+    {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+        if (sock < 0)
+        {
+            continue;
+        }
+
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if (sock >= 0)
+    {
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    return sock;
+}
+
+
+static int add_sample(struct samples *s, double us)
+{
+    if (s->n == s->size)
+    {
+        size_t size = s->size ? s->size * 2 : 4096;
+        double *p = realloc(s->us, size * sizeof(double));
+
+        if (!p)
+        {
+            return -1;
+        }
+
+        s->us = p;
+        s->size = size;
+    }
+
+    s->us[s->n++] = us;
+
+    return 0;
+}
+
+
+/*
+ * Read one reply of up to lines lines.  buf keeps what came after it for
+ * the next one.  Returns 1 for a good reply, 0 for an RPRT error, -1 when
+ * the connection is gone.
+ */
+static int read_reply(int sock, char *buf, size_t size, size_t *len,
+                      int lines)
+{
+    int got = 0;
+    int rc = 1;
+
+    for (;;)
+    {
+        char *nl;
+
+        while ((nl = memchr(buf, '\n', *len)))
+        {
+            size_t used = nl - buf + 1;
+
+            if (got == 0 && !strncmp(buf, "RPRT ", 5))
+            {
+                rc = atoi(buf + 5) == 0;
+                lines = 1;
+            }
+
+            memmove(buf, nl + 1, *len - used);
+            *len -= used;
+
+            if (++got == lines)
+            {
+                return rc;
+            }
+        }
+
+        if (*len == size)
+        {
+            return -1;
+        }
+
+        {
+            ssize_t n = recv(sock, buf + *len, size - *len, 0);
+
+            if (n <= 0)
+            {
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+
+                return -1;
+            }
+
+            *len += n;
+        }
+    }
+}
+
+
+static void *client_thread(void *arg)
+{
+    struct load_client *c = arg;
+    char buf[4096];
+    size_t len = 0;
+    int sock;
+
+    sock = connect_rigctld();
+
+    if (sock < 0)
+    {
+        c->failed = 1;
+        return NULL;
+    }
+
+    while (now_us() < deadline)
+    {
+        const struct step *st;
+
+        for (st = c->steps; st->cmd && now_us() < deadline; st++)
+        {
+            char cmd[64];
+            double start;
+            int rc;
+
+            snprintf(cmd, sizeof(cmd), st->cmd, c->freq);
+
+            if (strchr(st->cmd, '%'))
+            {
+                c->freq = c->freq < 14350000 ? c->freq + 100 : 14000000;
+            }
+
+            start = now_us();
+
+            if (send(sock, cmd, strlen(cmd), 0) < 0)
+            {
+                c->failed = 1;
+                break;
+            }
+
+            rc = read_reply(sock, buf, sizeof(buf), &len, st->lines);
+
+            if (rc < 0)
+            {
+                c->failed = 1;
+                break;
+            }
+
+            if (add_sample(&c->s[st->cls], now_us() - start) < 0)
+            {
+                c->failed = 1;
+                break;
+            }
+
+            if (!rc)
+            {
+                c->s[st->cls].errors++;
+            }
+
+            if (!flood && st->pause_ms)
+            {
+                double left = deadline - now_us();
+
+                if (left > 0)
+                {
+                    usleep(left < st->pause_ms * 1e3 ? left : st->pause_ms * 1e3);
+                }
+            }
+        }
+
+        if (c->failed)
+        {
+            break;
+        }
+    }
+
+    close(sock);
+
+    return NULL;
+}
+
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+/* nearest rank, s sorted */
+static double percentile(const struct samples *s, double pct)
+{
+    size_t rank;
+
+    if (!s->n)
+    {
+        return 0;
+    }
+
+    rank = (size_t)(pct / 100 * s->n + 0.5);
+
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    if (rank > s->n)
+    {
+        rank = s->n;
+    }
+
+    return s->us[rank - 1];
+}
+
+
+static pid_t start_rigctld(const char *path, int delay_ms)
+{
+    char conf[32];
+    pid_t pid;
+    int i;
+
+    snprintf(conf, sizeof(conf), "cmd_delay=%d", delay_ms);
+
+    pid = fork();
+
+    if (pid < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        execl(path, path, "-m", "1", "-t", port, "-C", conf, (char *)NULL);
+        perror(path);
+        _exit(1);
+    }
+
+    /* ready once it takes connections */
+    for (i = 0; i < 100; i++)
+    {
+        int sock;
+
+        usleep(100 * 1000);
+
+        sock = connect_rigctld();
+
+        if (sock >= 0)
+        {
+            close(sock);
+            return pid;
+        }
+    }
+
+    fprintf(stderr, "%s does not answer on port %s\n", path, port);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    return -1;
+}
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: rigctld_load [-h host] [-p port] [-c clients] [-t seconds]\n"
+            "                    [-x wsjtx|logger|contest|panadapter|all] [-f]\n"
+            "                    [-s rigctld] [-l ms]\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    static struct load_client clients[MAX_CLIENTS];
+    struct samples all[LOAD_CLASSES];
+    const char *mix = "all";
+    const char *rigctld = NULL;
+    int nclients = 8;
+    int seconds = 10;
+    int delay_ms = 20;
+    int mix_idx = -1;
+    unsigned long total = 0, errors = 0;
+    double start, elapsed;
+    pid_t pid = 0;
+    int opt;
+    int i, k;
+
+    while ((opt = getopt(argc, argv, "h:p:c:t:x:fs:l:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+            host = optarg;
+            break;
+
+        case 'p':
+            port = optarg;
+            break;
+
+        case 'c':
+            nclients = atoi(optarg);
+            break;
+
+        case 't':
+            seconds = atoi(optarg);
+            break;
+
+        case 'x':
+            mix = optarg;
+            break;
+
+        case 'f':
+            flood = 1;
+            break;
+
+        case 's':
+            rigctld = optarg;
+            break;
+
+        case 'l':
+            delay_ms = atoi(optarg);
+            break;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (nclients < 1 || nclients > MAX_CLIENTS || seconds < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    if (strcmp(mix, "all"))
+    {
+        for (i = 0; mixes[i].name && strcmp(mixes[i].name, mix); i++);
+
+        if (!mixes[i].name)
+        {
+            usage();
+            return 1;
+        }
+
+        mix_idx = i;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if (rigctld)
+    {
+        pid = start_rigctld(rigctld, delay_ms);
+
+        if (pid < 0)
+        {
+            return 1;
+        }
+    }
+
+    start = now_us();
+    deadline = start + seconds * 1e6;
+
+    for (i = 0; i < nclients; i++)
+    {
+        int m = mix_idx >= 0 ? mix_idx : i % 4;
+
+        clients[i].steps = mixes[m].steps;
+        clients[i].freq = 14000000 + i * 1000;
+
+        if (pthread_create(&clients[i].thread, NULL, client_thread, &clients[i]))
+        {
+            fprintf(stderr, "pthread_create failed\n");
+            nclients = i;
+            break;
+        }
+    }
+
+    memset(all, 0, sizeof(all));
+
+    for (i = 0; i < nclients; i++)
+    {
+        pthread_join(clients[i].thread, NULL);
+
+        if (clients[i].failed)
+        {
+            fprintf(stderr, "client %d lost its connection\n", i + 1);
+        }
+
+        for (k = 0; k < LOAD_CLASSES; k++)
+        {
+            struct samples *s = &clients[i].s[k];
+            size_t j;
+
+            for (j = 0; j < s->n; j++)
+            {
+                add_sample(&all[k], s->us[j]);
+            }
+
+            all[k].errors += s->errors;
+            free(s->us);
+        }
+    }
+
+    elapsed = (now_us() - start) / 1e6;
+
+    if (pid > 0)
+    {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+
+    for (k = 0; k < LOAD_CLASSES; k++)
+    {
+        total += all[k].n;
+        errors += all[k].errors;
+    }
+
+    printf("{\n");
+    printf("  \"clients\": %d,\n", nclients);
+    printf("  \"mix\": \"%s\",\n", mix);
+    printf("  \"flood\": %s,\n", flood ? "true" : "false");
+    printf("  \"seconds\": %.3f,\n", elapsed);
+    printf("  \"commands\": %lu,\n", total);
+    printf("  \"errors\": %lu,\n", errors);
+    printf("  \"per_second\": %.1f,\n", total / elapsed);
+    printf("  \"classes\": {");
+
+    for (k = 0, i = 0; k < LOAD_CLASSES; k++)
+    {
+        struct samples *s = &all[k];
+
+        if (!s->n)
+        {
+            continue;
+        }
+
+        qsort(s->us, s->n, sizeof(double), cmp_double);
+
+        printf("%s\n    \"%s\": {\"commands\": %lu, \"errors\": %lu, "
+               "\"per_second\": %.1f, \"p50_ms\": %.3f, \"p99_ms\": %.3f, "
+               "\"p999_ms\": %.3f, \"max_ms\": %.3f}",
+               i++ ? "," : "", class_name[k], (unsigned long)s->n, s->errors,
+               s->n / elapsed, percentile(s, 50) / 1e3,
+               percentile(s, 99) / 1e3, percentile(s, 99.9) / 1e3,
+               s->us[s->n - 1] / 1e3);
+
+        free(s->us);
+    }
+
+    printf("\n  }\n}\n");
+
+    return 0;
+}
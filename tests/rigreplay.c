@@ -0,0 +1,736 @@
+/*
+ * rigreplay - replay a recorded CAT session as a benchmark
+ *
+ *  Copyright (c) 2021 by the Hamlib group
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation; either version 2
+ *   of the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The capture is a pcap file saved with the dump_wirecap command of
+ * rigctl or rigctld while talking to the real radio, see rigcapdump.
+ * Each command sent in it, with the frames the radio sent back before the
+ * next command, is one recorded exchange.
+ *
+ * A thread behind a pty plays the radio: every command the backend sends
+ * is looked up among the recorded ones, in recorded order, and answered
+ * with the recorded reply after the recorded delay.  A command that was
+ * never recorded, like set_freq to another frequency, gets the reply of
+ * the recorded command of the same length it shares the longest start
+ * with.  The backend opens the pty as its serial port and a fixed list of
+ * API calls is run over it, with the cache off so every call reaches the
+ * port.  Each call is reported with its port transactions (writes) and
+ * wall time, both as averages per call.
+ *
+ * The capture should start before rig_open, or the open will not find
+ * its replies.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include <hamlib/rig.h>
+
+
+#define SIM_GAP_MS      50      /* a command is complete after this quiet */
+
+struct frame
+{
+    int dir;
+    double t_us;
+    unsigned char *data;
+    int len;
+};
+
+/* a recorded command and the frames received until the next one */
+struct exchange
+{
+    const struct frame *tx;
+    int first_rx, nrx;
+};
+
+static struct frame *frames;
+static int nframes;
+static struct exchange *exchanges;
+static int nexchanges;
+
+static int sim_master;
+static int sim_timing = 1;
+static unsigned long sim_exact, sim_nearest, sim_unknown;
+
+static freq_t last_freq;
+static rmode_t last_mode = RIG_MODE_USB;
+static pbwidth_t last_width = RIG_PASSBAND_NORMAL;
+
+struct call
+{
+    const char *name;
+    int (*run)(RIG *rig);
+    unsigned long count, errors, writes;
+    double us;
+};
+
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+static uint32_t swap32(uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+
+/*
+ * Read the capture into frames[] and group it into exchanges[], frames
+ * received before the first command are dropped.
+ */
+static int load_capture(const char *path)
+{
+    uint32_t file_hdr[6];
+    int swapped;
+    int size = 0;
+    int i;
+    FILE *fp;
+
+    fp = fopen(path, "rb");
+
+    if (!fp)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(file_hdr, sizeof(file_hdr), 1, fp) != 1
+            || (file_hdr[0] != 0xa1b2c3d4 && file_hdr[0] != 0xd4c3b2a1))
+    {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    swapped = file_hdr[0] == 0xd4c3b2a1;
+
+    if ((swapped ? swap32(file_hdr[5]) : file_hdr[5]) != RIG_WIRECAP_LINKTYPE)
+    {
+        fprintf(stderr, "%s: not a Hamlib capture\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    while (1)
+    {
+        uint32_t rec[4];    /* ts_sec, ts_usec, incl_len, orig_len */
+        struct frame *f;
+
+        if (fread(rec, sizeof(rec), 1, fp) != 1)
+        {
+            break;
+        }
+
+        if (swapped)
+        {
+            for (i = 0; i < 4; i++) { rec[i] = swap32(rec[i]); }
+        }
+
+        if (rec[2] < 1 || rec[2] > 65536)
+        {
+            fprintf(stderr, "%s: truncated capture\n", path);
+            break;
+        }
+
+        if (nframes == size)
+        {
+            struct frame *p;
+
+            size = size ? size * 2 : 1024;
+            p = realloc(frames, size * sizeof(*frames));
+
+            if (!p)
+            {
+                fclose(fp);
+                return -1;
+            }
+
+            frames = p;
+        }
+
+        f = &frames[nframes];
+        f->data = malloc(rec[2]);
+
+        if (!f->data || fread(f->data, rec[2], 1, fp) != 1)
+        {
+            fprintf(stderr, "%s: truncated capture\n", path);
+            free(f->data);
+            break;
+        }
+
+        /* the direction byte goes, the frame moves up over it */
+        f->dir = f->data[0];
+        f->len = rec[2] - 1;
+        memmove(f->data, f->data + 1, f->len);
+        f->t_us = rec[0] * 1e6 + rec[1];
+        nframes++;
+    }
+
+    fclose(fp);
+
+    exchanges = calloc(nframes + 1, sizeof(*exchanges));
+
+    if (!exchanges)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < nframes; i++)
+    {
+        if (frames[i].dir == RIG_WIRECAP_TX && frames[i].len > 0)
+        {
+            exchanges[nexchanges].tx = &frames[i];
+            exchanges[nexchanges].first_rx = i + 1;
+            nexchanges++;
+        }
+        else if (nexchanges > 0 && frames[i].len > 0)
+        {
+            exchanges[nexchanges - 1].nrx++;
+        }
+    }
+
+    return nexchanges > 0 ? 0 : -1;
+}
+
+
+/*
+ * The exchange for the len bytes in buf, starting the search after the
+ * last one used.  Returns -2 while buf is the start of a recorded command
+ * and more may come, -1 when nothing fits.
+ */
+static int sim_match(const unsigned char *buf, int len, int cursor,
+                     int complete, int *used)
+{
+    int best = -1, best_len = 1;
+    int i, k;
+
+    for (k = 0; k < nexchanges; k++)
+    {
+        const struct frame *tx;
+
+        i = (cursor + k) % nexchanges;
+        tx = exchanges[i].tx;
+
+        if (tx->len <= len && !memcmp(tx->data, buf, tx->len))
+        {
+            *used = tx->len;
+            sim_exact++;
+            return i;
+        }
+    }
+
+    if (!complete)
+    {
+        for (i = 0; i < nexchanges; i++)
+        {
+            const struct frame *tx = exchanges[i].tx;
+
+            if (tx->len > len && !memcmp(tx->data, buf, len))
+            {
+                return -2;
+            }
+        }
+    }
+
+    for (k = 0; k < nexchanges; k++)
+    {
+        const struct frame *tx;
+        int n;
+
+        i = (cursor + k) % nexchanges;
+        tx = exchanges[i].tx;
+
+        if (tx->len != len)
+        {
+            continue;
+        }
+
+        for (n = 0; n < len && tx->data[n] == buf[n]; n++);
+
+        if (n > best_len)
+        {
+            best = i;
+            best_len = n;
+        }
+    }
+
+    if (best >= 0)
+    {
+        *used = len;
+        sim_nearest++;
+    }
+
+    return best;
+}
+
+
+static void sim_reply(int e, const unsigned char *cmd, int cmd_len,
+                      double start)
+{
+    const struct exchange *ex = &exchanges[e];
+    int i, sent = 0;
+
+    for (i = ex->first_rx; sent < ex->nrx; i++)
+    {
+        const struct frame *rx = &frames[i];
+        const unsigned char *data = rx->data;
+        int len = rx->len;
+
+        if (rx->len == 0)
+        {
+            continue;
+        }
+
+        sent++;
+
+        /* an echo of the recorded command echoes the one sent instead */
+        if (i == ex->first_rx && len == ex->tx->len
+                && !memcmp(data, ex->tx->data, len))
+        {
+            data = cmd;
+            len = cmd_len;
+        }
+
+        if (sim_timing)
+        {
+            double wait = start + (rx->t_us - ex->tx->t_us) - now_us();
+
+            if (wait > 0)
+            {
+                usleep(wait);
+            }
+        }
+
+        if (write(sim_master, data, len) < 0)
+        {
+            return;
+        }
+    }
+}
+
+
+/* the radio, until the port is closed */
+static void *sim_thread(void *arg)
+{
+    unsigned char buf[4096];
+    int len = 0;
+    int cursor = 0;
+
+    while (1)
+    {
+        struct pollfd pfd;
+        int complete = 0;
+        int rc;
+
+        pfd.fd = sim_master;
+        pfd.events = POLLIN;
+
+        rc = poll(&pfd, 1, len ? SIM_GAP_MS : -1);
+
+        if (rc < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (rc == 0)
+        {
+            complete = 1;
+        }
+        else
+        {
+            ssize_t n;
+
+            if (rc < 0 || ((pfd.revents & (POLLHUP | POLLERR))
+                           && !(pfd.revents & POLLIN)))
+            {
+                usleep(10 * 1000);  /* no slave open yet, or between opens */
+                continue;
+            }
+
+            n = read(sim_master, buf + len, sizeof(buf) - len);
+
+            if (n <= 0)
+            {
+                continue;
+            }
+
+            len += n;
+            complete = len == sizeof(buf);
+        }
+
+        while (len > 0)
+        {
+            double start = now_us();
+            int used = 0;
+            int e = sim_match(buf, len, cursor, complete, &used);
+
+            if (e == -2)
+            {
+                break;
+            }
+
+            if (e == -1)
+            {
+                sim_unknown++;
+                len = 0;
+                break;
+            }
+
+            sim_reply(e, buf, used, start);
+            cursor = e + 1;
+            memmove(buf, buf + used, len - used);
+            len -= used;
+        }
+    }
+
+    return NULL;
+}
+
+
+static int call_get_freq(RIG *rig)
+{
+    return rig_get_freq(rig, RIG_VFO_CURR, &last_freq);
+}
+
+static int call_set_freq(RIG *rig)
+{
+    return rig_set_freq(rig, RIG_VFO_CURR, last_freq > 0 ? last_freq : 14074000);
+}
+
+static int call_get_mode(RIG *rig)
+{
+    return rig_get_mode(rig, RIG_VFO_CURR, &last_mode, &last_width);
+}
+
+static int call_set_mode(RIG *rig)
+{
+    return rig_set_mode(rig, RIG_VFO_CURR, last_mode, last_width);
+}
+
+static int call_get_vfo(RIG *rig)
+{
+    vfo_t vfo;
+
+    return rig_get_vfo(rig, &vfo);
+}
+
+static int call_get_ptt(RIG *rig)
+{
+    ptt_t ptt;
+
+    return rig_get_ptt(rig, RIG_VFO_CURR, &ptt);
+}
+
+static int call_get_split_vfo(RIG *rig)
+{
+    split_t split;
+    vfo_t tx_vfo;
+
+    return rig_get_split_vfo(rig, RIG_VFO_CURR, &split, &tx_vfo);
+}
+
+static int call_get_strength(RIG *rig)
+{
+    value_t val;
+
+    return rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_STRENGTH, &val);
+}
+
+static struct call calls[] =
+{
+    { "get_freq", call_get_freq },
+    { "get_mode", call_get_mode },
+    { "get_vfo", call_get_vfo },
+    { "get_ptt", call_get_ptt },
+    { "get_split_vfo", call_get_split_vfo },
+    { "get_level STRENGTH", call_get_strength },
+    { "set_freq", call_set_freq },
+    { "set_mode", call_set_mode },
+    { NULL }
+};
+
+
+static unsigned long port_writes(RIG *rig)
+{
+    rig_port_stats_t stats;
+
+    if (rig_get_port_stats(rig, &stats) != RIG_OK)
+    {
+        return 0;
+    }
+
+    return stats.writes;
+}
+
+
+static void timed_call(RIG *rig, struct call *c)
+{
+    unsigned long writes = port_writes(rig);
+    double start = now_us();
+
+    if (c->run(rig) != RIG_OK)
+    {
+        c->errors++;
+    }
+
+    c->us += now_us() - start;
+    c->writes += port_writes(rig) - writes;
+    c->count++;
+}
+
+
+static void print_call(const struct call *c)
+{
+    if (!c->count)
+    {
+        return;
+    }
+
+    printf("%-20s %6lu %6lu %12.2f %10.3f\n", c->name, c->count, c->errors,
+           (double)c->writes / c->count, c->us / c->count / 1e3);
+}
+
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [OPTION]... FILE\n"
+           "Replay a capture saved by the dump_wirecap command against the\n"
+           "backend and time its API calls.\n\n",
+           name);
+
+    printf(
+        "  -m, --model=ID        radio model the capture was taken from\n"
+        "  -s, --serial-speed=BAUD  serial speed the backend sets\n"
+        "  -C, --set-conf=PARM=VAL  set config parameters\n"
+        "  -l, --loops=NUM       rounds of API calls (default 10)\n"
+        "  -z, --no-timing       answer at once, not with the recorded delays\n"
+        "  -h, --help            display this help and exit\n"
+        "  -V, --version         output version information and exit\n\n"
+    );
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"model",        1, 0, 'm'},
+        {"serial-speed", 1, 0, 's'},
+        {"set-conf",     1, 0, 'C'},
+        {"loops",        1, 0, 'l'},
+        {"no-timing",    0, 0, 'z'},
+        {"help",         0, 0, 'h'},
+        {"version",      0, 0, 'V'},
+        {0, 0, 0, 0}
+    };
+    rig_model_t model = RIG_MODEL_DUMMY;
+    const char *conf[16];
+    int nconf = 0;
+    int serial_rate = 0;
+    int loops = 10;
+    struct call open_call = { "rig_open" };
+    pthread_t thread;
+    RIG *rig;
+    double start;
+    int retcode;
+    int i, k;
+
+    while (1)
+    {
+        int c = getopt_long(argc, argv, "m:s:C:l:zhV", long_options, NULL);
+
+        if (c == -1)
+        {
+            break;
+        }
+
+        switch (c)
+        {
+        case 'm':
+            model = atoi(optarg);
+            break;
+
+        case 's':
+            serial_rate = atoi(optarg);
+            break;
+
+        case 'C':
+            if (nconf < 16)
+            {
+                conf[nconf++] = optarg;
+            }
+
+            break;
+
+        case 'l':
+            loops = atoi(optarg);
+            break;
+
+        case 'z':
+            sim_timing = 0;
+            break;
+
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+
+        case 'V':
+            printf("rigreplay, %s\n", hamlib_version);
+            exit(0);
+
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    if (load_capture(argv[optind]) < 0)
+    {
+        fprintf(stderr, "%s: no commands to replay\n", argv[optind]);
+        exit(1);
+    }
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    sim_master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (sim_master < 0 || grantpt(sim_master) < 0 || unlockpt(sim_master) < 0)
+    {
+        perror("posix_openpt");
+        exit(1);
+    }
+
+    rig = rig_init(model);
+
+    if (!rig)
+    {
+        fprintf(stderr, "Unknown rig num %u\n", (unsigned)model);
+        exit(1);
+    }
+
+    strncpy(rig->state.rigport.pathname, ptsname(sim_master),
+            HAMLIB_FILPATHLEN - 1);
+
+    if (serial_rate)
+    {
+        rig->state.rigport.parm.serial.rate = serial_rate;
+    }
+
+    for (i = 0; i < nconf; i++)
+    {
+        char name[64];
+        const char *val = strchr(conf[i], '=');
+
+        if (!val || val - conf[i] >= sizeof(name))
+        {
+            fprintf(stderr, "bad conf %s\n", conf[i]);
+            exit(1);
+        }
+
+        snprintf(name, sizeof(name), "%.*s", (int)(val - conf[i]), conf[i]);
+
+        retcode = rig_set_conf(rig, rig_token_lookup(rig, name), val + 1);
+
+        if (retcode != RIG_OK)
+        {
+            fprintf(stderr, "%s: %s\n", conf[i], rigerror(retcode));
+            exit(1);
+        }
+    }
+
+    pthread_create(&thread, NULL, sim_thread, NULL);
+
+    printf("%s: %d frames, %d commands, %s timing\n", argv[optind], nframes,
+           nexchanges, sim_timing ? "recorded" : "no");
+
+    start = now_us();
+    retcode = rig_open(rig);
+    open_call.us = now_us() - start;
+    open_call.count = 1;
+    open_call.errors = retcode != RIG_OK;
+    open_call.writes = port_writes(rig);
+
+    if (retcode != RIG_OK)
+    {
+        printf("rig_open: error = %s\n", rigerror(retcode));
+        exit(2);
+    }
+
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, 0);
+
+    start = now_us();
+
+    for (k = 0; k < loops; k++)
+    {
+        for (i = 0; calls[i].name; i++)
+        {
+            timed_call(rig, &calls[i]);
+        }
+    }
+
+    printf("\n%-20s %6s %6s %12s %10s\n", "call", "count", "errors",
+           "transactions", "ms");
+    print_call(&open_call);
+
+    for (i = 0; calls[i].name; i++)
+    {
+        print_call(&calls[i]);
+    }
+
+    printf("\n%d rounds in %.3f s\n", loops, (now_us() - start) / 1e6);
+    printf("simulator: %lu commands answered, %lu by nearest match, "
+           "%lu unknown\n", sim_exact + sim_nearest, sim_nearest, sim_unknown);
+
+    rig_close(rig);
+    rig_cleanup(rig);
+
+    return 0;
+}
@@ -37,31 +37,6 @@
 #include <ctype.h>
 #include <errno.h>
 
-#ifdef HAVE_LIBREADLINE
-#  if defined(HAVE_READLINE_READLINE_H)
-#    include <readline/readline.h>
-#  elif defined(HAVE_READLINE_H)    /* !defined(HAVE_READLINE_READLINE_H) */
-#    include <readline.h>
-#  else                             /* !defined(HAVE_READLINE_H) */
-extern char *readline();
-#  endif                            /* HAVE_READLINE_H */
-#else
-/* no readline */
-#endif                              /* HAVE_LIBREADLINE */
-
-#ifdef HAVE_READLINE_HISTORY
-#  if defined(HAVE_READLINE_HISTORY_H)
-#    include <readline/history.h>
-#  elif defined(HAVE_HISTORY_H)
-#    include <history.h>
-#  else                             /* !defined(HAVE_HISTORY_H) */
-extern void add_history();
-extern int write_history();
-extern int read_history();
-#  endif                            /* defined(HAVE_READLINE_HISTORY_H) */
-/* no history */
-#endif                              /* HAVE_READLINE_HISTORY */
-
 #include <hamlib/rotator.h>
 #include "serial.h"
 #include "misc.h"
@@ -85,6 +60,9 @@ extern int read_history();
 #endif
 
 #include "rotctl_parse.h"
+#include "cmd_index.h"
+#include "cmd_engine.h"
+#include "metrics.h"
 #include "sprintflst.h"
 
 /* Hash table implementation See:  http://uthash.sourceforge.net/ */
@@ -96,39 +74,13 @@ extern int read_history();
 static pthread_mutex_t rot_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
-#define STR1(S) #S
-#define STR(S) STR1(S)
-
-#define MAXNAMSIZ 32
 #define MAXNBOPT 100    /* max number of different options */
 #define MAXARGSZ 127
 
-#define ARG_IN1  0x01
-#define ARG_OUT1 0x02
-#define ARG_IN2  0x04
-#define ARG_OUT2 0x08
-#define ARG_IN3  0x10
-#define ARG_OUT3 0x20
-#define ARG_IN4  0x40
-#define ARG_OUT4 0x80
-#define ARG_IN_LINE 0x4000
-
-#define ARG_NONE    0
-#define ARG_IN  (ARG_IN1|ARG_IN2|ARG_IN3|ARG_IN4)
-#define ARG_OUT  (ARG_OUT1|ARG_OUT2|ARG_OUT3|ARG_OUT4)
-
-/* variables for readline support */
 #ifdef HAVE_LIBREADLINE
-static char *input_line = (char *)NULL;
-static char *result = (char *)NULL;
-static char *parsed_input[sizeof(char *) * 7];
 static const int have_rl = 1;
 #endif
 
-#ifdef HAVE_READLINE_HISTORY
-static char *rp_hist_buf = (char *)NULL;
-#endif
-
 struct test_table
 {
     unsigned char cmd;
@@ -244,22 +196,48 @@ struct test_table test_list[] =
 };
 
 
-struct test_table *find_cmd_entry(int cmd)
+static struct cmd_index cmd_idx;
+static struct cmd_metrics cmd_metrics[256];   /* by command char */
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t cmd_idx_once = PTHREAD_ONCE_INIT;
+#endif
+
+static void build_cmd_index(void)
 {
-    int i;
+    cmd_index_build(&cmd_idx, test_list, sizeof(test_list[0]), MAXNAMSIZ);
+}
 
-    for (i = 0; test_list[i].cmd != 0x00; i++)
-        if (test_list[i].cmd == cmd)
-        {
-            break;
-        }
 
-    if (test_list[i].cmd == 0x00)
+/* the index is built on first use, from whichever thread gets there first */
+static const struct cmd_index *get_cmd_index(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_once(&cmd_idx_once, build_cmd_index);
+#else
+    static int built;
+
+    if (!built)
     {
-        return NULL;
+        build_cmd_index();
+        built = 1;
     }
 
-    return &test_list[i];
+#endif
+    return &cmd_idx;
+}
+
+
+/* Prometheus text for the commands run so far, see metrics_print_cmds() */
+void rotctl_print_metrics(FILE *fout, const char *prefix)
+{
+    metrics_print_cmds(fout, prefix, get_cmd_index(), cmd_metrics);
+}
+
+
+struct test_table *find_cmd_entry(int cmd)
+{
+    return (struct test_table *)cmd_index_find_cmd(get_cmd_index(), cmd);
 }
 
 
@@ -333,180 +311,11 @@ void hash_delete_all()
 }
 
 
-#ifdef HAVE_LIBREADLINE
-/* Frees allocated memory and sets pointers to NULL before calling readline
- * and then parses the input into space separated tokens.
- */
-static void rp_getline(const char *s)
-{
-    int i;
-
-    /* free allocated memory and set pointers to NULL */
-    if (input_line)
-    {
-        free(input_line);
-        input_line = (char *)NULL;
-    }
-
-    if (result)
-    {
-        result = (char *)NULL;
-    }
-
-    /* cmd, arg1, arg2, arg3, arg4, arg5, arg6
-     * arg5 and arg 6 are currently unused.
-     */
-    for (i = 0; i < 7; i++)
-    {
-        parsed_input[i] = NULL;
-    }
-
-    /* Action!  Returns typed line with newline stripped. */
-    input_line = readline(s);
-}
-#endif
-
-
-/*
- * TODO: use Lex?
- */
 char parse_arg(const char *arg)
 {
-    int i;
+    const struct cmd_index_row *row = cmd_index_find_name(get_cmd_index(), arg);
 
-    for (i = 0; test_list[i].cmd != 0; i++)
-    {
-        if (!strncmp(arg, test_list[i].name, MAXNAMSIZ))
-        {
-            return test_list[i].cmd;
-        }
-    }
-
-    return 0;
-}
-
-
-/*
- * This scanf works even in presence of signals (timer, SIGIO, ..)
- */
-static int scanfc(FILE *fin, const char *format, void *p)
-{
-    do
-    {
-        int ret;
-
-        ret = fscanf(fin, format, p);
-
-        if (ret < 0)
-        {
-            if (errno == EINTR)
-            {
-                continue;
-            }
-
-            rig_debug(RIG_DEBUG_ERR, "fscanf: %s\n", strerror(errno));
-            rig_debug(RIG_DEBUG_ERR, "fscanf: parsing '%s' with '%s'\n", (char *)p, format);
-        }
-
-        return ret;
-    }
-    while (1);
-}
-
-
-/*
- * function to get the next word from the command line or from stdin
- * until stdin exhausted. stdin is read if the special token '-' is
- * found on the command line.
- *
- * returns EOF when words exhausted
- * returns <0 is error number
- * returns >=0 when successful
- */
-static int next_word(char *buffer, int argc, char *argv[], int newline)
-{
-    int ret;
-    char c;
-    static int reading_stdin;
-
-    if (!reading_stdin)
-    {
-        if (optind >= argc)
-        {
-            return EOF;
-        }
-        else if (newline
-                 && '-' == argv[optind][0]
-                 && 1 == strlen(argv[optind]))
-        {
-
-            ++optind;
-            reading_stdin = 1;
-        }
-    }
-
-    if (reading_stdin)
-    {
-        do
-        {
-            do
-            {
-                ret = scanf(" %c%" STR(MAXARGSZ) "[^ \t\n#]", &c, &buffer[1]);
-            }
-            while (EINTR == ret);
-
-            if (ret > 0 && '#' == c)
-            {
-                do
-                {
-                    ret = scanf("%*[^\n]");
-                }
-                while (EINTR == ret);   /* consume comments */
-
-                ret = 0;
-            }
-        }
-        while (!ret);
-
-        if (EOF == ret)
-        {
-            reading_stdin = 0;
-        }
-        else if (ret < 0)
-        {
-            rig_debug(RIG_DEBUG_ERR, "scanf: %s\n", strerror(errno));
-            reading_stdin = 0;
-        }
-        else
-        {
-            buffer[0] = c;
-            buffer[1 == ret ? 1 : MAXARGSZ] = '\0';
-
-            if (newline)
-            {
-                putchar('\n');
-            }
-
-            fputs(buffer, stdout);
-            putchar(' ');
-        }
-    }
-
-    if (!reading_stdin)
-    {
-        if (optind < argc)
-        {
-            strncpy(buffer, argv[optind++], MAXARGSZ);
-            buffer[MAXARGSZ] = '\0';
-            ret = 1;
-        }
-        else
-        {
-            ret = EOF;
-        }
-    }
-
-    return ret;
+    return row ? row->cmd : 0;
 }
 
 
@@ -518,14 +327,19 @@ static int next_word(char *buffer, int argc, char *argv[], int newline)
     })
 
 
+static const struct cmd_proto rot_proto = { NETROTCTL_RET, MAXARGSZ, 0 };
+
+
 int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
                  int interactive, int prompt, char send_cmd_term)
 {
     int retcode;            /* generic return code from functions */
+    unsigned long start_us;
     unsigned char cmd;
     struct test_table *cmd_entry = NULL;
     int ext_resp = 0;
     char resp_sep = '\n';
+    struct cmd_source src = { fin, fout, interactive, prompt, argc, argv };
 
     char command[MAXARGSZ + 1];
     char arg1[MAXARGSZ + 1], *p1 = NULL;
@@ -554,7 +368,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
 
             do
             {
-                if (scanfc(fin, "%c", &cmd) < 1)
+                if (cmd_scanfc(fin, "%c", &cmd) < 1)
                 {
                     return -1;
                 }
@@ -566,7 +380,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
                 {
                     ext_resp = 1;
 
-                    if (scanfc(fin, "%c", &cmd) < 1)
+                    if (cmd_scanfc(fin, "%c", &cmd) < 1)
                     {
                         return -1;
                     }
@@ -586,7 +400,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
                     ext_resp = 1;
                     resp_sep = cmd;
 
-                    if (scanfc(fin, "%c", &cmd) < 1)
+                    if (cmd_scanfc(fin, "%c", &cmd) < 1)
                     {
                         return -1;
                     }
@@ -607,14 +421,14 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
                     unsigned char cmd_name[MAXNAMSIZ], *pcmd = cmd_name;
                     int c_len = MAXNAMSIZ;
 
-                    if (scanfc(fin, "%c", pcmd) < 1)
+                    if (cmd_scanfc(fin, "%c", pcmd) < 1)
                     {
                         return -1;
                     }
 
                     while (c_len-- && (isalnum(*pcmd) || *pcmd == '_'))
                     {
-                        if (scanfc(fin, "%c", ++pcmd) < 1)
+                        if (cmd_scanfc(fin, "%c", ++pcmd) < 1)
                         {
                             return -1;
                         }
@@ -649,7 +463,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
             {
                 while (cmd != '\n' && cmd != '\r')
                 {
-                    if (scanfc(fin, "%c", &cmd) < 1)
+                    if (cmd_scanfc(fin, "%c", &cmd) < 1)
                     {
                         return -1;
                     }
@@ -673,7 +487,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
         else
         {
             /* parse rest of command line */
-            retcode = next_word(command, argc, argv, 1);
+            retcode = cmd_next_word(command, MAXARGSZ, argc, argv, 1);
 
             if (EOF == retcode)
             {
@@ -700,233 +514,22 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
             fprintf_flush(stderr, "Command '%c' not found!\n", cmd);
             return 0;
         }
-
-        if ((cmd_entry->flags & ARG_IN_LINE)
-                && (cmd_entry->flags & ARG_IN1)
-                && cmd_entry->arg1)
-        {
-
-            if (interactive)
-            {
-                char *nl;
-
-                if (prompt)
-                {
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg1);
-                }
-
-                if (fgets(arg1, MAXARGSZ, fin) == NULL)
-                {
-                    return -1;
-                }
-
-                if (arg1[0] == 0xa)
-                {
-                    if (fgets(arg1, MAXARGSZ, fin) == NULL)
-                    {
-                        return -1;
-                    }
-                }
-
-                nl = strchr(arg1, 0xa);
-
-                if (nl)
-                {
-                    *nl = '\0';    /* chomp */
-                }
-
-                p1 = arg1[0] == ' ' ? arg1 + 1 : arg1;
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr,
-                            "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
-
-                p1 = arg1;
-            }
-        }
-        else  if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
-        {
-            if (interactive)
-            {
-                if (prompt)
-                {
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg1);
-                }
-
-                if (scanfc(fin, "%s", arg1) < 1)
-                {
-                    return -1;
-                }
-
-                p1 = arg1;
-            }
-            else
-            {
-                retcode = next_word(arg1, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr,
-                            "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
-
-                p1 = arg1;
-            }
-        }
-
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN2)
-                && cmd_entry->arg2)
-        {
-
-            if (interactive)
-            {
-                if (prompt)
-                {
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg2);
-                }
-
-                if (scanfc(fin, "%s", arg2) < 1)
-                {
-                    return -1;
-                }
-
-                p2 = arg2;
-            }
-            else
-            {
-                retcode = next_word(arg2, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr,
-                            "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
-
-                p2 = arg2;
-            }
-        }
-
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN3)
-                && cmd_entry->arg3)
-        {
-
-            if (interactive)
-            {
-                if (prompt)
-                {
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg3);
-                }
-
-                if (scanfc(fin, "%s", arg3) < 1)
-                {
-                    return -1;
-                }
-
-                p3 = arg3;
-            }
-            else
-            {
-                retcode = next_word(arg3, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr,
-                            "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
-
-                p3 = arg3;
-            }
-        }
-
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN4)
-                && cmd_entry->arg4)
-        {
-
-            if (interactive)
-            {
-                if (prompt)
-                {
-                    fprintf_flush(fout, "%s: ", cmd_entry->arg4);
-                }
-
-                if (scanfc(fin, "%s", arg4) < 1)
-                {
-                    return -1;
-                }
-
-                p4 = arg4;
-            }
-            else
-            {
-                retcode = next_word(arg4, argc, argv, 0);
-
-                if (EOF == retcode)
-                {
-                    fprintf(stderr,
-                            "Invalid arg for command '%s'\n",
-                            cmd_entry->name);
-                    return 1;
-                }
-                else if (retcode < 0)
-                {
-                    return retcode;
-                }
-
-                p4 = arg4;
-            }
-        }
     }
 
 #ifdef HAVE_LIBREADLINE
 
     if (interactive && prompt && have_rl)
     {
-        int j, x;
+        char *input_line;
+        char *result;
+        int j;
 
-#ifdef HAVE_READLINE_HISTORY
         /* Minimum space for 32+1+128+1+128+1+128+1+128+1+128+1+128+1 = 807
          * chars, so allocate 896 chars cleared to zero for safety.
          */
-        rp_hist_buf = (char *)calloc(896, sizeof(char));
-#endif
+        cmd_rl_history_begin(896);
 
-        rp_getline("\nRotator command: ");
+        input_line = cmd_rl_getline("\nRotator command: ");
 
         /* EOF (Ctl-D) received on empty input line, bail out gracefully. */
         if (!input_line)
@@ -972,42 +575,28 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
          */
         result = strtok(input_line, " ");
 
-        /* parsed_input stores pointers into input_line where the token strings
-         * start.
-         */
-        if (result)
-        {
-            parsed_input[0] = result;
-        }
-        else
+        if (!result)
         {
             /* Oops!  Invoke GDB!! */
             fprintf_flush(fout, "\n");
             return 1;
         }
 
-        /* At this point parsed_input contains the typed text of the command
+        /* At this point result holds the typed text of the command
          * with surrounding space characters removed.  If Readline History is
          * available, copy the command string into a history buffer.
          */
 
         /* Single character command */
-        if ((strlen(parsed_input[0]) == 1) && (*parsed_input[0] != '\\'))
+        if ((strlen(result) == 1) && (*result != '\\'))
         {
-            cmd = *parsed_input[0];
-
-#ifdef HAVE_READLINE_HISTORY
+            cmd = *result;
 
             /* Store what is typed, not validated, for history. */
-            if (rp_hist_buf)
-            {
-                strncpy(rp_hist_buf, parsed_input[0], 1);
-            }
-
-#endif
+            cmd_rl_history_add(result, 1);
         }
-        /* Test the command token, parsed_input[0] */
-        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) > 1))
+        /* Test the command token */
+        else if ((*result == '\\') && (strlen(result) > 1))
         {
             char cmd_name[MAXNAMSIZ];
 
@@ -1015,23 +604,17 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
              * srncpy() doesn't add one even if the supplied length is less
              * than the destination array.  Truncate the source string here.
              */
-            if (strlen(parsed_input[0] + 1) >= MAXNAMSIZ)
+            if (strlen(result + 1) >= MAXNAMSIZ)
             {
-                *(parsed_input[0] + MAXNAMSIZ) = '\0';
+                *(result + MAXNAMSIZ) = '\0';
             }
 
-#ifdef HAVE_READLINE_HISTORY
-
-            if (rp_hist_buf)
-            {
-                strncpy(rp_hist_buf, parsed_input[0], MAXNAMSIZ);
-            }
+            cmd_rl_history_add(result, MAXNAMSIZ);
 
-#endif
             /* The starting position of the source string is the first
              * character past the initial '\'.
              */
-            snprintf(cmd_name, sizeof(cmd_name), "%s", parsed_input[0] + 1);
+            snprintf(cmd_name, sizeof(cmd_name), "%s", result + 1);
 
             /* Sanity check as valid multiple character commands consist of
              * alphanumeric characters and the underscore ('_') character.
@@ -1049,7 +632,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
             cmd = parse_arg(cmd_name);
         }
         /* Single '\' entered, prompt again */
-        else if ((*parsed_input[0] == '\\') && (strlen(parsed_input[0]) == 1))
+        else if ((*result == '\\') && (strlen(result) == 1))
         {
             return 0;
         }
@@ -1066,7 +649,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
         {
             if (cmd == '\0')
             {
-                fprintf(stderr, "Command '%s' not found!\n", parsed_input[0]);
+                fprintf(stderr, "Command '%s' not found!\n", result);
             }
             else
             {
@@ -1075,324 +658,65 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
 
             return 0;
         }
+    }
 
-        /* \send_cmd */
-        if ((cmd_entry->flags & ARG_IN_LINE)
-                && (cmd_entry->flags & ARG_IN1)
-                && cmd_entry->arg1)
-        {
-
-            /* Check for a non-existent delimiter so as to not break up
-             * remaining line into separate tokens (spaces OK).
-             */
-            result = strtok(NULL, "\0");
-
-            if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
-                x = 0;
-
-                strcpy(pmptstr, cmd_entry->arg1);
-                strcat(pmptstr, ": ");
-
-                rp_getline(pmptstr);
-
-                if (input_line == NULL)
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-                /* Blank line entered */
-                else if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
-                else
-                {
-                    parsed_input[x] = input_line;
-                }
-            }
-
-            /* The arg1 array size is MAXARGSZ + 1 so truncate it to fit if larger. */
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
-
-#ifdef HAVE_READLINE_HISTORY
-
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
+#endif // HAVE_LIBREADLINE
 
-#endif
-            strcpy(arg1, parsed_input[x]);
-            p1 = arg1;
-        }
+    if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
+    {
+        p1 = cmd_read_arg(&rot_proto, &src, cmd_entry->name, cmd_entry->arg1,
+                          (cmd_entry->flags & ARG_IN_LINE) ? CMD_ARG_LINE
+                          : CMD_ARG_WORD, arg1, &retcode);
 
-        /* Normal argument parsing. */
-        else if ((cmd_entry->flags & ARG_IN1) && cmd_entry->arg1)
+        if (!p1)
         {
-            result = strtok(NULL, " ");
-
-            if (result)
-            {
-                x = 1;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg1) + 3)];
-                x = 0;
-
-                strcpy(pmptstr, cmd_entry->arg1);
-                strcat(pmptstr, ": ");
-
-                rp_getline(pmptstr);
-
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
-
-                result = strtok(input_line, " ");
-
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
-
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
-
-#ifdef HAVE_READLINE_HISTORY
-
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
-
-#endif
-            strcpy(arg1, parsed_input[x]);
-            p1 = arg1;
+            return retcode;
         }
+    }
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN2)
-                && cmd_entry->arg2)
-        {
-
-            result = strtok(NULL, " ");
-
-            if (result)
-            {
-                x = 2;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg2) + 3)];
-                x = 0;
-
-                strcpy(pmptstr, cmd_entry->arg2);
-                strcat(pmptstr, ": ");
-
-                rp_getline(pmptstr);
-
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
-
-                result = strtok(input_line, " ");
-
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
-
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
-
-#ifdef HAVE_READLINE_HISTORY
-
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
-
-#endif
-            strcpy(arg2, parsed_input[x]);
-            p2 = arg2;
-        }
+    if (p1
+            && p1[0] != '?'
+            && (cmd_entry->flags & ARG_IN2)
+            && cmd_entry->arg2)
+    {
+        p2 = cmd_read_arg(&rot_proto, &src, cmd_entry->name, cmd_entry->arg2,
+                          CMD_ARG_WORD, arg2, &retcode);
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN3)
-                && cmd_entry->arg3)
+        if (!p2)
         {
-
-            result = strtok(NULL, " ");
-
-            if (result)
-            {
-                x = 3;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg3) + 3)];
-                x = 0;
-
-                strcpy(pmptstr, cmd_entry->arg3);
-                strcat(pmptstr, ": ");
-
-                rp_getline(pmptstr);
-
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
-
-                result = strtok(input_line, " ");
-
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
-
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
-
-#ifdef HAVE_READLINE_HISTORY
-
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
-
-#endif
-            strcpy(arg3, parsed_input[x]);
-            p3 = arg3;
+            return retcode;
         }
+    }
 
-        if (p1
-                && p1[0] != '?'
-                && (cmd_entry->flags & ARG_IN4)
-                && cmd_entry->arg4)
-        {
-
-            result = strtok(NULL, " ");
-
-            if (result)
-            {
-                x = 4;
-                parsed_input[x] = result;
-            }
-            else
-            {
-                char pmptstr[(strlen(cmd_entry->arg4) + 3)];
-                x = 0;
-
-                strcpy(pmptstr, cmd_entry->arg4);
-                strcat(pmptstr, ": ");
-
-                rp_getline(pmptstr);
-
-                if (!(strcmp(input_line, "")))
-                {
-                    fprintf(fout, "? for help, q to quit.\n");
-                    fflush(fout);
-                    return 0;
-                }
-
-                result = strtok(input_line, " ");
-
-                if (result)
-                {
-                    parsed_input[x] = result;
-                }
-                else
-                {
-                    fprintf_flush(fout, "\n");
-                    return 1;
-                }
-            }
-
-            if (strlen(parsed_input[x]) > MAXARGSZ)
-            {
-                parsed_input[x][MAXARGSZ] = '\0';
-            }
-
-#ifdef HAVE_READLINE_HISTORY
-
-            if (rp_hist_buf)
-            {
-                strncat(rp_hist_buf, " ", 2);
-                strncat(rp_hist_buf, parsed_input[x], MAXARGSZ);
-            }
+    if (p1
+            && p1[0] != '?'
+            && (cmd_entry->flags & ARG_IN3)
+            && cmd_entry->arg3)
+    {
+        p3 = cmd_read_arg(&rot_proto, &src, cmd_entry->name, cmd_entry->arg3,
+                          CMD_ARG_WORD, arg3, &retcode);
 
-#endif
-            strcpy(arg4, parsed_input[x]);
-            p4 = arg4;
+        if (!p3)
+        {
+            return retcode;
         }
+    }
 
-#ifdef HAVE_READLINE_HISTORY
+    if (p1
+            && p1[0] != '?'
+            && (cmd_entry->flags & ARG_IN4)
+            && cmd_entry->arg4)
+    {
+        p4 = cmd_read_arg(&rot_proto, &src, cmd_entry->name, cmd_entry->arg4,
+                          CMD_ARG_WORD, arg4, &retcode);
 
-        if (rp_hist_buf)
+        if (!p4)
         {
-            add_history(rp_hist_buf);
-            free(rp_hist_buf);
-            rp_hist_buf = (char *)NULL;
+            return retcode;
         }
-
-#endif
     }
 
-#endif // HAVE_LIBREADLINE
+    cmd_rl_history_end();
 
     /*
      * mutex locking needed because rotctld is multithreaded
@@ -1419,19 +743,12 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
      */
     if (interactive && ext_resp && !prompt)
     {
-        char a1[MAXARGSZ + 2];
-        char a2[MAXARGSZ + 2];
-        char a3[MAXARGSZ + 2];
-        char a4[MAXARGSZ + 2];
-
-        p1 == NULL ? a1[0] = '\0' : snprintf(a1, sizeof(a1), " %s", p1);
-        p2 == NULL ? a2[0] = '\0' : snprintf(a2, sizeof(a2), " %s", p2);
-        p3 == NULL ? a3[0] = '\0' : snprintf(a3, sizeof(a3), " %s", p3);
-        p4 == NULL ? a4[0] = '\0' : snprintf(a4, sizeof(a4), " %s", p4);
+        const char *args[] = { p1, p2, p3, p4 };
 
-        fprintf(fout, "%s:%s%s%s%s%c", cmd_entry->name, a1, a2, a3, a4, resp_sep);
+        cmd_reply_begin(fout, cmd_entry->name, args, 4, resp_sep);
     }
 
+    start_us = metrics_now_us();
     retcode = (*cmd_entry->rot_routine)(my_rot,
                                         fout,
                                         interactive,
@@ -1452,53 +769,17 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, char *argv[], int argc,
                                         "");
 #endif
 
+    metrics_cmd_record(&cmd_metrics[cmd_entry->cmd], metrics_now_us() - start_us,
+                       retcode != RIG_OK);
+
 #ifdef HAVE_PTHREAD
     pthread_mutex_unlock(&rot_mutex);
 #endif
 
     if (retcode == RIG_EIO) { return retcode; }
 
-    if (retcode != RIG_OK)
-    {
-        /* only for rotctld */
-        if (interactive && !prompt)
-        {
-            rot_debug(RIG_DEBUG_TRACE, "%s: NETROTCTL_RET %d\n", __func__, retcode);
-            fprintf(fout, NETROTCTL_RET "%d\n", retcode);
-            // ext_resp = 0; // not used ?
-            resp_sep = '\n';
-        }
-        else
-        {
-            if (cmd_entry->name != NULL)
-            {
-                fprintf(fout, "%s: error = %s\n", cmd_entry->name, rigerror(retcode));
-            }
-        }
-    }
-    else
-    {
-        /* only for rotctld */
-        if (interactive && !prompt)
-        {
-            /* netrotctl RIG_OK */
-            if (!(cmd_entry->flags & ARG_OUT) && !ext_resp)
-            {
-                rot_debug(RIG_DEBUG_TRACE, "%s: NETROTCTL_RET 0\n", __func__);
-                fprintf(fout, NETROTCTL_RET "0\n");
-            }
-
-            /* Extended Response protocol */
-            else if (ext_resp && cmd != 0xf0)
-            {
-                rot_debug(RIG_DEBUG_TRACE, "%s: NETROTCTL_RET 0\n", __func__);
-                fprintf(fout, NETROTCTL_RET "0\n");
-                resp_sep = '\n';
-            }
-        }
-    }
-
-    fflush(fout);
+    cmd_reply_end(&rot_proto, fout, interactive && !prompt, cmd_entry->name,
+                  retcode, cmd_entry->flags & ARG_OUT, &ext_resp, &resp_sep);
 
     return retcode != RIG_OK ? 2 : 0;
 }
@@ -0,0 +1,119 @@
+/*
+ * Hamlib sample program for the asynchronous request engine
+ *
+ * Drives one rig (dummy by default) from a poll() loop:
+ * requests without callback are collected through rig_async_get_fd(),
+ * one request completes through a callback instead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <poll.h>
+
+#include <hamlib/rig.h>
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+
+static int callbacks;
+
+static void ptt_done(RIG *rig, rig_async_req_t *req, rig_ptr_t arg)
+{
+    printf("callback: set_ptt %s\n", rigerror(req->retcode));
+    callbacks++;
+}
+
+
+int main(int argc, char *argv[])
+{
+    RIG *my_rig;
+    rig_async_req_t set_freq, get_freq, set_ptt;
+    struct pollfd pfd;
+    int pending = 2;
+    int retcode;
+
+    rig_set_debug_level(RIG_DEBUG_NONE);
+
+    my_rig = rig_init(argc > 1 ? atoi(argv[1]) : RIG_MODEL_DUMMY);
+
+    if (!my_rig)
+    {
+        fprintf(stderr, "Unknown rig num\n");
+        exit(1);
+    }
+
+    retcode = rig_open(my_rig);
+
+    if (retcode != RIG_OK)
+    {
+        printf("rig_open: error = %s\n", rigerror(retcode));
+        exit(2);
+    }
+
+    retcode = rig_async_open(my_rig);
+
+    if (retcode != RIG_OK)
+    {
+        printf("rig_async_open: error = %s\n", rigerror(retcode));
+        exit(3);
+    }
+
+    memset(&set_freq, 0, sizeof(set_freq));
+    set_freq.op = RIG_ASYNC_SET_FREQ;
+    set_freq.vfo = RIG_VFO_CURR;
+    set_freq.freq = 14074000;
+
+    memset(&get_freq, 0, sizeof(get_freq));
+    get_freq.op = RIG_ASYNC_GET_FREQ;
+    get_freq.vfo = RIG_VFO_CURR;
+
+    memset(&set_ptt, 0, sizeof(set_ptt));
+    set_ptt.op = RIG_ASYNC_SET_PTT;
+    set_ptt.vfo = RIG_VFO_CURR;
+    set_ptt.ptt = RIG_PTT_OFF;
+    set_ptt.cb = ptt_done;
+
+    rig_async_submit(my_rig, &set_freq);
+    rig_async_submit(my_rig, &get_freq);
+    rig_async_submit(my_rig, &set_ptt);
+
+    pfd.fd = rig_async_get_fd(my_rig);
+    pfd.events = POLLIN;
+
+    while (pending > 0)
+    {
+        rig_async_req_t *req;
+
+        if (poll(&pfd, 1, 5000) <= 0)
+        {
+            printf("timed out waiting for completions\n");
+            exit(4);
+        }
+
+        while ((req = rig_async_next_done(my_rig)) != NULL)
+        {
+            printf("done: op=%d %s\n", req->op, rigerror(req->retcode));
+            pending--;
+        }
+    }
+
+    /* also waits for the callback request to run */
+    rig_async_close(my_rig);
+
+    printf("freq=%.0f callbacks=%d\n", get_freq.freq, callbacks);
+
+    rig_close(my_rig);
+    rig_cleanup(my_rig);
+
+    if (set_freq.retcode != RIG_OK || get_freq.retcode != RIG_OK
+            || get_freq.freq != 14074000 || callbacks != 1)
+    {
+        return 1;
+    }
+
+    return 0;
+}